@@ -0,0 +1,193 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// Frame-scoped linear allocator.
+// Every in-flight frame owns one FrameArena : allocations bump an atomic
+// offset (so worker threads may allocate concurrently) and nothing is freed
+// until reset() at the start of the next use of that frame. If a frame needs
+// more than the block, the extra goes to overflow blocks and the block is
+// grown to the peak at the next reset, so steady-state frames never touch the
+// heap.
+//
+// Define FRAME_ARENA_DEBUG to poison memory on reset and to make every
+// FrameArray access check that its frame is still alive.
+
+struct FrameArenaStats
+{
+	uint32_t allocations;   // this frame
+	size_t bytes;           // this frame, overflow included
+	size_t peakBytes;       // over all frames
+	uint32_t overflows;     // heap blocks allocated this frame
+	size_t capacity;
+};
+
+class FrameArena
+{
+public:
+	explicit FrameArena(size_t capacity = 1 << 20)
+		: block((unsigned char *)malloc(capacity)), capacity(capacity), offset(0), allocations(0),
+		  overflowBytes(0), overflowCount(0), peakBytes(0), currentGeneration(1)
+	{
+		memset(&lastStats, 0, sizeof(lastStats));
+	}
+
+	~FrameArena()
+	{
+		free(block);
+		releaseOverflow();
+	}
+
+	// Thread safe. The memory is not initialised.
+	void *allocate(size_t bytes, size_t align = 16)
+	{
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		size_t padded = (bytes + align - 1) & ~(align - 1);
+		size_t start = offset.fetch_add(padded + align, std::memory_order_relaxed);
+		size_t aligned = (start + align - 1) & ~(align - 1);
+		if (aligned + bytes <= capacity)
+			return block + aligned;
+
+		// Slow path, the block is full
+		std::lock_guard<std::mutex> lock(overflowMutex);
+		void *p = malloc(bytes + align);
+		overflow.push_back(p);
+		overflowBytes += bytes;
+		return (void *)(((uintptr_t)p + align - 1) & ~(uintptr_t)(align - 1));
+	}
+
+	template <class T> T *allocArray(size_t count)
+	{
+		return (T *)allocate(count * sizeof(T), alignof(T) > 16 ? alignof(T) : 16);
+	}
+
+	// Start of a new frame : everything allocated before is gone
+	void reset()
+	{
+		size_t used = usedBytes();
+		if (used > peakBytes)
+			peakBytes = used;
+		if (!overflow.empty())
+		{
+			// Grow so the next frames fit in one block
+			releaseOverflow();
+			capacity = peakBytes + peakBytes / 4;
+			free(block);
+			block = (unsigned char *)malloc(capacity);
+		}
+#ifdef FRAME_ARENA_DEBUG
+		memset(block, 0xDD, capacity);
+#endif
+		lastStats.allocations = allocations.load();
+		lastStats.bytes = used;
+		lastStats.overflows = overflowCount;
+		overflowCount = 0;
+		offset.store(0);
+		allocations.store(0);
+		overflowBytes = 0;
+		currentGeneration++;
+	}
+
+	// Bumped by every reset
+	uint64_t generation() const { return currentGeneration; }
+
+	// Figures of the frame before the last reset
+	FrameArenaStats stats() const
+	{
+		FrameArenaStats s = lastStats;
+		s.peakBytes = peakBytes;
+		s.capacity = capacity;
+		return s;
+	}
+
+private:
+	size_t usedBytes() const
+	{
+		size_t used = offset.load();
+		return (used < capacity ? used : capacity) + overflowBytes;
+	}
+
+	void releaseOverflow()
+	{
+		overflowCount += (uint32_t)overflow.size();
+		for (size_t i = 0; i < overflow.size(); i++)
+			free(overflow[i]);
+		overflow.clear();
+	}
+
+	unsigned char *block;
+	size_t capacity;
+	std::atomic<size_t> offset;
+	std::atomic<uint32_t> allocations;
+	std::mutex overflowMutex;
+	std::vector<void *> overflow;
+	size_t overflowBytes;
+	uint32_t overflowCount;
+	size_t peakBytes;
+	uint64_t currentGeneration;
+	FrameArenaStats lastStats;
+
+	FrameArena(const FrameArena &);
+	FrameArena &operator=(const FrameArena &);
+};
+
+// Fixed size array allocated in a frame arena, valid until the arena is reset
+template <class T> class FrameArray
+{
+public:
+	FrameArray() : items(NULL), length(0), arena(NULL), generation(0) {}
+
+	FrameArray(FrameArena &frame, size_t count)
+		: items(count ? frame.allocArray<T>(count) : NULL), length(count), arena(&frame), generation(frame.generation())
+	{
+	}
+
+	T &operator[](size_t i) const
+	{
+		check();
+		return items[i];
+	}
+
+	T *data() const
+	{
+		check();
+		return items;
+	}
+
+	size_t size() const { return length; }
+	bool empty() const { return length == 0; }
+
+	// Only the first `count` items are used from now on
+	void shrink(size_t count)
+	{
+		if (count < length)
+			length = count;
+	}
+
+private:
+	void check() const
+	{
+#ifdef FRAME_ARENA_DEBUG
+		if (arena && arena->generation() != generation)
+		{
+			fprintf(stderr, "Frame memory used after its frame ended (allocated in generation %llu, arena is at %llu)\n",
+					(unsigned long long)generation, (unsigned long long)arena->generation());
+			abort();
+		}
+#endif
+	}
+
+	T *items;
+	size_t length;
+	const FrameArena *arena;
+	uint64_t generation;
+};
+
+#endif
@@ -0,0 +1,397 @@
+#ifndef ATLAS_HPP
+#define ATLAS_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "image.hpp"
+#include "resources.hpp"
+
+// Texture packing.
+// Every distinct texture is a bind, and a bind ends a multi-draw batch. Two
+// ways to give differently textured objects one texture, so they share a
+// draw :
+//   atlas : the images packed side by side into one 2D texture by a skyline
+//           packer, each draw gets the offset and scale of its image
+//   array : the images are the layers of a GL_TEXTURE_2D_ARRAY, each draw
+//           gets its layer. All images must have the same size.
+// The per-draw part is the `texture` of the draw's material (materials.hpp),
+// see g_textured_fragment_shader.
+//
+// Atlas images are repeated inside their region with fract(), so their
+// borders are filled with wrapped texels. Mip levels are built on the CPU
+// with a box filter : images are placed on a grid of 2^(levels - 1) texels
+// and surrounded by as many border texels, so up to the last level a texel
+// never mixes two images and bilinear lookups stay inside their own image.
+// Coarser levels are not built, the atlas stops at `levels`.
+
+#define TEXTURE_UNIT_ALBEDO 3 // deferred uses 0 to 2, shadows 6 and 7
+#define ATLAS_LEVELS 4		  // mip levels kept clean in an atlas, 8 texel borders
+
+enum TexturePacking
+{
+	TEXTURES_SEPARATE,
+	TEXTURES_ATLAS,
+	TEXTURES_ARRAY
+};
+
+static const char *const g_texture_packing_names[] = {"separate", "atlas", "array"};
+
+// StandardShading of step8 with the diffuse color from the draw's image.
+// drawTexture : offset and scale of the image, (0, 0, 1, 1) for a whole texture.
+// The gradients of the unwrapped coordinates keep the mip level across the fract() seams.
+static const char *const g_textured_fragment_shader = R"(#version 430 core
+in vec3 Position_worldspace;
+in vec3 Normal_cameraspace;
+in vec3 EyeDirection_cameraspace;
+in vec3 LightDirection_cameraspace;
+in vec3 fragmentColor;
+in vec3 Position_modelspace;
+flat in vec4 drawTexture;
+out vec3 color;
+uniform vec3 LightPosition_worldspace;
+layout(binding = 3) uniform sampler2D albedo;
+void main()
+{
+	vec2 textureUV = boxProjection(Position_modelspace);
+	vec2 uv = drawTexture.xy + fract(textureUV) * drawTexture.zw;
+	vec3 MaterialDiffuseColor = textureGrad(albedo, uv, dFdx(textureUV) * drawTexture.zw, dFdy(textureUV) * drawTexture.zw).rgb;
+	float distance = length(LightPosition_worldspace - Position_worldspace);
+	color = standardShading(MaterialDiffuseColor, vec4(0.3, 0.3, 0.3, 5.0), Normal_cameraspace, LightDirection_cameraspace,
+							EyeDirection_cameraspace, distance, 1.0);
+}
+)";
+
+// Same with the layer drawTexture.x of an array texture, repeated by the sampler
+static const char *const g_layered_fragment_shader = R"(#version 430 core
+in vec3 Position_worldspace;
+in vec3 Normal_cameraspace;
+in vec3 EyeDirection_cameraspace;
+in vec3 LightDirection_cameraspace;
+in vec3 fragmentColor;
+in vec3 Position_modelspace;
+flat in vec4 drawTexture;
+out vec3 color;
+uniform vec3 LightPosition_worldspace;
+layout(binding = 3) uniform sampler2DArray albedo;
+void main()
+{
+	vec2 textureUV = boxProjection(Position_modelspace);
+	vec3 MaterialDiffuseColor = texture(albedo, vec3(textureUV, drawTexture.x)).rgb;
+	float distance = length(LightPosition_worldspace - Position_worldspace);
+	color = standardShading(MaterialDiffuseColor, vec4(0.3, 0.3, 0.3, 5.0), Normal_cameraspace, LightDirection_cameraspace,
+							EyeDirection_cameraspace, distance, 1.0);
+}
+)";
+
+// One texture per image, full mip chain : what the atlas and the array replace
+inline TextureId uploadImage(GpuResources &resources, const TextureImage &image)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	TextureImage level = image;
+	GLint l = 0;
+	for (;; l++)
+	{
+		glTexImage2D(GL_TEXTURE_2D, l, GL_RGBA8, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, level.texels.data());
+		if (level.width == 1 && level.height == 1)
+			break;
+		level = downsampleImage(level);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, l);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return resources.adoptTexture(texture);
+}
+
+// Bottom-left skyline packing : each rectangle goes where its top is the
+// lowest, leftmost on ties. The skyline is the top of what is packed, as
+// horizontal segments left to right.
+class SkylinePacker
+{
+public:
+	SkylinePacker() : width(0), height(0), used(0) {}
+
+	void reset(int w, int h)
+	{
+		width = w;
+		height = h;
+		used = 0;
+		Segment floor = {0, 0, w};
+		skyline.assign(1, floor);
+	}
+
+	// Position of a w x h rectangle, false when it does not fit
+	bool pack(int w, int h, int &x, int &y)
+	{
+		size_t best = skyline.size();
+		int bestX = 0, bestY = height;
+		for (size_t i = 0; i < skyline.size(); i++)
+		{
+			int top;
+			if (fits(i, w, h, top) && (top < bestY || (top == bestY && skyline[i].x < bestX)))
+			{
+				best = i;
+				bestX = skyline[i].x;
+				bestY = top;
+			}
+		}
+		if (best == skyline.size())
+			return false;
+
+		// The new segment covers the start of the ones under it
+		Segment top = {bestX, bestY + h, w};
+		skyline.insert(skyline.begin() + best, top);
+		for (size_t i = best + 1; i < skyline.size();)
+		{
+			int covered = top.x + top.width - skyline[i].x;
+			if (covered <= 0)
+				break;
+			skyline[i].x += covered;
+			skyline[i].width -= covered;
+			if (skyline[i].width > 0)
+				break;
+			skyline.erase(skyline.begin() + i);
+		}
+		for (size_t i = 1; i < skyline.size();)
+			if (skyline[i].y == skyline[i - 1].y)
+			{
+				skyline[i - 1].width += skyline[i].width;
+				skyline.erase(skyline.begin() + i);
+			}
+			else
+				i++;
+
+		x = bestX;
+		y = bestY;
+		used += (int64_t)w * h;
+		return true;
+	}
+
+	// Packed area over the whole area
+	double occupancy() const { return width && height ? (double)used / ((double)width * height) : 0.0; }
+
+private:
+	struct Segment
+	{
+		int x;
+		int y; // top of what is packed under
+		int width;
+	};
+
+	// Whether a rectangle starting at segment `index` fits, `top` : where its bottom goes
+	bool fits(size_t index, int w, int h, int &top) const
+	{
+		if (skyline[index].x + w > width)
+			return false;
+		top = 0;
+		for (int remaining = w; remaining > 0; index++)
+		{
+			top = std::max(top, skyline[index].y);
+			if (top + h > height)
+				return false;
+			remaining -= skyline[index].width;
+		}
+		return true;
+	}
+
+	std::vector<Segment> skyline;
+	int width;
+	int height;
+	int64_t used;
+};
+
+// Images packed into one texture. add() them, build(), then upload().
+class TextureAtlas
+{
+public:
+	TextureAtlas() : width(0), height(0), block(1), occupied(0.0) {}
+
+	// Copies the image, returns its index
+	uint32_t add(const TextureImage &image)
+	{
+		images.push_back(image);
+		return (uint32_t)images.size() - 1;
+	}
+
+	// Packs the images into the smallest power of two up to maxSize a side,
+	// false when they do not fit. Power of two images keep every level clean.
+	bool build(int maxSize, int levels = ATLAS_LEVELS)
+	{
+		block = 1 << (levels - 1);
+		// Tallest first, the skyline stays flat longer
+		std::vector<uint32_t> order(images.size());
+		int64_t area = 0;
+		for (uint32_t i = 0; i < images.size(); i++)
+		{
+			order[i] = i;
+			area += (int64_t)blocks(images[i].width) * blocks(images[i].height) * block * block;
+		}
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return images[a].height > images[b].height; });
+
+		// Square or twice as wide, smallest first
+		regions.assign(images.size(), glm::ivec2(0, 0));
+		for (int w = block; w <= maxSize; w *= 2)
+			for (int h = w / 2; h <= w; h = h == w / 2 ? w : w + 1)
+			{
+				if (h < block || (int64_t)w * h < area || !packAll(order, w, h))
+					continue;
+				compose(levels);
+				return true;
+			}
+		fprintf(stderr, "Texture atlas : %u images do not fit in %dx%d\n", (unsigned)images.size(), maxSize, maxSize);
+		return false;
+	}
+
+	TextureId upload(GpuResources &resources) const
+	{
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		for (size_t level = 0; level < levels.size(); level++)
+			glTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_RGBA8, levels[level].width, levels[level].height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+						 levels[level].texels.data());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return resources.adoptTexture(texture);
+	}
+
+	// Offset and scale of the image in the atlas coordinates
+	glm::vec4 region(uint32_t index) const
+	{
+		return glm::vec4((float)(regions[index].x + block) / width, (float)(regions[index].y + block) / height,
+						 (float)images[index].width / width, (float)images[index].height / height);
+	}
+
+	uint32_t count() const { return (uint32_t)images.size(); }
+	int atlasWidth() const { return width; }
+	int atlasHeight() const { return height; }
+	// Image texels over atlas texels, borders and padding are the rest
+	double occupancy() const { return occupied; }
+
+private:
+	TextureAtlas(const TextureAtlas &);
+	TextureAtlas &operator=(const TextureAtlas &);
+
+	// Blocks of an image side and its borders
+	int blocks(int texels) const { return (texels + block - 1) / block + 2; }
+
+	// Packs in block units, so every position is a multiple of `block`
+	bool packAll(const std::vector<uint32_t> &order, int w, int h)
+	{
+		SkylinePacker packer;
+		packer.reset(w / block, h / block);
+		for (size_t o = 0; o < order.size(); o++)
+		{
+			const TextureImage &image = images[order[o]];
+			int x, y;
+			if (!packer.pack(blocks(image.width), blocks(image.height), x, y))
+				return false;
+			regions[order[o]] = glm::ivec2(x * block, y * block);
+		}
+		width = w;
+		height = h;
+		return true;
+	}
+
+	// Images and their wrapped borders, then the mip levels
+	void compose(int levelCount)
+	{
+		TextureImage base(width, height);
+		int64_t texels = 0;
+		for (size_t i = 0; i < images.size(); i++)
+		{
+			const TextureImage &image = images[i];
+			for (int y = -block; y < image.height + block; y++)
+				for (int x = -block; x < image.width + block; x++)
+					base.at(regions[i].x + block + x, regions[i].y + block + y) =
+						image.at((x % image.width + image.width) % image.width, (y % image.height + image.height) % image.height);
+			texels += (int64_t)image.width * image.height;
+		}
+		occupied = (double)texels / ((double)width * height);
+		levels.assign(1, base);
+		while ((int)levels.size() < levelCount && levels.back().width > 1 && levels.back().height > 1)
+			levels.push_back(downsampleImage(levels.back()));
+	}
+
+	std::vector<TextureImage> images;
+	std::vector<glm::ivec2> regions; // lower left texel of the borders of each image
+	std::vector<TextureImage> levels;
+	int width;
+	int height;
+	int block;
+	double occupied;
+};
+
+// Images of one size as the layers of a GL_TEXTURE_2D_ARRAY, full mip chain
+class TextureArray
+{
+public:
+	TextureArray() {}
+
+	// Copies the image, false when its size is not the one of the first
+	bool add(const TextureImage &image)
+	{
+		if (!images.empty() && (image.width != images[0].width || image.height != images[0].height))
+		{
+			fprintf(stderr, "Texture array : a %dx%d image among %dx%d layers\n", image.width, image.height, images[0].width,
+					images[0].height);
+			return false;
+		}
+		images.push_back(image);
+		return true;
+	}
+
+	TextureId upload(GpuResources &resources) const
+	{
+		if (images.empty())
+			return TextureId();
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		std::vector<TextureImage> layers(images);
+		std::vector<uint32_t> texels;
+		GLint level = 0;
+		for (;; level++)
+		{
+			texels.clear();
+			for (size_t l = 0; l < layers.size(); l++)
+				texels.insert(texels.end(), layers[l].texels.begin(), layers[l].texels.end());
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, layers[0].width, layers[0].height, (GLsizei)layers.size(), 0, GL_RGBA,
+						 GL_UNSIGNED_BYTE, texels.data());
+			if (layers[0].width == 1 && layers[0].height == 1)
+				break;
+			for (size_t l = 0; l < layers.size(); l++)
+				layers[l] = downsampleImage(layers[l]);
+		}
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, level);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		return resources.adoptTexture(texture, GL_TEXTURE_2D_ARRAY);
+	}
+
+	uint32_t layers() const { return (uint32_t)images.size(); }
+
+private:
+	TextureArray(const TextureArray &);
+	TextureArray &operator=(const TextureArray &);
+
+	std::vector<TextureImage> images;
+};
+
+#endif
@@ -0,0 +1,638 @@
+#ifndef CAPTURE_HPP
+#define CAPTURE_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <GL/glew.h>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+// Frame capture and recording without stalling the GPU.
+// glReadPixels into a pixel pack buffer only queues the copy : the frame is
+// read into one of CAPTURE_SLOTS PBOs, a fence marks the end of the copy, and
+// the PBO is mapped a few frames later when the fence has signaled. The
+// pixels are then copied into a pooled CPU frame and handed to an encoder
+// thread through a lock-free queue, so the render thread only pays for the
+// readback call and one memcpy.
+//
+// Image sequences, one file per frame :
+//   CAPTURE_PNG  : <prefix>NNNNNN.png, stored (uncompressed) deflate
+//   CAPTURE_PPM  : <prefix>NNNNNN.ppm
+// Recordings, one stream :
+//   CAPTURE_RAW  : <prefix>.rgb, top-down RGB24, e.g.
+//                  ffmpeg -f rawvideo -pixel_format rgb24 -video_size WxH -framerate 60 -i <prefix>.rgb out.mp4
+//   CAPTURE_Y4M  : <prefix>.y4m, YUV 4:2:0 read by ffmpeg, mpv, x264... as is
+//   CAPTURE_PIPE : the frames piped to an encoder process, by default
+//                  ffmpeg into <prefix>.mp4
+//
+// When the encoder falls behind, an image sequence drops frames (and counts
+// them) rather than slowing the render thread down. A recording with holes
+// is useless : it has a deeper queue to absorb bursts, and when that is full
+// too the render thread waits for the encoder, which is counted as
+// backpressure.
+//
+// Per frame : readback() after the last draw and before the swap, endFrame()
+// after the swap.
+
+#define CAPTURE_SLOTS 3
+#define CAPTURE_FRAMES 8         // CPU frames of an image sequence
+#define CAPTURE_RECORD_FRAMES 32 // CPU frames of a recording, half a second at 60 fps
+#define CAPTURE_QUEUE_SIZE 64    // power of two, more than any frame count
+
+enum CaptureFormat
+{
+	CAPTURE_PNG,
+	CAPTURE_PPM,
+	CAPTURE_RAW,
+	CAPTURE_Y4M,
+	CAPTURE_PIPE
+};
+
+static const char *const g_capture_format_names[] = {"png", "ppm", "raw", "y4m", "pipe"};
+
+struct CaptureStats
+{
+	uint32_t captured;     // frames read back into a PBO
+	uint32_t encoded;      // frames written by the encoder thread
+	uint32_t dropped;      // frames skipped because the encoder was behind (image sequences)
+	uint32_t backlog;      // most frames waiting for the encoder at once
+	uint32_t blocked;      // frames the render thread waited on the encoder for (recordings)
+	double blockedSeconds; // render thread time spent in those waits
+	double stallSeconds;   // waiting for a readback the GPU had not finished
+};
+
+// A frame read back, on its way to the encoder
+struct CapturedFrame
+{
+	uint64_t number;
+	std::vector<unsigned char> rgba; // rows bottom-up, as read
+};
+
+// Single producer, single consumer ring of frames, lock-free (Lamport)
+class CaptureQueue
+{
+public:
+	CaptureQueue() : head(0), tail(0) {}
+
+	// Producer only, false when full
+	bool push(CapturedFrame *frame)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == CAPTURE_QUEUE_SIZE)
+			return false;
+		entries[t & (CAPTURE_QUEUE_SIZE - 1)] = frame;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only, NULL when empty
+	CapturedFrame *pop()
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return NULL;
+		CapturedFrame *frame = entries[h & (CAPTURE_QUEUE_SIZE - 1)];
+		head.store(h + 1, std::memory_order_release);
+		return frame;
+	}
+
+	// Exact from either side when the other one is idle, a hint otherwise
+	size_t size() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire); }
+
+private:
+	std::atomic<size_t> head;
+	char padding[64]; // head and tail are written by different threads, keep them on different cache lines
+	std::atomic<size_t> tail;
+	CapturedFrame *entries[CAPTURE_QUEUE_SIZE];
+};
+
+class FrameCapture
+{
+public:
+	FrameCapture()
+		: width(0), height(0), fps(60), format(CAPTURE_PNG), head(0), pending(0), frameCount(0), spare(NULL), output(NULL), piped(false),
+		  encoded(0), writeFailed(false), stopped(false), sleeping(false)
+	{
+		for (int i = 0; i < CAPTURE_SLOTS; i++)
+		{
+			pbos[i] = 0;
+			slots[i].fence = 0;
+		}
+		resetStats();
+	}
+
+	~FrameCapture() { stopEncoder(); }
+
+	// Captures width x height from the bottom left of the read buffer. `command`
+	// replaces the encoder process of CAPTURE_PIPE, it reads bottom-up RGBA
+	// frames of that size on its standard input.
+	bool create(int captureWidth, int captureHeight, const char *pathPrefix, CaptureFormat captureFormat, int framesPerSecond = 60,
+				const char *command = NULL)
+	{
+		width = captureWidth;
+		height = captureHeight;
+		prefix = pathPrefix;
+		format = captureFormat;
+		fps = framesPerSecond;
+		if (!openOutput(command))
+			return false;
+
+		glGenBuffers(CAPTURE_SLOTS, pbos);
+		for (int i = 0; i < CAPTURE_SLOTS; i++)
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[i]);
+			glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes(), NULL, GL_STREAM_READ);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		frameCount = recording() ? CAPTURE_RECORD_FRAMES : CAPTURE_FRAMES;
+		for (int i = 0; i < frameCount; i++)
+		{
+			CapturedFrame *frame = new CapturedFrame;
+			frame->rgba.resize(frameBytes());
+			freeFrames.push(frame);
+		}
+		stopped.store(false);
+		encoder = std::thread(&FrameCapture::encoderLoop, this);
+		return true;
+	}
+
+	// Finishes the readbacks in flight and waits for the encoder to write them. Needs the GL context.
+	void destroy()
+	{
+		while (pending)
+			collect(true);
+		if (pbos[0])
+			glDeleteBuffers(CAPTURE_SLOTS, pbos);
+		for (int i = 0; i < CAPTURE_SLOTS; i++)
+			pbos[i] = 0;
+		stopEncoder();
+		while (CapturedFrame *frame = freeFrames.pop())
+			delete frame;
+		delete spare;
+		spare = NULL;
+	}
+
+	// Queues the copy of the back buffer, tagged with `frame`
+	void readback(uint64_t frame)
+	{
+		// Every PBO still in flight : the oldest one has to be read now
+		if (pending == CAPTURE_SLOTS)
+			collect(true);
+		Slot &slot = slots[head];
+		slot.frame = frame;
+		glReadBuffer(GL_BACK);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[head]);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void *)0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		head = (head + 1) % CAPTURE_SLOTS;
+		pending++;
+		stats.captured++;
+	}
+
+	// After the swap : fences the readback of this frame, hands finished ones to the encoder
+	void endFrame()
+	{
+		int newest = (head + CAPTURE_SLOTS - 1) % CAPTURE_SLOTS;
+		if (pending && !slots[newest].fence)
+			slots[newest].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		while (pending && collect(false))
+			;
+	}
+
+	// Counters since the last call
+	CaptureStats takeStats()
+	{
+		CaptureStats result = stats;
+		result.encoded = encoded.exchange(0);
+		resetStats();
+		return result;
+	}
+
+	CaptureFormat captureFormat() const { return format; }
+	bool recording() const { return format >= CAPTURE_RAW; }
+	// The output stopped accepting frames (disk full, encoder process gone)
+	bool failed() const { return writeFailed.load(); }
+
+private:
+	struct Slot
+	{
+		uint64_t frame;
+		GLsync fence;
+	};
+
+	struct CrcTable
+	{
+		uint32_t table[256];
+
+		CrcTable()
+		{
+			for (uint32_t n = 0; n < 256; n++)
+			{
+				uint32_t c = n;
+				for (int k = 0; k < 8; k++)
+					c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				table[n] = c;
+			}
+		}
+	};
+
+	size_t frameBytes() const { return (size_t)width * height * 4; }
+
+	bool openOutput(const char *command)
+	{
+		if (format == CAPTURE_PIPE)
+		{
+			char line[512];
+			if (!command)
+			{
+				snprintf(line, sizeof(line),
+						 "ffmpeg -y -loglevel error -f rawvideo -pixel_format rgba -video_size %dx%d -framerate %d -i - "
+						 "-vf vflip -pix_fmt yuv420p \"%s.mp4\"",
+						 width, height, fps, prefix.c_str());
+				command = line;
+			}
+#ifndef _WIN32
+			// A dead encoder process fails the writes instead of killing us
+			signal(SIGPIPE, SIG_IGN);
+			output = popen(command, "w");
+#else
+			output = popen(command, "wb");
+#endif
+			piped = true;
+			if (!output)
+				fprintf(stderr, "Could not start the encoder : %s\n", command);
+			return output != NULL;
+		}
+		if (format == CAPTURE_RAW || format == CAPTURE_Y4M)
+		{
+			std::string path = prefix + (format == CAPTURE_RAW ? ".rgb" : ".y4m");
+			if (!(output = fopen(path.c_str(), "wb")))
+			{
+				fprintf(stderr, "Could not write %s\n", path.c_str());
+				return false;
+			}
+			if (format == CAPTURE_Y4M)
+				fprintf(output, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+		}
+		return true;
+	}
+
+	// Reads the oldest readback back if it is finished (or once it is, when `wait`)
+	bool collect(bool wait)
+	{
+		int oldest = (head + CAPTURE_SLOTS - pending) % CAPTURE_SLOTS;
+		Slot &slot = slots[oldest];
+		if (!slot.fence)
+			slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		GLenum status = glClientWaitSync(slot.fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+		{
+			if (!wait)
+				return false;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+			do
+			{
+				status = glClientWaitSync(slot.fence, flags, 1000000); // 1 ms
+				flags = 0;
+			} while (status == GL_TIMEOUT_EXPIRED);
+			stats.stallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+		pending--;
+
+		// The frame of a failed map is kept here : only the encoder pushes free frames
+		CapturedFrame *frame = spare ? spare : freeFrames.pop();
+		spare = NULL;
+		if (!frame && recording() && !writeFailed.load())
+		{
+			// Backpressure : every frame is queued, wait for the encoder to finish one
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			while (!(frame = freeFrames.pop()) && !writeFailed.load())
+				std::this_thread::yield();
+			stats.blocked++;
+			stats.blockedSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+		if (!frame)
+		{
+			stats.dropped++;
+			return true;
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[oldest]);
+		const void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes(), GL_MAP_READ_BIT);
+		if (pixels)
+		{
+			frame->number = slot.frame;
+			memcpy(frame->rgba.data(), pixels, frameBytes());
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		if (!pixels)
+		{
+			spare = frame;
+			stats.dropped++;
+			return true;
+		}
+
+		// Both queues hold every frame at most once, the push can't fail
+		frames.push(frame);
+		uint32_t backlog = (uint32_t)frames.size();
+		if (backlog > stats.backlog)
+			stats.backlog = backlog;
+		if (sleeping.load())
+			cond.notify_one();
+		return true;
+	}
+
+	void encoderLoop()
+	{
+		std::vector<unsigned char> converted;
+		int idle = 0;
+		for (;;)
+		{
+			CapturedFrame *frame = frames.pop();
+			// Stopped after its last push : one more look before leaving
+			if (!frame && stopped.load() && !(frame = frames.pop()))
+				return;
+			if (!frame)
+			{
+				if (++idle < 64)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+				// The timeout covers a push racing with going to sleep
+				std::unique_lock<std::mutex> lock(mutex);
+				sleeping.store(true);
+				cond.wait_for(lock, std::chrono::milliseconds(1));
+				sleeping.store(false);
+				continue;
+			}
+			idle = 0;
+			if (!writeFailed.load())
+				encode(*frame, converted);
+			freeFrames.push(frame);
+			encoded++;
+		}
+	}
+
+	void encode(const CapturedFrame &frame, std::vector<unsigned char> &converted)
+	{
+		bool written = true;
+		if (format == CAPTURE_PIPE)
+			// As read, the encoder process flips it
+			written = fwrite(frame.rgba.data(), 1, frame.rgba.size(), output) == frame.rgba.size();
+		else if (format == CAPTURE_Y4M)
+		{
+			toYuv420(frame.rgba.data(), converted);
+			written = fputs("FRAME\n", output) >= 0 && fwrite(converted.data(), 1, converted.size(), output) == converted.size();
+		}
+		else
+		{
+			// Top-down RGB for the other formats
+			converted.resize((size_t)width * height * 3);
+			for (int y = 0; y < height; y++)
+			{
+				const unsigned char *src = &frame.rgba[(size_t)(height - 1 - y) * width * 4];
+				unsigned char *dst = &converted[(size_t)y * width * 3];
+				for (int x = 0; x < width; x++, src += 4, dst += 3)
+				{
+					dst[0] = src[0];
+					dst[1] = src[1];
+					dst[2] = src[2];
+				}
+			}
+			if (format == CAPTURE_RAW)
+				written = fwrite(converted.data(), 1, converted.size(), output) == converted.size();
+			else
+			{
+				char number[32];
+				snprintf(number, sizeof(number), "%06llu", (unsigned long long)frame.number);
+				std::string path = prefix + number + (format == CAPTURE_PNG ? ".png" : ".ppm");
+				if (format == CAPTURE_PNG)
+					writePNG(path.c_str(), converted.data());
+				else
+					writePPM(path.c_str(), converted.data());
+			}
+		}
+		if (!written)
+		{
+			fprintf(stderr, "Recording stopped, the %s output does not accept frames anymore\n", g_capture_format_names[format]);
+			writeFailed.store(true);
+		}
+	}
+
+	// BT.601 studio range, chroma averaged over 2x2 pixels, planes top-down
+	void toYuv420(const unsigned char *rgba, std::vector<unsigned char> &yuv) const
+	{
+		int chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+		yuv.resize((size_t)width * height + 2 * (size_t)chromaWidth * chromaHeight);
+		unsigned char *luma = yuv.data();
+		unsigned char *u = luma + (size_t)width * height;
+		unsigned char *v = u + (size_t)chromaWidth * chromaHeight;
+		for (int y = 0; y < height; y++)
+		{
+			const unsigned char *src = rgba + (size_t)(height - 1 - y) * width * 4;
+			for (int x = 0; x < width; x++, src += 4)
+				luma[(size_t)y * width + x] = (unsigned char)(((66 * src[0] + 129 * src[1] + 25 * src[2] + 128) >> 8) + 16);
+		}
+		for (int cy = 0; cy < chromaHeight; cy++)
+			for (int cx = 0; cx < chromaWidth; cx++)
+			{
+				int r = 0, g = 0, b = 0, n = 0;
+				for (int dy = 0; dy < 2; dy++)
+					for (int dx = 0; dx < 2; dx++)
+					{
+						int x = 2 * cx + dx, y = 2 * cy + dy;
+						if (x >= width || y >= height)
+							continue;
+						const unsigned char *p = rgba + ((size_t)(height - 1 - y) * width + x) * 4;
+						r += p[0];
+						g += p[1];
+						b += p[2];
+						n++;
+					}
+				r /= n;
+				g /= n;
+				b /= n;
+				u[(size_t)cy * chromaWidth + cx] = (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+				v[(size_t)cy * chromaWidth + cx] = (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+			}
+	}
+
+	void stopEncoder()
+	{
+		stopped.store(true);
+		cond.notify_all();
+		if (encoder.joinable())
+			encoder.join();
+		if (output)
+		{
+			if (piped)
+				pclose(output);
+			else
+				fclose(output);
+		}
+		output = NULL;
+	}
+
+	void writePPM(const char *path, const unsigned char *rgb) const
+	{
+		FILE *file = fopen(path, "wb");
+		if (!file)
+		{
+			fprintf(stderr, "Could not write %s\n", path);
+			return;
+		}
+		fprintf(file, "P6\n%d %d\n255\n", width, height);
+		fwrite(rgb, 1, (size_t)width * height * 3, file);
+		fclose(file);
+	}
+
+	// PNG with stored deflate blocks : cheap to write and read by any viewer,
+	// but as large as the pixels
+	void writePNG(const char *path, const unsigned char *rgb) const
+	{
+		FILE *file = fopen(path, "wb");
+		if (!file)
+		{
+			fprintf(stderr, "Could not write %s\n", path);
+			return;
+		}
+		static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+		fwrite(signature, 1, 8, file);
+
+		unsigned char header[13];
+		putBigEndian(header, width);
+		putBigEndian(header + 4, height);
+		header[8] = 8; // bits per channel
+		header[9] = 2; // RGB
+		header[10] = header[11] = header[12] = 0;
+		writeChunk(file, "IHDR", header, 13);
+
+		// Every row starts with its filter type, 0 : none
+		size_t rowBytes = (size_t)width * 3 + 1;
+		size_t rawBytes = rowBytes * height;
+		std::vector<unsigned char> raw(rawBytes);
+		for (int y = 0; y < height; y++)
+		{
+			raw[y * rowBytes] = 0;
+			memcpy(&raw[y * rowBytes + 1], rgb + (size_t)y * width * 3, width * 3);
+		}
+
+		// zlib stream : header, stored blocks of at most 65535 bytes, Adler-32
+		size_t blocks = (rawBytes + 65534) / 65535;
+		std::vector<unsigned char> zlib;
+		zlib.reserve(2 + rawBytes + blocks * 5 + 4);
+		zlib.push_back(0x78);
+		zlib.push_back(0x01);
+		uint32_t a = 1, b = 0;
+		for (size_t offset = 0; offset < rawBytes; offset += 65535)
+		{
+			size_t length = rawBytes - offset < 65535 ? rawBytes - offset : 65535;
+			zlib.push_back(offset + length == rawBytes ? 1 : 0);
+			zlib.push_back(length & 0xff);
+			zlib.push_back(length >> 8);
+			zlib.push_back(~length & 0xff);
+			zlib.push_back((~length >> 8) & 0xff);
+			zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+			for (size_t i = offset; i < offset + length; i++)
+			{
+				a = (a + raw[i]) % 65521;
+				b = (b + a) % 65521;
+			}
+		}
+		unsigned char adler[4];
+		putBigEndian(adler, (b << 16) | a);
+		zlib.insert(zlib.end(), adler, adler + 4);
+		writeChunk(file, "IDAT", zlib.data(), zlib.size());
+		writeChunk(file, "IEND", NULL, 0);
+		fclose(file);
+	}
+
+	static void putBigEndian(unsigned char *out, uint32_t value)
+	{
+		out[0] = value >> 24;
+		out[1] = (value >> 16) & 0xff;
+		out[2] = (value >> 8) & 0xff;
+		out[3] = value & 0xff;
+	}
+
+	static void writeChunk(FILE *file, const char *type, const unsigned char *data, size_t size)
+	{
+		static const CrcTable crc32;
+		const uint32_t *table = crc32.table;
+		unsigned char length[4];
+		putBigEndian(length, (uint32_t)size);
+		fwrite(length, 1, 4, file);
+		fwrite(type, 1, 4, file);
+		if (size)
+			fwrite(data, 1, size, file);
+		// CRC-32 of the type and the data
+		uint32_t crc = 0xffffffffu;
+		for (int i = 0; i < 4; i++)
+			crc = table[(crc ^ (unsigned char)type[i]) & 0xff] ^ (crc >> 8);
+		for (size_t i = 0; i < size; i++)
+			crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		unsigned char footer[4];
+		putBigEndian(footer, crc ^ 0xffffffffu);
+		fwrite(footer, 1, 4, file);
+	}
+
+
+	void resetStats()
+	{
+		stats.captured = 0;
+		stats.encoded = 0;
+		stats.dropped = 0;
+		stats.backlog = 0;
+		stats.blocked = 0;
+		stats.blockedSeconds = 0.0;
+		stats.stallSeconds = 0.0;
+	}
+
+	int width;
+	int height;
+	int fps; // announced to the video formats
+	std::string prefix;
+	CaptureFormat format;
+	GLuint pbos[CAPTURE_SLOTS];
+	Slot slots[CAPTURE_SLOTS];
+	int head;    // next slot to read into
+	int pending; // slots read into and not collected yet, oldest first
+	int frameCount;
+	CapturedFrame *spare;
+	FILE *output; // the stream of a recording
+	bool piped;
+	CaptureStats stats;
+
+	// Shared with the encoder thread
+	std::thread encoder;
+	CaptureQueue frames;     // render thread to encoder
+	CaptureQueue freeFrames; // and back
+	std::atomic<uint32_t> encoded;
+	std::atomic<bool> writeFailed;
+	std::atomic<bool> stopped;
+	std::atomic<bool> sleeping;
+	std::mutex mutex; // only to sleep on, the queues are lock-free
+	std::condition_variable cond;
+
+	FrameCapture(const FrameCapture &);
+	FrameCapture &operator=(const FrameCapture &);
+};
+
+#endif
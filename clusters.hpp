@@ -0,0 +1,286 @@
+#ifndef CLUSTERS_HPP
+#define CLUSTERS_HPP
+
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <glm/glm.hpp>
+
+#include "arena.hpp"
+#include "jobs.hpp"
+
+// Clustered light binning.
+// The view frustum is cut into CLUSTER_X x CLUSTER_Y screen tiles and
+// CLUSTER_Z depth slices, exponential in depth so that clusters stay about
+// as deep as they are wide. Every frame each point light is bounded in view
+// space, its index goes to the clusters the bounds overlap, and a fragment
+// only loops over the lights of its own cluster.
+//
+// Binning runs on the job system and needs no atomics :
+//   1. per light : position at the frame time, view space bounds, cluster box
+//   2. per depth slice : lights counted into the clusters of the slice, a job
+//      owns whole slices so no two jobs touch the same counter. Within a slice
+//      a light is bounded again by its cross section at the slice's depths,
+//      much tighter than its bounds over the whole frustum.
+//   3. prefix sum of the counts, then the walk of 2 again writing the indices,
+//      in light order
+// Everything of the frame lives in its arena.
+
+#define CLUSTER_X 16
+#define CLUSTER_Y 12
+#define CLUSTER_Z 24
+#define CLUSTER_COUNT (CLUSTER_X * CLUSTER_Y * CLUSTER_Z)
+#define CLUSTER_MAX_INDICES (1 << 19) // light indices of a frame, the rest is dropped
+#define LIGHT_UNBOUNDED 1e30f         // range of a light that reaches every cluster
+
+// std430 layout, read as is by the shaders
+struct PointLight
+{
+	glm::vec4 position; // view space, w : range
+	glm::vec4 color;	// w : power
+};
+
+// A light circling the vertical axis through the origin
+struct LightOrbit
+{
+	float radius;
+	float height;
+	float phase; // angle at time 0
+	float speed; // radians per second
+	float range; // distance where its contribution reaches 0
+	glm::vec3 color;
+	float power;
+};
+
+struct LightClusters
+{
+	FrameArray<PointLight> lights;
+	FrameArray<glm::uvec2> clusters; // first index and count, x fastest then y then z
+	FrameArray<uint32_t> indices;	 // into lights
+	float near;
+	float far;
+	uint32_t visibleLights; // inside the frustum
+	uint32_t maxPerCluster;
+	uint32_t dropped; // indices beyond CLUSTER_MAX_INDICES
+	double seconds;	  // binning time
+};
+
+// Depth slice of a view distance : log(d / near) / log(far / near) of the slices
+inline int clusterSlice(float distance, float near, float far)
+{
+	int slice = (int)floorf(logf(distance / near) / logf(far / near) * CLUSTER_Z);
+	return std::max(0, std::min(CLUSTER_Z - 1, slice));
+}
+
+// `first` is a light that stays where it is, the others circle through a box
+// of half size `extent` around the origin. Same seed, same lights.
+inline void makeLightOrbits(uint32_t count, const glm::vec3 &first, float extent, std::vector<LightOrbit> &orbits)
+{
+	orbits.resize(count);
+	if (!count)
+		return;
+	// The single light of the shaders, unchanged
+	orbits[0].radius = sqrtf(first.x * first.x + first.z * first.z);
+	orbits[0].height = first.y;
+	orbits[0].phase = atan2f(first.z, first.x);
+	orbits[0].speed = 0.0f;
+	orbits[0].range = LIGHT_UNBOUNDED;
+	orbits[0].color = glm::vec3(1.0f);
+	orbits[0].power = 50.0f;
+
+	// About the same number of lights reach any point, however many there are
+	float range = std::max(1.0f, std::min(extent, extent * cbrtf(4.0f / count)));
+	uint32_t state = 0x9e3779b9u;
+	for (uint32_t i = 1; i < count; i++)
+	{
+		float r[6];
+		for (int k = 0; k < 6; k++)
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			r[k] = (state >> 8) / 16777216.0f;
+		}
+		LightOrbit &orbit = orbits[i];
+		orbit.radius = 0.5f + r[0] * extent;
+		orbit.height = (r[1] * 2.0f - 1.0f) * extent;
+		orbit.phase = r[2] * 6.2831853f;
+		orbit.speed = (r[3] < 0.5f ? -1.0f : 1.0f) * (0.2f + r[3]);
+		orbit.range = range;
+		// Saturated hue
+		float hue = r[4] * 6.0f;
+		orbit.color = glm::clamp(glm::vec3(fabsf(hue - 3.0f) - 1.0f, 2.0f - fabsf(hue - 2.0f), 2.0f - fabsf(hue - 4.0f)), 0.0f, 1.0f);
+		orbit.power = (0.15f + 0.1f * r[5]) * range * range;
+	}
+}
+
+class ClusterBuilder
+{
+public:
+	// Places the lights at `time` and bins them for the symmetric perspective `projection`
+	LightClusters build(JobSystem &jobs, FrameArena &frame, const LightOrbit *orbits, uint32_t count, float time, const glm::mat4 &view,
+						const glm::mat4 &projection)
+	{
+		double start = now();
+		LightClusters out;
+		out.near = projection[3][2] / (projection[2][2] - 1.0f);
+		out.far = projection[3][2] / (projection[2][2] + 1.0f);
+		out.lights = FrameArray<PointLight>(frame, count);
+		out.clusters = FrameArray<glm::uvec2>(frame, CLUSTER_COUNT);
+		FrameArray<ClusterBox> boxes(frame, count);
+		FrameArray<uint32_t> cursors(frame, CLUSTER_COUNT);
+		Binning binning;
+		binning.lights = out.lights.data();
+		binning.boxes = boxes.data();
+		binning.count = count;
+		binning.xScale = projection[0][0];
+		binning.yScale = projection[1][1];
+		float near = out.near, far = out.far;
+		for (int z = 0; z <= CLUSTER_Z; z++)
+			binning.depths[z] = near * powf(far / near, (float)z / CLUSTER_Z);
+
+		// 1. Lights
+		jobs.parallelFor(count, 64, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++)
+			{
+				const LightOrbit &orbit = orbits[i];
+				float angle = orbit.phase + orbit.speed * time;
+				glm::vec4 world(orbit.radius * cosf(angle), orbit.height, orbit.radius * sinf(angle), 1.0f);
+				glm::vec3 center = glm::vec3(view * world);
+				out.lights[i].position = glm::vec4(center, orbit.range);
+				out.lights[i].color = glm::vec4(orbit.color, orbit.power);
+				boxes[i] = bound(center, orbit.range, binning.xScale, binning.yScale, near, far);
+			}
+		});
+
+		// 2. Counts, a job per slice
+		for (uint32_t c = 0; c < CLUSTER_COUNT; c++)
+			out.clusters[c] = glm::uvec2(0, 0);
+		jobs.parallelFor(CLUSTER_Z, 1, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t z = begin; z < end; z++)
+				walkSlice(binning, z, [&](uint32_t cluster, uint32_t) { out.clusters[cluster].y++; });
+		});
+
+		// 3. Offsets, then the indices
+		uint32_t total = 0;
+		out.dropped = 0;
+		out.maxPerCluster = 0;
+		for (uint32_t c = 0; c < CLUSTER_COUNT; c++)
+		{
+			uint32_t n = out.clusters[c].y;
+			out.maxPerCluster = std::max(out.maxPerCluster, n);
+			if (total + n > CLUSTER_MAX_INDICES)
+			{
+				out.dropped += total + n - CLUSTER_MAX_INDICES;
+				n = CLUSTER_MAX_INDICES - total;
+			}
+			out.clusters[c] = glm::uvec2(total, n);
+			cursors[c] = total;
+			total += n;
+		}
+		out.indices = FrameArray<uint32_t>(frame, total);
+		jobs.parallelFor(CLUSTER_Z, 1, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t z = begin; z < end; z++)
+				walkSlice(binning, z, [&](uint32_t cluster, uint32_t light) {
+					if (cursors[cluster] < out.clusters[cluster].x + out.clusters[cluster].y)
+						out.indices[cursors[cluster]++] = light;
+				});
+		});
+
+		out.visibleLights = 0;
+		for (uint32_t i = 0; i < count; i++)
+			out.visibleLights += boxes[i].z0 <= boxes[i].z1;
+		out.seconds = now() - start;
+		return out;
+	}
+
+private:
+	// Clusters overlapped by a light, inclusive, empty when z0 > z1
+	struct ClusterBox
+	{
+		uint8_t x0, x1, y0, y1, z0, z1;
+	};
+
+	// What the slice walks read
+	struct Binning
+	{
+		const PointLight *lights;
+		const ClusterBox *boxes;
+		uint32_t count;
+		float xScale, yScale;
+		float depths[CLUSTER_Z + 1]; // view distance where each slice starts, and the far plane
+	};
+
+	static double now()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// View space box of the sphere, projected through its corners. Conservative :
+	// the corners of the box stick out of the sphere, clusters are never missed.
+	static ClusterBox bound(const glm::vec3 &center, float range, float xScale, float yScale, float near, float far)
+	{
+		ClusterBox box = {0, 0, 0, 0, 1, 0};
+		float distanceNear = std::max(-center.z - range, near);
+		float distanceFar = std::min(-center.z + range, far);
+		if (distanceNear > distanceFar)
+			return box;
+		float x[2], y[2];
+		if (!project(center.x, range, xScale, distanceNear, distanceFar, x) || !project(center.y, range, yScale, distanceNear, distanceFar, y))
+			return box;
+		box.x0 = (uint8_t)tile(x[0], CLUSTER_X);
+		box.x1 = (uint8_t)tile(x[1], CLUSTER_X);
+		box.y0 = (uint8_t)tile(y[0], CLUSTER_Y);
+		box.y1 = (uint8_t)tile(y[1], CLUSTER_Y);
+		box.z0 = (uint8_t)clusterSlice(distanceNear, near, far);
+		box.z1 = (uint8_t)clusterSlice(distanceFar, near, far);
+		return box;
+	}
+
+	// NDC range of [c - r, c + r] seen between two distances, false when off screen
+	static bool project(float c, float r, float scale, float distanceNear, float distanceFar, float *range)
+	{
+		// c / d is monotonic in each of c and d, the extremes are at the corners
+		float lo = c - r, hi = c + r;
+		range[0] = scale * std::min(lo / distanceNear, lo / distanceFar);
+		range[1] = scale * std::max(hi / distanceNear, hi / distanceFar);
+		return range[0] <= 1.0f && range[1] >= -1.0f;
+	}
+
+	static int tile(float ndc, int tiles)
+	{
+		float t = (ndc * 0.5f + 0.5f) * tiles;
+		return t <= 0.0f ? 0 : t >= tiles ? tiles - 1 : (int)t;
+	}
+
+	// Calls f(cluster, light) for every cluster of slice z a light may reach
+	template <class F> static void walkSlice(const Binning &binning, uint32_t z, const F &f)
+	{
+		for (uint32_t i = 0; i < binning.count; i++)
+		{
+			const ClusterBox &box = binning.boxes[i];
+			if (z < box.z0 || z > box.z1)
+				continue;
+			// The sphere between the slice's depths fits in a cylinder of its widest cross section there
+			glm::vec4 light = binning.lights[i].position;
+			float depth = -light.z;
+			float distanceNear = std::max(binning.depths[z], depth - light.w);
+			float distanceFar = std::min(binning.depths[z + 1], depth + light.w);
+			float offset = depth < distanceNear ? distanceNear - depth : depth > distanceFar ? depth - distanceFar : 0.0f;
+			float radius = sqrtf(std::max(light.w * light.w - offset * offset, 0.0f));
+			float x[2], y[2];
+			if (distanceNear > distanceFar || !project(light.x, radius, binning.xScale, distanceNear, distanceFar, x) ||
+				!project(light.y, radius, binning.yScale, distanceNear, distanceFar, y))
+				continue;
+			uint32_t x0 = std::max<uint32_t>(box.x0, tile(x[0], CLUSTER_X)), x1 = std::min<uint32_t>(box.x1, tile(x[1], CLUSTER_X));
+			uint32_t y0 = std::max<uint32_t>(box.y0, tile(y[0], CLUSTER_Y)), y1 = std::min<uint32_t>(box.y1, tile(y[1], CLUSTER_Y));
+			for (uint32_t y = y0; y <= y1; y++)
+				for (uint32_t x = x0; x <= x1; x++)
+					f((z * CLUSTER_Y + y) * CLUSTER_X + x, i);
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef COMMANDS_HPP
+#define COMMANDS_HPP
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glm/glm.hpp>
+
+#include "arena.hpp"
+
+// Backend agnostic draw commands.
+// Commands are small POD structs packed back to back in blocks taken from the
+// frame arena, each starting with a header giving its type and size. Worker
+// threads record one buffer each for disjoint parts of the scene, the render
+// thread replays the buffers in order, so recording scales with cores while
+// only one thread talks to GL.
+
+enum CommandType
+{
+	CMD_PROGRAM,   // switch shader program
+	CMD_TRANSFORM, // per object matrices
+	CMD_DRAW,      // draw a range of a mesh
+	CMD_TEXTURE    // switch texture
+};
+
+struct CommandHeader
+{
+	uint16_t type;
+	uint16_t size; // bytes, header included
+};
+
+struct ProgramCommand
+{
+	CommandHeader header;
+	uint32_t program;
+};
+
+struct TransformCommand
+{
+	CommandHeader header;
+	glm::mat4 mvp;
+	glm::mat4 model;
+};
+
+struct DrawCommand
+{
+	CommandHeader header;
+	uint32_t mesh;
+	uint32_t first;
+	uint32_t count;
+	uint32_t material; // entry of the MaterialTable (materials.hpp) : parameters, atlas region or array layer
+};
+
+struct TextureCommand
+{
+	CommandHeader header;
+	uint32_t texture; // 0 for none
+};
+
+template <class T> struct CommandTraits;
+template <> struct CommandTraits<ProgramCommand> { enum { type = CMD_PROGRAM }; };
+template <> struct CommandTraits<TransformCommand> { enum { type = CMD_TRANSFORM }; };
+template <> struct CommandTraits<DrawCommand> { enum { type = CMD_DRAW }; };
+template <> struct CommandTraits<TextureCommand> { enum { type = CMD_TEXTURE }; };
+
+#define COMMAND_BLOCK_BYTES (16 * 1024)
+
+// Commands are stored in a chain of blocks taken from the frame arena
+struct CommandBlock
+{
+	CommandBlock *next;
+	uint32_t used;
+	uint32_t capacity;
+	unsigned char *data() { return (unsigned char *)(this + 1); }
+	const unsigned char *data() const { return (const unsigned char *)(this + 1); }
+};
+
+class CommandBuffer
+{
+public:
+	// Starts an empty buffer whose blocks come from `frame`
+	void begin(FrameArena &frame)
+	{
+		arena = &frame;
+		head = tail = NULL;
+		size = 0;
+		count = 0;
+	}
+
+	// Appends a command of type T, fills in its header
+	template <class T> T *push()
+	{
+		if (!tail || tail->used + sizeof(T) > tail->capacity)
+			grow(sizeof(T));
+		T *command = (T *)(tail->data() + tail->used);
+		command->header.type = CommandTraits<T>::type;
+		command->header.size = sizeof(T);
+		tail->used += sizeof(T);
+		size += sizeof(T);
+		count++;
+		return command;
+	}
+
+	const CommandBlock *firstBlock() const { return head; }
+	size_t bytes() const { return size; }
+	uint32_t commandCount() const { return count; }
+
+private:
+	void grow(size_t bytes)
+	{
+		uint32_t capacity = bytes > COMMAND_BLOCK_BYTES ? (uint32_t)bytes : COMMAND_BLOCK_BYTES;
+		CommandBlock *block = (CommandBlock *)arena->allocate(sizeof(CommandBlock) + capacity);
+		block->next = NULL;
+		block->used = 0;
+		block->capacity = capacity;
+		if (tail)
+			tail->next = block;
+		else
+			head = block;
+		tail = block;
+	}
+
+	FrameArena *arena;
+	CommandBlock *head;
+	CommandBlock *tail;
+	size_t size;
+	uint32_t count;
+};
+
+// Walks the commands of a buffer : while (const CommandHeader *cmd = reader.next())
+class CommandReader
+{
+public:
+	explicit CommandReader(const CommandBuffer &buffer) : block(buffer.firstBlock()), offset(0) {}
+
+	const CommandHeader *next()
+	{
+		while (block && offset >= block->used)
+		{
+			block = block->next;
+			offset = 0;
+		}
+		if (!block)
+			return NULL;
+		const CommandHeader *command = (const CommandHeader *)(block->data() + offset);
+		offset += command->size;
+		return command;
+	}
+
+private:
+	const CommandBlock *block;
+	uint32_t offset;
+};
+
+#endif
@@ -0,0 +1,411 @@
+#ifndef DEFERRED_HPP
+#define DEFERRED_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "shaders.hpp"
+#include "lighting.hpp"
+
+// Deferred shading.
+// The geometry pass only writes what the lighting needs into a compact
+// G-buffer, then a compute pass shades every pixel once. Forward shading
+// runs the light loop for every fragment that passes the depth test, the
+// overdrawn ones included. Here it runs once per pixel, with lights culled
+// per 16x16 tile against the depth range actually in the tile.
+//   target 0, RGBA8 : albedo, specular intensity
+//   target 1, RG16  : view space normal, octahedral encoding
+//   depth, 24 bits  : the view position is rebuilt from it
+// 8 bytes of color and 4 of depth per pixel.
+//
+// The lights are the PointLight array of lighting.hpp, bound by
+// ClusteredLighting::upload(). The lit image is copied into the scene
+// target, background pixels left as they were cleared. The G-buffer is not
+// multisampled.
+//
+// Per frame : begin() after clearing the scene target, end() after the last
+// draw, with the framebuffer the scene goes to.
+
+#define DEFERRED_TILE 16		  // pixels, side of a light culling tile
+#define DEFERRED_TILE_LIGHTS 1024 // most lights a tile shades, the rest are dropped
+#define FRAGMENT_QUERIES 8		  // sample queries in flight
+
+// StandardShading of step8, writing the G-buffer
+static const char *const g_gbuffer_fragment_shader = R"(#version 330 core
+in vec3 Position_worldspace;
+in vec3 Normal_cameraspace;
+in vec3 EyeDirection_cameraspace;
+in vec3 LightDirection_cameraspace;
+in vec3 fragmentColor;
+layout(location = 0) out vec4 albedoSpecular;
+layout(location = 1) out vec2 normal;
+// Unit vector to the unit octahedron, folded into [0, 1]^2
+vec2 octahedron(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return e * 0.5 + 0.5;
+}
+void main()
+{
+	albedoSpecular = vec4(fragmentColor, 0.3);
+	normal = octahedron(normalize(Normal_cameraspace));
+}
+)";
+
+// One work group per tile : the tile's depth range, its lights, then its pixels
+static const char *const g_deferred_lighting_shader = R"(#version 430 core
+layout(local_size_x = 16, local_size_y = 16) in;
+struct PointLight
+{
+	vec4 position;
+	vec4 color;
+};
+layout(std430, binding = 4) readonly buffer Lights
+{
+	PointLight lights[];
+};
+layout(rgba8, binding = 0) writeonly uniform image2D result;
+uniform sampler2D albedoSpecular;
+uniform sampler2D normals;
+uniform sampler2D depths;
+uniform vec2 extent;
+uniform vec4 projection; // P[0][0], P[1][1], P[2][2], P[3][2]
+shared uint tileNear;
+shared uint tileFar;
+shared uint tileCount;
+shared uint tileLights[1024];
+vec3 decodeNormal(vec2 e)
+{
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0)
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(n);
+}
+void main()
+{
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	bool inside = pixel.x < int(extent.x) && pixel.y < int(extent.y);
+	float depth = inside ? texelFetch(depths, pixel, 0).r : 1.0;
+	bool geometry = depth < 1.0;
+	// View distance of the depth, positive
+	float viewDistance = projection.w / (depth * 2.0 - 1.0 + projection.z);
+
+	if (gl_LocalInvocationIndex == 0u)
+	{
+		tileNear = 0x7f7fffffu;
+		tileFar = 0u;
+		tileCount = 0u;
+	}
+	barrier();
+	// Positive floats order like their bits
+	if (geometry)
+	{
+		atomicMin(tileNear, floatBitsToUint(viewDistance));
+		atomicMax(tileFar, floatBitsToUint(viewDistance));
+	}
+	barrier();
+
+	// Side planes of the tile through the eye, inside positive
+	vec2 ndc0 = vec2(gl_WorkGroupID.xy * gl_WorkGroupSize.xy) / extent * 2.0 - 1.0;
+	vec2 ndc1 = vec2((gl_WorkGroupID.xy + 1u) * gl_WorkGroupSize.xy) / extent * 2.0 - 1.0;
+	vec3 planes[4] = vec3[4](normalize(vec3(1.0, 0.0, ndc0.x / projection.x)), normalize(vec3(-1.0, 0.0, -ndc1.x / projection.x)),
+							 normalize(vec3(0.0, 1.0, ndc0.y / projection.y)), normalize(vec3(0.0, -1.0, -ndc1.y / projection.y)));
+	float near = uintBitsToFloat(tileNear), far = uintBitsToFloat(tileFar);
+	uint count = uint(lights.length());
+	for (uint i = gl_LocalInvocationIndex; i < count && near <= far; i += 256u)
+	{
+		vec4 light = lights[i].position;
+		bool touches = -light.z + light.w >= near && -light.z - light.w <= far;
+		for (int p = 0; p < 4; p++)
+			touches = touches && dot(planes[p], light.xyz) >= -light.w;
+		if (touches)
+		{
+			uint slot = atomicAdd(tileCount, 1u);
+			if (slot < 1024u)
+				tileLights[slot] = i;
+		}
+	}
+	barrier();
+	if (!geometry)
+		return;
+
+	vec2 ndc = (vec2(pixel) + 0.5) / extent * 2.0 - 1.0;
+	vec3 position = vec3(ndc.x * viewDistance / projection.x, ndc.y * viewDistance / projection.y, -viewDistance);
+	vec4 material = texelFetch(albedoSpecular, pixel, 0);
+	vec3 MaterialDiffuseColor = material.rgb;
+	vec4 MaterialSpecular = vec4(vec3(material.a), 5.0);
+	vec3 n = decodeNormal(texelFetch(normals, pixel, 0).rg);
+	vec3 E = normalize(-position);
+
+	vec3 color = vec3(0.1, 0.1, 0.1) * MaterialDiffuseColor;
+	uint shaded = min(tileCount, 1024u);
+	for (uint i = 0u; i < shaded; i++)
+	{
+		PointLight light = lights[tileLights[i]];
+		vec3 toLight = light.position.xyz - position;
+		float distance = length(toLight);
+		float fade = clamp(1.0 - pow(distance / light.position.w, 4.0), 0.0, 1.0);
+		color += phong(MaterialDiffuseColor, MaterialSpecular, n, toLight / distance, E) * light.color.rgb * light.color.w * fade *
+				 fade / (distance * distance);
+	}
+	imageStore(result, pixel, vec4(color, 1.0));
+}
+)";
+
+// Full screen triangle of the lit pixels
+static const char *const g_deferred_copy_vertex_shader = R"(#version 330 core
+void main()
+{
+	vec2 uv = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+static const char *const g_deferred_copy_fragment_shader = R"(#version 330 core
+out vec4 color;
+uniform sampler2D lit;
+uniform sampler2D depths;
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	if (texelFetch(depths, pixel, 0).r == 1.0)
+		discard;
+	color = texelFetch(lit, pixel, 0);
+}
+)";
+
+// Fragments that pass the depth test, from GL_SAMPLES_PASSED queries read
+// back a few frames later (samples, with multisampling). Forward shading runs
+// the light loop for each of them, deferred writes each to the G-buffer.
+struct FragmentStats
+{
+	double fragments; // sum over the frames read back
+	uint32_t frames;
+};
+
+class FragmentCounter
+{
+public:
+	FragmentCounter() : head(0), tail(0), counting(false)
+	{
+		memset(queries, 0, sizeof(queries));
+		resetStats();
+	}
+
+	void create() { glGenQueries(FRAGMENT_QUERIES, queries); }
+
+	void destroy()
+	{
+		if (queries[0])
+			glDeleteQueries(FRAGMENT_QUERIES, queries);
+		memset(queries, 0, sizeof(queries));
+	}
+
+	// Around the draws of the scene
+	void begin()
+	{
+		counting = head - tail < FRAGMENT_QUERIES;
+		if (counting)
+			glBeginQuery(GL_SAMPLES_PASSED, queries[head % FRAGMENT_QUERIES]);
+	}
+
+	void end()
+	{
+		if (counting)
+		{
+			glEndQuery(GL_SAMPLES_PASSED);
+			head++;
+		}
+		while (tail < head)
+		{
+			GLuint query = queries[tail % FRAGMENT_QUERIES];
+			GLint available = 0;
+			glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				break;
+			GLuint64 samples = 0;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &samples);
+			stats.fragments += (double)samples;
+			stats.frames++;
+			tail++;
+		}
+	}
+
+	FragmentStats takeStats()
+	{
+		FragmentStats s = stats;
+		resetStats();
+		return s;
+	}
+
+private:
+	FragmentCounter(const FragmentCounter &);
+	FragmentCounter &operator=(const FragmentCounter &);
+
+	void resetStats()
+	{
+		stats.fragments = 0.0;
+		stats.frames = 0;
+	}
+
+	GLuint queries[FRAGMENT_QUERIES];
+	uint64_t head; // next query to begin
+	uint64_t tail; // oldest query not read back
+	bool counting;
+	FragmentStats stats;
+};
+
+class DeferredRenderer
+{
+public:
+	DeferredRenderer()
+		: width(0), height(0), framebuffer(0), albedoSpecular(0), normals(0), depth(0), lit(0), lightingProgram(0), copyProgram(0),
+		  vertexArray(0), extentId(-1), projectionId(-1)
+	{
+	}
+
+	static bool supported() { return GLEW_VERSION_4_3 != 0; }
+
+	// The G-buffer is `width` x `height`, what is drawn of it is the viewport of each frame
+	bool create(int width, int height)
+	{
+		this->width = width;
+		this->height = height;
+		lightingProgram = buildComputeProgram(g_deferred_lighting_shader, "deferred lighting");
+		copyProgram = buildProgram(g_deferred_copy_vertex_shader, g_deferred_copy_fragment_shader, "deferred copy");
+		if (!lightingProgram || !copyProgram)
+		{
+			destroy();
+			return false;
+		}
+		extentId = glGetUniformLocation(lightingProgram, "extent");
+		projectionId = glGetUniformLocation(lightingProgram, "projection");
+		glUseProgram(lightingProgram);
+		glUniform1i(glGetUniformLocation(lightingProgram, "albedoSpecular"), 0);
+		glUniform1i(glGetUniformLocation(lightingProgram, "normals"), 1);
+		glUniform1i(glGetUniformLocation(lightingProgram, "depths"), 2);
+		glUseProgram(copyProgram);
+		glUniform1i(glGetUniformLocation(copyProgram, "lit"), 0);
+		glUniform1i(glGetUniformLocation(copyProgram, "depths"), 2);
+		glUseProgram(0);
+		glGenVertexArrays(1, &vertexArray);
+
+		albedoSpecular = createTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+		normals = createTexture(GL_RG16, GL_RG, GL_UNSIGNED_SHORT);
+		depth = createTexture(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT);
+		lit = createTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoSpecular, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normals, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+		static const GLenum targets[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+		glDrawBuffers(2, targets);
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (status != GL_FRAMEBUFFER_COMPLETE)
+		{
+			fprintf(stderr, "G-buffer incomplete (0x%x)\n", status);
+			destroy();
+			return false;
+		}
+		return true;
+	}
+
+	void destroy()
+	{
+		if (framebuffer)
+			glDeleteFramebuffers(1, &framebuffer);
+		GLuint textures[4] = {albedoSpecular, normals, depth, lit};
+		if (albedoSpecular)
+			glDeleteTextures(4, textures);
+		if (vertexArray)
+			glDeleteVertexArrays(1, &vertexArray);
+		if (lightingProgram)
+			glDeleteProgram(lightingProgram);
+		if (copyProgram)
+			glDeleteProgram(copyProgram);
+		framebuffer = albedoSpecular = normals = depth = lit = vertexArray = lightingProgram = copyProgram = 0;
+	}
+
+	// Draws go to the G-buffer from here, cleared within the current viewport and scissor
+	void begin()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	}
+
+	// Lights the `sceneWidth` x `sceneHeight` corner and copies it into `target`
+	void end(const glm::mat4 &projection, GLuint target, int sceneWidth, int sceneHeight)
+	{
+		glUseProgram(lightingProgram);
+		glUniform2f(extentId, (float)sceneWidth, (float)sceneHeight);
+		GLfloat p[4] = {projection[0][0], projection[1][1], projection[2][2], projection[3][2]};
+		glUniform4fv(projectionId, 1, p);
+		bindTextures(albedoSpecular, normals);
+		glBindImageTexture(0, lit, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+		glDispatchCompute((sceneWidth + DEFERRED_TILE - 1) / DEFERRED_TILE, (sceneHeight + DEFERRED_TILE - 1) / DEFERRED_TILE, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, target);
+		glDisable(GL_DEPTH_TEST);
+		glUseProgram(copyProgram);
+		bindTextures(lit, 0);
+		glBindVertexArray(vertexArray);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		bindTextures(0, 0);
+		glEnable(GL_DEPTH_TEST);
+	}
+
+	// Estimated bytes moved in a frame of `fragments` over `pixels`, depth tests aside.
+	// The G-buffer is written per fragment, then read, lit and copied per pixel.
+	static double frameBytes(double fragments, double pixels) { return fragments * (8 + 4) + pixels * ((8 + 4) + 4 + (4 + 4 + 4)); }
+
+private:
+	DeferredRenderer(const DeferredRenderer &);
+	DeferredRenderer &operator=(const DeferredRenderer &);
+
+	GLuint createTexture(GLint internalFormat, GLenum format, GLenum type)
+	{
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+		// Read with texelFetch only, no mipmaps
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return texture;
+	}
+
+	// Units 0 and 1, the depth always on unit 2
+	void bindTextures(GLuint unit0, GLuint unit1)
+	{
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, unit0);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, unit1);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, unit0 ? depth : 0);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	int width, height;
+	GLuint framebuffer;
+	GLuint albedoSpecular;
+	GLuint normals;
+	GLuint depth;
+	GLuint lit; // written by the lighting pass
+	GLuint lightingProgram;
+	GLuint copyProgram;
+	GLuint vertexArray;
+	GLint extentId, projectionId;
+};
+
+#endif
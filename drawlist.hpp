@@ -0,0 +1,193 @@
+#ifndef DRAWLIST_HPP
+#define DRAWLIST_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "arena.hpp"
+#include "commands.hpp"
+#include "entities.hpp"
+#include "jobs.hpp"
+#include "renderthread.hpp"
+
+// Per-frame CPU stages between the simulation and the render packet :
+// frustum culling of the renderable entities, draw list building and sorting,
+// each of them spread over the job system chunk by chunk, then recording of
+// the sorted list into command buffers. All their arrays are frame arena
+// allocations.
+
+// The six planes of a view-projection matrix, normals pointing inside
+struct Frustum
+{
+	glm::vec4 planes[6];
+
+	Frustum() {}
+
+	// Gribb / Hartmann plane extraction
+	explicit Frustum(const glm::mat4 &viewProjection)
+	{
+		glm::vec4 row[4];
+		for (int r = 0; r < 4; r++)
+			row[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+		planes[0] = row[3] + row[0]; // left
+		planes[1] = row[3] - row[0]; // right
+		planes[2] = row[3] + row[1]; // bottom
+		planes[3] = row[3] - row[1]; // top
+		planes[4] = row[3] + row[2]; // near
+		planes[5] = row[3] - row[2]; // far
+		for (int p = 0; p < 6; p++)
+			planes[p] = planes[p] / glm::length(glm::vec3(planes[p]));
+	}
+
+	bool containsSphere(const glm::vec3 &center, float radius) const
+	{
+		for (int p = 0; p < 6; p++)
+			if (glm::dot(glm::vec3(planes[p]), center) + planes[p].w < -radius)
+				return false;
+		return true;
+	}
+};
+
+// Program then texture in the high half so state changes are grouped, then
+// front to back, or back to front for comparing what early-Z saves. Only the
+// low 16 bits of the handles are kept, their slot index : enough to group.
+inline uint64_t drawSortKey(uint32_t program, uint32_t texture, float viewDepth, bool backToFront = false)
+{
+	uint32_t depthBits;
+	float depth = viewDepth > 0.0f ? viewDepth : 0.0f; // positive floats sort like their bits
+	memcpy(&depthBits, &depth, sizeof(depthBits));
+	if (backToFront)
+		depthBits = ~depthBits;
+	return ((uint64_t)(program & 0xffff) << 48) | ((uint64_t)(texture & 0xffff) << 32) | depthBits;
+}
+
+inline bool drawItemLess(const DrawItem &a, const DrawItem &b)
+{
+	return a.sortKey < b.sortKey;
+}
+
+class DrawListBuilder
+{
+public:
+	uint32_t visibleCount;
+	uint32_t culledCount;
+	bool backToFront; // farthest first within a program, front to back otherwise
+
+	DrawListBuilder() : visibleCount(0), culledCount(0), backToFront(false) {}
+
+	// Culls the renderable entities of `chunks`, returns the sorted draw list.
+	// Every array of the frame, the result included, lives in `frame`.
+	FrameArray<DrawItem> build(JobSystem &jobs, FrameArena &frame, const std::vector<Chunk *> &chunks, const glm::mat4 &view, const Frustum &frustum)
+	{
+		// Each chunk gets a fixed window of the scratch list, so no two jobs write the same item
+		FrameArray<uint32_t> firsts(frame, chunks.size() + 1);
+		FrameArray<uint32_t> visible(frame, chunks.size());
+		firsts[0] = 0;
+		for (size_t c = 0; c < chunks.size(); c++)
+			firsts[c + 1] = firsts[c] + chunks[c]->count;
+		FrameArray<DrawItem> scratch(frame, firsts[chunks.size()]);
+
+		jobs.parallelFor((uint32_t)chunks.size(), 4, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t c = begin; c < end; c++)
+				visible[c] = cullChunk(*chunks[c], view, frustum, backToFront, scratch.data() + firsts[c]);
+		});
+
+		// Compact the windows into the output
+		FrameArray<uint32_t> outFirsts(frame, chunks.size());
+		uint32_t total = 0;
+		for (size_t c = 0; c < chunks.size(); c++)
+		{
+			outFirsts[c] = total;
+			total += visible[c];
+		}
+		FrameArray<DrawItem> out(frame, total);
+		jobs.parallelFor((uint32_t)chunks.size(), 16, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t c = begin; c < end; c++)
+				if (visible[c])
+					memcpy(out.data() + outFirsts[c], scratch.data() + firsts[c], visible[c] * sizeof(DrawItem));
+		});
+
+		// The scratch list is free again, sort through it
+		if (total)
+			parallelSort(jobs, out.data(), total, scratch.data(), drawItemLess);
+
+		visibleCount = total;
+		culledCount = firsts[chunks.size()] - total;
+		return out;
+	}
+
+private:
+	// Writes the visible renderables of the chunk to `items`, returns how many
+	static uint32_t cullChunk(Chunk &chunk, const glm::mat4 &view, const Frustum &frustum, bool backToFront, DrawItem *items)
+	{
+		Transform *transform = chunk.array<Transform>();
+		MeshHandle *mesh = chunk.array<MeshHandle>();
+		MaterialHandle *material = chunk.array<MaterialHandle>();
+		bool bounded = (chunk.archetype->mask & COMPONENT_BIT(COMPONENT_BOUNDS)) != 0;
+		Bounds *bounds = bounded ? chunk.array<Bounds>() : NULL;
+		glm::vec4 depthRow(view[0][2], view[1][2], view[2][2], view[3][2]);
+
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < chunk.count; i++)
+		{
+			glm::vec3 center = bounded ? bounds[i].worldCenter : glm::vec3(transform[i].model[3]);
+			if (bounded && !frustum.containsSphere(center, bounds[i].worldRadius))
+				continue;
+			DrawItem &item = items[count++];
+			item.model = transform[i].model;
+			item.program = material[i].id;
+			item.texture = material[i].texture;
+			item.material = material[i].material;
+			item.mesh = mesh[i].id;
+			item.vertexCount = mesh[i].vertexCount;
+			item.sortKey = drawSortKey(material[i].id, material[i].texture, -glm::dot(depthRow, glm::vec4(center, 1.0f)), backToFront);
+		}
+		return count;
+	}
+};
+
+// Records draws in order, switching program and texture only where they change
+inline void recordDraws(const DrawItem *items, size_t count, const glm::mat4 &viewProjection, CommandBuffer &out)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		if (i == 0 || items[i].program != items[i - 1].program)
+			out.push<ProgramCommand>()->program = items[i].program;
+		if (i == 0 || items[i].texture != items[i - 1].texture)
+			out.push<TextureCommand>()->texture = items[i].texture;
+		TransformCommand *transform = out.push<TransformCommand>();
+		transform->mvp = viewProjection * items[i].model;
+		transform->model = items[i].model;
+		DrawCommand *draw = out.push<DrawCommand>();
+		draw->mesh = items[i].mesh;
+		draw->first = 0;
+		draw->count = items[i].vertexCount;
+		draw->material = items[i].material;
+	}
+}
+
+// Cuts the sorted draw list into consecutive slices recorded in parallel, one
+// command buffer each, so replaying the buffers in order keeps the sort.
+inline FrameArray<CommandBuffer> recordDrawCommands(JobSystem &jobs, FrameArena &frame, const FrameArray<DrawItem> &draws, const glm::mat4 &viewProjection)
+{
+	const uint32_t minDrawsPerList = 64;
+	uint32_t listCount = std::min(jobs.threadCount() * 4, (uint32_t)(draws.size() + minDrawsPerList - 1) / minDrawsPerList);
+	FrameArray<CommandBuffer> lists(frame, listCount);
+	if (listCount == 0)
+		return lists;
+	size_t perList = (draws.size() + listCount - 1) / listCount;
+	jobs.parallelFor(listCount, 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t l = begin; l < end; l++)
+		{
+			size_t first = std::min(draws.size(), l * perList);
+			size_t last = std::min(draws.size(), first + perList);
+			lists[l].begin(frame);
+			recordDraws(draws.data() + first, last - first, viewProjection, lists[l]);
+		}
+	});
+	return lists;
+}
+
+#endif
@@ -0,0 +1,301 @@
+#ifndef DYNRES_HPP
+#define DYNRES_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#include <GL/glew.h>
+
+#include "shaders.hpp"
+
+// Dynamic resolution : the scene is drawn offscreen at a fraction of the
+// window size, chosen each frame to hold a GPU time budget, then upscaled
+// into the window. Under load the image gets softer instead of the frames
+// getting late.
+//
+// The targets are allocated once at full size and the scene is drawn into
+// their lower left corner, so a new scale is only a new viewport. With
+// multisampling the scene goes to multisampled renderbuffers, and the used
+// corner is resolved into a texture before the upscale.
+//
+// The controller assumes GPU time grows with the pixel count, so the scale
+// it aims at is sqrt(budget / time) times the current one. It moves part of
+// the way there each time, faster down than up : a load spike is met within
+// a few frames, and the scale recovers without oscillating. After a change
+// it waits for the timer queries of the new scale before judging it.
+//
+// Per frame : begin() before the clear, end() after the last draw (before a
+// capture readback, which then sees the upscaled image), update() with each
+// GPU time measured.
+
+#define DYNRES_SETTLE_FRAMES 4 // frames a new scale takes to show in the timer queries
+#define DYNRES_MIN_CHANGE 0.02f // smaller corrections are noise
+
+enum UpscaleFilter
+{
+	UPSCALE_BILINEAR,
+	UPSCALE_SHARPEN
+};
+
+static const char *const g_upscale_filter_names[] = {"bilinear", "sharpen"};
+
+// Full screen triangle
+static const char *const g_upscale_vertex_shader = R"(#version 330 core
+out vec2 uv;
+void main()
+{
+	uv = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+// Bilinear, then with `sharpness` an unsharp mask over the 4 neighbours,
+// clamped to their range so edges don't ring. Samples stay inside the
+// rendered corner, what is beyond is an older frame.
+static const char *const g_upscale_fragment_shader = R"(#version 330 core
+in vec2 uv;
+out vec4 color;
+uniform sampler2D source;
+uniform vec2 extent;
+uniform float sharpness;
+void main()
+{
+	vec2 texel = 1.0 / vec2(textureSize(source, 0));
+	vec2 st = clamp(uv * extent, 0.5 * texel, extent - 0.5 * texel);
+	vec3 c = texture(source, st).rgb;
+	if (sharpness > 0.0)
+	{
+		vec3 n = texture(source, clamp(st + vec2(0.0, texel.y), 0.5 * texel, extent - 0.5 * texel)).rgb;
+		vec3 s = texture(source, clamp(st - vec2(0.0, texel.y), 0.5 * texel, extent - 0.5 * texel)).rgb;
+		vec3 e = texture(source, clamp(st + vec2(texel.x, 0.0), 0.5 * texel, extent - 0.5 * texel)).rgb;
+		vec3 w = texture(source, clamp(st - vec2(texel.x, 0.0), 0.5 * texel, extent - 0.5 * texel)).rgb;
+		vec3 low = min(c, min(min(n, s), min(e, w)));
+		vec3 high = max(c, max(max(n, s), max(e, w)));
+		c = clamp(c + sharpness * (c - 0.25 * (n + s + e + w)), low, high);
+	}
+	color = vec4(c, 1.0);
+}
+)";
+
+struct DynamicResolutionStats
+{
+	float minScale; // over the period
+	float maxScale;
+	double scaleSum;
+	uint32_t frames;
+	uint32_t changes;
+};
+
+class DynamicResolution
+{
+public:
+	DynamicResolution()
+		: width(0), height(0), samples(0), budget(0.0), filter(UPSCALE_BILINEAR), lowest(0.5f), current(1.0f),
+		  settle(0), program(0), sourceId(-1), extentId(-1), sharpnessId(-1), vertexArray(0), sceneFramebuffer(0),
+		  resolveFramebuffer(0), colorBuffer(0), depthBuffer(0), texture(0)
+	{
+		resetStats();
+	}
+
+	// budget : GPU seconds per frame to hold. minScale : lowest fraction of the window size.
+	bool create(int width, int height, int samples, double budget, UpscaleFilter filter, float minScale)
+	{
+		this->width = width;
+		this->height = height;
+		this->budget = budget;
+		this->filter = filter;
+		lowest = minScale < 0.1f ? 0.1f : minScale > 1.0f ? 1.0f : minScale;
+		current = 1.0f;
+
+		program = buildProgram(g_upscale_vertex_shader, g_upscale_fragment_shader, "upscale");
+		if (!program)
+			return false;
+		sourceId = glGetUniformLocation(program, "source");
+		extentId = glGetUniformLocation(program, "extent");
+		sharpnessId = glGetUniformLocation(program, "sharpness");
+		glGenVertexArrays(1, &vertexArray);
+
+		GLint maxSamples = 0;
+		glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+		this->samples = samples > maxSamples ? maxSamples : samples > 1 ? samples : 0;
+
+		// What the upscale reads
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glGenFramebuffers(1, &resolveFramebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, resolveFramebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+
+		// Without multisampling the scene is drawn straight into the texture
+		glGenRenderbuffers(1, &depthBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+		glRenderbufferStorageMultisample(GL_RENDERBUFFER, this->samples, GL_DEPTH_COMPONENT24, width, height);
+		if (this->samples)
+		{
+			glGenRenderbuffers(1, &colorBuffer);
+			glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+			glRenderbufferStorageMultisample(GL_RENDERBUFFER, this->samples, GL_RGBA8, width, height);
+			glGenFramebuffers(1, &sceneFramebuffer);
+			glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+		}
+		else
+			sceneFramebuffer = resolveFramebuffer;
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		if (status == GL_FRAMEBUFFER_COMPLETE && this->samples)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, resolveFramebuffer);
+			status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (status != GL_FRAMEBUFFER_COMPLETE)
+		{
+			fprintf(stderr, "Offscreen target incomplete (0x%x)\n", status);
+			destroy();
+			return false;
+		}
+		return true;
+	}
+
+	void destroy()
+	{
+		if (sceneFramebuffer && sceneFramebuffer != resolveFramebuffer)
+			glDeleteFramebuffers(1, &sceneFramebuffer);
+		if (resolveFramebuffer)
+			glDeleteFramebuffers(1, &resolveFramebuffer);
+		if (colorBuffer)
+			glDeleteRenderbuffers(1, &colorBuffer);
+		if (depthBuffer)
+			glDeleteRenderbuffers(1, &depthBuffer);
+		if (texture)
+			glDeleteTextures(1, &texture);
+		if (vertexArray)
+			glDeleteVertexArrays(1, &vertexArray);
+		if (program)
+			glDeleteProgram(program);
+		sceneFramebuffer = resolveFramebuffer = colorBuffer = depthBuffer = texture = vertexArray = program = 0;
+	}
+
+	// Draws go to the offscreen corner from here, clears included
+	void begin()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+		glViewport(0, 0, renderWidth(), renderHeight());
+		glScissor(0, 0, renderWidth(), renderHeight());
+		glEnable(GL_SCISSOR_TEST);
+		stats.minScale = current < stats.minScale ? current : stats.minScale;
+		stats.maxScale = current > stats.maxScale ? current : stats.maxScale;
+		stats.scaleSum += current;
+		stats.frames++;
+	}
+
+	// Resolves the corner and upscales it into the window
+	void end()
+	{
+		int w = renderWidth(), h = renderHeight();
+		glDisable(GL_SCISSOR_TEST);
+		if (samples)
+		{
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFramebuffer);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFramebuffer);
+			glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, width, height);
+
+		glDisable(GL_DEPTH_TEST);
+		glUseProgram(program);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glUniform1i(sourceId, 0);
+		glUniform2f(extentId, (float)w / width, (float)h / height);
+		// Nothing to sharpen at full size
+		glUniform1f(sharpnessId, filter == UPSCALE_SHARPEN && current < 1.0f ? 0.5f : 0.0f);
+		glBindVertexArray(vertexArray);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glEnable(GL_DEPTH_TEST);
+	}
+
+	// With the GPU time of a past frame
+	void update(double gpuSeconds)
+	{
+		if (settle)
+		{
+			settle--;
+			return;
+		}
+		if (gpuSeconds <= 0.0)
+			return;
+		float target = current * (float)sqrt(budget / gpuSeconds);
+		target = target < lowest ? lowest : target > 1.0f ? 1.0f : target;
+		float next = current + (target - current) * (target < current ? 0.5f : 0.15f);
+		// Straight to a bound when close, the last small step would never be taken
+		bool bound = target == 1.0f || target == lowest;
+		if (bound && fabsf(target - next) < DYNRES_MIN_CHANGE)
+			next = target;
+		if (next == current || (fabsf(next - current) < DYNRES_MIN_CHANGE && next != target))
+			return;
+		current = next;
+		settle = DYNRES_SETTLE_FRAMES;
+		stats.changes++;
+	}
+
+	float scale() const { return current; }
+	int renderWidth() const { return (int)(width * current + 0.5f); }
+	int renderHeight() const { return (int)(height * current + 0.5f); }
+	double frameBudget() const { return budget; }
+	UpscaleFilter upscaleFilter() const { return filter; }
+	int sampleCount() const { return samples; }
+	// Where begin() sends the draws
+	GLuint framebuffer() const { return sceneFramebuffer; }
+
+	DynamicResolutionStats takeStats()
+	{
+		DynamicResolutionStats s = stats;
+		resetStats();
+		return s;
+	}
+
+private:
+	DynamicResolution(const DynamicResolution &);
+	DynamicResolution &operator=(const DynamicResolution &);
+
+	void resetStats()
+	{
+		stats.minScale = 1.0f;
+		stats.maxScale = 0.0f;
+		stats.scaleSum = 0.0;
+		stats.frames = 0;
+		stats.changes = 0;
+	}
+
+	int width, height; // of the window, and of the targets
+	int samples;
+	double budget;
+	UpscaleFilter filter;
+	float lowest;
+	float current;
+	int settle; // measurements to skip before judging the scale
+	GLuint program;
+	GLint sourceId, extentId, sharpnessId;
+	GLuint vertexArray;
+	GLuint sceneFramebuffer;
+	GLuint resolveFramebuffer;
+	GLuint colorBuffer; // multisampled, 0 without
+	GLuint depthBuffer;
+	GLuint texture;
+	DynamicResolutionStats stats;
+};
+
+#endif
@@ -0,0 +1,391 @@
+#ifndef ENTITIES_HPP
+#define ENTITIES_HPP
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// Data-oriented entity store.
+// Entities with the same set of components share an archetype, and the
+// components of an archetype are packed per type (one array per component)
+// into fixed size chunks, so a system only streams the arrays it reads.
+
+// Components
+struct Transform
+{
+	glm::vec3 position;
+	float scale;
+	glm::mat4 model; // written by transformSystem
+};
+
+struct MeshHandle
+{
+	uint32_t id;
+	uint32_t vertexCount;
+};
+
+struct MaterialHandle
+{
+	uint32_t id;
+	uint32_t texture;  // 0 for none
+	uint32_t material; // entry of the material table, see DrawCommand
+};
+
+struct Bounds
+{
+	glm::vec3 center; // model space
+	float radius;
+	glm::vec3 worldCenter; // written by transformSystem
+	float worldRadius;
+};
+
+struct Animation
+{
+	glm::vec3 axis;
+	float angle;
+	float previousAngle; // before the last step, rendering interpolates between the two
+	float speed;		 // radians per second
+};
+
+enum ComponentType
+{
+	COMPONENT_TRANSFORM,
+	COMPONENT_MESH,
+	COMPONENT_MATERIAL,
+	COMPONENT_BOUNDS,
+	COMPONENT_ANIMATION,
+	COMPONENT_COUNT
+};
+
+#define COMPONENT_BIT(type) (1u << (type))
+
+template <class T> struct ComponentId;
+template <> struct ComponentId<Transform> { enum { value = COMPONENT_TRANSFORM }; };
+template <> struct ComponentId<MeshHandle> { enum { value = COMPONENT_MESH }; };
+template <> struct ComponentId<MaterialHandle> { enum { value = COMPONENT_MATERIAL }; };
+template <> struct ComponentId<Bounds> { enum { value = COMPONENT_BOUNDS }; };
+template <> struct ComponentId<Animation> { enum { value = COMPONENT_ANIMATION }; };
+
+static const size_t g_component_size[COMPONENT_COUNT] = {
+	sizeof(Transform),
+	sizeof(MeshHandle),
+	sizeof(MaterialHandle),
+	sizeof(Bounds),
+	sizeof(Animation)};
+
+// Default values of a freshly created component
+inline void constructComponent(int type, void *p)
+{
+	switch (type)
+	{
+	case COMPONENT_TRANSFORM:
+	{
+		Transform *t = new (p) Transform();
+		t->position = glm::vec3(0.0f);
+		t->scale = 1.0f;
+		t->model = glm::mat4(1.0f);
+		break;
+	}
+	case COMPONENT_MESH:
+		memset(new (p) MeshHandle(), 0, sizeof(MeshHandle));
+		break;
+	case COMPONENT_MATERIAL:
+		memset(new (p) MaterialHandle(), 0, sizeof(MaterialHandle));
+		break;
+	case COMPONENT_BOUNDS:
+	{
+		Bounds *b = new (p) Bounds();
+		b->center = b->worldCenter = glm::vec3(0.0f);
+		b->radius = b->worldRadius = 0.0f;
+		break;
+	}
+	case COMPONENT_ANIMATION:
+	{
+		Animation *a = new (p) Animation();
+		a->axis = glm::vec3(0.0f, 1.0f, 0.0f);
+		a->angle = a->previousAngle = 0.0f;
+		a->speed = 0.0f;
+		break;
+	}
+	}
+}
+
+struct Entity
+{
+	uint32_t index;
+	uint32_t generation;
+};
+
+static const Entity NULL_ENTITY = {0xFFFFFFFFu, 0};
+
+#define ENTITY_CHUNK_BYTES (16 * 1024)
+
+struct Archetype;
+
+// One block of ENTITY_CHUNK_BYTES holding `capacity` entities of an archetype
+struct Chunk
+{
+	Archetype *archetype;
+	uint32_t count;
+	uint32_t capacity;
+	unsigned char *data;
+	Entity *entities;
+
+	template <class T> T *array();
+};
+
+struct Archetype
+{
+	uint32_t mask;
+	uint32_t capacity;                 // entities per chunk
+	uint32_t offsets[COMPONENT_COUNT]; // byte offset of each array in a chunk
+	std::vector<Chunk *> chunks;
+};
+
+template <class T> T *Chunk::array()
+{
+	return (T *)(data + archetype->offsets[ComponentId<T>::value]);
+}
+
+class EntityStore
+{
+public:
+	EntityStore() {}
+
+	~EntityStore()
+	{
+		for (size_t i = 0; i < archetypes.size(); i++)
+		{
+			for (size_t c = 0; c < archetypes[i]->chunks.size(); c++)
+				freeChunk(archetypes[i]->chunks[c]);
+			delete archetypes[i];
+		}
+	}
+
+	Entity create(uint32_t mask)
+	{
+		Archetype *arch = findArchetype(mask);
+		if (arch->chunks.empty() || arch->chunks.back()->count == arch->capacity)
+			arch->chunks.push_back(allocChunk(arch));
+		Chunk *chunk = arch->chunks.back();
+		uint32_t row = chunk->count++;
+
+		Entity e;
+		if (!freeRecords.empty())
+		{
+			e.index = freeRecords.back();
+			freeRecords.pop_back();
+		}
+		else
+		{
+			e.index = (uint32_t)records.size();
+			Record r = {NULL, 0, 0, 0};
+			records.push_back(r);
+		}
+		Record &r = records[e.index];
+		r.archetype = arch;
+		r.chunk = (uint32_t)arch->chunks.size() - 1;
+		r.row = row;
+		e.generation = r.generation;
+
+		chunk->entities[row] = e;
+		for (int c = 0; c < COMPONENT_COUNT; c++)
+			if (mask & COMPONENT_BIT(c))
+				constructComponent(c, chunk->data + arch->offsets[c] + row * g_component_size[c]);
+		living++;
+		return e;
+	}
+
+	// Moves the archetype's last entity into the hole so chunks stay dense
+	void destroy(Entity e)
+	{
+		if (!alive(e))
+			return;
+		Record &r = records[e.index];
+		Archetype *arch = r.archetype;
+		Chunk *chunk = arch->chunks[r.chunk];
+		Chunk *last = arch->chunks.back();
+		uint32_t lastRow = last->count - 1;
+
+		if (last != chunk || lastRow != r.row)
+		{
+			for (int c = 0; c < COMPONENT_COUNT; c++)
+				if (arch->mask & COMPONENT_BIT(c))
+					memcpy(chunk->data + arch->offsets[c] + r.row * g_component_size[c],
+						   last->data + arch->offsets[c] + lastRow * g_component_size[c],
+						   g_component_size[c]);
+			Entity moved = last->entities[lastRow];
+			chunk->entities[r.row] = moved;
+			records[moved.index].chunk = r.chunk;
+			records[moved.index].row = r.row;
+		}
+		if (--last->count == 0)
+		{
+			freeChunk(last);
+			arch->chunks.pop_back();
+		}
+
+		r.archetype = NULL;
+		r.generation++;
+		freeRecords.push_back(e.index);
+		living--;
+	}
+
+	bool alive(Entity e) const
+	{
+		return e.index < records.size() && records[e.index].archetype != NULL && records[e.index].generation == e.generation;
+	}
+
+	// Returns NULL if the entity is dead or has no such component
+	template <class T> T *get(Entity e)
+	{
+		if (!alive(e))
+			return NULL;
+		Record &r = records[e.index];
+		if (!(r.archetype->mask & COMPONENT_BIT(ComponentId<T>::value)))
+			return NULL;
+		return r.archetype->chunks[r.chunk]->template array<T>() + r.row;
+	}
+
+	// Calls f(Chunk &) for every chunk whose archetype has all the components of `mask`
+	template <class F> void eachChunk(uint32_t mask, F f)
+	{
+		for (size_t i = 0; i < archetypes.size(); i++)
+		{
+			Archetype *arch = archetypes[i];
+			if ((arch->mask & mask) != mask)
+				continue;
+			for (size_t c = 0; c < arch->chunks.size(); c++)
+				f(*arch->chunks[c]);
+		}
+	}
+
+	// Same chunks as eachChunk, collected so the work can be split across threads
+	void gatherChunks(uint32_t mask, std::vector<Chunk *> &out)
+	{
+		out.clear();
+		eachChunk(mask, [&out](Chunk &chunk) { out.push_back(&chunk); });
+	}
+
+	size_t size() const { return living; }
+
+private:
+	struct Record
+	{
+		Archetype *archetype;
+		uint32_t chunk;
+		uint32_t row;
+		uint32_t generation;
+	};
+
+	Archetype *findArchetype(uint32_t mask)
+	{
+		for (size_t i = 0; i < archetypes.size(); i++)
+			if (archetypes[i]->mask == mask)
+				return archetypes[i];
+
+		size_t rowBytes = sizeof(Entity);
+		for (int c = 0; c < COMPONENT_COUNT; c++)
+			if (mask & COMPONENT_BIT(c))
+				rowBytes += g_component_size[c];
+
+		Archetype *arch = new Archetype();
+		arch->mask = mask;
+		// Keep some room for the 16 byte alignment of each array
+		arch->capacity = (uint32_t)((ENTITY_CHUNK_BYTES - 16 * (COMPONENT_COUNT + 1)) / rowBytes);
+		uint32_t offset = 0;
+		for (int c = 0; c < COMPONENT_COUNT; c++)
+		{
+			arch->offsets[c] = 0;
+			if (!(mask & COMPONENT_BIT(c)))
+				continue;
+			arch->offsets[c] = offset;
+			offset += (uint32_t)((arch->capacity * g_component_size[c] + 15) & ~(size_t)15);
+		}
+		archetypes.push_back(arch);
+		return arch;
+	}
+
+	Chunk *allocChunk(Archetype *arch)
+	{
+		Chunk *chunk = new Chunk();
+		chunk->archetype = arch;
+		chunk->count = 0;
+		chunk->capacity = arch->capacity;
+		chunk->data = (unsigned char *)malloc(ENTITY_CHUNK_BYTES);
+		// Entity ids go last, they are only read when destroying
+		chunk->entities = (Entity *)(chunk->data + ENTITY_CHUNK_BYTES - arch->capacity * sizeof(Entity));
+		return chunk;
+	}
+
+	void freeChunk(Chunk *chunk)
+	{
+		free(chunk->data);
+		delete chunk;
+	}
+
+	std::vector<Archetype *> archetypes;
+	std::vector<Record> records;
+	std::vector<uint32_t> freeRecords;
+	size_t living = 0;
+
+	EntityStore(const EntityStore &);
+	EntityStore &operator=(const EntityStore &);
+};
+
+// Systems
+// Each system is a kernel over one chunk, so callers can spread the chunks over threads
+
+// Advances the rotation of every animated entity by one step
+inline void animateChunk(Chunk &chunk, float deltaTime)
+{
+	if (!(chunk.archetype->mask & COMPONENT_BIT(COMPONENT_ANIMATION)))
+		return;
+	Animation *anim = chunk.array<Animation>();
+	for (uint32_t i = 0; i < chunk.count; i++)
+	{
+		anim[i].previousAngle = anim[i].angle;
+		anim[i].angle += anim[i].speed * deltaTime;
+	}
+}
+
+// Rebuilds model matrices (and world bounds when present) from position, scale and animation.
+// `alpha` places the animation between its last two steps, 1 for the latest.
+inline void transformChunk(Chunk &chunk, float alpha = 1.0f)
+{
+	if (!(chunk.archetype->mask & COMPONENT_BIT(COMPONENT_TRANSFORM)))
+		return;
+	Transform *transform = chunk.array<Transform>();
+	bool animated = (chunk.archetype->mask & COMPONENT_BIT(COMPONENT_ANIMATION)) != 0;
+	bool bounded = (chunk.archetype->mask & COMPONENT_BIT(COMPONENT_BOUNDS)) != 0;
+	Animation *anim = animated ? chunk.array<Animation>() : NULL;
+	Bounds *bounds = bounded ? chunk.array<Bounds>() : NULL;
+	for (uint32_t i = 0; i < chunk.count; i++)
+	{
+		glm::mat4 model = glm::translate(glm::mat4(1.0f), transform[i].position);
+		if (animated)
+			model = glm::rotate(model, anim[i].previousAngle + (anim[i].angle - anim[i].previousAngle) * alpha, anim[i].axis);
+		transform[i].model = glm::scale(model, glm::vec3(transform[i].scale));
+		if (bounded)
+		{
+			bounds[i].worldCenter = glm::vec3(transform[i].model * glm::vec4(bounds[i].center, 1.0f));
+			bounds[i].worldRadius = bounds[i].radius * transform[i].scale;
+		}
+	}
+}
+
+inline void animationSystem(EntityStore &store, float deltaTime)
+{
+	store.eachChunk(COMPONENT_BIT(COMPONENT_ANIMATION), [deltaTime](Chunk &chunk) { animateChunk(chunk, deltaTime); });
+}
+
+inline void transformSystem(EntityStore &store, float alpha = 1.0f)
+{
+	store.eachChunk(COMPONENT_BIT(COMPONENT_TRANSFORM), [alpha](Chunk &chunk) { transformChunk(chunk, alpha); });
+}
+
+#endif
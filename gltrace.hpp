@@ -0,0 +1,1300 @@
+#ifndef GLTRACE_HPP
+#define GLTRACE_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <GL/glew.h>
+
+// GL command stream capture, for replaying the exact same calls later
+// (tools/gltrace_replay.cpp) without the window, the input or glfwGetTime()
+// deciding what gets drawn.
+//
+// Built with -DGLTRACE, this header reroutes the GL calls of everything
+// included after it to wrappers that record each call, its arguments and its
+// payloads (buffer contents, uniforms, shader sources...) into a binary
+// trace. Without it nothing is rerouted and the functions below do nothing.
+// Only the calls the tree makes are wrapped : a new call site of another GL
+// function needs its wrapper here, or the replay won't see it.
+//
+// Recording runs from glTraceOpen() to the end of the frame range : the
+// frames before the range are kept since they create the state the range
+// draws with, the replay times the range only.
+//
+// What the trace can't see is written as plain data :
+//   - writes through mapped pointers : a write map is copied when it is
+//     unmapped, a persistent one is compared with a shadow copy before every
+//     call that may read it and the changed bytes are recorded
+//   - programs built outside (LoadShaders) : glTraceAdoptProgram() records
+//     them as if built here, from their source files
+// Names (buffers, programs, syncs, uniform locations...) are recorded as the
+// driver returned them, the replay maps them to its own.
+//
+// New calls are appended to GLTRACE_OPS, older traces keep their codes.
+//
+// Format : GlTraceHeader, then per call its GlTraceOp byte and its arguments,
+// little endian. Blobs are a 64 bit size and the bytes, strings a 32 bit size
+// and the characters.
+
+#define GLTRACE_VERSION 1
+
+#define GLTRACE_OPS(X)                                                                                                          \
+	X(Frame) X(MappedWrite) X(AttachShader) X(BindBuffer) X(BindBufferBase) X(BindBufferRange) X(BindVertexArray) X(BufferData) \
+	X(BufferStorage) X(Clear) X(ClearBufferData) X(ClearBufferSubData) X(ClearColor) X(ClientWaitSync) X(CompileShader)         \
+	X(CopyBufferSubData) X(CreateProgram) X(CreateShader) X(DeleteBuffers) X(DeleteProgram) X(DeleteShader) X(DeleteSync)       \
+	X(DeleteTextures) X(DeleteVertexArrays) X(DepthFunc) X(DetachShader) X(DisableVertexAttribArray) X(DispatchCompute)         \
+	X(DrawArrays) X(Enable) X(EnableVertexAttribArray) X(FenceSync) X(Finish) X(GenBuffers) X(GenVertexArrays)                  \
+	X(GetBufferSubData) X(GetIntegerv) X(GetProgramInfoLog) X(GetProgramiv) X(GetShaderInfoLog) X(GetShaderiv)                  \
+	X(GetUniformLocation) X(LinkProgram) X(MapBufferRange) X(MemoryBarrier) X(MultiDrawElementsIndirect)                        \
+	X(MultiDrawElementsIndirectCountARB) X(PixelStorei) X(ReadBuffer) X(ReadPixels) X(ShaderSource) X(Uniform1f)                \
+	X(Uniform1ui) X(Uniform3f) X(Uniform4fv) X(UniformMatrix4fv) X(UnmapBuffer) X(UseProgram) X(VertexAttribPointer)            \
+	X(BeginQuery) X(DeleteQueries) X(EndQuery) X(GenQueries) X(GetQueryObjectiv) X(GetQueryObjectui64v)                         \
+	X(ActiveTexture) X(BindFramebuffer) X(BindRenderbuffer) X(BindTexture) X(BlitFramebuffer) X(CheckFramebufferStatus)         \
+	X(DeleteFramebuffers) X(DeleteRenderbuffers) X(Disable) X(FramebufferRenderbuffer) X(FramebufferTexture2D)                  \
+	X(GenFramebuffers) X(GenRenderbuffers) X(GenTextures) X(RenderbufferStorageMultisample) X(Scissor) X(TexImage2D)            \
+	X(TexParameteri) X(Uniform1i) X(Uniform2f) X(Viewport) X(BindImageTexture) X(DrawBuffers) X(QueryCounter)                   \
+	X(BlendFunc) X(ColorMask) X(DepthMask) X(TexImage3D) X(ClearBufferfv) X(TexSubImage2D)
+
+#define GLTRACE_ENUM(name) GLT_##name,
+enum GlTraceOp
+{
+	GLTRACE_OPS(GLTRACE_ENUM) GLT_COUNT
+};
+#undef GLTRACE_ENUM
+
+#define GLTRACE_NAME(name) #name,
+static const char *const g_gltrace_op_names[] = {GLTRACE_OPS(GLTRACE_NAME)};
+#undef GLTRACE_NAME
+
+struct GlTraceHeader
+{
+	char magic[8]; // "GLTRACE", 0
+	uint32_t version;
+	uint32_t width; // of the default framebuffer
+	uint32_t height;
+	uint32_t firstFrame; // the frames timed by the replay
+	uint32_t frameCount;
+	char renderer[128]; // GL_RENDERER and GL_VERSION of the recording
+	char glVersion[128];
+};
+
+// Bytes of one element of glClearBuffer(Sub)Data
+inline size_t glTraceClearSize(GLenum format, GLenum type)
+{
+	size_t components = 4;
+	if (format == GL_RED || format == GL_RED_INTEGER)
+		components = 1;
+	else if (format == GL_RG || format == GL_RG_INTEGER)
+		components = 2;
+	else if (format == GL_RGB || format == GL_RGB_INTEGER)
+		components = 3;
+	size_t bytes = 4;
+	if (type == GL_UNSIGNED_BYTE || type == GL_BYTE)
+		bytes = 1;
+	else if (type == GL_UNSIGNED_SHORT || type == GL_SHORT || type == GL_HALF_FLOAT)
+		bytes = 2;
+	return components * bytes;
+}
+
+// Reads a trace, call by call
+class GlTraceReader
+{
+public:
+	GlTraceReader() : file(NULL), failed(false) {}
+	~GlTraceReader() { close(); }
+
+	bool open(const char *path)
+	{
+		if (!(file = fopen(path, "rb")))
+		{
+			fprintf(stderr, "Could not read %s\n", path);
+			return false;
+		}
+		setvbuf(file, NULL, _IOFBF, 1 << 20);
+		if (fread(&header, sizeof(header), 1, file) != 1 || strcmp(header.magic, "GLTRACE") || header.version != GLTRACE_VERSION)
+		{
+			fprintf(stderr, "%s is not a version %d GL trace\n", path, GLTRACE_VERSION);
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close()
+	{
+		if (file)
+			fclose(file);
+		file = NULL;
+	}
+
+	// False at the end of the trace
+	bool next(GlTraceOp &op)
+	{
+		int c = fgetc(file);
+		if (c == EOF || c >= GLT_COUNT)
+		{
+			if (c != EOF)
+				fprintf(stderr, "Unknown call %d in the trace\n", c);
+			return false;
+		}
+		op = (GlTraceOp)c;
+		return !failed;
+	}
+
+	// Arguments are read with the types of the GL signature, as recorded
+	template <typename T> T get()
+	{
+		T value = T();
+		if (fread(&value, sizeof(T), 1, file) != 1)
+			failed = true;
+		return value;
+	}
+
+	// Size of the blob, 0 when the call passed NULL
+	size_t bytes(std::vector<unsigned char> &out)
+	{
+		uint64_t size = get<uint64_t>();
+		out.resize(size);
+		if (size && fread(out.data(), 1, size, file) != size)
+			failed = true;
+		return size;
+	}
+
+	std::string string()
+	{
+		uint32_t size = get<uint32_t>();
+		std::string out(size, '\0');
+		if (size && fread(&out[0], 1, size, file) != size)
+			failed = true;
+		return out;
+	}
+
+	bool truncated() const { return failed; }
+
+	GlTraceHeader header;
+
+private:
+	FILE *file;
+	bool failed;
+};
+
+#ifdef GLTRACE
+
+// The recording side, one per process : GL calls are made by one thread at a time
+class GlTraceWriter
+{
+public:
+	static GlTraceWriter &get()
+	{
+		static GlTraceWriter writer;
+		return writer;
+	}
+
+	bool open(const char *path, int width, int height, uint32_t firstFrame, uint32_t frameCount)
+	{
+		if (!(file = fopen(path, "wb")))
+		{
+			fprintf(stderr, "Could not write %s\n", path);
+			return false;
+		}
+		setvbuf(file, NULL, _IOFBF, 1 << 20);
+		GlTraceHeader header;
+		memset(&header, 0, sizeof(header));
+		strcpy(header.magic, "GLTRACE");
+		header.version = GLTRACE_VERSION;
+		header.width = width;
+		header.height = height;
+		header.firstFrame = firstFrame;
+		header.frameCount = frameCount;
+		const char *renderer = (const char *)glGetString(GL_RENDERER);
+		const char *version = (const char *)glGetString(GL_VERSION);
+		strncpy(header.renderer, renderer ? renderer : "", sizeof(header.renderer) - 1);
+		strncpy(header.glVersion, version ? version : "", sizeof(header.glVersion) - 1);
+		fwrite(&header, sizeof(header), 1, file);
+		lastFrame = firstFrame + frameCount;
+		tracePath = path;
+		calls = 0;
+		return true;
+	}
+
+	bool active() const { return file != NULL; }
+
+	// After the swap. Closes the trace after the last frame of the range.
+	void frame(uint64_t number)
+	{
+		if (!file)
+			return;
+		flushPersistent();
+		op(GLT_Frame);
+		put<uint64_t>(number);
+		if (number + 1 >= lastFrame)
+		{
+			long bytes = ftell(file);
+			fclose(file);
+			file = NULL;
+			printf("GL trace : %llu calls, %.1f MB written to %s\n", (unsigned long long)calls, bytes / 1048576.0, tracePath.c_str());
+		}
+	}
+
+	void op(GlTraceOp code)
+	{
+		fputc(code, file);
+		calls++;
+	}
+
+	template <typename T> void put(T value) { fwrite(&value, sizeof(T), 1, file); }
+
+	void bytes(const void *data, size_t size)
+	{
+		put<uint64_t>(data ? size : 0);
+		if (data && size)
+			fwrite(data, 1, size, file);
+	}
+
+	void string(const char *text, size_t size)
+	{
+		put<uint32_t>((uint32_t)size);
+		fwrite(text, 1, size, file);
+	}
+
+	// Mirrors of the state the recording needs
+	GLuint bound(GLenum target) const
+	{
+		std::map<GLenum, GLuint>::const_iterator it = bindings.find(target);
+		return it == bindings.end() ? 0 : it->second;
+	}
+
+	void bind(GLenum target, GLuint buffer) { bindings[target] = buffer; }
+
+	uint32_t newSync(GLsync sync)
+	{
+		uint32_t id = ++syncCount;
+		syncs[sync] = id;
+		return id;
+	}
+
+	uint32_t syncId(GLsync sync, bool forget)
+	{
+		std::map<GLsync, uint32_t>::iterator it = syncs.find(sync);
+		if (it == syncs.end())
+			return 0;
+		uint32_t id = it->second;
+		if (forget)
+			syncs.erase(it);
+		return id;
+	}
+
+	// Mapped ranges, recorded as writes when they may be read
+	void mapped(GLuint buffer, GLintptr offset, GLsizeiptr length, GLbitfield access, void *pointer)
+	{
+		if (!pointer || !(access & GL_MAP_WRITE_BIT))
+			return;
+		Mapping &m = mappings[buffer];
+		m.offset = offset;
+		m.pointer = (unsigned char *)pointer;
+		m.persistent = (access & GL_MAP_PERSISTENT_BIT) != 0;
+		m.shadow.clear();
+		m.length = length;
+		// A persistent map starts as the driver gives it, record it whole once
+		if (m.persistent)
+			m.shadow.assign(length, 0);
+	}
+
+	void unmapped(GLuint buffer)
+	{
+		std::map<GLuint, Mapping>::iterator it = mappings.find(buffer);
+		if (it == mappings.end())
+			return;
+		if (it->second.persistent)
+			flushMapping(buffer, it->second);
+		else
+			writeRange(buffer, it->second.offset, it->second.pointer, it->second.length);
+		mappings.erase(it);
+	}
+
+	void forgetBuffer(GLuint buffer) { mappings.erase(buffer); }
+
+	// Before anything that may read a buffer : what changed in persistent maps
+	void flushPersistent()
+	{
+		for (std::map<GLuint, Mapping>::iterator it = mappings.begin(); it != mappings.end(); ++it)
+			if (it->second.persistent)
+				flushMapping(it->first, it->second);
+	}
+
+private:
+	struct Mapping
+	{
+		GLintptr offset;
+		size_t length;
+		unsigned char *pointer;
+		bool persistent;
+		std::vector<unsigned char> shadow; // persistent maps : the bytes last recorded
+	};
+
+	GlTraceWriter() : file(NULL), calls(0), lastFrame(0), syncCount(0) {}
+
+	// Changed runs of 64 bytes, neighbours merged
+	void flushMapping(GLuint buffer, Mapping &m)
+	{
+		const size_t block = 64;
+		size_t runStart = 0, runEnd = 0;
+		for (size_t start = 0; start < m.length; start += block)
+		{
+			size_t size = m.length - start < block ? m.length - start : block;
+			if (!memcmp(m.pointer + start, &m.shadow[start], size))
+				continue;
+			memcpy(&m.shadow[start], m.pointer + start, size);
+			if (runEnd != start && runEnd > runStart)
+			{
+				writeRange(buffer, m.offset + runStart, m.pointer + runStart, runEnd - runStart);
+				runStart = start;
+			}
+			else if (runEnd <= runStart)
+				runStart = start;
+			runEnd = start + size;
+		}
+		if (runEnd > runStart)
+			writeRange(buffer, m.offset + runStart, m.pointer + runStart, runEnd - runStart);
+	}
+
+	void writeRange(GLuint buffer, GLintptr offset, const void *data, size_t size)
+	{
+		op(GLT_MappedWrite);
+		put<uint32_t>(buffer);
+		put<uint64_t>(offset);
+		bytes(data, size);
+	}
+
+	FILE *file;
+	std::string tracePath;
+	uint64_t calls;
+	uint64_t lastFrame;
+	std::map<GLenum, GLuint> bindings;
+	std::map<GLsync, uint32_t> syncs;
+	uint32_t syncCount;
+	std::map<GLuint, Mapping> mappings;
+};
+
+// Payloads of a recorded call
+struct GlTraceBlob
+{
+	const void *data; // NULL is recorded as an empty blob
+	size_t size;
+};
+
+struct GlTraceString
+{
+	const char *text;
+	size_t size;
+};
+
+inline void glTracePut(GlTraceWriter &t, const GlTraceBlob &blob) { t.bytes(blob.data, blob.size); }
+inline void glTracePut(GlTraceWriter &t, const GlTraceString &string) { t.string(string.text, string.size); }
+template <typename T> inline void glTracePut(GlTraceWriter &t, T value) { t.put<T>(value); }
+
+inline void glTraceArgs(GlTraceWriter &) {}
+
+template <typename T, typename... Rest> inline void glTraceArgs(GlTraceWriter &t, const T &value, const Rest &... rest)
+{
+	glTracePut(t, value);
+	glTraceArgs(t, rest...);
+}
+
+// One call and its arguments, each written with its own type : the replay
+// reads them back with the types of the GL signature. Sizes and offsets are
+// cast to 64 bits, pointers too.
+template <typename... Args> inline void glTraceRecord(GlTraceOp op, const Args &... args)
+{
+	GlTraceWriter &t = GlTraceWriter::get();
+	if (!t.active())
+		return;
+	t.op(op);
+	glTraceArgs(t, args...);
+}
+
+inline bool glTraceOpen(const char *path, int width, int height, uint32_t firstFrame, uint32_t frameCount)
+{
+	return GlTraceWriter::get().open(path, width, height, firstFrame, frameCount);
+}
+
+inline void glTraceFrame(uint64_t number) { GlTraceWriter::get().frame(number); }
+
+// Records a program linked by code outside the trace, as if built here from its sources
+inline void glTraceAdoptProgram(GLuint program, const char *vertexPath, const char *fragmentPath)
+{
+	if (!GlTraceWriter::get().active())
+		return;
+	const char *paths[2] = {vertexPath, fragmentPath};
+	const GLenum types[2] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+	// Names the driver can't have given : the shaders only live in the trace
+	const GLuint shaders[2] = {0x7fff0000u, 0x7fff0001u};
+	for (int i = 0; i < 2; i++)
+	{
+		std::string source;
+		if (FILE *file = fopen(paths[i], "rb"))
+		{
+			char buffer[4096];
+			size_t size;
+			while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+				source.append(buffer, size);
+			fclose(file);
+		}
+		else
+			fprintf(stderr, "GL trace : could not read %s, the replay will miss this program\n", paths[i]);
+		GlTraceString text = {source.data(), source.size()};
+		glTraceRecord(GLT_CreateShader, types[i], shaders[i]);
+		glTraceRecord(GLT_ShaderSource, shaders[i], (GLsizei)1, text);
+		glTraceRecord(GLT_CompileShader, shaders[i]);
+	}
+	glTraceRecord(GLT_CreateProgram, program);
+	for (int i = 0; i < 2; i++)
+		glTraceRecord(GLT_AttachShader, program, shaders[i]);
+	glTraceRecord(GLT_LinkProgram, program);
+	for (int i = 0; i < 2; i++)
+	{
+		glTraceRecord(GLT_DetachShader, program, shaders[i]);
+		glTraceRecord(GLT_DeleteShader, shaders[i]);
+	}
+}
+
+// Before anything that may read a buffer the GPU way : draws, dispatches, copies, fences
+inline void glTraceFlushMapped()
+{
+	GlTraceWriter &t = GlTraceWriter::get();
+	if (t.active())
+		t.flushPersistent();
+}
+
+// The wrappers : recorded, then forwarded to the real call (the gl names
+// below still are the real ones, the reroute is at the end of the file)
+
+inline void glTraceActiveTexture(GLenum texture)
+{
+	glTraceRecord(GLT_ActiveTexture, texture);
+	glActiveTexture(texture);
+}
+
+inline void glTraceAttachShader(GLuint program, GLuint shader)
+{
+	glTraceRecord(GLT_AttachShader, program, shader);
+	glAttachShader(program, shader);
+}
+
+inline void glTraceBeginQuery(GLenum target, GLuint id)
+{
+	glTraceRecord(GLT_BeginQuery, target, id);
+	glBeginQuery(target, id);
+}
+
+inline void glTraceBindBuffer(GLenum target, GLuint buffer)
+{
+	glTraceRecord(GLT_BindBuffer, target, buffer);
+	GlTraceWriter::get().bind(target, buffer);
+	glBindBuffer(target, buffer);
+}
+
+// Also binds the generic binding point of the target
+inline void glTraceBindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	glTraceRecord(GLT_BindBufferBase, target, index, buffer);
+	GlTraceWriter::get().bind(target, buffer);
+	glBindBufferBase(target, index, buffer);
+}
+
+inline void glTraceBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	glTraceRecord(GLT_BindBufferRange, target, index, buffer, (uint64_t)offset, (uint64_t)size);
+	GlTraceWriter::get().bind(target, buffer);
+	glBindBufferRange(target, index, buffer, offset, size);
+}
+
+inline void glTraceBindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	glTraceRecord(GLT_BindFramebuffer, target, framebuffer);
+	glBindFramebuffer(target, framebuffer);
+}
+
+inline void glTraceBindImageTexture(GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format)
+{
+	glTraceRecord(GLT_BindImageTexture, unit, texture, level, layered, layer, access, format);
+	glBindImageTexture(unit, texture, level, layered, layer, access, format);
+}
+
+inline void glTraceBindRenderbuffer(GLenum target, GLuint renderbuffer)
+{
+	glTraceRecord(GLT_BindRenderbuffer, target, renderbuffer);
+	glBindRenderbuffer(target, renderbuffer);
+}
+
+inline void glTraceBindTexture(GLenum target, GLuint texture)
+{
+	glTraceRecord(GLT_BindTexture, target, texture);
+	glBindTexture(target, texture);
+}
+
+inline void glTraceBindVertexArray(GLuint array)
+{
+	glTraceRecord(GLT_BindVertexArray, array);
+	glBindVertexArray(array);
+}
+
+inline void glTraceBlendFunc(GLenum sfactor, GLenum dfactor)
+{
+	glTraceRecord(GLT_BlendFunc, sfactor, dfactor);
+	glBlendFunc(sfactor, dfactor);
+}
+
+inline void glTraceBlitFramebuffer(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter)
+{
+	glTraceFlushMapped();
+	glTraceRecord(GLT_BlitFramebuffer, srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
+	glBlitFramebuffer(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
+}
+
+inline void glTraceBufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage)
+{
+	GlTraceBlob blob = {data, (size_t)size};
+	glTraceRecord(GLT_BufferData, target, (uint64_t)size, blob, usage);
+	glBufferData(target, size, data, usage);
+}
+
+inline void glTraceBufferStorage(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags)
+{
+	GlTraceBlob blob = {data, (size_t)size};
+	glTraceRecord(GLT_BufferStorage, target, (uint64_t)size, blob, flags);
+	glBufferStorage(target, size, data, flags);
+}
+
+inline GLenum glTraceCheckFramebufferStatus(GLenum target)
+{
+	glTraceRecord(GLT_CheckFramebufferStatus, target);
+	return glCheckFramebufferStatus(target);
+}
+
+inline void glTraceClear(GLbitfield mask)
+{
+	glTraceRecord(GLT_Clear, mask);
+	glClear(mask);
+}
+
+inline void glTraceClearBufferData(GLenum target, GLenum internalformat, GLenum format, GLenum type, const void *data)
+{
+	GlTraceBlob blob = {data, glTraceClearSize(format, type)};
+	glTraceRecord(GLT_ClearBufferData, target, internalformat, format, type, blob);
+	glClearBufferData(target, internalformat, format, type, data);
+}
+
+inline void glTraceClearBufferSubData(GLenum target, GLenum internalformat, GLintptr offset, GLsizeiptr size, GLenum format, GLenum type,
+									  const void *data)
+{
+	GlTraceBlob blob = {data, glTraceClearSize(format, type)};
+	glTraceRecord(GLT_ClearBufferSubData, target, internalformat, (uint64_t)offset, (uint64_t)size, format, type, blob);
+	glClearBufferSubData(target, internalformat, offset, size, format, type, data);
+}
+
+// GL_COLOR clears take 4 values, GL_DEPTH one
+inline void glTraceClearBufferfv(GLenum buffer, GLint drawbuffer, const GLfloat *value)
+{
+	GlTraceBlob blob = {value, (buffer == GL_COLOR ? 4 : 1) * sizeof(GLfloat)};
+	glTraceRecord(GLT_ClearBufferfv, buffer, drawbuffer, blob);
+	glClearBufferfv(buffer, drawbuffer, value);
+}
+
+inline void glTraceClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+{
+	glTraceRecord(GLT_ClearColor, red, green, blue, alpha);
+	glClearColor(red, green, blue, alpha);
+}
+
+// Syncs are recorded as numbers, in the order they were created
+inline GLenum glTraceClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout)
+{
+	glTraceRecord(GLT_ClientWaitSync, GlTraceWriter::get().syncId(sync, false), flags, timeout);
+	return glClientWaitSync(sync, flags, timeout);
+}
+
+inline void glTraceColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+{
+	glTraceRecord(GLT_ColorMask, red, green, blue, alpha);
+	glColorMask(red, green, blue, alpha);
+}
+
+inline void glTraceCompileShader(GLuint shader)
+{
+	glTraceRecord(GLT_CompileShader, shader);
+	glCompileShader(shader);
+}
+
+inline void glTraceCopyBufferSubData(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size)
+{
+	glTraceFlushMapped();
+	glTraceRecord(GLT_CopyBufferSubData, readTarget, writeTarget, (uint64_t)readOffset, (uint64_t)writeOffset, (uint64_t)size);
+	glCopyBufferSubData(readTarget, writeTarget, readOffset, writeOffset, size);
+}
+
+inline GLuint glTraceCreateProgram()
+{
+	GLuint program = glCreateProgram();
+	glTraceRecord(GLT_CreateProgram, program);
+	return program;
+}
+
+inline GLuint glTraceCreateShader(GLenum type)
+{
+	GLuint shader = glCreateShader(type);
+	glTraceRecord(GLT_CreateShader, type, shader);
+	return shader;
+}
+
+inline void glTraceDeleteBuffers(GLsizei n, const GLuint *buffers)
+{
+	GlTraceBlob names = {buffers, n * sizeof(GLuint)};
+	glTraceRecord(GLT_DeleteBuffers, names);
+	for (GLsizei i = 0; i < n; i++)
+		GlTraceWriter::get().forgetBuffer(buffers[i]);
+	glDeleteBuffers(n, buffers);
+}
+
+inline void glTraceDeleteFramebuffers(GLsizei n, const GLuint *framebuffers)
+{
+	GlTraceBlob names = {framebuffers, n * sizeof(GLuint)};
+	glTraceRecord(GLT_DeleteFramebuffers, names);
+	glDeleteFramebuffers(n, framebuffers);
+}
+
+inline void glTraceDeleteProgram(GLuint program)
+{
+	glTraceRecord(GLT_DeleteProgram, program);
+	glDeleteProgram(program);
+}
+
+inline void glTraceDeleteQueries(GLsizei n, const GLuint *ids)
+{
+	GlTraceBlob names = {ids, n * sizeof(GLuint)};
+	glTraceRecord(GLT_DeleteQueries, names);
+	glDeleteQueries(n, ids);
+}
+
+inline void glTraceDeleteRenderbuffers(GLsizei n, const GLuint *renderbuffers)
+{
+	GlTraceBlob names = {renderbuffers, n * sizeof(GLuint)};
+	glTraceRecord(GLT_DeleteRenderbuffers, names);
+	glDeleteRenderbuffers(n, renderbuffers);
+}
+
+inline void glTraceDeleteShader(GLuint shader)
+{
+	glTraceRecord(GLT_DeleteShader, shader);
+	glDeleteShader(shader);
+}
+
+inline void glTraceDeleteSync(GLsync sync)
+{
+	glTraceRecord(GLT_DeleteSync, GlTraceWriter::get().syncId(sync, true));
+	glDeleteSync(sync);
+}
+
+inline void glTraceDeleteTextures(GLsizei n, const GLuint *textures)
+{
+	GlTraceBlob names = {textures, n * sizeof(GLuint)};
+	glTraceRecord(GLT_DeleteTextures, names);
+	glDeleteTextures(n, textures);
+}
+
+inline void glTraceDeleteVertexArrays(GLsizei n, const GLuint *arrays)
+{
+	GlTraceBlob names = {arrays, n * sizeof(GLuint)};
+	glTraceRecord(GLT_DeleteVertexArrays, names);
+	glDeleteVertexArrays(n, arrays);
+}
+
+inline void glTraceDepthFunc(GLenum func)
+{
+	glTraceRecord(GLT_DepthFunc, func);
+	glDepthFunc(func);
+}
+
+inline void glTraceDepthMask(GLboolean flag)
+{
+	glTraceRecord(GLT_DepthMask, flag);
+	glDepthMask(flag);
+}
+
+inline void glTraceDetachShader(GLuint program, GLuint shader)
+{
+	glTraceRecord(GLT_DetachShader, program, shader);
+	glDetachShader(program, shader);
+}
+
+inline void glTraceDisable(GLenum cap)
+{
+	glTraceRecord(GLT_Disable, cap);
+	glDisable(cap);
+}
+
+inline void glTraceDisableVertexAttribArray(GLuint index)
+{
+	glTraceRecord(GLT_DisableVertexAttribArray, index);
+	glDisableVertexAttribArray(index);
+}
+
+inline void glTraceDispatchCompute(GLuint x, GLuint y, GLuint z)
+{
+	glTraceFlushMapped();
+	glTraceRecord(GLT_DispatchCompute, x, y, z);
+	glDispatchCompute(x, y, z);
+}
+
+inline void glTraceDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+	glTraceFlushMapped();
+	glTraceRecord(GLT_DrawArrays, mode, first, count);
+	glDrawArrays(mode, first, count);
+}
+
+inline void glTraceDrawBuffers(GLsizei n, const GLenum *bufs)
+{
+	GlTraceBlob blob = {bufs, n * sizeof(GLenum)};
+	glTraceRecord(GLT_DrawBuffers, blob);
+	glDrawBuffers(n, bufs);
+}
+
+inline void glTraceEnable(GLenum cap)
+{
+	glTraceRecord(GLT_Enable, cap);
+	glEnable(cap);
+}
+
+inline void glTraceEnableVertexAttribArray(GLuint index)
+{
+	glTraceRecord(GLT_EnableVertexAttribArray, index);
+	glEnableVertexAttribArray(index);
+}
+
+inline void glTraceEndQuery(GLenum target)
+{
+	glTraceRecord(GLT_EndQuery, target);
+	glEndQuery(target);
+}
+
+inline GLsync glTraceFenceSync(GLenum condition, GLbitfield flags)
+{
+	glTraceFlushMapped();
+	GLsync sync = glFenceSync(condition, flags);
+	if (GlTraceWriter::get().active())
+		glTraceRecord(GLT_FenceSync, condition, flags, GlTraceWriter::get().newSync(sync));
+	return sync;
+}
+
+inline void glTraceFinish()
+{
+	glTraceRecord(GLT_Finish);
+	glFinish();
+}
+
+inline void glTraceFramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer)
+{
+	glTraceRecord(GLT_FramebufferRenderbuffer, target, attachment, renderbuffertarget, renderbuffer);
+	glFramebufferRenderbuffer(target, attachment, renderbuffertarget, renderbuffer);
+}
+
+inline void glTraceFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level)
+{
+	glTraceRecord(GLT_FramebufferTexture2D, target, attachment, textarget, texture, level);
+	glFramebufferTexture2D(target, attachment, textarget, texture, level);
+}
+
+inline void glTraceGenBuffers(GLsizei n, GLuint *buffers)
+{
+	glGenBuffers(n, buffers);
+	GlTraceBlob names = {buffers, n * sizeof(GLuint)};
+	glTraceRecord(GLT_GenBuffers, names);
+}
+
+inline void glTraceGenFramebuffers(GLsizei n, GLuint *framebuffers)
+{
+	glGenFramebuffers(n, framebuffers);
+	GlTraceBlob names = {framebuffers, n * sizeof(GLuint)};
+	glTraceRecord(GLT_GenFramebuffers, names);
+}
+
+inline void glTraceGenQueries(GLsizei n, GLuint *ids)
+{
+	glGenQueries(n, ids);
+	GlTraceBlob names = {ids, n * sizeof(GLuint)};
+	glTraceRecord(GLT_GenQueries, names);
+}
+
+inline void glTraceGenRenderbuffers(GLsizei n, GLuint *renderbuffers)
+{
+	glGenRenderbuffers(n, renderbuffers);
+	GlTraceBlob names = {renderbuffers, n * sizeof(GLuint)};
+	glTraceRecord(GLT_GenRenderbuffers, names);
+}
+
+inline void glTraceGenTextures(GLsizei n, GLuint *textures)
+{
+	glGenTextures(n, textures);
+	GlTraceBlob names = {textures, n * sizeof(GLuint)};
+	glTraceRecord(GLT_GenTextures, names);
+}
+
+inline void glTraceGenVertexArrays(GLsizei n, GLuint *arrays)
+{
+	glGenVertexArrays(n, arrays);
+	GlTraceBlob names = {arrays, n * sizeof(GLuint)};
+	glTraceRecord(GLT_GenVertexArrays, names);
+}
+
+// Queries are replayed into scratch memory : they cost driver time, some stall
+inline void glTraceGetBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, void *data)
+{
+	glTraceFlushMapped();
+	glTraceRecord(GLT_GetBufferSubData, target, (uint64_t)offset, (uint64_t)size);
+	glGetBufferSubData(target, offset, size, data);
+}
+
+inline void glTraceGetIntegerv(GLenum pname, GLint *data)
+{
+	glTraceRecord(GLT_GetIntegerv, pname);
+	glGetIntegerv(pname, data);
+}
+
+inline void glTraceGetProgramInfoLog(GLuint program, GLsizei bufSize, GLsizei *length, GLchar *infoLog)
+{
+	glTraceRecord(GLT_GetProgramInfoLog, program, bufSize);
+	glGetProgramInfoLog(program, bufSize, length, infoLog);
+}
+
+inline void glTraceGetProgramiv(GLuint program, GLenum pname, GLint *params)
+{
+	glTraceRecord(GLT_GetProgramiv, program, pname);
+	glGetProgramiv(program, pname, params);
+}
+
+inline void glTraceGetQueryObjectiv(GLuint id, GLenum pname, GLint *params)
+{
+	glTraceRecord(GLT_GetQueryObjectiv, id, pname);
+	glGetQueryObjectiv(id, pname, params);
+}
+
+inline void glTraceGetQueryObjectui64v(GLuint id, GLenum pname, GLuint64 *params)
+{
+	glTraceRecord(GLT_GetQueryObjectui64v, id, pname);
+	glGetQueryObjectui64v(id, pname, params);
+}
+
+inline void glTraceGetShaderInfoLog(GLuint shader, GLsizei bufSize, GLsizei *length, GLchar *infoLog)
+{
+	glTraceRecord(GLT_GetShaderInfoLog, shader, bufSize);
+	glGetShaderInfoLog(shader, bufSize, length, infoLog);
+}
+
+inline void glTraceGetShaderiv(GLuint shader, GLenum pname, GLint *params)
+{
+	glTraceRecord(GLT_GetShaderiv, shader, pname);
+	glGetShaderiv(shader, pname, params);
+}
+
+inline GLint glTraceGetUniformLocation(GLuint program, const GLchar *name)
+{
+	GLint location = glGetUniformLocation(program, name);
+	GlTraceString text = {name, strlen(name)};
+	glTraceRecord(GLT_GetUniformLocation, program, text, location);
+	return location;
+}
+
+inline void glTraceLinkProgram(GLuint program)
+{
+	glTraceRecord(GLT_LinkProgram, program);
+	glLinkProgram(program);
+}
+
+// Records the buffer mapped, the replay maps its own and copies the recorded writes in
+inline void *glTraceMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+	void *pointer = glMapBufferRange(target, offset, length, access);
+	GlTraceWriter &t = GlTraceWriter::get();
+	glTraceRecord(GLT_MapBufferRange, target, t.bound(target), (uint64_t)offset, (uint64_t)length, access);
+	if (t.active())
+		t.mapped(t.bound(target), offset, length, access, pointer);
+	return pointer;
+}
+
+inline void glTraceMemoryBarrier(GLbitfield barriers)
+{
+	glTraceRecord(GLT_MemoryBarrier, barriers);
+	glMemoryBarrier(barriers);
+}
+
+inline void glTraceMultiDrawElementsIndirect(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride)
+{
+	glTraceFlushMapped();
+	glTraceRecord(GLT_MultiDrawElementsIndirect, mode, type, (uint64_t)(uintptr_t)indirect, drawcount, stride);
+	glMultiDrawElementsIndirect(mode, type, indirect, drawcount, stride);
+}
+
+inline void glTraceMultiDrawElementsIndirectCountARB(GLenum mode, GLenum type, const void *indirect, GLintptr drawcount, GLsizei maxdrawcount,
+													 GLsizei stride)
+{
+	glTraceFlushMapped();
+	glTraceRecord(GLT_MultiDrawElementsIndirectCountARB, mode, type, (uint64_t)(uintptr_t)indirect, (uint64_t)drawcount, maxdrawcount, stride);
+	glMultiDrawElementsIndirectCountARB(mode, type, indirect, drawcount, maxdrawcount, stride);
+}
+
+inline void glTracePixelStorei(GLenum pname, GLint param)
+{
+	glTraceRecord(GLT_PixelStorei, pname, param);
+	glPixelStorei(pname, param);
+}
+
+inline void glTraceQueryCounter(GLuint id, GLenum target)
+{
+	glTraceRecord(GLT_QueryCounter, id, target);
+	glQueryCounter(id, target);
+}
+
+inline void glTraceReadBuffer(GLenum src)
+{
+	glTraceRecord(GLT_ReadBuffer, src);
+	glReadBuffer(src);
+}
+
+// Into a pack buffer the pointer is an offset, otherwise the replay reads into scratch memory
+inline void glTraceReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void *pixels)
+{
+	GLuint packBuffer = GlTraceWriter::get().bound(GL_PIXEL_PACK_BUFFER);
+	glTraceRecord(GLT_ReadPixels, x, y, width, height, format, type, packBuffer, (uint64_t)(uintptr_t)pixels);
+	glReadPixels(x, y, width, height, format, type, pixels);
+}
+
+inline void glTraceRenderbufferStorageMultisample(GLenum target, GLsizei samples, GLenum internalformat, GLsizei width, GLsizei height)
+{
+	glTraceRecord(GLT_RenderbufferStorageMultisample, target, samples, internalformat, width, height);
+	glRenderbufferStorageMultisample(target, samples, internalformat, width, height);
+}
+
+inline void glTraceScissor(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	glTraceRecord(GLT_Scissor, x, y, width, height);
+	glScissor(x, y, width, height);
+}
+
+inline void glTraceShaderSource(GLuint shader, GLsizei count, const GLchar *const *string, const GLint *length)
+{
+	glTraceRecord(GLT_ShaderSource, shader, count);
+	for (GLsizei i = 0; i < count && GlTraceWriter::get().active(); i++)
+		GlTraceWriter::get().string(string[i], length && length[i] >= 0 ? length[i] : strlen(string[i]));
+	glShaderSource(shader, count, string, length);
+}
+
+// Tightly packed pixels : the tree uploads no textures with an unpack alignment or row length
+inline void glTraceTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format,
+							  GLenum type, const void *pixels)
+{
+	GlTraceBlob data = {pixels, glTraceClearSize(format, type) * width * height};
+	glTraceRecord(GLT_TexImage2D, target, level, internalformat, width, height, border, format, type, data);
+	glTexImage2D(target, level, internalformat, width, height, border, format, type, pixels);
+}
+
+inline void glTraceTexImage3D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border,
+							  GLenum format, GLenum type, const void *pixels)
+{
+	GlTraceBlob data = {pixels, glTraceClearSize(format, type) * width * height * depth};
+	glTraceRecord(GLT_TexImage3D, target, level, internalformat, width, height, depth, border, format, type, data);
+	glTexImage3D(target, level, internalformat, width, height, depth, border, format, type, pixels);
+}
+
+inline void glTraceTexParameteri(GLenum target, GLenum pname, GLint param)
+{
+	glTraceRecord(GLT_TexParameteri, target, pname, param);
+	glTexParameteri(target, pname, param);
+}
+
+// Locations are recorded as the driver gave them, the replay maps them by program and name
+inline void glTraceTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format,
+								 GLenum type, const void *pixels)
+{
+	GlTraceBlob data = {pixels, glTraceClearSize(format, type) * width * height};
+	glTraceRecord(GLT_TexSubImage2D, target, level, xoffset, yoffset, width, height, format, type, data);
+	glTexSubImage2D(target, level, xoffset, yoffset, width, height, format, type, pixels);
+}
+
+inline void glTraceUniform1f(GLint location, GLfloat v0)
+{
+	glTraceRecord(GLT_Uniform1f, location, v0);
+	glUniform1f(location, v0);
+}
+
+inline void glTraceUniform1i(GLint location, GLint v0)
+{
+	glTraceRecord(GLT_Uniform1i, location, v0);
+	glUniform1i(location, v0);
+}
+
+inline void glTraceUniform1ui(GLint location, GLuint v0)
+{
+	glTraceRecord(GLT_Uniform1ui, location, v0);
+	glUniform1ui(location, v0);
+}
+
+inline void glTraceUniform2f(GLint location, GLfloat v0, GLfloat v1)
+{
+	glTraceRecord(GLT_Uniform2f, location, v0, v1);
+	glUniform2f(location, v0, v1);
+}
+
+inline void glTraceUniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2)
+{
+	glTraceRecord(GLT_Uniform3f, location, v0, v1, v2);
+	glUniform3f(location, v0, v1, v2);
+}
+
+inline void glTraceUniform4fv(GLint location, GLsizei count, const GLfloat *value)
+{
+	GlTraceBlob values = {value, count * 4 * sizeof(GLfloat)};
+	glTraceRecord(GLT_Uniform4fv, location, count, values);
+	glUniform4fv(location, count, value);
+}
+
+inline void glTraceUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
+{
+	GlTraceBlob values = {value, count * 16 * sizeof(GLfloat)};
+	glTraceRecord(GLT_UniformMatrix4fv, location, count, transpose, values);
+	glUniformMatrix4fv(location, count, transpose, value);
+}
+
+// The writes through the mapping come first, the replay copies them into its own
+inline GLboolean glTraceUnmapBuffer(GLenum target)
+{
+	GlTraceWriter &t = GlTraceWriter::get();
+	if (t.active())
+		t.unmapped(t.bound(target));
+	glTraceRecord(GLT_UnmapBuffer, target, t.bound(target));
+	return glUnmapBuffer(target);
+}
+
+inline void glTraceUseProgram(GLuint program)
+{
+	glTraceRecord(GLT_UseProgram, program);
+	glUseProgram(program);
+}
+
+inline void glTraceVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer)
+{
+	glTraceRecord(GLT_VertexAttribPointer, index, size, type, normalized, stride, (uint64_t)(uintptr_t)pointer);
+	glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+}
+
+inline void glTraceViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	glTraceRecord(GLT_Viewport, x, y, width, height);
+	glViewport(x, y, width, height);
+}
+
+// The reroute. GLEW defines most of these names as macros, the rest are plain functions.
+#undef glActiveTexture
+#define glActiveTexture glTraceActiveTexture
+#undef glAttachShader
+#define glAttachShader glTraceAttachShader
+#undef glBeginQuery
+#define glBeginQuery glTraceBeginQuery
+#undef glBindBuffer
+#define glBindBuffer glTraceBindBuffer
+#undef glBindBufferBase
+#define glBindBufferBase glTraceBindBufferBase
+#undef glBindBufferRange
+#define glBindBufferRange glTraceBindBufferRange
+#undef glBindFramebuffer
+#define glBindFramebuffer glTraceBindFramebuffer
+#undef glBindImageTexture
+#define glBindImageTexture glTraceBindImageTexture
+#undef glBindRenderbuffer
+#define glBindRenderbuffer glTraceBindRenderbuffer
+#undef glBindTexture
+#define glBindTexture glTraceBindTexture
+#undef glBindVertexArray
+#define glBindVertexArray glTraceBindVertexArray
+#undef glBlendFunc
+#define glBlendFunc glTraceBlendFunc
+#undef glBlitFramebuffer
+#define glBlitFramebuffer glTraceBlitFramebuffer
+#undef glBufferData
+#define glBufferData glTraceBufferData
+#undef glBufferStorage
+#define glBufferStorage glTraceBufferStorage
+#undef glCheckFramebufferStatus
+#define glCheckFramebufferStatus glTraceCheckFramebufferStatus
+#undef glClear
+#define glClear glTraceClear
+#undef glClearBufferData
+#define glClearBufferData glTraceClearBufferData
+#undef glClearBufferSubData
+#define glClearBufferSubData glTraceClearBufferSubData
+#undef glClearBufferfv
+#define glClearBufferfv glTraceClearBufferfv
+#undef glClearColor
+#define glClearColor glTraceClearColor
+#undef glClientWaitSync
+#define glClientWaitSync glTraceClientWaitSync
+#undef glColorMask
+#define glColorMask glTraceColorMask
+#undef glCompileShader
+#define glCompileShader glTraceCompileShader
+#undef glCopyBufferSubData
+#define glCopyBufferSubData glTraceCopyBufferSubData
+#undef glCreateProgram
+#define glCreateProgram glTraceCreateProgram
+#undef glCreateShader
+#define glCreateShader glTraceCreateShader
+#undef glDeleteBuffers
+#define glDeleteBuffers glTraceDeleteBuffers
+#undef glDeleteFramebuffers
+#define glDeleteFramebuffers glTraceDeleteFramebuffers
+#undef glDeleteProgram
+#define glDeleteProgram glTraceDeleteProgram
+#undef glDeleteQueries
+#define glDeleteQueries glTraceDeleteQueries
+#undef glDeleteRenderbuffers
+#define glDeleteRenderbuffers glTraceDeleteRenderbuffers
+#undef glDeleteShader
+#define glDeleteShader glTraceDeleteShader
+#undef glDeleteSync
+#define glDeleteSync glTraceDeleteSync
+#undef glDeleteTextures
+#define glDeleteTextures glTraceDeleteTextures
+#undef glDeleteVertexArrays
+#define glDeleteVertexArrays glTraceDeleteVertexArrays
+#undef glDepthFunc
+#define glDepthFunc glTraceDepthFunc
+#undef glDepthMask
+#define glDepthMask glTraceDepthMask
+#undef glDetachShader
+#define glDetachShader glTraceDetachShader
+#undef glDisable
+#define glDisable glTraceDisable
+#undef glDisableVertexAttribArray
+#define glDisableVertexAttribArray glTraceDisableVertexAttribArray
+#undef glDispatchCompute
+#define glDispatchCompute glTraceDispatchCompute
+#undef glDrawArrays
+#define glDrawArrays glTraceDrawArrays
+#undef glDrawBuffers
+#define glDrawBuffers glTraceDrawBuffers
+#undef glEnable
+#define glEnable glTraceEnable
+#undef glEnableVertexAttribArray
+#define glEnableVertexAttribArray glTraceEnableVertexAttribArray
+#undef glEndQuery
+#define glEndQuery glTraceEndQuery
+#undef glFenceSync
+#define glFenceSync glTraceFenceSync
+#undef glFinish
+#define glFinish glTraceFinish
+#undef glFramebufferRenderbuffer
+#define glFramebufferRenderbuffer glTraceFramebufferRenderbuffer
+#undef glFramebufferTexture2D
+#define glFramebufferTexture2D glTraceFramebufferTexture2D
+#undef glGenBuffers
+#define glGenBuffers glTraceGenBuffers
+#undef glGenFramebuffers
+#define glGenFramebuffers glTraceGenFramebuffers
+#undef glGenQueries
+#define glGenQueries glTraceGenQueries
+#undef glGenRenderbuffers
+#define glGenRenderbuffers glTraceGenRenderbuffers
+#undef glGenTextures
+#define glGenTextures glTraceGenTextures
+#undef glGenVertexArrays
+#define glGenVertexArrays glTraceGenVertexArrays
+#undef glGetBufferSubData
+#define glGetBufferSubData glTraceGetBufferSubData
+#undef glGetIntegerv
+#define glGetIntegerv glTraceGetIntegerv
+#undef glGetProgramInfoLog
+#define glGetProgramInfoLog glTraceGetProgramInfoLog
+#undef glGetProgramiv
+#define glGetProgramiv glTraceGetProgramiv
+#undef glGetQueryObjectiv
+#define glGetQueryObjectiv glTraceGetQueryObjectiv
+#undef glGetQueryObjectui64v
+#define glGetQueryObjectui64v glTraceGetQueryObjectui64v
+#undef glGetShaderInfoLog
+#define glGetShaderInfoLog glTraceGetShaderInfoLog
+#undef glGetShaderiv
+#define glGetShaderiv glTraceGetShaderiv
+#undef glGetUniformLocation
+#define glGetUniformLocation glTraceGetUniformLocation
+#undef glLinkProgram
+#define glLinkProgram glTraceLinkProgram
+#undef glMapBufferRange
+#define glMapBufferRange glTraceMapBufferRange
+#undef glMemoryBarrier
+#define glMemoryBarrier glTraceMemoryBarrier
+#undef glMultiDrawElementsIndirect
+#define glMultiDrawElementsIndirect glTraceMultiDrawElementsIndirect
+#undef glMultiDrawElementsIndirectCountARB
+#define glMultiDrawElementsIndirectCountARB glTraceMultiDrawElementsIndirectCountARB
+#undef glPixelStorei
+#define glPixelStorei glTracePixelStorei
+#undef glQueryCounter
+#define glQueryCounter glTraceQueryCounter
+#undef glReadBuffer
+#define glReadBuffer glTraceReadBuffer
+#undef glReadPixels
+#define glReadPixels glTraceReadPixels
+#undef glRenderbufferStorageMultisample
+#define glRenderbufferStorageMultisample glTraceRenderbufferStorageMultisample
+#undef glScissor
+#define glScissor glTraceScissor
+#undef glShaderSource
+#define glShaderSource glTraceShaderSource
+#undef glTexImage2D
+#define glTexImage2D glTraceTexImage2D
+#undef glTexImage3D
+#define glTexImage3D glTraceTexImage3D
+#undef glTexParameteri
+#define glTexParameteri glTraceTexParameteri
+#undef glTexSubImage2D
+#define glTexSubImage2D glTraceTexSubImage2D
+#undef glUniform1f
+#define glUniform1f glTraceUniform1f
+#undef glUniform1i
+#define glUniform1i glTraceUniform1i
+#undef glUniform1ui
+#define glUniform1ui glTraceUniform1ui
+#undef glUniform2f
+#define glUniform2f glTraceUniform2f
+#undef glUniform3f
+#define glUniform3f glTraceUniform3f
+#undef glUniform4fv
+#define glUniform4fv glTraceUniform4fv
+#undef glUniformMatrix4fv
+#define glUniformMatrix4fv glTraceUniformMatrix4fv
+#undef glUnmapBuffer
+#define glUnmapBuffer glTraceUnmapBuffer
+#undef glUseProgram
+#define glUseProgram glTraceUseProgram
+#undef glVertexAttribPointer
+#define glVertexAttribPointer glTraceVertexAttribPointer
+
+#undef glViewport
+#define glViewport glTraceViewport
+#else
+
+inline bool glTraceOpen(const char *, int, int, uint32_t, uint32_t)
+{
+	fprintf(stderr, "GL tracing needs a build with -DGLTRACE\n");
+	return false;
+}
+
+inline void glTraceFrame(uint64_t) {}
+inline void glTraceAdoptProgram(GLuint, const char *, const char *) {}
+
+#endif
+
+#endif
@@ -0,0 +1,344 @@
+#ifndef GPUCULL_HPP
+#define GPUCULL_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "entities.hpp"
+#include "drawlist.hpp"
+#include "indirect.hpp"
+#include "resources.hpp"
+#include "shaders.hpp"
+
+// GPU driven culling.
+// The renderable entities are copied once to a static instance buffer. Every
+// frame a compute shader animates each instance, tests its bounding sphere
+// against the frustum and appends the survivors (matrices and a
+// DrawElementsIndirectCommand) through an atomic counter. The counter then
+// serves as the draw count of glMultiDrawElementsIndirectCountARB, so the CPU
+// cost of a frame no longer depends on the number of objects.
+//
+// Without ARB_indirect_parameters the command buffer is cleared every frame
+// and drawn in full : the entries past the counter are empty draws.
+
+// std430 layout of an instance
+struct GpuInstance
+{
+	glm::vec4 positionScale;
+	glm::vec4 axisAngle;   // spin axis and angle at the time of the upload
+	glm::vec4 boundsCenterRadius; // model space
+	float speed;           // radians per second
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	int32_t baseVertex;
+	uint32_t material; // entry of the MaterialTable
+	uint32_t padding[3];
+};
+
+// Same model matrix as transformChunk : translate * rotate * scale
+static const char *const g_cull_compute_shader = R"(#version 430 core
+layout(local_size_x = 64) in;
+struct Instance
+{
+	vec4 positionScale;
+	vec4 axisAngle;
+	vec4 boundsCenterRadius;
+	float speed;
+	uint firstIndex;
+	uint indexCount;
+	int baseVertex;
+	uint material;
+};
+struct DrawData
+{
+	mat4 mvp;
+	mat4 model;
+	uint material;
+};
+struct DrawCommand
+{
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+layout(std430, binding = 0) readonly buffer Instances { Instance instances[]; };
+layout(std430, binding = 1) writeonly buffer Draws { DrawData draws[]; };
+layout(std430, binding = 2) writeonly buffer Commands { DrawCommand commands[]; };
+layout(std430, binding = 3) buffer Counter { uint drawCount; };
+uniform mat4 viewProjection;
+uniform vec4 planes[6];
+uniform float time;
+uniform uint instanceCount;
+void main()
+{
+	uint i = gl_GlobalInvocationID.x;
+	if (i >= instanceCount)
+		return;
+	Instance instance = instances[i];
+
+	// glm::rotate
+	float angle = instance.axisAngle.w + instance.speed * time;
+	vec3 a = normalize(instance.axisAngle.xyz);
+	float c = cos(angle);
+	float s = sin(angle);
+	vec3 t = (1.0 - c) * a;
+	mat3 rotation = mat3(vec3(c + t.x * a.x, t.x * a.y + s * a.z, t.x * a.z - s * a.y),
+						 vec3(t.y * a.x - s * a.z, c + t.y * a.y, t.y * a.z + s * a.x),
+						 vec3(t.z * a.x + s * a.y, t.z * a.y - s * a.x, c + t.z * a.z));
+	float scale = instance.positionScale.w;
+	mat4 model = mat4(vec4(rotation[0] * scale, 0.0), vec4(rotation[1] * scale, 0.0), vec4(rotation[2] * scale, 0.0),
+					  vec4(instance.positionScale.xyz, 1.0));
+
+	vec3 center = (model * vec4(instance.boundsCenterRadius.xyz, 1.0)).xyz;
+	float radius = instance.boundsCenterRadius.w * scale;
+	for (int p = 0; p < 6; p++)
+		if (dot(planes[p].xyz, center) + planes[p].w < -radius)
+			return;
+
+	uint slot = atomicAdd(drawCount, 1u);
+	draws[slot].mvp = viewProjection * model;
+	draws[slot].model = model;
+	draws[slot].material = instance.material;
+	commands[slot].count = instance.indexCount;
+	commands[slot].instanceCount = 1u;
+	commands[slot].firstIndex = instance.firstIndex;
+	commands[slot].baseVertex = instance.baseVertex;
+	commands[slot].baseInstance = slot; // picks the draw data in the vertex shader
+}
+)";
+
+class GpuCuller
+{
+public:
+	GpuCuller()
+		: cullProgram(0), drawProgram(0), countDraws(false), instanceBuffer(0), drawBuffer(0), commandBuffer(0), counterBuffer(0),
+		  instanceCount(0), switches(0), readIndex(0), lastVisible(0)
+	{
+		for (int i = 0; i < STREAM_FRAMES; i++)
+		{
+			readbackBuffers[i] = 0;
+			readbackFences[i] = 0;
+		}
+	}
+
+	static bool supported()
+	{
+		return (GLEW_VERSION_4_3 || (GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object && GLEW_ARB_multi_draw_indirect)) &&
+			   GLEW_ARB_shader_draw_parameters;
+	}
+
+	// fragmentShader : takes the outputs of g_indirect_vertex_shader
+	bool create(const char *fragmentShader = g_standard_fragment_shader)
+	{
+		cullProgram = buildComputeProgram(g_cull_compute_shader, "cull");
+		drawProgram = buildProgram(g_indirect_vertex_shader, fragmentShader, "indirect");
+		if (!cullProgram || !drawProgram)
+		{
+			destroy();
+			return false;
+		}
+		viewProjectionId = glGetUniformLocation(cullProgram, "viewProjection");
+		planesId = glGetUniformLocation(cullProgram, "planes");
+		timeId = glGetUniformLocation(cullProgram, "time");
+		instanceCountId = glGetUniformLocation(cullProgram, "instanceCount");
+		viewId = glGetUniformLocation(drawProgram, "V");
+		lightId = glGetUniformLocation(drawProgram, "LightPosition_worldspace");
+		countDraws = GLEW_ARB_indirect_parameters;
+
+		glGenBuffers(1, &counterBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+		glGenBuffers(STREAM_FRAMES, readbackBuffers);
+		for (int i = 0; i < STREAM_FRAMES; i++)
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffers[i]);
+			glBufferData(GL_COPY_WRITE_BUFFER, sizeof(GLuint), NULL, GL_STREAM_READ);
+		}
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		return true;
+	}
+
+	// Snapshot of the renderable, bounded entities of `chunks`. Entities without
+	// Animation keep their orientation. Meshes outside the MeshBank are skipped.
+	void upload(const std::vector<Chunk *> &chunks, const GpuResources &resources)
+	{
+		std::vector<GpuInstance> instances;
+		switches = 0;
+		for (size_t c = 0; c < chunks.size(); c++)
+		{
+			Chunk &chunk = *chunks[c];
+			uint32_t mask = chunk.archetype->mask;
+			if (!(mask & COMPONENT_BIT(COMPONENT_BOUNDS)))
+				continue;
+			Transform *transform = chunk.array<Transform>();
+			MeshHandle *mesh = chunk.array<MeshHandle>();
+			MaterialHandle *material = chunk.array<MaterialHandle>();
+			Bounds *bounds = chunk.array<Bounds>();
+			Animation *anim = (mask & COMPONENT_BIT(COMPONENT_ANIMATION)) ? chunk.array<Animation>() : NULL;
+			for (uint32_t i = 0; i < chunk.count; i++)
+			{
+				const GpuMesh *m = resources.mesh(MeshId::fromValue(mesh[i].id));
+				if (!m || !m->bank.indexCount)
+					continue;
+				GpuInstance instance;
+				instance.positionScale = glm::vec4(transform[i].position, transform[i].scale);
+				instance.axisAngle = anim ? glm::vec4(anim[i].axis, anim[i].angle) : glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+				instance.boundsCenterRadius = glm::vec4(bounds[i].center, bounds[i].radius);
+				instance.speed = anim ? anim[i].speed : 0.0f;
+				instance.firstIndex = m->bank.firstIndex;
+				instance.indexCount = m->bank.indexCount;
+				instance.baseVertex = m->bank.baseVertex;
+				instance.material = material[i].material;
+				if (!instances.empty() && instance.material != instances.back().material)
+					switches++;
+				instances.push_back(instance);
+			}
+		}
+		instanceCount = (uint32_t)instances.size();
+
+		size_t count = instanceCount ? instanceCount : 1;
+		allocate(instanceBuffer, count * sizeof(GpuInstance), instances.data(), GL_STATIC_DRAW);
+		allocate(drawBuffer, count * sizeof(DrawData), NULL, GL_DYNAMIC_COPY);
+		allocate(commandBuffer, count * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_COPY);
+	}
+
+	void destroy()
+	{
+		GLuint buffers[4] = {instanceBuffer, drawBuffer, commandBuffer, counterBuffer};
+		glDeleteBuffers(4, buffers);
+		glDeleteBuffers(STREAM_FRAMES, readbackBuffers);
+		for (int i = 0; i < STREAM_FRAMES; i++)
+		{
+			if (readbackFences[i])
+				glDeleteSync(readbackFences[i]);
+			readbackBuffers[i] = 0;
+			readbackFences[i] = 0;
+		}
+		if (cullProgram)
+			glDeleteProgram(cullProgram);
+		if (drawProgram)
+			glDeleteProgram(drawProgram);
+		instanceBuffer = drawBuffer = commandBuffer = counterBuffer = 0;
+		cullProgram = drawProgram = 0;
+	}
+
+	// Compute pass : animation, frustum test and compaction of the instances at `time`
+	void cull(const glm::mat4 &viewProjection, float time)
+	{
+		if (!instanceCount)
+			return;
+		Frustum frustum(viewProjection);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+		glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+		if (!countDraws)
+		{
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+			glClearBufferData(GL_DRAW_INDIRECT_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		}
+		glUseProgram(cullProgram);
+		glUniformMatrix4fv(viewProjectionId, 1, GL_FALSE, &viewProjection[0][0]);
+		glUniform4fv(planesId, 6, &frustum.planes[0][0]);
+		glUniform1f(timeId, time);
+		glUniform1ui(instanceCountId, instanceCount);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instanceBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, drawBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, counterBuffer);
+		glDispatchCompute((instanceCount + 63) / 64, 1, 1);
+		// Commands and instances for the draws, the counter for the copy below
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+		// Keep a copy of the counter for the statistics, read a few frames later
+		readIndex = (readIndex + 1) % STREAM_FRAMES;
+		if (readbackFences[readIndex])
+		{
+			GLenum status = glClientWaitSync(readbackFences[readIndex], 0, 0);
+			if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+			{
+				glBindBuffer(GL_COPY_READ_BUFFER, readbackBuffers[readIndex]);
+				glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(GLuint), &lastVisible);
+			}
+			glDeleteSync(readbackFences[readIndex]);
+		}
+		glBindBuffer(GL_COPY_READ_BUFFER, counterBuffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffers[readIndex]);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(GLuint));
+		readbackFences[readIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	// Draws what cull() kept, the MeshBank VAO must be bound
+	void draw(const glm::mat4 &view, const glm::vec3 &lightPos)
+	{
+		if (!instanceCount)
+			return;
+		glUseProgram(drawProgram);
+		glUniformMatrix4fv(viewId, 1, GL_FALSE, &view[0][0]);
+		glUniform3f(lightId, lightPos.x, lightPos.y, lightPos.z);
+		issue();
+	}
+
+	// Draws what cull() kept with `depthProgram` (see prepass.hpp), before draw(). The positions VAO of the MeshBank must be bound.
+	void drawDepth(GLuint depthProgram)
+	{
+		if (!instanceCount)
+			return;
+		glUseProgram(depthProgram);
+		issue();
+	}
+
+	uint32_t instances() const { return instanceCount; }
+	// Survivors of a recent frame, a few frames late
+	uint32_t visible() const { return lastVisible; }
+	// Material changes along the instance order, counted at upload, culled instances
+	// included : the survivors are compacted in no fixed order, so there is no per-frame count
+	uint32_t materialChanges() const { return switches; }
+
+private:
+	void issue()
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, drawBuffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		if (countDraws)
+		{
+			glBindBuffer(GL_PARAMETER_BUFFER_ARB, counterBuffer);
+			glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)0, 0, instanceCount, 0);
+			glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+		}
+		else
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)0, instanceCount, 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	static void allocate(GLuint &buffer, size_t bytes, const void *data, GLenum usage)
+	{
+		if (!buffer)
+			glGenBuffers(1, &buffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, bytes, data, usage);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+
+	GLuint cullProgram;
+	GLuint drawProgram;
+	GLint viewProjectionId, planesId, timeId, instanceCountId;
+	GLint viewId, lightId;
+	bool countDraws; // ARB_indirect_parameters
+	GLuint instanceBuffer;
+	GLuint drawBuffer;
+	GLuint commandBuffer;
+	GLuint counterBuffer;
+	uint32_t instanceCount;
+	uint32_t switches;
+	GLuint readbackBuffers[STREAM_FRAMES];
+	GLsync readbackFences[STREAM_FRAMES];
+	int readIndex;
+	GLuint lastVisible;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef IMAGE_HPP
+#define IMAGE_HPP
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+// CPU images of the texture paths (atlas.hpp, pagefile.hpp), no GL here so
+// the tools can build them.
+
+// RGBA8 texels, rows bottom up like glTexImage2D
+struct TextureImage
+{
+	int width;
+	int height;
+	std::vector<uint32_t> texels;
+
+	TextureImage() : width(0), height(0) {}
+	TextureImage(int w, int h) : width(w), height(h), texels((size_t)w * h, 0) {}
+	uint32_t &at(int x, int y) { return texels[(size_t)y * width + x]; }
+	uint32_t at(int x, int y) const { return texels[(size_t)y * width + x]; }
+};
+
+// `squares` x `squares` checker of two colors (0xAABBGGRR)
+inline TextureImage checkerImage(int size, int squares, uint32_t even, uint32_t odd)
+{
+	TextureImage image(size, size);
+	for (int y = 0; y < size; y++)
+		for (int x = 0; x < size; x++)
+			image.at(x, y) = ((x * squares / size + y * squares / size) & 1) ? odd : even;
+	return image;
+}
+
+// Half the size, 2 x 2 box filter. Sizes must be even.
+inline TextureImage downsampleImage(const TextureImage &source)
+{
+	TextureImage half(std::max(source.width / 2, 1), std::max(source.height / 2, 1));
+	for (int y = 0; y < half.height; y++)
+		for (int x = 0; x < half.width; x++)
+		{
+			uint32_t sum[4] = {0, 0, 0, 0};
+			for (int s = 0; s < 4; s++)
+			{
+				uint32_t texel = source.at(std::min(2 * x + (s & 1), source.width - 1), std::min(2 * y + (s >> 1), source.height - 1));
+				for (int c = 0; c < 4; c++)
+					sum[c] += (texel >> (8 * c)) & 0xff;
+			}
+			uint32_t texel = 0;
+			for (int c = 0; c < 4; c++)
+				texel |= ((sum[c] + 2) / 4) << (8 * c);
+			half.at(x, y) = texel;
+		}
+	return half;
+}
+
+#endif
@@ -0,0 +1,355 @@
+#ifndef INDIRECT_HPP
+#define INDIRECT_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "atlas.hpp"
+#include "materials.hpp"
+#include "resources.hpp"
+#include "shaders.hpp"
+#include "stream.hpp"
+
+// Multi-draw indirect submission.
+// Instead of setting uniforms and calling glDrawArrays per object, the render
+// thread appends per-draw matrices to a shader storage buffer and one
+// DrawElementsIndirectCommand per object to an indirect buffer, both streamed
+// through StreamRings, then draws each batch with a single
+// glMultiDrawElementsIndirect over the MeshBank buffers. The vertex shader
+// picks its matrices with gl_BaseInstanceARB, so the commands of several
+// ranges of one object (its visible meshlets) share the same draw data.
+//
+// Needs GL 4.3 (or multi_draw_indirect + shader_storage_buffer_object) and
+// ARB_shader_draw_parameters, see supported().
+//
+// A texture bound with setTexture() also ends the batch. Atlases and array
+// textures (atlas.hpp) let differently textured draws share one. The image
+// and every other parameter of a draw are those of its entry in the
+// material table (materials.hpp), which draws of a batch need not share.
+
+// std430 layout of the per-draw data
+struct DrawData
+{
+	glm::mat4 mvp;
+	glm::mat4 model;
+	uint32_t material; // entry of the MaterialTable
+	uint32_t padding[3];
+};
+
+// Layout fixed by GL
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// StandardShading of step8, reading MVP and M from the draw data
+static const char *const g_indirect_vertex_shader = R"(#version 430 core
+#extension GL_ARB_shader_draw_parameters : require
+layout(location = 0) in vec3 vertexPosition_modelspace;
+layout(location = 1) in vec3 vertexColor;
+layout(location = 2) in vec3 vertexNormal_modelspace;
+out vec3 Position_worldspace;
+out vec3 Normal_cameraspace;
+out vec3 EyeDirection_cameraspace;
+out vec3 LightDirection_cameraspace;
+out vec3 fragmentColor;
+out vec3 Position_modelspace;
+flat out vec4 drawTexture;
+flat out uint drawMaterial;
+// Same depth as the pre-pass of prepass.hpp, which GL_EQUAL relies on
+invariant gl_Position;
+struct DrawData
+{
+	mat4 mvp;
+	mat4 model;
+	uint material;
+};
+layout(std430, binding = 0) readonly buffer Draws
+{
+	DrawData draws[];
+};
+struct Material
+{
+	vec4 diffuse;
+	vec4 specular;
+	vec4 texture;
+};
+layout(std430, binding = 8) readonly buffer Materials
+{
+	Material materials[];
+};
+uniform mat4 V;
+uniform vec3 LightPosition_worldspace;
+void main()
+{
+	mat4 M = draws[gl_BaseInstanceARB].model;
+	gl_Position = draws[gl_BaseInstanceARB].mvp * vec4(vertexPosition_modelspace, 1);
+	Position_worldspace = (M * vec4(vertexPosition_modelspace, 1)).xyz;
+	vec3 vertexPosition_cameraspace = (V * M * vec4(vertexPosition_modelspace, 1)).xyz;
+	EyeDirection_cameraspace = vec3(0, 0, 0) - vertexPosition_cameraspace;
+	vec3 LightPosition_cameraspace = (V * vec4(LightPosition_worldspace, 1)).xyz;
+	LightDirection_cameraspace = LightPosition_cameraspace + EyeDirection_cameraspace;
+	Normal_cameraspace = (V * M * vec4(vertexNormal_modelspace, 0)).xyz;
+	fragmentColor = vertexColor;
+	// The meshes have no texture coordinates, the textured shaders project this one
+	Position_modelspace = vertexPosition_modelspace;
+	drawMaterial = draws[gl_BaseInstanceARB].material;
+	drawTexture = materials[drawMaterial].texture;
+}
+)";
+
+static const char *const g_standard_fragment_shader = R"(#version 330 core
+in vec3 Position_worldspace;
+in vec3 Normal_cameraspace;
+in vec3 EyeDirection_cameraspace;
+in vec3 LightDirection_cameraspace;
+in vec3 fragmentColor;
+out vec3 color;
+uniform vec3 LightPosition_worldspace;
+void main()
+{
+	vec3 MaterialDiffuseColor = fragmentColor;
+	float distance = length(LightPosition_worldspace - Position_worldspace);
+	color = standardShading(MaterialDiffuseColor, vec4(0.3, 0.3, 0.3, 5.0), Normal_cameraspace, LightDirection_cameraspace,
+							EyeDirection_cameraspace, distance, 1.0);
+}
+)";
+
+class IndirectRenderer
+{
+public:
+	IndirectRenderer()
+		: program(0), viewId(-1), lightId(-1), drawCapacity(0), commandCapacity(0), draws(NULL), commands(NULL),
+		  drawsOffset(0), commandsOffset(0), drawCount(0), commandCount(0), batchFirst(0), dropped(0), textureTarget(GL_TEXTURE_2D),
+		  currentTexture(0), binds(0), lastMaterial(0), switches(0)
+	{
+	}
+
+	static bool supported()
+	{
+		bool multiDraw = GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_shader_storage_buffer_object);
+		return multiDraw && GLEW_ARB_shader_draw_parameters;
+	}
+
+	// maxDraws : most objects drawn in one frame
+	// maxCommands : most ranges drawn in one frame, maxDraws when 0
+	// fragmentShader : takes the outputs of g_indirect_vertex_shader
+	bool create(uint32_t maxDraws, uint32_t maxCommands = 0, const char *fragmentShader = g_standard_fragment_shader)
+	{
+		program = buildProgram(g_indirect_vertex_shader, fragmentShader, "indirect");
+		if (!program)
+			return false;
+		viewId = glGetUniformLocation(program, "V");
+		lightId = glGetUniformLocation(program, "LightPosition_worldspace");
+
+		drawCapacity = maxDraws;
+		commandCapacity = maxCommands > maxDraws ? maxCommands : maxDraws;
+		if (!drawRing.create(GL_SHADER_STORAGE_BUFFER, drawCapacity * sizeof(DrawData)) ||
+			!commandRing.create(GL_DRAW_INDIRECT_BUFFER, commandCapacity * sizeof(DrawElementsIndirectCommand)))
+		{
+			destroy();
+			return false;
+		}
+		batches.reserve(64);
+		return true;
+	}
+
+	void destroy()
+	{
+		drawRing.destroy();
+		commandRing.destroy();
+		if (program)
+			glDeleteProgram(program);
+		program = 0;
+	}
+
+	bool beginFrame()
+	{
+		drawCount = 0;
+		commandCount = 0;
+		batchFirst = 0;
+		dropped = 0;
+		currentTexture = 0;
+		lastMaterial = 0;
+		switches = 0;
+		batches.clear();
+		draws = NULL;
+		commands = NULL;
+		if (drawRing.beginFrame())
+			draws = (DrawData *)drawRing.allocate(drawCapacity * sizeof(DrawData), &drawsOffset);
+		if (commandRing.beginFrame())
+			commands = (DrawElementsIndirectCommand *)commandRing.allocate(commandCapacity * sizeof(DrawElementsIndirectCommand), &commandsOffset);
+		return draws && commands;
+	}
+
+	// Appends one object to the current batch. material : its entry in the MaterialTable.
+	void add(const glm::mat4 &mvp, const glm::mat4 &model, const MeshRange &range, uint32_t material = 0)
+	{
+		if (addObject(mvp, model, material))
+			addRange(range);
+	}
+
+	// Starts an object, whose ranges follow with addRange. False when the frame is full.
+	bool addObject(const glm::mat4 &mvp, const glm::mat4 &model, uint32_t material = 0)
+	{
+		if (!draws || !commands || drawCount == drawCapacity)
+		{
+			dropped++;
+			return false;
+		}
+		// Another material inside a batch : what would have been a uniform update and a bind
+		if (material != lastMaterial && commandCount > batchFirst)
+			switches++;
+		lastMaterial = material;
+		draws[drawCount].mvp = mvp;
+		draws[drawCount].model = model;
+		draws[drawCount].material = material;
+		drawCount++;
+		return true;
+	}
+
+	// Draws a range of the MeshBank with the matrices of the last object
+	void addRange(const MeshRange &range)
+	{
+		if (!drawCount || commandCount == commandCapacity)
+		{
+			dropped++;
+			return;
+		}
+		DrawElementsIndirectCommand &command = commands[commandCount++];
+		command.count = range.indexCount;
+		command.instanceCount = 1;
+		command.firstIndex = range.firstIndex;
+		command.baseVertex = range.baseVertex;
+		command.baseInstance = drawCount - 1;
+	}
+
+	// Ends the current batch, e.g. on a program change
+	void flush()
+	{
+		if (commandCount == batchFirst)
+			return;
+		Batch batch;
+		batch.first = batchFirst;
+		batch.count = commandCount - batchFirst;
+		batch.texture = currentTexture;
+		batches.push_back(batch);
+		batchFirst = commandCount;
+	}
+
+	// Texture of the draws that follow, on unit TEXTURE_UNIT_ALBEDO. A change ends the batch.
+	void setTexture(GLenum target, GLuint texture)
+	{
+		if (texture == currentTexture)
+			return;
+		flush();
+		textureTarget = target;
+		currentTexture = texture;
+	}
+
+	// Issues every batch, the MeshBank VAO must be bound
+	void submit(const glm::mat4 &view, const glm::vec3 &lightPos)
+	{
+		if (!commitFrame())
+			return;
+		glUseProgram(program);
+		glUniformMatrix4fv(viewId, 1, GL_FALSE, &view[0][0]);
+		glUniform3f(lightId, lightPos.x, lightPos.y, lightPos.z);
+		issue(true);
+	}
+
+	// Issues every batch with another program on the same draw data, without the textures : the depth pre-pass
+	// (prepass.hpp, positions VAO of the MeshBank bound) or the virtual texture feedback (vtexture.hpp)
+	void submitProgram(GLuint otherProgram)
+	{
+		if (!commitFrame())
+			return;
+		glUseProgram(otherProgram);
+		issue(false);
+	}
+
+	// Fences the rings, after submit. Fencing flushes, so after the swap keeps it out of the submit time.
+	void endFrame()
+	{
+		drawRing.endFrame();
+		commandRing.endFrame();
+	}
+
+	uint32_t calls() const { return (uint32_t)batches.size(); }
+	uint32_t commandsIssued() const { return commandCount; }
+	uint32_t droppedDraws() const { return dropped; }
+	// Texture binds of the last submit
+	uint32_t textureBinds() const { return binds; }
+	// Material changes between consecutive draws of a batch this frame, none of which ended it
+	uint32_t materialSwitches() const { return switches; }
+
+private:
+	struct Batch
+	{
+		uint32_t first; // command
+		uint32_t count;
+		GLuint texture; // 0 to leave the bindings alone
+	};
+
+	// The recording of the frame is over, false when there is nothing to draw
+	bool commitFrame()
+	{
+		flush();
+		drawRing.commit();
+		commandRing.commit();
+		return !batches.empty();
+	}
+
+	void issue(bool bindTextures)
+	{
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, drawRing.buffer(), drawsOffset, drawCount * sizeof(DrawData));
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandRing.buffer());
+		GLuint bound = 0;
+		binds = 0;
+		for (size_t b = 0; b < batches.size(); b++)
+		{
+			if (bindTextures && batches[b].texture && batches[b].texture != bound)
+			{
+				glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_ALBEDO);
+				glBindTexture(textureTarget, batches[b].texture);
+				glActiveTexture(GL_TEXTURE0);
+				bound = batches[b].texture;
+				binds++;
+			}
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+										(void *)(commandsOffset + batches[b].first * sizeof(DrawElementsIndirectCommand)), batches[b].count, 0);
+		}
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	GLuint program;
+	GLint viewId;
+	GLint lightId;
+	StreamRing drawRing;
+	StreamRing commandRing;
+	uint32_t drawCapacity;
+	uint32_t commandCapacity;
+	DrawData *draws;
+	DrawElementsIndirectCommand *commands;
+	GLintptr drawsOffset;
+	GLintptr commandsOffset;
+	uint32_t drawCount;
+	uint32_t commandCount;
+	uint32_t batchFirst;
+	uint32_t dropped;
+	std::vector<Batch> batches;
+	GLenum textureTarget;
+	GLuint currentTexture;
+	uint32_t binds;
+	uint32_t lastMaterial;
+	uint32_t switches;
+};
+
+#endif
@@ -0,0 +1,360 @@
+#ifndef JOBS_HPP
+#define JOBS_HPP
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing job system.
+// Every thread of the system (the thread that created it is thread 0) owns a
+// Chase-Lev deque : it pushes and pops its own jobs at the bottom while idle
+// threads steal from the top. Waiting on a JobCounter never blocks a thread,
+// it keeps running jobs until the counter drops to zero, and a counter can
+// carry a continuation job that is queued when its last job finishes, which
+// parallelSort uses to chain its merges.
+//
+// Only the threads of the system may submit or wait.
+
+struct Job;
+struct JobCounter;
+typedef void (*JobFunction)(const Job &job);
+
+struct Job
+{
+	JobFunction function;
+	const void *context;
+	uint32_t begin;
+	uint32_t end;
+	JobCounter *counter;
+};
+
+struct JobCounter
+{
+	std::atomic<int32_t> pending;
+	Job *continuation; // set before the jobs run, queued by the thread that finishes the last job
+
+	JobCounter() : pending(0), continuation(NULL) {}
+};
+
+#define JOB_QUEUE_SIZE 4096 // per thread, power of two
+#define JOB_POOL_SIZE 4096  // jobs are recycled in a ring, per thread
+
+// Chase-Lev deque of fixed capacity (Le, Pop, Cohen, Zappa Nardelli 2013)
+class WorkStealingQueue
+{
+public:
+	WorkStealingQueue() : top(0), bottom(0)
+	{
+		for (int i = 0; i < JOB_QUEUE_SIZE; i++)
+			entries[i].store(NULL, std::memory_order_relaxed);
+	}
+
+	// Owner only, false when full
+	bool push(Job *job)
+	{
+		int64_t b = bottom.load(std::memory_order_relaxed);
+		int64_t t = top.load(std::memory_order_acquire);
+		if (b - t >= JOB_QUEUE_SIZE)
+			return false;
+		entries[b & (JOB_QUEUE_SIZE - 1)].store(job, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Owner only, LIFO end
+	Job *pop()
+	{
+		int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = top.load(std::memory_order_relaxed);
+		if (t > b)
+		{
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return NULL;
+		}
+		Job *job = entries[b & (JOB_QUEUE_SIZE - 1)].load(std::memory_order_relaxed);
+		if (t == b)
+		{
+			// Last job : race against the thieves
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				job = NULL;
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	// Any thread, FIFO end
+	Job *steal()
+	{
+		int64_t t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t b = bottom.load(std::memory_order_acquire);
+		if (t >= b)
+			return NULL;
+		Job *job = entries[t & (JOB_QUEUE_SIZE - 1)].load(std::memory_order_relaxed);
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return NULL;
+		return job;
+	}
+
+private:
+	std::atomic<int64_t> top;
+	std::atomic<int64_t> bottom;
+	std::atomic<Job *> entries[JOB_QUEUE_SIZE];
+};
+
+// Index of the calling thread in the job system it belongs to
+inline unsigned &jobThreadIndex()
+{
+	static thread_local unsigned index = 0;
+	return index;
+}
+
+class JobSystem
+{
+public:
+	// 0 threads means one per hardware thread
+	explicit JobSystem(unsigned threadCount = 0) : running(true), sleeping(0)
+	{
+		if (threadCount == 0)
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		workers.resize(threadCount);
+		for (unsigned i = 0; i < threadCount; i++)
+			workers[i] = new Worker();
+		jobThreadIndex() = 0;
+		for (unsigned i = 1; i < threadCount; i++)
+			threads.push_back(std::thread(&JobSystem::workerLoop, this, i));
+	}
+
+	~JobSystem()
+	{
+		running.store(false);
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		sleepCond.notify_all();
+		for (size_t i = 0; i < threads.size(); i++)
+			threads[i].join();
+		for (size_t i = 0; i < workers.size(); i++)
+			delete workers[i];
+	}
+
+	unsigned threadCount() const { return (unsigned)workers.size(); }
+
+	// The job is only valid until JOB_POOL_SIZE more jobs are created on this thread
+	Job *create(JobFunction function, const void *context, uint32_t begin, uint32_t end, JobCounter *counter)
+	{
+		Worker *w = workers[jobThreadIndex()];
+		Job *job = &w->pool[w->allocated++ & (JOB_POOL_SIZE - 1)];
+		job->function = function;
+		job->context = context;
+		job->begin = begin;
+		job->end = end;
+		job->counter = counter;
+		return job;
+	}
+
+	// The counter must be incremented for the job before it is run
+	void run(Job *job)
+	{
+		if (!workers[jobThreadIndex()]->queue.push(job))
+		{
+			execute(job); // queue full, run it in place
+			return;
+		}
+		if (sleeping.load(std::memory_order_relaxed) > 0)
+			sleepCond.notify_one();
+	}
+
+	// Runs other jobs until every job of the counter is done
+	void wait(JobCounter &counter)
+	{
+		while (counter.pending.load(std::memory_order_acquire) > 0)
+		{
+			Job *job = next(jobThreadIndex());
+			if (job)
+				execute(job);
+			else
+				std::this_thread::yield();
+		}
+	}
+
+	// Calls f(begin, end) on slices of at most `grain` items of [0, count) and waits for all of them
+	template <class F> void parallelFor(uint32_t count, uint32_t grain, const F &f)
+	{
+		if (count == 0)
+			return;
+		if (grain == 0)
+			grain = 1;
+		// Never more than 8 slices per thread, which also bounds the jobs in flight
+		uint32_t minGrain = (count + threadCount() * 8 - 1) / (threadCount() * 8);
+		grain = std::max(grain, minGrain);
+		if (threadCount() == 1 || count <= grain)
+		{
+			f(0u, count);
+			return;
+		}
+		JobCounter counter;
+		uint32_t slices = (count + grain - 1) / grain;
+		counter.pending.store((int32_t)slices);
+		for (uint32_t begin = 0; begin < count; begin += grain)
+			run(create(&parallelForJob<F>, &f, begin, std::min(count, begin + grain), &counter));
+		wait(counter);
+	}
+
+private:
+	struct Worker
+	{
+		WorkStealingQueue queue;
+		Job pool[JOB_POOL_SIZE];
+		uint32_t allocated;
+		Worker() : allocated(0) {}
+	};
+
+	template <class F> static void parallelForJob(const Job &job)
+	{
+		(*(const F *)job.context)(job.begin, job.end);
+	}
+
+	void execute(Job *job)
+	{
+		JobCounter *counter = job->counter;
+		job->function(*job);
+		if (!counter)
+			return;
+		// The waiter may return and destroy the counter (parallelFor keeps it on
+		// its stack) once pending reaches 0 : never touch it after the decrement
+		Job *continuation = counter->continuation;
+		if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1 && continuation)
+			run(continuation);
+	}
+
+	// Own queue first, then steal starting from the next thread
+	Job *next(unsigned index)
+	{
+		Job *job = workers[index]->queue.pop();
+		if (job)
+			return job;
+		for (size_t i = 1; i < workers.size(); i++)
+		{
+			job = workers[(index + i) % workers.size()]->queue.steal();
+			if (job)
+				return job;
+		}
+		return NULL;
+	}
+
+	void workerLoop(unsigned index)
+	{
+		jobThreadIndex() = index;
+		int idle = 0;
+		while (running.load(std::memory_order_relaxed))
+		{
+			Job *job = next(index);
+			if (job)
+			{
+				execute(job);
+				idle = 0;
+			}
+			else if (++idle < 64)
+			{
+				std::this_thread::yield();
+			}
+			else
+			{
+				// The timeout covers a push racing with going to sleep
+				std::unique_lock<std::mutex> lock(sleepMutex);
+				sleeping++;
+				sleepCond.wait_for(lock, std::chrono::milliseconds(1));
+				sleeping--;
+			}
+		}
+	}
+
+	std::vector<Worker *> workers;
+	std::vector<std::thread> threads;
+	std::atomic<bool> running;
+	std::atomic<int> sleeping;
+	std::mutex sleepMutex;
+	std::condition_variable sleepCond;
+
+	JobSystem(const JobSystem &);
+	JobSystem &operator=(const JobSystem &);
+};
+
+template <class T, class Less> struct ParallelSortContext
+{
+	T *buffers[2]; // merges of level k write to buffers[k & 1], the runs are sorted in place in buffers[0]
+	size_t count;
+	size_t runSize;
+	Less less;
+};
+
+// Node `job.end` of level `job.begin` : sorts run `job.end` at level 0, merges the two halves below it above
+template <class T, class Less> void parallelSortJob(const Job &job)
+{
+	const ParallelSortContext<T, Less> &sort = *(const ParallelSortContext<T, Less> *)job.context;
+	uint32_t level = job.begin;
+	size_t width = sort.runSize << level;
+	size_t first = std::min(sort.count, (size_t)job.end * width);
+	size_t last = std::min(sort.count, first + width);
+	if (level == 0)
+	{
+		std::sort(sort.buffers[0] + first, sort.buffers[0] + last, sort.less);
+		return;
+	}
+	size_t middle = std::min(sort.count, first + width / 2);
+	const T *src = sort.buffers[(level - 1) & 1];
+	std::merge(src + first, src + middle, src + middle, src + last, sort.buffers[level & 1] + first, sort.less);
+}
+
+// Sorts runs of the array in parallel, then merges them pairwise up a tree.
+// Each merge is the continuation of the counter of its two halves, so it is
+// queued as soon as both are done, without a barrier between the levels :
+// the calling thread only waits for the last merge.
+template <class T, class Less> void parallelSort(JobSystem &jobs, T *items, size_t count, T *scratch, Less less)
+{
+	uint32_t runs = 1, levels = 0;
+	while (runs < jobs.threadCount() * 2 && count / (runs * 2) >= 1024)
+	{
+		runs *= 2;
+		levels++;
+	}
+	if (runs == 1)
+	{
+		std::sort(items, items + count, less);
+		return;
+	}
+
+	ParallelSortContext<T, Less> sort = {{items, scratch}, count, (count + runs - 1) / runs, less};
+	// Nodes numbered as a heap : the root merge is 1, the children of n are 2n and 2n + 1, the runs
+	// runs to 2 runs - 1. Counter n waits for the children of merge n, counter 0 for the root.
+	std::vector<JobCounter> counters(runs);
+	counters[0].pending.store(1);
+	uint32_t depth = 0;
+	for (uint32_t node = 1; node < 2 * runs; node++)
+	{
+		if (node == (2u << depth))
+			depth++;
+		Job *job = jobs.create(&parallelSortJob<T, Less>, &sort, levels - depth, node - (1u << depth), &counters[node / 2]);
+		if (node < runs)
+		{
+			counters[node].pending.store(2);
+			counters[node].continuation = job;
+		}
+		else
+			jobs.run(job);
+	}
+	jobs.wait(counters[0]);
+	if (levels & 1)
+		std::copy(scratch, scratch + count, items);
+}
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef LIGHTING_HPP
+#define LIGHTING_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "clusters.hpp"
+#include "stream.hpp"
+
+// Clustered forward shading of the lights binned by clusters.hpp.
+// Per frame the lights, the cluster grid and the light indices are streamed
+// through one StreamRing and bound to fixed storage buffer bindings, so any
+// program built with g_clustered_fragment_shader reads them without uniforms :
+//   LIGHTING_BINDING_LIGHTS   : PointLight of the frame, in view space
+//   LIGHTING_BINDING_CLUSTERS : how to find the cluster of a fragment, then
+//                               first index and count of every cluster
+//   LIGHTING_BINDING_INDICES  : light indices of all the clusters
+//
+// Needs GL 4.3 or ARB_shader_storage_buffer_object, see supported().
+
+#define LIGHTING_BINDING_LIGHTS 4
+#define LIGHTING_BINDING_CLUSTERS 5
+#define LIGHTING_BINDING_INDICES 6
+
+// std430 layout of the start of the cluster buffer
+struct ClusterGridHeader
+{
+	glm::uvec4 size;	// CLUSTER_X, CLUSTER_Y, CLUSTER_Z
+	glm::vec4 mapping; // gl_FragCoord.xy to tiles, log(view distance) to slices
+};
+
+// StandardShading of step8 summed over the lights of the fragment's cluster,
+// each fading out to 0 at its range
+static const char *const g_clustered_fragment_shader = R"(#version 430 core
+in vec3 Position_worldspace;
+in vec3 Normal_cameraspace;
+in vec3 EyeDirection_cameraspace;
+in vec3 LightDirection_cameraspace;
+in vec3 fragmentColor;
+out vec3 color;
+struct PointLight
+{
+	vec4 position;
+	vec4 color;
+};
+layout(std430, binding = 4) readonly buffer Lights
+{
+	PointLight lights[];
+};
+layout(std430, binding = 5) readonly buffer Clusters
+{
+	uvec4 gridSize;
+	vec4 gridMapping;
+	uvec2 clusters[];
+};
+layout(std430, binding = 6) readonly buffer LightIndices
+{
+	uint lightIndices[];
+};
+void main()
+{
+	vec3 MaterialDiffuseColor = fragmentColor;
+	vec4 MaterialSpecular = vec4(0.3, 0.3, 0.3, 5.0);
+	vec3 position = -EyeDirection_cameraspace;
+	vec3 n = normalize(Normal_cameraspace);
+	vec3 E = normalize(EyeDirection_cameraspace);
+
+	vec3 cell = vec3(gl_FragCoord.xy * gridMapping.xy, log(-position.z) * gridMapping.z + gridMapping.w);
+	uvec3 c = uvec3(clamp(cell, vec3(0), vec3(gridSize.xyz - 1u)));
+	uvec2 cluster = clusters[(c.z * gridSize.y + c.y) * gridSize.x + c.x];
+
+	color = vec3(0.1, 0.1, 0.1) * MaterialDiffuseColor;
+	for (uint i = 0u; i < cluster.y; i++)
+	{
+		PointLight light = lights[lightIndices[cluster.x + i]];
+		vec3 toLight = light.position.xyz - position;
+		float distance = length(toLight);
+		float fade = clamp(1.0 - pow(distance / light.position.w, 4.0), 0.0, 1.0);
+		color += phong(MaterialDiffuseColor, MaterialSpecular, n, toLight / distance, E) * light.color.rgb * light.color.w * fade *
+				 fade / (distance * distance);
+	}
+}
+)";
+
+class ClusteredLighting
+{
+public:
+	ClusteredLighting() : maxLights(0) {}
+
+	static bool supported() { return GLEW_VERSION_4_3 || GLEW_ARB_shader_storage_buffer_object; }
+
+	bool create(uint32_t maxLights)
+	{
+		this->maxLights = maxLights;
+		// Three allocations, each may need a full alignment of padding
+		size_t bytes = maxLights * sizeof(PointLight) + sizeof(ClusterGridHeader) + CLUSTER_COUNT * sizeof(glm::uvec2) +
+					   CLUSTER_MAX_INDICES * sizeof(uint32_t) + 3 * 256;
+		return ring.create(GL_SHADER_STORAGE_BUFFER, bytes);
+	}
+
+	void destroy() { ring.destroy(); }
+
+	// Streams the lights of the frame and binds them. The scene is drawn at
+	// gl_FragCoord 0 to `width` x `height`.
+	bool upload(const LightClusters &frame, int width, int height)
+	{
+		if (!ring.beginFrame())
+			return false;
+		GLintptr lightsOffset = 0, clustersOffset = 0, indicesOffset = 0;
+		// Storage buffer ranges may not be empty
+		size_t lightBytes = (frame.lights.size() ? frame.lights.size() : 1) * sizeof(PointLight);
+		size_t clusterBytes = sizeof(ClusterGridHeader) + CLUSTER_COUNT * sizeof(glm::uvec2);
+		size_t indexBytes = (frame.indices.size() ? frame.indices.size() : 1) * sizeof(uint32_t);
+		void *lights = ring.allocate(lightBytes, &lightsOffset);
+		unsigned char *clusters = (unsigned char *)ring.allocate(clusterBytes, &clustersOffset);
+		void *indices = ring.allocate(indexBytes, &indicesOffset);
+		if (!lights || !clusters || !indices || frame.lights.size() > maxLights)
+		{
+			ring.commit();
+			return false;
+		}
+		memcpy(lights, frame.lights.data(), frame.lights.size() * sizeof(PointLight));
+		ClusterGridHeader header;
+		float slices = CLUSTER_Z / logf(frame.far / frame.near);
+		header.size = glm::uvec4(CLUSTER_X, CLUSTER_Y, CLUSTER_Z, 0);
+		header.mapping = glm::vec4((float)CLUSTER_X / width, (float)CLUSTER_Y / height, slices, -logf(frame.near) * slices);
+		memcpy(clusters, &header, sizeof(header));
+		memcpy(clusters + sizeof(header), frame.clusters.data(), CLUSTER_COUNT * sizeof(glm::uvec2));
+		memcpy(indices, frame.indices.data(), frame.indices.size() * sizeof(uint32_t));
+		ring.commit();
+
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHTING_BINDING_LIGHTS, ring.buffer(), lightsOffset, lightBytes);
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHTING_BINDING_CLUSTERS, ring.buffer(), clustersOffset, clusterBytes);
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHTING_BINDING_INDICES, ring.buffer(), indicesOffset, indexBytes);
+		return true;
+	}
+
+	// After the last draw of the frame
+	void endFrame() { ring.endFrame(); }
+
+	const StreamStats &frameStats() const { return ring.frameStats(); }
+
+private:
+	ClusteredLighting(const ClusteredLighting &);
+	ClusteredLighting &operator=(const ClusteredLighting &);
+
+	uint32_t maxLights;
+	StreamRing ring;
+};
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef MATERIALS_HPP
+#define MATERIALS_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Material table.
+// Every material parameter lives in one shader storage buffer, and each
+// draw of the multi-draw paths carries the index of its entry in its
+// DrawData (indirect.hpp, gpucull.hpp). g_indirect_vertex_shader looks the
+// entry up, so draws of different materials share a batch : a material
+// change costs nothing, where the per-object path would set uniforms and
+// bind a texture. The textures of the materials are the layers of one
+// array texture (atlas.hpp), or the regions of an atlas, bound once.
+//
+// Entry 0 is the default material : the vertex colors and the specular of
+// StandardShading, the whole bound texture. The table is uploaded once,
+// bind() it before the draws of every frame.
+//
+// Bindless textures (ARB_bindless_texture) would let each entry name its
+// own texture, but their handles are values written into the buffer,
+// which gltrace.hpp cannot remap on replay.
+
+#define MATERIAL_BINDING 8 // draws use 0, GPU culling 1 to 3, lights 4 to 6, shadows 7
+
+// std430 layout of an entry
+struct MaterialData
+{
+	glm::vec4 diffuse;  // rgb : tint of the vertex colors or of the texture, a : 1 to sample the texture
+	glm::vec4 specular; // rgb, a : exponent
+	glm::vec4 texture;  // image : offset and scale in an atlas, layer in x for an array (g_textured_fragment_shader)
+};
+
+// StandardShading of step8 with the parameters of the draw's material, and
+// its layer of the array texture when it has one
+static const char *const g_material_fragment_shader = R"(#version 430 core
+in vec3 Position_worldspace;
+in vec3 Normal_cameraspace;
+in vec3 EyeDirection_cameraspace;
+in vec3 LightDirection_cameraspace;
+in vec3 fragmentColor;
+in vec3 Position_modelspace;
+flat in uint drawMaterial;
+out vec3 color;
+uniform vec3 LightPosition_worldspace;
+struct Material
+{
+	vec4 diffuse;
+	vec4 specular;
+	vec4 texture;
+};
+layout(std430, binding = 8) readonly buffer Materials
+{
+	Material materials[];
+};
+layout(binding = 3) uniform sampler2DArray albedo;
+void main()
+{
+	Material material = materials[drawMaterial];
+	// Sampled by textured materials only
+	vec2 textureUV = boxProjection(Position_modelspace);
+	vec3 textureColor = texture(albedo, vec3(textureUV, material.texture.x)).rgb;
+	vec3 MaterialDiffuseColor = material.diffuse.rgb * mix(fragmentColor, textureColor, material.diffuse.a);
+	float distance = length(LightPosition_worldspace - Position_worldspace);
+	color = standardShading(MaterialDiffuseColor, material.specular, Normal_cameraspace, LightDirection_cameraspace,
+							EyeDirection_cameraspace, distance, 1.0);
+}
+)";
+
+class MaterialTable
+{
+public:
+	MaterialTable() : buffer(0), uploaded(0)
+	{
+		MaterialData standard;
+		standard.diffuse = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+		standard.specular = glm::vec4(0.3f, 0.3f, 0.3f, 5.0f);
+		standard.texture = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+		entries.push_back(standard);
+	}
+
+	// Index of the new entry
+	uint32_t add(const MaterialData &material)
+	{
+		entries.push_back(material);
+		return (uint32_t)entries.size() - 1;
+	}
+
+	// The default material with another image
+	uint32_t addTexture(const glm::vec4 &texture)
+	{
+		MaterialData material = entries[0];
+		material.texture = texture;
+		return add(material);
+	}
+
+	// Copies the entries added so far to the GPU
+	void upload()
+	{
+		if (!buffer)
+			glGenBuffers(1, &buffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, entries.size() * sizeof(MaterialData), entries.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		uploaded = (uint32_t)entries.size();
+	}
+
+	void bind() const { glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BINDING, buffer); }
+
+	void destroy()
+	{
+		if (buffer)
+			glDeleteBuffers(1, &buffer);
+		buffer = 0;
+		uploaded = 0;
+	}
+
+	// Entries on the GPU, the default one included
+	uint32_t count() const { return uploaded; }
+
+private:
+	MaterialTable(const MaterialTable &);
+	MaterialTable &operator=(const MaterialTable &);
+
+	std::vector<MaterialData> entries;
+	GLuint buffer;
+	uint32_t uploaded;
+};
+
+#endif
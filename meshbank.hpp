@@ -0,0 +1,135 @@
+#ifndef MESHBANK_HPP
+#define MESHBANK_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "resources.hpp"
+
+// Shared vertex and index buffers ("megabuffers") holding many meshes, so one
+// VAO and one pair of buffers serve every draw of a multi-draw call. Meshes
+// are appended on the CPU, their identical vertices welded into an index
+// list, then everything is uploaded at once. A mesh is then only a range of
+// the index buffer plus a base vertex.
+// The positions are also uploaded alone, for passes that need nothing else
+// (depth only) : a third of the vertex bytes to fetch.
+
+struct BankVertex
+{
+	glm::vec3 position;
+	glm::vec3 color;
+	glm::vec3 normal;
+};
+
+class MeshBank
+{
+public:
+	MeshBank() : vao(0), positionVao(0) {}
+
+	// Appends a triangle list given as separate xyz streams, returns its range
+	MeshRange add(const float *positions, const float *colors, const float *normals, uint32_t vertexCount)
+	{
+		std::vector<BankVertex> unwelded(vertexCount);
+		for (uint32_t i = 0; i < vertexCount; i++)
+		{
+			unwelded[i].position = glm::vec3(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+			unwelded[i].color = glm::vec3(colors[3 * i], colors[3 * i + 1], colors[3 * i + 2]);
+			unwelded[i].normal = glm::vec3(normals[3 * i], normals[3 * i + 1], normals[3 * i + 2]);
+		}
+
+		// Sort the corners so identical vertices are neighbours, keep one of each
+		std::vector<uint32_t> order(vertexCount);
+		for (uint32_t i = 0; i < vertexCount; i++)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+			return memcmp(&unwelded[a], &unwelded[b], sizeof(BankVertex)) < 0;
+		});
+
+		MeshRange range;
+		range.baseVertex = (int32_t)vertices.size();
+		range.firstIndex = (uint32_t)indices.size();
+		range.indexCount = vertexCount;
+		indices.resize(indices.size() + vertexCount);
+		uint32_t *meshIndices = &indices[range.firstIndex];
+		for (uint32_t i = 0; i < vertexCount; i++)
+		{
+			if (i == 0 || memcmp(&unwelded[order[i]], &unwelded[order[i - 1]], sizeof(BankVertex)) != 0)
+				vertices.push_back(unwelded[order[i]]);
+			meshIndices[order[i]] = (uint32_t)vertices.size() - 1 - range.baseVertex;
+		}
+		return range;
+	}
+
+	// (Re)creates the buffers and the VAO from everything added so far
+	void upload(GpuResources &resources)
+	{
+		resources.destroy(vertexBuffer);
+		resources.destroy(indexBuffer);
+		resources.destroy(positionBuffer);
+		if (!vao)
+			glGenVertexArrays(1, &vao);
+		glBindVertexArray(vao);
+		vertexBuffer = resources.createBuffer(GL_ARRAY_BUFFER, vertices.size() * sizeof(BankVertex), vertices.data(), GL_STATIC_DRAW);
+		indexBuffer = resources.createBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+		// Same attributes as the separate streams : 0 position, 1 color, 2 normal
+		glBindBuffer(GL_ARRAY_BUFFER, resources.buffer(vertexBuffer));
+		for (GLuint attribute = 0; attribute < 3; attribute++)
+		{
+			glEnableVertexAttribArray(attribute);
+			glVertexAttribPointer(attribute, 3, GL_FLOAT, GL_FALSE, sizeof(BankVertex), (void *)(attribute * sizeof(glm::vec3)));
+		}
+
+		// Position only, same indices
+		std::vector<glm::vec3> positions(vertices.size());
+		for (size_t v = 0; v < vertices.size(); v++)
+			positions[v] = vertices[v].position;
+		if (!positionVao)
+			glGenVertexArrays(1, &positionVao);
+		glBindVertexArray(positionVao);
+		positionBuffer = resources.createBuffer(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, resources.buffer(indexBuffer));
+		glBindBuffer(GL_ARRAY_BUFFER, resources.buffer(positionBuffer));
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
+		glBindVertexArray(0);
+	}
+
+	void destroy(GpuResources &resources)
+	{
+		resources.destroy(vertexBuffer);
+		resources.destroy(indexBuffer);
+		resources.destroy(positionBuffer);
+		if (vao)
+			glDeleteVertexArrays(1, &vao);
+		if (positionVao)
+			glDeleteVertexArrays(1, &positionVao);
+		vao = positionVao = 0;
+	}
+
+	// The element buffer is part of the VAO state
+	void bind() const { glBindVertexArray(vao); }
+	// Attribute 0 only
+	void bindPositions() const { glBindVertexArray(positionVao); }
+
+	uint32_t vertexCount() const { return (uint32_t)vertices.size(); }
+	uint32_t indexCount() const { return (uint32_t)indices.size(); }
+
+	// CPU copies, for offline passes over the meshes (e.g. meshlet building) before upload
+	const BankVertex *vertexData() const { return vertices.data(); }
+	uint32_t *indexData() { return indices.data(); }
+
+private:
+	std::vector<BankVertex> vertices;
+	std::vector<uint32_t> indices;
+	BufferId vertexBuffer;
+	BufferId indexBuffer;
+	BufferId positionBuffer;
+	GLuint vao;
+	GLuint positionVao;
+};
+
+#endif
@@ -0,0 +1,283 @@
+#ifndef MESHLETS_HPP
+#define MESHLETS_HPP
+
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "drawlist.hpp"
+#include "meshbank.hpp"
+#include "resources.hpp"
+
+// Meshlets : a banked mesh is split offline into small clusters of
+// neighbouring triangles, each with a bounding sphere and a cone bounding the
+// normals of its triangles. At draw time the clusters outside the frustum or
+// facing away from the camera are skipped, so a large mesh seen from one side
+// only sends the half that can be seen. The triangles of a mesh are reordered
+// so every meshlet is a contiguous run of its index range, and neighbouring
+// visible meshlets merge into a single draw range.
+//
+// Back-face culling of clusters assumes closed meshes, whose back faces are
+// hidden by front faces anyway.
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+struct Meshlet
+{
+	glm::vec3 center; // bounding sphere, model space
+	float radius;
+	glm::vec3 coneAxis; // average facing of the triangles
+	float coneCutoff;   // sine of the cone half angle, 1 when some triangle may always face the camera
+	uint32_t firstIndex; // in the bank
+	uint32_t triangleCount;
+	uint32_t vertexCount;
+};
+
+struct MeshletStats
+{
+	uint32_t meshlets;
+	uint32_t frustumCulled;
+	uint32_t backfaceCulled;
+	uint32_t ranges; // draw ranges left after merging neighbours
+	uint64_t triangles;
+	uint64_t trianglesCulled;
+
+	MeshletStats() { reset(); }
+
+	void reset()
+	{
+		meshlets = frustumCulled = backfaceCulled = ranges = 0;
+		triangles = trianglesCulled = 0;
+	}
+};
+
+class MeshletSet
+{
+public:
+	// Splits the triangles of `range` into meshlets. The mesh must still be on
+	// the CPU side of the bank : its index range is reordered in place, upload after.
+	MeshletRange build(MeshBank &bank, const MeshRange &range)
+	{
+		const BankVertex *vertices = bank.vertexData() + range.baseVertex;
+		uint32_t *indices = bank.indexData() + range.firstIndex;
+		uint32_t triangleCount = range.indexCount / 3;
+		uint32_t vertexCount = 0;
+		for (uint32_t i = 0; i < triangleCount * 3; i++)
+			if (indices[i] >= vertexCount)
+				vertexCount = indices[i] + 1;
+
+		// Triangles around each vertex, the candidates to grow a meshlet with
+		std::vector<uint32_t> adjacencyFirst(vertexCount + 1, 0);
+		std::vector<uint32_t> adjacency(triangleCount * 3);
+		for (uint32_t i = 0; i < triangleCount * 3; i++)
+			adjacencyFirst[indices[i] + 1]++;
+		for (uint32_t v = 0; v < vertexCount; v++)
+			adjacencyFirst[v + 1] += adjacencyFirst[v];
+		std::vector<uint32_t> fill(adjacencyFirst.begin(), adjacencyFirst.end() - 1);
+		for (uint32_t i = 0; i < triangleCount * 3; i++)
+			adjacency[fill[indices[i]]++] = i / 3;
+
+		std::vector<uint8_t> emitted(triangleCount, 0);
+		std::vector<uint32_t> vertexMeshlet(vertexCount, UINT32_MAX); // last meshlet the vertex joined
+		std::vector<uint32_t> order;
+		std::vector<uint32_t> members; // vertices of the current meshlet
+		std::vector<uint32_t> candidates;
+		order.reserve(triangleCount * 3);
+
+		MeshletRange result;
+		result.first = (uint32_t)meshlets.size();
+		uint32_t scan = 0;
+		for (;;)
+		{
+			// Seed with a triangle next to the last meshlet if any, keeps neighbours in order
+			uint32_t seed = UINT32_MAX;
+			for (size_t c = 0; c < candidates.size() && seed == UINT32_MAX; c++)
+				if (!emitted[candidates[c]])
+					seed = candidates[c];
+			while (seed == UINT32_MAX && scan < triangleCount)
+				if (!emitted[scan++])
+					seed = scan - 1;
+			if (seed == UINT32_MAX)
+				break;
+
+			uint32_t id = (uint32_t)meshlets.size();
+			Meshlet meshlet;
+			meshlet.firstIndex = range.firstIndex + (uint32_t)order.size();
+			meshlet.triangleCount = 0;
+			members.clear();
+			candidates.clear();
+			for (uint32_t next = seed; next != UINT32_MAX;)
+			{
+				emitted[next] = 1;
+				meshlet.triangleCount++;
+				for (int k = 0; k < 3; k++)
+				{
+					uint32_t v = indices[3 * next + k];
+					order.push_back(v);
+					if (vertexMeshlet[v] == id)
+						continue;
+					vertexMeshlet[v] = id;
+					members.push_back(v);
+					for (uint32_t a = adjacencyFirst[v]; a < adjacencyFirst[v + 1]; a++)
+						if (!emitted[adjacency[a]])
+							candidates.push_back(adjacency[a]);
+				}
+				if (meshlet.triangleCount == MESHLET_MAX_TRIANGLES)
+					break;
+
+				// The neighbour adding the fewest new vertices, while they fit
+				next = UINT32_MAX;
+				uint32_t fewest = 4;
+				for (size_t c = 0; c < candidates.size();)
+				{
+					uint32_t t = candidates[c];
+					if (emitted[t])
+					{
+						candidates[c] = candidates.back();
+						candidates.pop_back();
+						continue;
+					}
+					uint32_t added = 0;
+					for (int k = 0; k < 3; k++)
+						added += vertexMeshlet[indices[3 * t + k]] != id;
+					if (added < fewest && members.size() + added <= MESHLET_MAX_VERTICES)
+					{
+						fewest = added;
+						next = t;
+						if (!added)
+							break;
+					}
+					c++;
+				}
+				// No neighbour left (disconnected parts) : the next triangle of the file, files are mostly coherent
+				while (next == UINT32_MAX && scan < triangleCount)
+				{
+					if (emitted[scan])
+					{
+						scan++;
+						continue;
+					}
+					uint32_t added = 0;
+					for (int k = 0; k < 3; k++)
+						added += vertexMeshlet[indices[3 * scan + k]] != id;
+					if (members.size() + added > MESHLET_MAX_VERTICES)
+						break;
+					next = scan;
+				}
+			}
+			meshlet.vertexCount = (uint32_t)members.size();
+			computeBounds(meshlet, vertices, members, &order[meshlet.firstIndex - range.firstIndex]);
+			meshlets.push_back(meshlet);
+		}
+
+		std::copy(order.begin(), order.end(), indices);
+		result.count = (uint32_t)meshlets.size() - result.first;
+		return result;
+	}
+
+	// Draws the visible meshlets of one object through `draw(const MeshRange &)`.
+	// `frustum` and `eye` are in model space : Frustum(mvp) and the camera position
+	// taken from inverse(view * model).
+	template <typename F>
+	void cull(const MeshletRange &set, int32_t baseVertex, const Frustum &frustum, const glm::vec3 &eye, MeshletStats &stats, F draw) const
+	{
+		MeshRange run;
+		run.baseVertex = baseVertex;
+		for (uint32_t i = 0; i < set.count; i++)
+		{
+			const Meshlet &m = meshlets[set.first + i];
+			stats.meshlets++;
+			stats.triangles += m.triangleCount;
+			bool visible = frustum.containsSphere(m.center, m.radius);
+			if (!visible)
+				stats.frustumCulled++;
+			else
+			{
+				// Every normal of the cone points away from every point of the sphere
+				glm::vec3 toCenter = m.center - eye;
+				visible = glm::dot(toCenter, m.coneAxis) < m.coneCutoff * glm::length(toCenter) + m.radius;
+				if (!visible)
+					stats.backfaceCulled++;
+			}
+			if (!visible)
+			{
+				stats.trianglesCulled += m.triangleCount;
+				continue;
+			}
+			if (run.indexCount && run.firstIndex + run.indexCount == m.firstIndex)
+			{
+				run.indexCount += 3 * m.triangleCount;
+				continue;
+			}
+			if (run.indexCount)
+			{
+				draw(run);
+				stats.ranges++;
+			}
+			run.firstIndex = m.firstIndex;
+			run.indexCount = 3 * m.triangleCount;
+		}
+		if (run.indexCount)
+		{
+			draw(run);
+			stats.ranges++;
+		}
+	}
+
+	const Meshlet &operator[](uint32_t i) const { return meshlets[i]; }
+	uint32_t size() const { return (uint32_t)meshlets.size(); }
+
+private:
+	static void computeBounds(Meshlet &meshlet, const BankVertex *vertices, const std::vector<uint32_t> &members, const uint32_t *indices)
+	{
+		glm::vec3 low = vertices[members[0]].position, high = low;
+		for (size_t i = 1; i < members.size(); i++)
+		{
+			low = glm::min(low, vertices[members[i]].position);
+			high = glm::max(high, vertices[members[i]].position);
+		}
+		meshlet.center = 0.5f * (low + high);
+		meshlet.radius = 0.0f;
+		for (size_t i = 0; i < members.size(); i++)
+			meshlet.radius = glm::max(meshlet.radius, glm::length(vertices[members[i]].position - meshlet.center));
+
+		// Face normals, wound like GL front faces but turned to agree with the
+		// vertex normals, since mesh files are not always consistently wound
+		std::vector<glm::vec3> normals;
+		glm::vec3 sum(0.0f);
+		for (uint32_t t = 0; t < meshlet.triangleCount; t++)
+		{
+			const BankVertex &a = vertices[indices[3 * t]];
+			const BankVertex &b = vertices[indices[3 * t + 1]];
+			const BankVertex &c = vertices[indices[3 * t + 2]];
+			glm::vec3 n = glm::cross(b.position - a.position, c.position - a.position);
+			float area = glm::length(n);
+			if (area <= 0.0f)
+				continue;
+			n = n / area;
+			if (glm::dot(n, a.normal + b.normal + c.normal) < 0.0f)
+				n = -n;
+			normals.push_back(n);
+			sum += n;
+		}
+		meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+		meshlet.coneCutoff = 1.0f;
+		float length = glm::length(sum);
+		if (normals.empty() || length <= 1e-6f)
+			return;
+		meshlet.coneAxis = sum / length;
+		float lowestDot = 1.0f;
+		for (size_t i = 0; i < normals.size(); i++)
+			lowestDot = glm::min(lowestDot, glm::dot(normals[i], meshlet.coneAxis));
+		// Past about 85 degrees the cone would almost never cull, leave it open
+		if (lowestDot > 0.1f)
+			meshlet.coneCutoff = sqrtf(1.0f - lowestDot * lowestDot);
+	}
+
+	std::vector<Meshlet> meshlets;
+};
+
+#endif
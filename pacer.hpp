@@ -0,0 +1,272 @@
+#ifndef PACER_HPP
+#define PACER_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <deque>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "renderthread.hpp"
+
+// Frame pacing : when frames start and how many the GPU may queue.
+//
+// Render thread, per frame : beginFrame() before the first GL call,
+// endFrame() after the swap.
+//   - CPU time : from beginFrame() to the end of the swap
+//   - GPU time : a GL_TIME_ELAPSED query around the frame, read back a few
+//     frames later when its result is available, so it never stalls
+//   - frames in flight : a fence after each swap, and the render thread waits
+//     for the oldest once more than `maxInFlight` are unfinished. The driver
+//     would otherwise queue several frames, each one more frame of latency.
+//   - the intervals between swaps, as a 1 ms histogram
+//
+// Simulation thread : waitForInput() before polling the input.
+//   - target fps : frames start on a fixed schedule of 1 / fps seconds.
+//     After a frame that missed its slot the schedule restarts from now
+//     instead of rushing frames to catch up.
+//   - late wake : the input is polled as late as the frame allows, the slot
+//     end minus the slowest input to present time of the last
+//     PACER_WORK_FRAMES frames. Without a target fps the slot is the swap
+//     interval measured on the render thread, vsync's.
+
+#define PACER_QUERIES 8      // GPU timer queries in flight
+#define PACER_WORK_FRAMES 16 // frames the late wake estimate comes from
+#define PACER_MARGIN 0.001   // seconds the late wake keeps in hand
+#define PACER_BUCKETS 64     // 1 ms buckets of frame intervals, the last one open ended
+
+struct PacerStats
+{
+	TimingStats interval;	  // swap to swap
+	TimingStats cpu;		  // render thread, from beginFrame() to the end of the swap
+	TimingStats gpu;		  // timer query of the frame
+	TimingStats inFlightWait; // render thread waits for the GPU to finish older frames
+	double intervalSquares;	  // for the jitter
+	double sleepSeconds;	  // simulation thread sleeps of the target fps and the late wake
+	uint32_t histogram[PACER_BUCKETS];
+
+	// Standard deviation of the frame intervals
+	double jitter() const
+	{
+		if (!interval.count)
+			return 0.0;
+		double mean = interval.average();
+		double variance = intervalSquares / interval.count - mean * mean;
+		return variance > 0.0 ? sqrt(variance) : 0.0;
+	}
+};
+
+class FramePacer
+{
+public:
+	FramePacer()
+		: maxInFlight(0), period(0.0), lateWake(false), queryHead(0), queryTail(0), timing(false), latestGpu(0.0),
+		  gpuMeasured(false), frameStart(0.0),
+		  workHead(0), nextSlot(0.0), lastPresent(0.0), measuredPeriod(0.0), predictedWork(0.0), sleptMicroseconds(0)
+	{
+		memset(queries, 0, sizeof(queries));
+		memset(work, 0, sizeof(work));
+		resetStats();
+	}
+
+	// maxInFlight : unfinished frames before the render thread waits, 0 to leave it to the driver.
+	// targetFps : 0 for no cap.
+	void create(int maxInFlight, double targetFps, bool lateWake)
+	{
+		this->maxInFlight = maxInFlight > 0 ? maxInFlight : 0;
+		this->period = targetFps > 0.0 ? 1.0 / targetFps : 0.0;
+		this->lateWake = lateWake;
+		glGenQueries(PACER_QUERIES, queries);
+	}
+
+	void destroy()
+	{
+		if (!queries[0])
+			return;
+		glDeleteQueries(PACER_QUERIES, queries);
+		memset(queries, 0, sizeof(queries));
+		while (!fences.empty())
+		{
+			glDeleteSync(fences.front());
+			fences.pop_front();
+		}
+	}
+
+	// Render thread, before the first GL call of the frame
+	void beginFrame()
+	{
+		frameStart = glfwGetTime();
+		// All queries still waiting for the GPU : this frame goes untimed
+		timing = queryHead - queryTail < PACER_QUERIES;
+		if (timing)
+			glBeginQuery(GL_TIME_ELAPSED, queries[queryHead % PACER_QUERIES]);
+	}
+
+	// Render thread, after the swap. `inputTime` is when the input of the frame was polled.
+	void endFrame(double inputTime)
+	{
+		if (timing)
+		{
+			glEndQuery(GL_TIME_ELAPSED);
+			queryHead++;
+		}
+		double now = glfwGetTime();
+		stats.cpu.add(now - frameStart);
+		if (lastPresent.load() > 0.0)
+		{
+			double interval = now - lastPresent.load();
+			stats.interval.add(interval);
+			stats.intervalSquares += interval * interval;
+			int bucket = (int)(interval * 1000.0);
+			stats.histogram[bucket < PACER_BUCKETS ? bucket : PACER_BUCKETS - 1]++;
+			double average = measuredPeriod.load();
+			measuredPeriod = average > 0.0 ? average + (interval - average) * 0.1 : interval;
+		}
+		lastPresent = now;
+
+		// Slowest recent frame from input to present, what the late wake leaves room for
+		work[workHead++ % PACER_WORK_FRAMES] = now - inputTime;
+		double slowest = 0.0;
+		for (int i = 0; i < PACER_WORK_FRAMES; i++)
+			slowest = work[i] > slowest ? work[i] : slowest;
+		predictedWork = slowest;
+
+		// Timer results come back in order
+		while (queryTail < queryHead)
+		{
+			GLuint query = queries[queryTail % PACER_QUERIES];
+			GLint available = 0;
+			glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				break;
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+			// The first frame is setup, and llvmpipe times its query from an unset start
+			if (queryTail)
+			{
+				stats.gpu.add(nanoseconds * 1e-9);
+				latestGpu = nanoseconds * 1e-9;
+				gpuMeasured = true;
+			}
+			queryTail++;
+		}
+
+		if (!maxInFlight)
+			return;
+		fences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+		// Finished frames leave, then the render thread waits while too many are left
+		while (!fences.empty())
+		{
+			bool tooMany = (int)fences.size() > maxInFlight;
+			double waitStart = tooMany ? glfwGetTime() : 0.0;
+			GLenum status = glClientWaitSync(fences.front(), GL_SYNC_FLUSH_COMMANDS_BIT, tooMany ? 1000000000 : 0);
+			if (tooMany)
+				stats.inFlightWait.add(glfwGetTime() - waitStart);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED && !tooMany)
+				break;
+			glDeleteSync(fences.front());
+			fences.pop_front();
+		}
+	}
+
+	// Render thread : the stats since the last call
+	PacerStats takeStats()
+	{
+		PacerStats s = stats;
+		s.sleepSeconds = sleptMicroseconds.exchange(0) * 1e-6;
+		resetStats();
+		return s;
+	}
+
+	// Simulation thread, before polling the input of a frame
+	void waitForInput()
+	{
+		double frame = period > 0.0 ? period : measuredPeriod.load();
+		if (!(period > 0.0 || lateWake) || frame <= 0.0)
+			return;
+		double now = glfwGetTime();
+		double slot;
+		if (period > 0.0)
+		{
+			if (nextSlot == 0.0 || now > nextSlot + period)
+				nextSlot = now;
+			slot = nextSlot;
+			nextSlot += period;
+		}
+		else
+			slot = lastPresent.load();
+		double wake = slot;
+		if (lateWake)
+		{
+			double late = slot + frame - predictedWork.load() - PACER_MARGIN;
+			wake = late > wake ? late : wake;
+		}
+		if (wake - now > frame)
+			wake = now + frame;
+		if (wake <= now)
+			return;
+		std::this_thread::sleep_for(std::chrono::duration<double>(wake - now));
+		sleptMicroseconds += (uint64_t)((glfwGetTime() - now) * 1e6);
+	}
+
+	// Render thread : the GPU time of the latest frame measured since the last call
+	bool newGpuTime(double &seconds)
+	{
+		if (!gpuMeasured)
+			return false;
+		seconds = latestGpu;
+		gpuMeasured = false;
+		return true;
+	}
+
+	int framesInFlight() const { return maxInFlight; }
+	double targetPeriod() const { return period; }
+	bool wakesLate() const { return lateWake; }
+
+private:
+	FramePacer(const FramePacer &);
+	FramePacer &operator=(const FramePacer &);
+
+	void resetStats()
+	{
+		stats.interval.reset();
+		stats.cpu.reset();
+		stats.gpu.reset();
+		stats.inFlightWait.reset();
+		stats.intervalSquares = 0.0;
+		stats.sleepSeconds = 0.0;
+		memset(stats.histogram, 0, sizeof(stats.histogram));
+	}
+
+	int maxInFlight;
+	double period; // of the target fps, 0 without
+	bool lateWake;
+
+	// Render thread
+	GLuint queries[PACER_QUERIES];
+	uint64_t queryHead; // next query to begin
+	uint64_t queryTail; // oldest query not read back
+	bool timing;		// this frame has a query
+	double latestGpu;
+	bool gpuMeasured; // latestGpu not taken yet
+	double frameStart;
+	std::deque<GLsync> fences;
+	double work[PACER_WORK_FRAMES];
+	uint32_t workHead;
+	PacerStats stats;
+
+	// Simulation thread
+	double nextSlot;
+
+	// Written by the render thread, read by the simulation thread
+	std::atomic<double> lastPresent;
+	std::atomic<double> measuredPeriod;
+	std::atomic<double> predictedWork;
+	std::atomic<uint64_t> sleptMicroseconds;
+};
+
+#endif
@@ -0,0 +1,190 @@
+#ifndef PAGEFILE_HPP
+#define PAGEFILE_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#ifndef _WIN32
+#include <sys/types.h>
+#endif
+
+#include "image.hpp"
+
+// Tiled on-disk format of the virtual textures (vtexture.hpp).
+// A square power of two texture and its mip levels down to a single page,
+// cut into pages of PAGE_SIZE x PAGE_SIZE texels. Each page is stored with a
+// border of PAGE_BORDER texels copied from its neighbours (clamped at the
+// edges of the texture), so a bilinear lookup near its edge needs no other
+// page. Every page has the same size, so any page is one seek away.
+//
+//   PageFileHeader
+//   pages : level 0 first, in each level rows of pages bottom up, each
+//           PAGE_SLOT x PAGE_SLOT RGBA8 texels, rows bottom up
+//
+// tools/pagefile_build writes them.
+
+#define PAGEFILE_MAGIC 0x58455456 // "VTEX"
+#define PAGEFILE_VERSION 1
+#define PAGE_SIZE 128 // texels of a page side, borders aside, also in the shaders of vtexture.hpp
+#define PAGE_BORDER 1 // texels on each side, also in the shaders
+#define PAGE_SLOT (PAGE_SIZE + 2 * PAGE_BORDER)
+#define PAGE_BYTES (PAGE_SLOT * PAGE_SLOT * 4)
+
+// Page files of the largest textures reach about 6 GB : fseek takes a long, 32 bits
+// on Windows, so seeks go through the 64-bit variants. 32-bit POSIX builds
+// need -D_FILE_OFFSET_BITS=64 for a 64-bit off_t, else far pages fail to read.
+inline bool seekPageFile(FILE *file, uint64_t offset)
+{
+#ifdef _WIN32
+	return !_fseeki64(file, (__int64)offset, SEEK_SET);
+#else
+	if ((uint64_t)(off_t)offset != offset)
+		return false;
+	return !fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
+
+struct PageFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size; // texels of a side at level 0
+	uint32_t levels;
+	uint32_t pageSize;
+	uint32_t border;
+};
+
+// Pages of a side at `level`
+inline uint32_t pagesPerSide(uint32_t size, uint32_t level)
+{
+	uint32_t pages = (size >> level) / PAGE_SIZE;
+	return pages ? pages : 1;
+}
+
+// Levels down to a single page
+inline uint32_t pageLevels(uint32_t size)
+{
+	uint32_t levels = 1;
+	while ((size >> (levels - 1)) > PAGE_SIZE)
+		levels++;
+	return levels;
+}
+
+// Pages of every level
+inline uint32_t pageCount(uint32_t size)
+{
+	uint32_t count = 0;
+	for (uint32_t level = 0; level < pageLevels(size); level++)
+		count += pagesPerSide(size, level) * pagesPerSide(size, level);
+	return count;
+}
+
+// Copies page (x, y) of `image` and its borders into `slot`, PAGE_SLOT x PAGE_SLOT texels
+inline void extractPage(const TextureImage &image, int x, int y, uint32_t *slot)
+{
+	for (int j = 0; j < PAGE_SLOT; j++)
+		for (int i = 0; i < PAGE_SLOT; i++)
+		{
+			int u = std::min(std::max(x * PAGE_SIZE + i - PAGE_BORDER, 0), image.width - 1);
+			int v = std::min(std::max(y * PAGE_SIZE + j - PAGE_BORDER, 0), image.height - 1);
+			slot[j * PAGE_SLOT + i] = image.at(u, v);
+		}
+}
+
+// Writes `image` and its mip levels. Its side must be a power of two, PAGE_SIZE or more.
+inline bool writePageFile(const char *path, const TextureImage &image)
+{
+	if (image.width != image.height || image.width < PAGE_SIZE || (image.width & (image.width - 1)))
+	{
+		fprintf(stderr, "Page file : %dx%d is not a square power of two of %d texels or more\n", image.width, image.height, PAGE_SIZE);
+		return false;
+	}
+	FILE *file = fopen(path, "wb");
+	if (!file)
+	{
+		fprintf(stderr, "Could not write %s\n", path);
+		return false;
+	}
+	PageFileHeader header = {PAGEFILE_MAGIC, PAGEFILE_VERSION, (uint32_t)image.width, pageLevels(image.width), PAGE_SIZE, PAGE_BORDER};
+	fwrite(&header, sizeof(header), 1, file);
+	std::vector<uint32_t> slot(PAGE_SLOT * PAGE_SLOT);
+	TextureImage level = image;
+	for (uint32_t l = 0; l < header.levels; l++)
+	{
+		uint32_t pages = pagesPerSide(header.size, l);
+		for (uint32_t y = 0; y < pages; y++)
+			for (uint32_t x = 0; x < pages; x++)
+			{
+				extractPage(level, x, y, slot.data());
+				fwrite(slot.data(), PAGE_BYTES, 1, file);
+			}
+		if (l + 1 < header.levels)
+			level = downsampleImage(level);
+	}
+	bool written = !ferror(file);
+	fclose(file);
+	if (!written)
+		fprintf(stderr, "Could not write %s\n", path);
+	return written;
+}
+
+// Reads pages one at a time, from one thread
+class PageFile
+{
+public:
+	PageFile() : file(NULL) { memset(&header, 0, sizeof(header)); }
+	~PageFile() { close(); }
+
+	bool open(const char *path)
+	{
+		file = fopen(path, "rb");
+		if (!file)
+		{
+			fprintf(stderr, "Could not open %s\n", path);
+			return false;
+		}
+		if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != PAGEFILE_MAGIC || header.version != PAGEFILE_VERSION ||
+			header.pageSize != PAGE_SIZE || header.border != PAGE_BORDER || header.levels != pageLevels(header.size))
+		{
+			fprintf(stderr, "%s : not a page file of %d texel pages\n", path, PAGE_SIZE);
+			close();
+			return false;
+		}
+		levelFirst.resize(header.levels);
+		uint64_t first = 0;
+		for (uint32_t l = 0; l < header.levels; l++)
+		{
+			levelFirst[l] = first;
+			first += pagesPerSide(header.size, l) * pagesPerSide(header.size, l);
+		}
+		return true;
+	}
+
+	void close()
+	{
+		if (file)
+			fclose(file);
+		file = NULL;
+	}
+
+	// PAGE_SLOT x PAGE_SLOT texels of page (x, y) of `level`
+	bool read(uint32_t level, uint32_t x, uint32_t y, uint32_t *slot)
+	{
+		uint64_t page = levelFirst[level] + (uint64_t)y * pagesPerSide(header.size, level) + x;
+		return seekPageFile(file, sizeof(PageFileHeader) + page * PAGE_BYTES) && fread(slot, PAGE_BYTES, 1, file) == 1;
+	}
+
+	uint32_t size() const { return header.size; }
+	uint32_t levels() const { return header.levels; }
+
+private:
+	PageFile(const PageFile &);
+	PageFile &operator=(const PageFile &);
+
+	FILE *file;
+	PageFileHeader header;
+	std::vector<uint64_t> levelFirst; // page index of the first page of each level
+};
+
+#endif
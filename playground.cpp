@@ -1,6 +1,10 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <vector>
+#include <thread>
+#include <atomic>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
@@ -9,12 +13,209 @@
 #include <common/objloader.hpp>
 #include <common/texture.hpp>
 
+// First : with -DGLTRACE it reroutes the GL calls of the headers below
+#include "gltrace.hpp"
+#include "entities.hpp"
+#include "renderthread.hpp"
+#include "jobs.hpp"
+#include "drawlist.hpp"
+#include "resources.hpp"
+#include "meshbank.hpp"
+#include "indirect.hpp"
+#include "gpucull.hpp"
+#include "meshlets.hpp"
+#include "capture.hpp"
+#include "simclock.hpp"
+#include "pacer.hpp"
+#include "dynres.hpp"
+#include "lighting.hpp"
+#include "deferred.hpp"
+#include "prepass.hpp"
+#include "atlas.hpp"
+#include "shadows.hpp"
+#include "vtexture.hpp"
+#include "materials.hpp"
+
 using namespace glm;
 
-int main(void)
+// Attribute 0 : positions, 1 : colors, 2 : normals, as laid out in the shaders
+static void bindMesh(const GpuResources &resources, const GpuMesh &mesh)
+{
+	BufferId streams[3] = {mesh.positions, mesh.colors, mesh.normals};
+	for (GLuint attribute = 0; attribute < 3; attribute++)
+	{
+		glEnableVertexAttribArray(attribute);
+		glBindBuffer(GL_ARRAY_BUFFER, resources.buffer(streams[attribute]));
+		glVertexAttribPointer(
+			attribute, // attribute index
+			3,		   // size
+			GL_FLOAT,  // type
+			GL_FALSE,  // normalized?
+			0,		   // stride
+			(void *)0  // array buffer offset
+		);
+	}
+}
+
+int main(int argc, char **argv)
 {
 	GLFWwindow *window;
 
+	// How many frames the simulation may run ahead of the render thread
+	int latency = 1;
+	// Worker threads of the job system, 0 for one per core
+	int threadCount = 0;
+	// Number of cubes in the scene
+	int cubeCount = 1;
+	// Submission : one glDrawArrays per object, or multi-draw indirect when supported
+	bool submitIndirect = true;
+	// Culling and animation in a compute shader instead of on the job system
+	bool gpuCulling = false;
+	// OBJ file drawn instead of the cube
+	const char *meshPath = NULL;
+	// Split the mesh into meshlets, culled one by one on the indirect path
+	bool useMeshlets = true;
+	// Every frame read back and written as <prefix>NNNNNN.png, or another format of capture.hpp
+	const char *capturePrefix = NULL;
+	CaptureFormat captureFormat = CAPTURE_PNG;
+	// Encoder process of the pipe format, ffmpeg by default
+	const char *captureCommand = NULL;
+	// GL calls recorded into a trace for tools/gltrace_replay, needs a -DGLTRACE build
+	const char *tracePath = NULL;
+	unsigned traceFirst = 60, traceCount = 120;
+	// Simulation steps per simulated second
+	double stepRate = 60.0;
+	// Steps per frame whatever the real time, without vsync : 0 to follow real time
+	int offlineSteps = 0;
+	// Swap interval, -1 to keep the driver's
+	int vsync = -1;
+	// Frames started on a fixed schedule, 0 for as soon as possible
+	double targetFps = 0.0;
+	// Unfinished frames the GPU may queue before the render thread waits, 0 to leave it to the driver
+	int framesInFlight = 2;
+	// Input polled as late as the frame allows
+	bool lateWake = false;
+	// GPU milliseconds per frame held by scaling the resolution down, 0 to draw at the window size
+	double resolutionBudget = 0.0;
+	UpscaleFilter upscaleFilter = UPSCALE_BILINEAR;
+	float minResolutionScale = 0.5f;
+	// Point lights shaded through clustered light lists, the first one is the single light of the shaders.
+	// 0 keeps that light alone as a uniform.
+	int lightCount = 0;
+	// Lights shaded per pixel from a G-buffer instead of per fragment, with at least the single light
+	bool deferredShading = false;
+	// Shadows of the point light (cube map) and of a sun (cascades) over a floor, the static ones kept between frames
+	bool shadows = false;
+	bool shadowCache = true;
+	// Cubes that do not spin, static shadow casters
+	int staticCubes = 0;
+	// Depth only pass before the shading one, which then shades each pixel once (multi-draw paths)
+	bool depthPrepass = false;
+	// Fragments added up in grey instead of shaded, white where 8 or more land on a pixel
+	bool overdraw = false;
+	// Draws of a program sorted back to front instead of front to back
+	bool backToFront = false;
+	// Images spread over the cubes, as separate textures, packed in an atlas or in the layers of an array texture
+	int textureCount = 0;
+	TexturePacking texturePacking = TEXTURES_SEPARATE;
+	// Page file (tools/pagefile_build) streamed into a cache of pageCacheSide^2 pages, each cube drawing a region of it
+	const char *virtualTexturePath = NULL;
+	int pageCacheSide = 16;
+	// Materials of their own tint and specular spread over the cubes, read from one table by the multi-draw paths
+	int materialCount = 0;
+	// Frames drawn before quitting, 0 to run until Escape. With --offline, a given frame is the same on every run.
+	int frameLimit = 0;
+	// The window is never shown, its frames are still drawn and captured
+	bool hiddenWindow = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--latency") && i + 1 < argc)
+			latency = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+			threadCount = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--cubes") && i + 1 < argc)
+			cubeCount = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--submit") && i + 1 < argc)
+			submitIndirect = strcmp(argv[++i], "loop") != 0;
+		else if (!strcmp(argv[i], "--cull") && i + 1 < argc)
+			gpuCulling = !strcmp(argv[++i], "gpu");
+		else if (!strcmp(argv[i], "--mesh") && i + 1 < argc)
+			meshPath = argv[++i];
+		else if (!strcmp(argv[i], "--meshlets") && i + 1 < argc)
+			useMeshlets = strcmp(argv[++i], "off") != 0;
+		else if (!strcmp(argv[i], "--capture") && i + 1 < argc)
+			capturePrefix = argv[++i];
+		else if (!strcmp(argv[i], "--capture-format") && i + 1 < argc)
+		{
+			const char *name = argv[++i];
+			for (int f = CAPTURE_PNG; f <= CAPTURE_PIPE; f++)
+				if (!strcmp(name, g_capture_format_names[f]))
+					captureFormat = (CaptureFormat)f;
+		}
+		else if (!strcmp(argv[i], "--capture-command") && i + 1 < argc)
+		{
+			captureCommand = argv[++i];
+			captureFormat = CAPTURE_PIPE;
+		}
+		else if (!strcmp(argv[i], "--trace") && i + 1 < argc)
+			tracePath = argv[++i];
+		else if (!strcmp(argv[i], "--trace-frames") && i + 1 < argc)
+			sscanf(argv[++i], "%u:%u", &traceFirst, &traceCount);
+		else if (!strcmp(argv[i], "--step-rate") && i + 1 < argc)
+			stepRate = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--offline") && i + 1 < argc)
+			offlineSteps = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--vsync") && i + 1 < argc)
+			vsync = strcmp(argv[++i], "off") != 0;
+		else if (!strcmp(argv[i], "--fps") && i + 1 < argc)
+			targetFps = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--frames-in-flight") && i + 1 < argc)
+			framesInFlight = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--late-wake") && i + 1 < argc)
+			lateWake = strcmp(argv[++i], "off") != 0;
+		else if (!strcmp(argv[i], "--dynamic-resolution") && i + 1 < argc)
+			resolutionBudget = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--upscale") && i + 1 < argc)
+			upscaleFilter = strcmp(argv[++i], "sharpen") ? UPSCALE_BILINEAR : UPSCALE_SHARPEN;
+		else if (!strcmp(argv[i], "--min-scale") && i + 1 < argc)
+			minResolutionScale = (float)atof(argv[++i]);
+		else if (!strcmp(argv[i], "--lights") && i + 1 < argc)
+			lightCount = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--shading") && i + 1 < argc)
+			deferredShading = !strcmp(argv[++i], "deferred");
+		else if (!strcmp(argv[i], "--shadows") && i + 1 < argc)
+			shadows = strcmp(argv[++i], "off") != 0;
+		else if (!strcmp(argv[i], "--shadow-cache") && i + 1 < argc)
+			shadowCache = strcmp(argv[++i], "off") != 0;
+		else if (!strcmp(argv[i], "--static") && i + 1 < argc)
+			staticCubes = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--prepass") && i + 1 < argc)
+			depthPrepass = strcmp(argv[++i], "off") != 0;
+		else if (!strcmp(argv[i], "--overdraw") && i + 1 < argc)
+			overdraw = strcmp(argv[++i], "off") != 0;
+		else if (!strcmp(argv[i], "--order") && i + 1 < argc)
+			backToFront = !strcmp(argv[++i], "back");
+		else if (!strcmp(argv[i], "--textures") && i + 1 < argc)
+			textureCount = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--texture-packing") && i + 1 < argc)
+		{
+			const char *name = argv[++i];
+			for (int p = TEXTURES_SEPARATE; p <= TEXTURES_ARRAY; p++)
+				if (!strcmp(name, g_texture_packing_names[p]))
+					texturePacking = (TexturePacking)p;
+		}
+		else if (!strcmp(argv[i], "--virtual-texture") && i + 1 < argc)
+			virtualTexturePath = argv[++i];
+		else if (!strcmp(argv[i], "--page-cache") && i + 1 < argc)
+			pageCacheSide = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--materials") && i + 1 < argc)
+			materialCount = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+			frameLimit = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--window") && i + 1 < argc)
+			hiddenWindow = !strcmp(argv[++i], "hidden");
+	}
+
 	// Initialise GLFW
 	if (!glfwInit())
 	{
@@ -29,6 +230,8 @@ int main(void)
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make MacOS happy; should not be needed
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	if (hiddenWindow)
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
 	// Open a window and create its OpenGL context
 	window = glfwCreateWindow(1024, 768, "Playground", NULL, NULL);
@@ -51,11 +254,24 @@ int main(void)
 		return -1;
 	}
 
+	// Recorded from here, the frames before the range build the state it draws with
+	if (tracePath)
+		glTraceOpen(tracePath, 1024, 768, traceFirst, traceCount);
+
+	// Offline runs go as fast as they can
+	if (offlineSteps > 0)
+		glfwSwapInterval(0);
+	else if (vsync >= 0)
+		glfwSwapInterval(vsync);
+
 	// Ensure we can capture the escape key being pressed below
 	glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
 
-	// Dark blue background
-	glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
+	// Dark blue background, black under the overdraw
+	if (overdraw)
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	else
+		glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
 
 	GLuint VertexArrayID;
 	glGenVertexArrays(1, &VertexArrayID);
@@ -63,6 +279,8 @@ int main(void)
 
 	//Pas de step9 donc on utilise le step8
 	GLuint programID = LoadShaders("playground_steps/step8/StandardShading.vertexshader", "playground_steps/step8/StandardShading.fragmentshader");
+	// Built by common/shader.cpp, out of the trace's sight
+	glTraceAdoptProgram(programID, "playground_steps/step8/StandardShading.vertexshader", "playground_steps/step8/StandardShading.fragmentshader");
 
 	// Vertex data for a cube
 	static const GLfloat g_vertex_buffer_data[] = {
@@ -215,26 +433,274 @@ int main(void)
 		1.0f, -1.0f, -1.8f,
 		-1.0f, -1.0f, -1.8f};
 
-	GLuint normalbuffer;
-	GLuint vertexbuffer;
-	GLuint colorbuffer;
+	// GL objects are owned by the resource pools, the scene only keeps handles
+	GpuResources resources;
+	ProgramId program = resources.adoptProgram(programID);
 
 	GLuint MatrixID = glGetUniformLocation(programID, "MVP");
 	GLuint ViewMatrixID = glGetUniformLocation(programID, "V");
 	GLuint ModelMatrixID = glGetUniformLocation(programID, "M");
 	
-	glGenBuffers(1, &normalbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(g_normal_buffer_data),
-				 g_normal_buffer_data, GL_STATIC_DRAW);
+	// The cube, or a mesh loaded from an OBJ file, in one color
+	std::vector<glm::vec3> meshPositions, meshColors, meshNormals;
+	glm::vec3 boundsCenter(0.0f, 0.0f, -0.8f);
+	float boundsRadius = 1.7321f;
+	float meshScale = 1.0f;
+	std::vector<glm::vec2> meshUVs;
+	if (meshPath && loadOBJ(meshPath, meshPositions, meshUVs, meshNormals) && !meshPositions.empty())
+	{
+		meshColors.assign(meshPositions.size(), glm::vec3(0.7f, 0.7f, 0.7f));
+		glm::vec3 low = meshPositions[0], high = low;
+		for (size_t i = 1; i < meshPositions.size(); i++)
+		{
+			low = glm::min(low, meshPositions[i]);
+			high = glm::max(high, meshPositions[i]);
+		}
+		boundsCenter = 0.5f * (low + high);
+		boundsRadius = 0.5f * glm::length(high - low);
+		// Scaled to the size of the cube, so it fits the grid
+		meshScale = 1.7321f / boundsRadius;
+	}
+	else
+	{
+		if (meshPath)
+			fprintf(stderr, "Could not load %s, drawing cubes\n", meshPath);
+		const uint32_t cubeVertexCount = sizeof(g_vertex_buffer_data) / sizeof(g_vertex_buffer_data[0]) / 3;
+		meshPositions.assign((const glm::vec3 *)g_vertex_buffer_data, (const glm::vec3 *)g_vertex_buffer_data + cubeVertexCount);
+		meshColors.assign((const glm::vec3 *)g_color_buffer_data, (const glm::vec3 *)g_color_buffer_data + cubeVertexCount);
+		meshNormals.assign((const glm::vec3 *)g_normal_buffer_data, (const glm::vec3 *)g_normal_buffer_data + cubeVertexCount);
+	}
+	const uint32_t cubeVertexCount = (uint32_t)meshPositions.size();
+	const GLsizeiptr streamBytes = cubeVertexCount * sizeof(glm::vec3);
+
+	// Every mesh also goes to the shared buffers of the multi-draw path, split into meshlets before the upload
+	MeshBank meshBank;
+	MeshletSet meshlets;
+	MeshRange cubeRange = meshBank.add(&meshPositions[0].x, &meshColors[0].x, &meshNormals[0].x, cubeVertexCount);
+	MeshletRange cubeMeshlets;
+	if (useMeshlets)
+	{
+		cubeMeshlets = meshlets.build(meshBank, cubeRange);
+		double meshletVertices = 0.0;
+		for (uint32_t m = 0; m < cubeMeshlets.count; m++)
+			meshletVertices += meshlets[cubeMeshlets.first + m].vertexCount;
+		printf("%u triangles in %u meshlets, %.1f triangles and %.1f vertices each on average\n", cubeRange.indexCount / 3,
+			   cubeMeshlets.count, cubeRange.indexCount / 3.0 / cubeMeshlets.count, meshletVertices / cubeMeshlets.count);
+	}
+	// Floor under the grid for the shadows : the cube of step8 flattened, with face normals
+	std::vector<glm::vec3> floorPositions, floorColors, floorNormals;
+	int gridSide = 1;
+	while (gridSide * gridSide * gridSide < cubeCount)
+		gridSide++;
+	float floorExtent = 1.5f * gridSide + 3.0f;
+	MeshRange floorRange;
+	MeshletRange floorMeshlets;
+	if (shadows)
+	{
+		const uint32_t floorVertexCount = sizeof(g_vertex_buffer_data) / sizeof(g_vertex_buffer_data[0]) / 3;
+		for (uint32_t v = 0; v < floorVertexCount; v++)
+		{
+			const GLfloat *p = g_vertex_buffer_data + 3 * v;
+			floorPositions.push_back(glm::vec3(p[0] * floorExtent, (p[1] - 1.0f) * 0.25f, (p[2] + 0.8f) * floorExtent));
+			floorColors.push_back(glm::vec3(0.4f, 0.4f, 0.4f));
+		}
+		for (uint32_t v = 0; v < floorVertexCount; v += 3)
+		{
+			glm::vec3 normal = glm::normalize(glm::cross(floorPositions[v + 1] - floorPositions[v], floorPositions[v + 2] - floorPositions[v]));
+			// Outwards from the center of the slab
+			if (glm::dot(normal, floorPositions[v] + floorPositions[v + 1] + floorPositions[v + 2] - glm::vec3(0.0f, -0.75f, 0.0f)) < 0.0f)
+				normal = -normal;
+			floorNormals.insert(floorNormals.end(), 3, normal);
+		}
+		floorRange = meshBank.add(&floorPositions[0].x, &floorColors[0].x, &floorNormals[0].x, floorVertexCount);
+		if (useMeshlets)
+			floorMeshlets = meshlets.build(meshBank, floorRange);
+	}
+	meshBank.upload(resources);
+	glBindVertexArray(VertexArrayID);
 
-	glGenBuffers(1, &vertexbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
+	MeshId cubeMesh = resources.createMesh(
+		resources.createBuffer(GL_ARRAY_BUFFER, streamBytes, meshPositions.data(), GL_STATIC_DRAW),
+		resources.createBuffer(GL_ARRAY_BUFFER, streamBytes, meshColors.data(), GL_STATIC_DRAW),
+		resources.createBuffer(GL_ARRAY_BUFFER, streamBytes, meshNormals.data(), GL_STATIC_DRAW),
+		cubeVertexCount, cubeRange, cubeMeshlets);
+	MeshId floorMesh;
+	if (shadows)
+	{
+		const GLsizeiptr floorBytes = floorPositions.size() * sizeof(glm::vec3);
+		floorMesh = resources.createMesh(resources.createBuffer(GL_ARRAY_BUFFER, floorBytes, floorPositions.data(), GL_STATIC_DRAW),
+										 resources.createBuffer(GL_ARRAY_BUFFER, floorBytes, floorColors.data(), GL_STATIC_DRAW),
+										 resources.createBuffer(GL_ARRAY_BUFFER, floorBytes, floorNormals.data(), GL_STATIC_DRAW),
+										 (uint32_t)floorPositions.size(), floorRange, floorMeshlets);
+	}
 
-	glGenBuffers(1, &colorbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, colorbuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(g_color_buffer_data), g_color_buffer_data, GL_STATIC_DRAW);
+	// Before the multi-draw programs, which pick their fragment shader from it
+	ClusteredLighting lighting;
+	if (deferredShading && lightCount < 1)
+		lightCount = 1;
+	if (lightCount > 0 && !(ClusteredLighting::supported() && (submitIndirect || gpuCulling) && lighting.create(lightCount)))
+	{
+		fprintf(stderr, "Clustered lighting needs GL 4.3 and the multi-draw path, shading with the single light\n");
+		lightCount = 0;
+	}
+	int sceneWidth, sceneHeight;
+	glfwGetFramebufferSize(window, &sceneWidth, &sceneHeight);
+	DeferredRenderer deferredRenderer;
+	if (deferredShading && overdraw)
+	{
+		fprintf(stderr, "The overdraw view counts the fragments of forward shading, shading forward\n");
+		deferredShading = false;
+	}
+	if (deferredShading && !(lightCount > 0 && DeferredRenderer::supported() && deferredRenderer.create(sceneWidth, sceneHeight)))
+	{
+		fprintf(stderr, "Deferred shading needs GL 4.3 and the lights of the multi-draw path, shading forward\n");
+		deferredShading = false;
+	}
+	// The floor is one more caster
+	ShadowRenderer shadowRenderer;
+	if (shadows && !(ShadowRenderer::supported() && submitIndirect && !gpuCulling && lightCount == 0 &&
+					 shadowRenderer.create(cubeCount + 1, shadowCache)))
+	{
+		fprintf(stderr, "Shadows need GL 4.3, the multi-draw path with CPU culling and the single light, drawing without\n");
+		shadows = false;
+	}
+	// A checker per image, each of its own hue and square count
+	std::vector<TextureId> cubeTextures;
+	TextureId packedTexture;
+	GLenum textureTarget = GL_TEXTURE_2D;
+	// Entry 0 is the default material, then the images and the materials of --materials
+	MaterialTable materialTable;
+	std::vector<uint32_t> imageMaterials; // entry of each image
+	if (textureCount > 0 && !(submitIndirect && !gpuCulling && lightCount == 0 && !shadows && !deferredShading))
+	{
+		fprintf(stderr, "Textures need the multi-draw path with CPU culling and the single light, drawing untextured\n");
+		textureCount = 0;
+	}
+	// Checked again once the multi-draw path and GPU culling are set up, which may fall back
+	auto materialsFit = [&]() {
+		return (submitIndirect || gpuCulling) && lightCount == 0 && !shadows && !deferredShading && !virtualTexturePath;
+	};
+	auto dropMaterials = [&]() {
+		fprintf(stderr, "Materials need the multi-draw path, the single light and no virtual texture, drawing with the vertex colors\n");
+		materialCount = 0;
+	};
+	if (materialCount > 0 && !materialsFit())
+		dropMaterials();
+	if (materialCount > 0 && textureCount > 0 && texturePacking != TEXTURES_ARRAY)
+	{
+		fprintf(stderr, "Materials sample array textures, packing the images as an array\n");
+		texturePacking = TEXTURES_ARRAY;
+	}
+	if (textureCount > 0)
+	{
+		std::vector<TextureImage> images;
+		for (int t = 0; t < textureCount; t++)
+		{
+			float hue = 6.0f * t / textureCount;
+			float rgb[3] = {fabsf(hue - 3.0f) - 1.0f, 2.0f - fabsf(hue - 2.0f), 2.0f - fabsf(hue - 4.0f)};
+			uint32_t color = 0xff000000;
+			for (int c = 0; c < 3; c++)
+				color |= (uint32_t)(255.0f * std::min(std::max(rgb[c], 0.0f), 1.0f)) << (8 * c);
+			images.push_back(checkerImage(128, 2 + t % 7, color, 0xffe0e0e0));
+		}
+		GLint maxSize = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+		TextureAtlas atlas;
+		for (int t = 0; texturePacking == TEXTURES_ATLAS && t < textureCount; t++)
+			atlas.add(images[t]);
+		if (texturePacking == TEXTURES_ATLAS && atlas.build(maxSize))
+		{
+			packedTexture = atlas.upload(resources);
+			for (int t = 0; t < textureCount; t++)
+				imageMaterials.push_back(materialTable.addTexture(atlas.region(t)));
+			printf("%d images in a %dx%d atlas, %.1f%% of it, %d clean mip levels\n", textureCount, atlas.atlasWidth(), atlas.atlasHeight(),
+				   100.0 * atlas.occupancy(), ATLAS_LEVELS);
+		}
+		else if (texturePacking == TEXTURES_ARRAY)
+		{
+			TextureArray layers;
+			for (int t = 0; t < textureCount; t++)
+			{
+				layers.add(images[t]);
+				imageMaterials.push_back(materialTable.addTexture(glm::vec4((float)t, 0.0f, 0.0f, 0.0f)));
+			}
+			packedTexture = layers.upload(resources);
+			textureTarget = GL_TEXTURE_2D_ARRAY;
+		}
+		else
+		{
+			texturePacking = TEXTURES_SEPARATE;
+			for (int t = 0; t < textureCount; t++)
+			{
+				cubeTextures.push_back(uploadImage(resources, images[t]));
+				imageMaterials.push_back(0);
+			}
+		}
+	}
+	// The cubes share the virtual texture, a cell of a grid each
+	// Checked again once the multi-draw path is set up, which may fall back
+	VirtualTexture virtualTexture;
+	auto virtualTextureFits = [&]() {
+		return submitIndirect && !gpuCulling && lightCount == 0 && !shadows && !deferredShading && textureCount == 0;
+	};
+	auto dropVirtualTexture = [&]() {
+		fprintf(stderr, "The virtual texture needs GL 4.3, the multi-draw path with CPU culling, the single light and no other textures, "
+						"drawing without\n");
+		virtualTexture.destroy();
+		virtualTexturePath = NULL;
+	};
+	if (virtualTexturePath && !(virtualTextureFits() && VirtualTexture::supported() &&
+								virtualTexture.create(virtualTexturePath, pageCacheSide, sceneWidth, sceneHeight)))
+		dropVirtualTexture();
+	if (virtualTexturePath)
+	{
+		int cells = (int)ceilf(sqrtf((float)cubeCount));
+		for (int i = 0; i < cubeCount; i++)
+			imageMaterials.push_back(materialTable.addTexture(glm::vec4((float)(i % cells), (float)(i / cells), 1.0f, 1.0f) / (float)cells));
+	}
+	// A tint around the color wheel, specular from dull to sharp, and a layer of the images when there are some
+	std::vector<uint32_t> cubeMaterials;
+	for (int m = 0; m < materialCount; m++)
+	{
+		float angle = 6.2832f * m / materialCount;
+		MaterialData material;
+		material.diffuse = glm::vec4(0.6f + 0.4f * cosf(angle), 0.6f + 0.4f * cosf(angle - 2.0944f), 0.6f + 0.4f * cosf(angle + 2.0944f),
+									 textureCount > 0 ? 1.0f : 0.0f);
+		material.specular = glm::vec4(glm::vec3(0.1f + 0.2f * (m % 4)), 2.0f + 6.0f * (m % 5));
+		material.texture = glm::vec4(textureCount > 0 ? (float)(m % textureCount) : 0.0f, 0.0f, 1.0f, 1.0f);
+		cubeMaterials.push_back(materialTable.add(material));
+	}
+	const char *fragmentShader = lightCount > 0 ? g_clustered_fragment_shader : g_standard_fragment_shader;
+	if (textureCount > 0)
+		fragmentShader = texturePacking == TEXTURES_ARRAY ? g_layered_fragment_shader : g_textured_fragment_shader;
+	if (virtualTexturePath)
+		fragmentShader = g_virtual_fragment_shader;
+	if (materialCount > 0)
+		fragmentShader = g_material_fragment_shader;
+	if (deferredShading)
+		fragmentShader = g_gbuffer_fragment_shader;
+	if (shadows)
+		fragmentShader = g_shadowed_fragment_shader;
+	if (overdraw)
+		fragmentShader = g_overdraw_fragment_shader;
+
+	// Visible meshlets are separated by culled ones, so an object needs at most half as many ranges
+	IndirectRenderer indirect;
+	int objectCount = cubeCount + (shadows ? 1 : 0);
+	uint32_t rangeCount = cubeCount * ((cubeMeshlets.count + 1) / 2) + (floorMeshlets.count + 1) / 2;
+	if (submitIndirect && !(IndirectRenderer::supported() && indirect.create(objectCount, rangeCount, fragmentShader)))
+	{
+		fprintf(stderr, "Multi-draw indirect needs GL 4.3 and ARB_shader_draw_parameters, drawing objects one by one\n");
+		submitIndirect = false;
+	}
+	if (shadows && !submitIndirect)
+	{
+		fprintf(stderr, "Shadows need GL 4.3, the multi-draw path with CPU culling and the single light, drawing without\n");
+		shadowRenderer.destroy();
+		shadows = false;
+	}
+	if (virtualTexturePath && !virtualTextureFits())
+		dropVirtualTexture();
 
 	// Projection matrix : 45 degrees Field of View, 4:3 ratio, display range : 0.1 unit <-> 100 units
 	glm::mat4 Projection = glm::perspective(45.0f, 4.0f / 3.0f, 0.1f, 100.0f);
@@ -250,108 +716,640 @@ int main(void)
 	glUseProgram(programID);
 	GLuint LightID = glGetUniformLocation(programID, "LightPosition_worldspace");
 
-	glm::mat4 Model1 = glm::mat4(1.0f);
-	glm::mat4 MVP;
-
-	float deltaTime = 0.0f;
-	float lastFrame = 0.0f;
-	float angle = 0.0f;
-
+	// Animation advances by fixed steps, rendering interpolates between the last two
+	SimulationClock simClock(1.0 / (stepRate > 0.0 ? stepRate : 60.0));
+	if (offlineSteps > 0)
+		simClock.setOffline(offlineSteps);
 
 	glm::vec3 lightPos = glm::vec3(4, 4, 1);
 	glUniform3f(LightID, lightPos.x, lightPos.y, lightPos.z);
 
-
-
-	do
+	// Scene : every renderable object is an entity of the store
+	const uint32_t renderable = COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_MESH) | COMPONENT_BIT(COMPONENT_MATERIAL);
+	EntityStore scene;
+	for (int i = 0; i < cubeCount; i++)
 	{
-		// Clear the screen
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		float currentFrame = glfwGetTime();
-		deltaTime = currentFrame - lastFrame;
-		lastFrame = currentFrame;
-		angle += 3.14159f / 2.0f * deltaTime;
-		float c = (float)cos(angle);
-		float s = (float)sin(angle);
-		Model1 = {c, 0.0f, s, 0.0f,
-				 0.0f, 1.0f, 0.0f, 0.0f,
-				 -s, 0.0f, c, 0.0f,
-				 0.0f, 0.0f, 0.0f, 1.0f};
-		// Model = glm::translate(Model, glm::vec3(0.0f, 0.001f, 0.0f));
-		// Model = glm::scale(Model, glm::vec3(1.001f, 1.001f, 1.0f));
-		// Model = glm::rotate(Model, glm::radians(1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-
-		// Use our shader
-		glUseProgram(programID);
-
-
-		// 1rst attribute buffer: vertices
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-		glVertexAttribPointer(
-			0,		  // attribute 0.
-			3,		  // size
-			GL_FLOAT, // type
-			GL_FALSE, // normalized?
-			0,		  // stride
-			(void *)0 // array buffer offset
-		);
-		
-		// 2nd attribute buffer : colors
-		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, colorbuffer);
-
-		glVertexAttribPointer(
-			1, // attribute 1.
-			// No particular reason for 1, but must match the layout in the shader.
-			3,		  // size
-			GL_FLOAT, // type
-			GL_FALSE, // normalized?
-			0,		  // stride
-			(void *)0 // array buffer offset
-		);
-
-		// 3rd attribute buffer : normals
-		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-		glVertexAttribPointer(
-			2,		  // attribute 2.
-			3,		  // size
-			GL_FLOAT, // type
-			GL_FALSE, // normalized?
-			0,		  // stride
-			(void *)0 // array buffer offset
-		);
+		bool spins = i >= staticCubes;
+		Entity cube = scene.create(renderable | COMPONENT_BIT(COMPONENT_BOUNDS) | (spins ? COMPONENT_BIT(COMPONENT_ANIMATION) : 0));
+		// Grid centered on the origin, a single cube stays at the origin
+		int x = i % gridSide, y = (i / gridSide) % gridSide, z = i / (gridSide * gridSide);
+		scene.get<Transform>(cube)->position = 3.0f * glm::vec3(x - gridSide / 2, y - gridSide / 2, z - gridSide / 2);
+		scene.get<MeshHandle>(cube)->id = cubeMesh.value;
+		scene.get<MeshHandle>(cube)->vertexCount = resources.mesh(cubeMesh)->vertexCount;
+		scene.get<MaterialHandle>(cube)->id = program.value;
+		if (textureCount > 0)
+		{
+			scene.get<MaterialHandle>(cube)->texture = texturePacking == TEXTURES_SEPARATE ? cubeTextures[i % textureCount].value : packedTexture.value;
+			scene.get<MaterialHandle>(cube)->material = imageMaterials[i % textureCount];
+		}
+		else if (virtualTexturePath)
+			scene.get<MaterialHandle>(cube)->material = imageMaterials[i];
+		if (materialCount > 0)
+			scene.get<MaterialHandle>(cube)->material = cubeMaterials[i % materialCount];
+		scene.get<Transform>(cube)->scale = meshScale;
+		scene.get<Bounds>(cube)->center = boundsCenter;
+		scene.get<Bounds>(cube)->radius = boundsRadius;
+		// Same spin as the hand written matrix of step8 : a quarter turn per second
+		if (spins)
+		{
+			scene.get<Animation>(cube)->axis = glm::vec3(0.0f, -1.0f, 0.0f);
+			scene.get<Animation>(cube)->speed = 3.14159f / 2.0f;
+		}
+	}
+	// Below the lowest cubes, a static caster like them
+	if (shadows)
+	{
+		Entity floor = scene.create(renderable | COMPONENT_BIT(COMPONENT_BOUNDS));
+		scene.get<Transform>(floor)->position = glm::vec3(0.0f, 3.0f * -(gridSide / 2) - 1.8f, 0.0f);
+		scene.get<Transform>(floor)->scale = 1.0f;
+		scene.get<MeshHandle>(floor)->id = floorMesh.value;
+		scene.get<MeshHandle>(floor)->vertexCount = resources.mesh(floorMesh)->vertexCount;
+		scene.get<MaterialHandle>(floor)->id = program.value;
+		scene.get<Bounds>(floor)->center = glm::vec3(0.0f, -0.25f, 0.0f);
+		scene.get<Bounds>(floor)->radius = floorExtent * 1.4143f;
+	}
 
-		MVP = Projection * View * Model1;
-		
+	// Per-frame CPU work (animation, transforms, culling, draw list) runs on the job system
+	JobSystem jobs(threadCount);
+	DrawListBuilder drawList;
+	drawList.backToFront = backToFront;
+	std::vector<Chunk *> chunks;
 
+	// Or the scene is handed to the GPU once, and the simulation thread only advances the time
+	GpuCuller gpuCuller;
+	if (gpuCulling && !(GpuCuller::supported() && gpuCuller.create(fragmentShader)))
+	{
+		fprintf(stderr, "GPU culling needs GL 4.3 and ARB_shader_draw_parameters, culling on the CPU\n");
+		gpuCulling = false;
+	}
+	if (gpuCulling)
+	{
+		scene.gatherChunks(renderable, chunks);
+		gpuCuller.upload(chunks, resources);
+	}
+	if (materialCount > 0 && !materialsFit())
+		dropMaterials();
+	// Read by g_indirect_vertex_shader, the default entry alone without textures or materials
+	if (submitIndirect || gpuCulling)
+		materialTable.upload();
+	if (lightCount > 0 && !submitIndirect && !gpuCulling)
+	{
+		fprintf(stderr, "Clustered lighting needs GL 4.3 and the multi-draw path, shading with the single light\n");
+		lighting.destroy();
+		lightCount = 0;
+		if (deferredShading)
+			deferredRenderer.destroy();
+		deferredShading = false;
+	}
 
-		// Draw the triangles
-		glDrawArrays(GL_TRIANGLES, 0, sizeof(g_vertex_buffer_data) / sizeof(g_vertex_buffer_data[0]));
+	// The other lights circle through the cubes, binned on the job system every frame
+	std::vector<LightOrbit> lightOrbits;
+	makeLightOrbits(lightCount, lightPos, 1.5f * gridSide + 2.0f, lightOrbits);
+	ClusterBuilder clusterBuilder;
+
+	// Casters culled per view on the job system, the views cover the scene seen from the camera
+	float sceneRadius = 0.0f;
+	scene.eachChunk(COMPONENT_BIT(COMPONENT_BOUNDS), [&](Chunk &chunk) {
+		Transform *transform = chunk.array<Transform>();
+		Bounds *bounds = chunk.array<Bounds>();
+		for (uint32_t i = 0; i < chunk.count; i++)
+			sceneRadius = std::max(sceneRadius, glm::length(transform[i].position) +
+													(glm::length(bounds[i].center) + bounds[i].radius) * transform[i].scale);
+	});
+	ShadowBuilder shadowBuilder(glm::vec3(-1.0f, 3.0f, 2.0f), glm::vec3(0.0f), sceneRadius, glm::length(glm::vec3(4, 3, 3)) + sceneRadius);
+
+	// Shares the draw data of the multi-draw path
+	DepthPrepass prepass;
+	if (depthPrepass && !((submitIndirect || gpuCulling) && prepass.create()))
+	{
+		fprintf(stderr, "The depth pre-pass needs the multi-draw path, drawing without\n");
+		depthPrepass = false;
+	}
+	if (overdraw && !submitIndirect && !gpuCulling)
+	{
+		fprintf(stderr, "The overdraw view needs the multi-draw path, shading normally\n");
+		overdraw = false;
+	}
 
-		glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &Model1[0][0]);
-		glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &View[0][0]);
+	// Fragments that pass the depth test, to compare the forward and deferred paths, only those of the shading pass after a pre-pass
+	FragmentCounter fragmentCounter;
+	fragmentCounter.create();
 
-		glEnable(GL_DEPTH_TEST);
-		glDepthFunc(GL_LESS);
+	FrameCapture capture;
+	if (capturePrefix)
+	{
+		int framebufferWidth, framebufferHeight;
+		glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+		if (!capture.create(framebufferWidth, framebufferHeight, capturePrefix, captureFormat, 60, captureCommand))
+			capturePrefix = NULL;
+	}
 
-		glDisableVertexAttribArray(0);
+	// Same multisampling as the window
+	DynamicResolution dynamicResolution;
+	if (resolutionBudget > 0.0)
+	{
+		int framebufferWidth, framebufferHeight;
+		GLint windowSamples = 0;
+		glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+		glGetIntegerv(GL_SAMPLES, &windowSamples);
+		if (!dynamicResolution.create(framebufferWidth, framebufferHeight, windowSamples, resolutionBudget / 1000.0, upscaleFilter,
+									  minResolutionScale))
+			resolutionBudget = 0.0;
+	}
 
-		// Swap buffers
-		glfwSwapBuffers(window);
+	FramePacer pacer;
+	pacer.create(framesInFlight, offlineSteps > 0 ? 0.0 : targetFps, lateWake && offlineSteps <= 0);
+
+	// From here on the GL context belongs to the render thread
+	FramePipeline pipeline(latency);
+	std::atomic<uint64_t> simulatedFrames(0);
+	std::atomic<uint64_t> droppedSteps(0);
+	glfwMakeContextCurrent(NULL);
+
+	std::thread renderThread([&]() {
+		glfwMakeContextCurrent(window);
+
+		TimingStats frameStats, latencyStats, submitStats, multiDrawStats, captureStats, stepStats, binningStats, shadowViewStats;
+		uint64_t lightIndices = 0;
+		MeshletStats meshletStats;
+		uint32_t drawCalls = 0;
+		uint32_t textureBinds = 0;
+		uint32_t materialSwitches = 0;
+		double lastSwap = glfwGetTime();
+		double lastReport = lastSwap;
+		uint64_t lastSimulated = 0;
+
+		while (RenderPacket *packet = pipeline.acquire())
+		{
+			pacer.beginFrame();
+			// Pages read since the last frame, and the requests of a finished feedback readback
+			if (virtualTexturePath)
+				virtualTexture.update();
+			// Before the scene, which samples them
+			if (shadows)
+			{
+				meshBank.bind();
+				shadowRenderer.render(packet->shadows, resources, sceneWidth, sceneHeight);
+				glBindVertexArray(VertexArrayID);
+			}
+			if (resolutionBudget > 0.0)
+				dynamicResolution.begin();
+
+			// Clear the screen
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			// Read by the multi-draw programs through their storage buffer bindings
+			if (lightCount > 0)
+			{
+				bool scaled = resolutionBudget > 0.0;
+				lighting.upload(packet->lights, scaled ? dynamicResolution.renderWidth() : sceneWidth,
+								scaled ? dynamicResolution.renderHeight() : sceneHeight);
+			}
+			if (!depthPrepass)
+				fragmentCounter.begin();
+			if (deferredShading)
+				deferredRenderer.begin();
+			if (overdraw)
+			{
+				glEnable(GL_BLEND);
+				glBlendFunc(GL_ONE, GL_ONE);
+			}
+
+			// Replay the command buffers recorded by the workers, in order.
+			// Commands carry handles : a stale one (destroyed resource) skips its draws.
+			// On the indirect path the draws are only appended to the multi-draw batches.
+			double submitStart = glfwGetTime();
+			GLuint currentProgram = 0;
+			uint32_t currentMesh = 0;
+			const GpuMesh *mesh = NULL;
+			const TransformCommand *transform = NULL;
+			drawCalls = 0;
+			if (submitIndirect || gpuCulling)
+				materialTable.bind();
+			if (submitIndirect)
+				indirect.beginFrame();
+			for (size_t l = 0; l < packet->commands.size(); l++)
+			{
+				CommandReader reader(packet->commands[l]);
+				while (const CommandHeader *cmd = reader.next())
+				{
+					switch (cmd->type)
+					{
+					case CMD_PROGRAM:
+					{
+						const ProgramCommand *c = (const ProgramCommand *)cmd;
+						GLuint name = resources.program(ProgramId::fromValue(c->program));
+						if (name == currentProgram)
+							break;
+						currentProgram = name;
+						if (submitIndirect)
+							indirect.flush();
+						if (!currentProgram || submitIndirect)
+							break;
+						glUseProgram(currentProgram);
+						glUniform3f(LightID, packet->lightPos.x, packet->lightPos.y, packet->lightPos.z);
+						glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &packet->view[0][0]);
+						break;
+					}
+					case CMD_TRANSFORM:
+					{
+						const TransformCommand *c = (const TransformCommand *)cmd;
+						transform = c;
+						if (submitIndirect)
+							break;
+						glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &c->mvp[0][0]);
+						glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &c->model[0][0]);
+						break;
+					}
+					case CMD_TEXTURE:
+					{
+						const TextureCommand *c = (const TextureCommand *)cmd;
+						if (submitIndirect)
+							indirect.setTexture(textureTarget, resources.texture(TextureId::fromValue(c->texture)));
+						break;
+					}
+					case CMD_DRAW:
+					{
+						const DrawCommand *c = (const DrawCommand *)cmd;
+						if (c->mesh != currentMesh)
+						{
+							currentMesh = c->mesh;
+							mesh = resources.mesh(MeshId::fromValue(c->mesh));
+							if (mesh && !submitIndirect)
+								bindMesh(resources, *mesh);
+						}
+						if (!currentProgram || !mesh)
+							break;
+						if (submitIndirect)
+						{
+							if (!transform || !mesh->bank.indexCount)
+								break;
+							// An entry past the table would read past its buffer
+							uint32_t material = c->material < materialTable.count() ? c->material : 0;
+							if (!mesh->meshlets.count)
+							{
+								indirect.add(transform->mvp, transform->model, mesh->bank, material);
+								break;
+							}
+							// Meshlets are culled in model space
+							if (indirect.addObject(transform->mvp, transform->model, material))
+								meshlets.cull(mesh->meshlets, mesh->bank.baseVertex, Frustum(transform->mvp),
+											  glm::vec3(glm::inverse(packet->view * transform->model)[3]), meshletStats,
+											  [&](const MeshRange &range) { indirect.addRange(range); });
+							break;
+						}
+						// Draw the triangles
+						glDrawArrays(GL_TRIANGLES, c->first, c->count);
+						drawCalls++;
+						break;
+					}
+					}
+				}
+			}
+			if (gpuCulling)
+			{
+				meshBank.bind();
+				gpuCuller.cull(packet->projection * packet->view, packet->sceneTime);
+				if (depthPrepass)
+				{
+					meshBank.bindPositions();
+					prepass.depthState();
+					gpuCuller.drawDepth(prepass.program());
+					meshBank.bind();
+					prepass.shadingState();
+					fragmentCounter.begin();
+				}
+				gpuCuller.draw(packet->view, packet->lightPos);
+				if (depthPrepass)
+					prepass.restoreState();
+				glBindVertexArray(VertexArrayID);
+				drawCalls = depthPrepass ? 2 : 1;
+			}
+			else if (submitIndirect)
+			{
+				double multiDrawStart = glfwGetTime();
+				if (depthPrepass)
+				{
+					meshBank.bindPositions();
+					prepass.depthState();
+					indirect.submitProgram(prepass.program());
+					prepass.shadingState();
+					fragmentCounter.begin();
+				}
+				meshBank.bind();
+				indirect.submit(packet->view, packet->lightPos);
+				if (depthPrepass)
+					prepass.restoreState();
+				multiDrawStats.add(glfwGetTime() - multiDrawStart);
+				glBindVertexArray(VertexArrayID);
+				drawCalls = indirect.calls() * (depthPrepass ? 2 : 1);
+				textureBinds = indirect.textureBinds();
+				materialSwitches = indirect.materialSwitches();
+			}
+			submitStats.add(glfwGetTime() - submitStart);
+
+			glEnable(GL_DEPTH_TEST);
+			glDepthFunc(GL_LESS);
+
+			glDisableVertexAttribArray(0);
+			glDisableVertexAttribArray(1);
+			glDisableVertexAttribArray(2);
+
+			if (overdraw)
+				glDisable(GL_BLEND);
+			fragmentCounter.end();
+			if (deferredShading)
+			{
+				bool scaled = resolutionBudget > 0.0;
+				deferredRenderer.end(packet->projection, scaled ? dynamicResolution.framebuffer() : 0,
+									 scaled ? dynamicResolution.renderWidth() : sceneWidth,
+									 scaled ? dynamicResolution.renderHeight() : sceneHeight);
+				glBindVertexArray(VertexArrayID);
+			}
+
+			if (resolutionBudget > 0.0)
+			{
+				dynamicResolution.end();
+				glBindVertexArray(VertexArrayID);
+			}
+
+			// The pages the frame wanted, drawn small with the draws of the frame
+			if (virtualTexturePath)
+			{
+				meshBank.bind();
+				virtualTexture.beginFeedback();
+				indirect.submitProgram(virtualTexture.feedbackProgram());
+				virtualTexture.endFeedback(sceneWidth, sceneHeight);
+				glBindVertexArray(VertexArrayID);
+			}
+
+			// Queued before the swap, while the back buffer still holds the frame
+			double captureStart = glfwGetTime();
+			if (capturePrefix)
+				capture.readback(packet->frame);
+			double captureTime = glfwGetTime() - captureStart;
+
+			// Swap buffers
+			glfwSwapBuffers(window);
+			// Objects destroyed in earlier frames are deleted once the GPU is done with them
+			resources.endFrame();
+			if (submitIndirect)
+				indirect.endFrame();
+			if (lightCount > 0)
+				lighting.endFrame();
+			if (shadows)
+				shadowRenderer.endFrame();
+			// Waits here when the GPU is more than `framesInFlight` frames behind
+			pacer.endFrame(packet->inputTime);
+			double gpuTime;
+			if (resolutionBudget > 0.0 && pacer.newGpuTime(gpuTime))
+				dynamicResolution.update(gpuTime);
+			glTraceFrame(packet->frame);
+			if (capturePrefix)
+			{
+				captureStart = glfwGetTime();
+				capture.endFrame();
+				captureStats.add(captureTime + glfwGetTime() - captureStart);
+			}
+
+			// Input to photon : from the input poll of this frame to the end of its swap
+			double now = glfwGetTime();
+			latencyStats.add(now - packet->inputTime);
+			frameStats.add(now - lastSwap);
+			lastSwap = now;
+			uint32_t visibleCount = gpuCulling ? gpuCuller.visible() : packet->visibleCount;
+			uint32_t culledCount = gpuCulling ? gpuCuller.instances() - visibleCount : packet->culledCount;
+			FrameArenaStats arenaStats = packet->arena.stats();
+			stepStats.merge(packet->steps);
+			LightClusters lightStats = packet->lights;
+			if (lightCount > 0)
+			{
+				binningStats.add(lightStats.seconds);
+				lightIndices += lightStats.indices.size();
+			}
+			if (shadows)
+				shadowViewStats.add(packet->shadows.seconds);
+			pipeline.release();
+
+			if (now - lastReport >= 2.0)
+			{
+				uint64_t simulated = simulatedFrames.load();
+				printf("sim %.1f fps | render %.1f fps (%.2f ms max) | input to photon %.2f ms avg, %.2f ms max | latency %d | %u drawn, %u culled\n",
+					   (simulated - lastSimulated) / (now - lastReport), frameStats.count / (now - lastReport),
+					   frameStats.max * 1000.0, latencyStats.average() * 1000.0, latencyStats.max * 1000.0, latency,
+					   visibleCount, culledCount);
+				printf("simulation%s : %.1f steps/s of %.2f ms (%.2fx real time), %.2f per frame, step %.3f ms avg, %.3f ms max, %llu dropped\n",
+					   simClock.offline() ? " (offline)" : "", stepStats.count / (now - lastReport), simClock.stepSeconds() * 1000.0,
+					   stepStats.count * simClock.stepSeconds() / (now - lastReport), (double)stepStats.count / frameStats.count,
+					   stepStats.average() * 1000.0, stepStats.max * 1000.0, (unsigned long long)droppedSteps.load());
+				PacerStats pacing = pacer.takeStats();
+				printf("pacing : cpu %.2f ms avg, %.2f ms max | gpu %.2f ms avg, %.2f ms max | %d frames in flight, %.2f ms waiting for the GPU | %.2f ms asleep before input",
+					   pacing.cpu.average() * 1000.0, pacing.cpu.max * 1000.0, pacing.gpu.average() * 1000.0, pacing.gpu.max * 1000.0,
+					   pacer.framesInFlight(), pacing.inFlightWait.sum * 1000.0 / frameStats.count, pacing.sleepSeconds * 1000.0 / frameStats.count);
+				if (pacer.targetPeriod() > 0.0)
+					printf(" | target %.1f fps", 1.0 / pacer.targetPeriod());
+				printf("%s\n", pacer.wakesLate() ? " | late wake" : "");
+				// Buckets holding at least 1% of the frames
+				printf("frame intervals : %.2f ms avg, %.2f ms jitter, %.2f ms max |", pacing.interval.average() * 1000.0,
+					   pacing.jitter() * 1000.0, pacing.interval.max * 1000.0);
+				for (int b = 0; b < PACER_BUCKETS; b++)
+					if (pacing.histogram[b] * 100 >= pacing.interval.count && pacing.histogram[b])
+						printf(" %s%d ms %.0f%%", b == PACER_BUCKETS - 1 ? ">=" : "", b, 100.0 * pacing.histogram[b] / pacing.interval.count);
+				printf("\n");
+				if (resolutionBudget > 0.0)
+				{
+					DynamicResolutionStats scaling = dynamicResolution.takeStats();
+					printf("dynamic resolution : %.2f scale (%.2f to %.2f), %dx%d, %s upscale | gpu %.2f ms for a %.2f ms budget | %u changes\n",
+						   scaling.frames ? scaling.scaleSum / scaling.frames : 1.0, scaling.minScale, scaling.maxScale,
+						   dynamicResolution.renderWidth(), dynamicResolution.renderHeight(),
+						   g_upscale_filter_names[dynamicResolution.upscaleFilter()], pacing.gpu.average() * 1000.0,
+						   dynamicResolution.frameBudget() * 1000.0, scaling.changes);
+				}
+				if (lightCount > 0)
+					printf("lights : %d (%u in view) in %dx%dx%d clusters, %.1f per cluster avg, %u max, %u dropped | binning %.3f ms avg, %.3f ms max\n",
+						   lightCount, lightStats.visibleLights, CLUSTER_X, CLUSTER_Y, CLUSTER_Z,
+						   (double)lightIndices / binningStats.count / CLUSTER_COUNT, lightStats.maxPerCluster, lightStats.dropped,
+						   binningStats.average() * 1000.0, binningStats.max * 1000.0);
+				// Forward writes color and depth per fragment, see DeferredRenderer::frameBytes() for the other path
+				FragmentStats fragments = fragmentCounter.takeStats();
+				if (fragments.frames)
+				{
+					double perFrame = fragments.fragments / fragments.frames;
+					double pixels = resolutionBudget > 0.0 ? (double)dynamicResolution.renderWidth() * dynamicResolution.renderHeight()
+														   : (double)sceneWidth * sceneHeight;
+					double forwardBytes = perFrame * (4 + 4), deferredBytes = DeferredRenderer::frameBytes(perFrame, pixels);
+					printf("shading (%s%s, %s) : %.0f fragments per frame, %.2f per pixel | ~%.2f MB per frame forward, ~%.2f MB deferred | gpu %.2f ms avg\n",
+						   deferredShading ? "deferred" : "forward", depthPrepass ? " after a depth pre-pass" : "",
+						   backToFront ? "back to front" : "front to back", perFrame, perFrame / pixels, forwardBytes / 1e6, deferredBytes / 1e6,
+						   pacing.gpu.average() * 1000.0);
+				}
+				if (shadows)
+				{
+					ShadowStats shadowing = shadowRenderer.takeStats();
+					printf("shadows (%s) : %.2f views redrawn per frame, %.0f static and %.0f dynamic casters drawn per frame, %u dropped | "
+						   "views %.3f ms avg | render cpu %.3f ms avg, gpu %.3f ms avg\n",
+						   shadowRenderer.cache() ? "static cached" : "all redrawn", (double)shadowing.redrawnViews / shadowing.frames,
+						   shadowing.staticCasters / shadowing.frames, shadowing.dynamicCasters / shadowing.frames, shadowing.dropped,
+						   shadowViewStats.average() * 1000.0, shadowing.cpu.average() * 1000.0, shadowing.gpu.average() * 1000.0);
+				}
+				printf("frame arena : %u allocations, %.1f KB (peak %.1f KB of %.1f KB), %u overflow blocks\n",
+					   arenaStats.allocations, arenaStats.bytes / 1024.0, arenaStats.peakBytes / 1024.0,
+					   arenaStats.capacity / 1024.0, arenaStats.overflows);
+				printf("submit (%s) : %.3f ms avg, %.3f ms max, %u draw calls",
+					   gpuCulling ? "GPU culling" : submitIndirect ? "multi-draw indirect" : "per object",
+					   submitStats.average() * 1000.0, submitStats.max * 1000.0, drawCalls);
+				if (submitIndirect && !gpuCulling)
+					printf(" (%.3f ms recording, %.3f ms inside the multi-draw calls)", (submitStats.average() - multiDrawStats.average()) * 1000.0,
+						   multiDrawStats.average() * 1000.0);
+				printf("\n");
+				if (textureCount > 0)
+					printf("textures (%s) : %d images, %u binds per frame\n", g_texture_packing_names[texturePacking], textureCount, textureBinds);
+				if (materialCount > 0 && gpuCulling)
+					printf("materials : %d of %u entries, %u changes along the %u instances (culled ones included), %u draw calls\n",
+						   materialCount, materialTable.count(), gpuCuller.materialChanges(), gpuCuller.instances(), drawCalls);
+				else if (materialCount > 0)
+					printf("materials : %d of %u entries, %u switches per frame inside the batches, %u draw calls\n", materialCount,
+						   materialTable.count(), materialSwitches, drawCalls);
+				if (virtualTexturePath)
+				{
+					VirtualTextureStats paging = virtualTexture.takeStats();
+					printf("virtual texture (%u texels) : %.1f%% of %.0f pages per readback resident | %.1f uploads, %.1f evictions per frame, "
+						   "%u dropped, %.2f MB read | %u of %u pages cached, %.1f MB of %.1f MB\n",
+						   virtualTexture.size(), paging.requested ? 100.0 * paging.hits / paging.requested : 100.0,
+						   paging.readbacks ? (double)paging.requested / paging.readbacks : 0.0, (double)paging.uploads / frameStats.count,
+						   (double)paging.evictions / frameStats.count, paging.dropped, paging.bytesRead / 1e6, paging.resident,
+						   paging.capacity, (double)paging.resident * PAGE_BYTES / 1e6, virtualTexture.fullBytes() / 1e6);
+				}
+				if (meshletStats.meshlets)
+					printf("meshlets : %.0f of %.0f per frame drawn in %.0f ranges, %.1f%% of the triangles culled (%.0f frustum, %.0f backface meshlets)\n",
+						   (meshletStats.meshlets - meshletStats.frustumCulled - meshletStats.backfaceCulled) / (double)frameStats.count,
+						   meshletStats.meshlets / (double)frameStats.count, meshletStats.ranges / (double)frameStats.count,
+						   100.0 * meshletStats.trianglesCulled / meshletStats.triangles, meshletStats.frustumCulled / (double)frameStats.count,
+						   meshletStats.backfaceCulled / (double)frameStats.count);
+				if (capturePrefix)
+				{
+					CaptureStats counts = capture.takeStats();
+					printf("capture (%s) : %u frames read back, %u written, %u dropped | render thread %.3f ms avg, %.3f ms max, %.3f ms waiting for readbacks\n",
+						   g_capture_format_names[capture.captureFormat()], counts.captured, counts.encoded, counts.dropped,
+						   captureStats.average() * 1000.0, captureStats.max * 1000.0, counts.stallSeconds * 1000.0);
+					if (capture.recording())
+						printf("encoder backpressure : up to %u frames queued, %u frames waited for, %.1f ms blocked%s\n", counts.backlog,
+							   counts.blocked, counts.blockedSeconds * 1000.0, capture.failed() ? " | output failed, not recording" : "");
+				}
+				lastSimulated = simulated;
+				lastReport = now;
+				frameStats.reset();
+				latencyStats.reset();
+				submitStats.reset();
+				multiDrawStats.reset();
+				meshletStats.reset();
+				captureStats.reset();
+				stepStats.reset();
+				binningStats.reset();
+				shadowViewStats.reset();
+				lightIndices = 0;
+			}
+		}
+
+		if (submitIndirect)
+			indirect.destroy();
+		if (gpuCulling)
+			gpuCuller.destroy();
+		materialTable.destroy();
+		meshBank.destroy(resources);
+		if (capturePrefix)
+			capture.destroy();
+		pacer.destroy();
+		if (lightCount > 0)
+			lighting.destroy();
+		if (deferredShading)
+			deferredRenderer.destroy();
+		if (shadows)
+			shadowRenderer.destroy();
+		if (virtualTexturePath)
+			virtualTexture.destroy();
+		fragmentCounter.destroy();
+		prepass.destroy();
+		if (resolutionBudget > 0.0)
+			dynamicResolution.destroy();
+		glfwMakeContextCurrent(NULL);
+	});
+
+	uint64_t frame = 0;
+	double lastInput = glfwGetTime();
+	do
+	{
+		// Target fps and late wake : sleeps until the input of this frame is due
+		pacer.waitForInput();
 		glfwPollEvents();
-
-		// Cleanup the buffer
-		glDeleteBuffers(1, &vertexbuffer);
-
-	} while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS && glfwWindowShouldClose(window) == 0);
+		double inputTime = glfwGetTime();
+
+		// Whole steps of the real time since the last frame, the GPU path only needs the clock
+		uint32_t steps = simClock.advance(inputTime - lastInput);
+		lastInput = inputTime;
+		TimingStats frameSteps;
+		if (!gpuCulling)
+			scene.gatherChunks(renderable, chunks);
+		for (uint32_t s = 0; s < steps; s++)
+		{
+			double stepStart = glfwGetTime();
+			if (!gpuCulling)
+			{
+				float step = (float)simClock.stepSeconds();
+				jobs.parallelFor((uint32_t)chunks.size(), 4, [&](uint32_t begin, uint32_t end) {
+					for (uint32_t c = begin; c < end; c++)
+						animateChunk(*chunks[c], step);
+				});
+			}
+			frameSteps.add(glfwGetTime() - stepStart);
+		}
+		droppedSteps = simClock.droppedSteps();
+		float alpha = simClock.alpha();
+		if (!gpuCulling)
+		{
+			jobs.parallelFor((uint32_t)chunks.size(), 4, [&](uint32_t begin, uint32_t end) {
+				for (uint32_t c = begin; c < end; c++)
+					transformChunk(*chunks[c], alpha);
+			});
+		}
+
+		// Waits here when the render thread is `latency` frames behind
+		RenderPacket *packet = pipeline.beginWrite();
+		packet->frame = frame++;
+		packet->inputTime = inputTime;
+		packet->view = View;
+		packet->projection = Projection;
+		packet->lightPos = lightPos;
+		packet->sceneTime = (float)simClock.time();
+		packet->steps = frameSteps;
+		if (lightCount > 0)
+			packet->lights = clusterBuilder.build(jobs, packet->arena, lightOrbits.data(), lightCount, packet->sceneTime, View, Projection);
+		if (shadows)
+			packet->shadows = shadowBuilder.build(jobs, packet->arena, chunks, View, Projection, lightPos);
+		if (gpuCulling)
+		{
+			packet->commands = FrameArray<CommandBuffer>();
+			packet->visibleCount = packet->culledCount = 0;
+		}
+		else
+		{
+			FrameArray<DrawItem> draws = drawList.build(jobs, packet->arena, chunks, View, Frustum(Projection * View));
+			packet->commands = recordDrawCommands(jobs, packet->arena, draws, Projection * View);
+			packet->visibleCount = drawList.visibleCount;
+			packet->culledCount = drawList.culledCount;
+		}
+		pipeline.publish();
+		simulatedFrames++;
+
+	} while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS && glfwWindowShouldClose(window) == 0 && (frameLimit <= 0 || frame < (uint64_t)frameLimit));
+
+	pipeline.stop();
+	renderThread.join();
+	glfwMakeContextCurrent(window);
 
 	// Close OpenGL window and terminate GLFW
+	resources.releaseAll();
 	glDeleteVertexArrays(1, &VertexArrayID);
-	glDeleteProgram(programID);
 	glfwTerminate();
 
 	return 0;
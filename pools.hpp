@@ -0,0 +1,138 @@
+#ifndef POOLS_HPP
+#define POOLS_HPP
+
+#include <stdint.h>
+#include <vector>
+
+// Generational handle pools.
+// A handle packs a slot index and the generation of the slot into 32 bits,
+// so it fits the id fields of the components and of the draw commands. Slots
+// live in one dense array and freed slots are chained in a free list, so
+// create / destroy at a high rate reuses memory instead of fragmenting it.
+// Freeing a slot bumps its generation : every handle still pointing at it
+// goes stale and lookups return NULL instead of someone else's object. With
+// 12 generation bits a slot has to be reused 4095 times before an old handle
+// can match it again.
+
+#define HANDLE_INDEX_BITS 20
+#define HANDLE_INDEX_MASK ((1u << HANDLE_INDEX_BITS) - 1)
+#define HANDLE_GENERATION_MASK ((1u << (32 - HANDLE_INDEX_BITS)) - 1)
+
+// Typed handle, Tag only keeps handles of different pools apart. 0 is never valid.
+template <class Tag> struct Handle
+{
+	uint32_t value;
+
+	Handle() : value(0) {}
+	static Handle fromValue(uint32_t value)
+	{
+		Handle h;
+		h.value = value;
+		return h;
+	}
+	static Handle make(uint32_t index, uint32_t generation)
+	{
+		return fromValue((generation << HANDLE_INDEX_BITS) | index);
+	}
+
+	uint32_t index() const { return value & HANDLE_INDEX_MASK; }
+	uint32_t generation() const { return value >> HANDLE_INDEX_BITS; }
+	bool valid() const { return value != 0; }
+	bool operator==(const Handle &other) const { return value == other.value; }
+	bool operator!=(const Handle &other) const { return value != other.value; }
+};
+
+template <class Tag, class T> class Pool
+{
+public:
+	typedef Handle<Tag> HandleType;
+
+	Pool() : freeHead(NO_SLOT), live(0) {}
+
+	HandleType create(const T &item)
+	{
+		uint32_t index;
+		if (freeHead != NO_SLOT)
+		{
+			index = freeHead;
+			freeHead = slots[index].nextFree;
+		}
+		else
+		{
+			if (slots.size() > HANDLE_INDEX_MASK)
+				return HandleType(); // full
+			index = (uint32_t)slots.size();
+			slots.push_back(Slot());
+			slots[index].generation = 1;
+		}
+		Slot &slot = slots[index];
+		slot.item = item;
+		slot.alive = true;
+		live++;
+		return HandleType::make(index, slot.generation);
+	}
+
+	// NULL for a stale or null handle
+	T *get(HandleType handle)
+	{
+		uint32_t index = handle.index();
+		if (index >= slots.size())
+			return NULL;
+		Slot &slot = slots[index];
+		if (!slot.alive || slot.generation != handle.generation())
+			return NULL;
+		return &slot.item;
+	}
+
+	const T *get(HandleType handle) const { return const_cast<Pool *>(this)->get(handle); }
+
+	// Frees the slot and hands back the item, false if the handle was stale
+	bool release(HandleType handle, T *out)
+	{
+		T *item = get(handle);
+		if (!item)
+			return false;
+		if (out)
+			*out = *item;
+		uint32_t index = handle.index();
+		Slot &slot = slots[index];
+		slot.alive = false;
+		// Generation 0 would make the null handle valid
+		slot.generation = (slot.generation + 1) & HANDLE_GENERATION_MASK;
+		if (slot.generation == 0)
+			slot.generation = 1;
+		slot.nextFree = freeHead;
+		freeHead = index;
+		live--;
+		return true;
+	}
+
+	// Calls f(handle, item) for every live item
+	template <class F> void each(F f)
+	{
+		for (uint32_t i = 0; i < slots.size(); i++)
+			if (slots[i].alive)
+				f(HandleType::make(i, slots[i].generation), slots[i].item);
+	}
+
+	uint32_t size() const { return live; }
+	uint32_t capacity() const { return (uint32_t)slots.size(); }
+
+private:
+	static const uint32_t NO_SLOT = 0xffffffffu;
+
+	struct Slot
+	{
+		T item;
+		uint32_t generation;
+		uint32_t nextFree;
+		bool alive;
+		Slot() : item(), generation(0), nextFree(NO_SLOT), alive(false) {}
+	};
+
+	std::vector<Slot> slots;
+	uint32_t freeHead;
+	uint32_t live;
+};
+
+#endif
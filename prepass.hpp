@@ -0,0 +1,114 @@
+#ifndef PREPASS_HPP
+#define PREPASS_HPP
+
+#include <GL/glew.h>
+
+#include "shaders.hpp"
+
+// Depth pre-pass.
+// The scene is drawn twice. First depth only, from the positions-only
+// stream of the MeshBank, with color writes off : no fragment shader work,
+// and the vertex fetch reads 12 bytes a vertex instead of 36. Then shaded
+// with the depth test on GL_EQUAL and depth writes off, so every pixel runs
+// the fragment shader once, for the surface that ends up visible, whatever
+// the draw order. Both passes use the DrawData array of indirect.hpp,
+// g_indirect_vertex_shader declares gl_Position invariant so the depths
+// match bit for bit.
+//
+// It pays when fragments are expensive (many lights, shadows) and the
+// scene overlaps itself. Front to back ordering (drawlist.hpp) gets part of
+// the way for free, early-Z rejects what is behind what was drawn first.
+//
+// Per frame : depthState(), the depth submit, shadingState(), the shading
+// submit, restoreState().
+
+// Positions through the draw's matrix, nothing else
+static const char *const g_depth_vertex_shader = R"(#version 430 core
+#extension GL_ARB_shader_draw_parameters : require
+layout(location = 0) in vec3 vertexPosition_modelspace;
+invariant gl_Position;
+struct DrawData
+{
+	mat4 mvp;
+	mat4 model;
+	uint material;
+};
+layout(std430, binding = 0) readonly buffer Draws
+{
+	DrawData draws[];
+};
+void main()
+{
+	gl_Position = draws[gl_BaseInstanceARB].mvp * vec4(vertexPosition_modelspace, 1);
+}
+)";
+
+static const char *const g_depth_fragment_shader = R"(#version 330 core
+void main()
+{
+}
+)";
+
+// Overdraw visualization : every fragment adds the same grey with
+// glBlendFunc(GL_ONE, GL_ONE), 8 layers make white
+static const char *const g_overdraw_fragment_shader = R"(#version 330 core
+out vec3 color;
+void main()
+{
+	color = vec3(0.125);
+}
+)";
+
+class DepthPrepass
+{
+public:
+	DepthPrepass() : depthProgram(0) {}
+
+	// Only with IndirectRenderer or GpuCuller, so their requirements hold
+	bool create()
+	{
+		depthProgram = buildProgram(g_depth_vertex_shader, g_depth_fragment_shader, "depth pre-pass");
+		return depthProgram != 0;
+	}
+
+	void destroy()
+	{
+		if (depthProgram)
+			glDeleteProgram(depthProgram);
+		depthProgram = 0;
+	}
+
+	// For IndirectRenderer::submitProgram() and GpuCuller::drawDepth()
+	GLuint program() const { return depthProgram; }
+
+	// Depth writes only
+	void depthState() const
+	{
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		glDepthMask(GL_TRUE);
+		glDepthFunc(GL_LESS);
+	}
+
+	// Colors, only where the depth is the one of the pre-pass
+	void shadingState() const
+	{
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		glDepthMask(GL_FALSE);
+		glDepthFunc(GL_EQUAL);
+	}
+
+	// Back to what the rest of the frame expects
+	void restoreState() const
+	{
+		glDepthMask(GL_TRUE);
+		glDepthFunc(GL_LESS);
+	}
+
+private:
+	DepthPrepass(const DepthPrepass &);
+	DepthPrepass &operator=(const DepthPrepass &);
+
+	GLuint depthProgram;
+};
+
+#endif
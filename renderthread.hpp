@@ -0,0 +1,168 @@
+#ifndef RENDERTHREAD_HPP
+#define RENDERTHREAD_HPP
+
+#include <stdint.h>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <glm/glm.hpp>
+
+#include "arena.hpp"
+#include "commands.hpp"
+#include "clusters.hpp"
+#include "shadowviews.hpp"
+
+// Hand-off between the simulation (main) thread and the render thread.
+// The main thread fills a RenderPacket for frame N+1 while the render thread,
+// which owns the GL context, submits frame N. The packets live in a ring of
+// latency + 1 slots : with a latency of 1 this is a plain double buffer, and
+// the simulation never runs more than `latency` frames ahead of the screen.
+
+struct DrawItem
+{
+	glm::mat4 model;
+	uint32_t program;
+	uint32_t texture;
+	uint32_t material;
+	uint32_t mesh;
+	uint32_t vertexCount;
+	uint64_t sortKey;
+};
+
+// Running min / average / max of a duration in seconds
+struct TimingStats
+{
+	uint64_t count;
+	double sum;
+	double min;
+	double max;
+
+	TimingStats() { reset(); }
+
+	void add(double t)
+	{
+		count++;
+		sum += t;
+		if (t < min)
+			min = t;
+		if (t > max)
+			max = t;
+	}
+
+	double average() const { return count ? sum / count : 0.0; }
+
+	// Adds the samples of another thread's stats
+	void merge(const TimingStats &other)
+	{
+		count += other.count;
+		sum += other.sum;
+		if (other.min < min)
+			min = other.min;
+		if (other.max > max)
+			max = other.max;
+	}
+
+	void reset()
+	{
+		count = 0;
+		sum = 0.0;
+		min = 1e30;
+		max = 0.0;
+	}
+};
+
+struct RenderPacket
+{
+	uint64_t frame;
+	double inputTime;  // glfwGetTime() when the input of this frame was polled
+	float sceneTime;   // simulated seconds since start, drives GPU side animation
+	TimingStats steps; // simulation steps run for this frame
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 lightPos;
+	LightClusters lights; // binned point lights, empty with the single light
+	ShadowFrame shadows;  // shadow views and their casters, empty without shadows
+	FrameArena arena; // everything transient of the frame, reset by beginWrite
+	FrameArray<CommandBuffer> commands; // replayed in order
+	uint32_t visibleCount;
+	uint32_t culledCount;
+};
+
+class FramePipeline
+{
+public:
+	explicit FramePipeline(int latency)
+		: slots(latency < 1 ? 2 : latency + 1), written(0), released(0), stopped(false)
+	{
+	}
+
+	// Simulation side : next packet to fill, waits while the render thread is `latency` frames behind.
+	// The frame arena of the packet is reset, nothing of the frame it last carried survives.
+	RenderPacket *beginWrite()
+	{
+		RenderPacket *packet;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock, [this] { return stopped || written - released < slots.size(); });
+			if (stopped)
+				return NULL;
+			packet = &slots[written % slots.size()];
+		}
+		packet->arena.reset();
+		return packet;
+	}
+
+	void publish()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			written++;
+		}
+		cond.notify_all();
+	}
+
+	// Render side : oldest published packet, NULL once stopped and drained
+	RenderPacket *acquire()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		cond.wait(lock, [this] { return stopped || written > released; });
+		if (written == released)
+			return NULL;
+		return &slots[released % slots.size()];
+	}
+
+	void release()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			released++;
+		}
+		cond.notify_all();
+	}
+
+	void stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopped = true;
+		}
+		cond.notify_all();
+	}
+
+	// Frames published but not yet released by the render thread
+	uint64_t inFlight()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return written - released;
+	}
+
+private:
+	std::vector<RenderPacket> slots;
+	uint64_t written;
+	uint64_t released;
+	bool stopped;
+	std::mutex mutex;
+	std::condition_variable cond;
+};
+
+#endif
@@ -0,0 +1,298 @@
+#ifndef RESOURCES_HPP
+#define RESOURCES_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <deque>
+#include <GL/glew.h>
+
+#include "pools.hpp"
+
+// GL objects behind generational handles.
+// Buffers, programs, textures and the meshes built from buffers each live in
+// a pool. destroy() invalidates the handle at once, so a draw recorded with it
+// is skipped rather than using a recycled name, but the GL object itself is
+// only deleted once the fence of the frame that destroyed it has signalled :
+// the GPU may still be reading it for the frames already submitted.
+//
+// Every call needs the GL context, so after start-up the render thread owns
+// the resources. Handle values themselves can be copied around freely.
+
+struct BufferTag;
+struct ProgramTag;
+struct TextureTag;
+struct MeshTag;
+typedef Handle<BufferTag> BufferId;
+typedef Handle<ProgramTag> ProgramId;
+typedef Handle<TextureTag> TextureId;
+typedef Handle<MeshTag> MeshId;
+
+struct GpuBuffer
+{
+	GLuint name;
+	GLenum target;
+	GLsizeiptr size;
+};
+
+struct GpuProgram
+{
+	GLuint name;
+};
+
+struct GpuTexture
+{
+	GLuint name;
+	GLenum target;
+};
+
+// Where a mesh sits in the shared vertex / index buffers of a MeshBank
+struct MeshRange
+{
+	uint32_t firstIndex;
+	uint32_t indexCount; // 0 when the mesh is not in a bank
+	int32_t baseVertex;
+
+	MeshRange() : firstIndex(0), indexCount(0), baseVertex(0) {}
+};
+
+// The meshlets of a banked mesh in a MeshletSet
+struct MeshletRange
+{
+	uint32_t first;
+	uint32_t count; // 0 when the mesh was not split
+
+	MeshletRange() : first(0), count(0) {}
+};
+
+// Non interleaved vertex streams drawn as a triangle list
+struct GpuMesh
+{
+	BufferId positions;
+	BufferId colors;
+	BufferId normals;
+	uint32_t vertexCount;
+	MeshRange bank; // same mesh, indexed, for the multi-draw path
+	MeshletRange meshlets; // clusters of the bank range, culled one by one
+};
+
+struct ResourceStats
+{
+	uint32_t buffers;
+	uint32_t programs;
+	uint32_t textures;
+	uint32_t meshes;
+	uint32_t pendingDeletes;  // destroyed, waiting for the GPU
+	uint64_t deleted;         // GL objects deleted so far
+};
+
+class GpuResources
+{
+public:
+	GpuResources() : frameSerial(1), completedSerial(0), deletedCount(0) {}
+
+	BufferId createBuffer(GLenum target, GLsizeiptr size, const void *data, GLenum usage)
+	{
+		GpuBuffer buffer;
+		glGenBuffers(1, &buffer.name);
+		glBindBuffer(target, buffer.name);
+		glBufferData(target, size, data, usage);
+		buffer.target = target;
+		buffer.size = size;
+		BufferId id = buffers.create(buffer);
+		if (!id.valid())
+			retire(GL_BUFFER, buffer.name);
+		return id;
+	}
+
+	// Takes ownership of a program linked elsewhere (LoadShaders)
+	ProgramId adoptProgram(GLuint name)
+	{
+		GpuProgram program;
+		program.name = name;
+		ProgramId id = programs.create(program);
+		if (!id.valid())
+			retire(GL_PROGRAM, name);
+		return id;
+	}
+
+	// Takes ownership of a texture created elsewhere (loadBMP_custom, loadDDS)
+	TextureId adoptTexture(GLuint name, GLenum target = GL_TEXTURE_2D)
+	{
+		GpuTexture texture;
+		texture.name = name;
+		texture.target = target;
+		TextureId id = textures.create(texture);
+		if (!id.valid())
+			retire(GL_TEXTURE, name);
+		return id;
+	}
+
+	MeshId createMesh(BufferId positions, BufferId colors, BufferId normals, uint32_t vertexCount, MeshRange bank = MeshRange(),
+					  MeshletRange meshlets = MeshletRange())
+	{
+		GpuMesh mesh;
+		mesh.positions = positions;
+		mesh.colors = colors;
+		mesh.normals = normals;
+		mesh.vertexCount = vertexCount;
+		mesh.bank = bank;
+		mesh.meshlets = meshlets;
+		return meshes.create(mesh);
+	}
+
+	// GL names, 0 for a stale handle
+	GLuint buffer(BufferId id) const
+	{
+		const GpuBuffer *b = buffers.get(id);
+		return b ? b->name : 0;
+	}
+	GLuint program(ProgramId id) const
+	{
+		const GpuProgram *p = programs.get(id);
+		return p ? p->name : 0;
+	}
+	GLuint texture(TextureId id) const
+	{
+		const GpuTexture *t = textures.get(id);
+		return t ? t->name : 0;
+	}
+	const GpuMesh *mesh(MeshId id) const { return meshes.get(id); }
+
+	// Stale handles are ignored, so destroying twice is harmless
+	void destroy(BufferId id)
+	{
+		GpuBuffer b;
+		if (buffers.release(id, &b))
+			retire(GL_BUFFER, b.name);
+	}
+	void destroy(ProgramId id)
+	{
+		GpuProgram p;
+		if (programs.release(id, &p))
+			retire(GL_PROGRAM, p.name);
+	}
+	void destroy(TextureId id)
+	{
+		GpuTexture t;
+		if (textures.release(id, &t))
+			retire(GL_TEXTURE, t.name);
+	}
+	// The mesh and the buffers it owns
+	void destroy(MeshId id)
+	{
+		GpuMesh m;
+		if (!meshes.release(id, &m))
+			return;
+		destroy(m.positions);
+		destroy(m.colors);
+		destroy(m.normals);
+	}
+
+	// After the swap : fences the frame, then deletes what the GPU is done with
+	void endFrame()
+	{
+		FrameFence fence;
+		fence.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		fence.serial = frameSerial++;
+		fences.push_back(fence);
+		collect();
+	}
+
+	// Deletes everything, pending or alive, once the GPU is idle. Shutdown only.
+	void releaseAll()
+	{
+		glFinish();
+		buffers.each([this](BufferId, GpuBuffer &b) { retire(GL_BUFFER, b.name); });
+		programs.each([this](ProgramId, GpuProgram &p) { retire(GL_PROGRAM, p.name); });
+		textures.each([this](TextureId, GpuTexture &t) { retire(GL_TEXTURE, t.name); });
+		buffers = Pool<BufferTag, GpuBuffer>();
+		programs = Pool<ProgramTag, GpuProgram>();
+		textures = Pool<TextureTag, GpuTexture>();
+		meshes = Pool<MeshTag, GpuMesh>();
+		for (size_t i = 0; i < fences.size(); i++)
+			glDeleteSync(fences[i].sync);
+		fences.clear();
+		completedSerial = frameSerial;
+		deleteRetired();
+	}
+
+	ResourceStats stats() const
+	{
+		ResourceStats s;
+		s.buffers = buffers.size();
+		s.programs = programs.size();
+		s.textures = textures.size();
+		s.meshes = meshes.size();
+		s.pendingDeletes = (uint32_t)retired.size();
+		s.deleted = deletedCount;
+		return s;
+	}
+
+private:
+	struct FrameFence
+	{
+		GLsync sync;
+		uint64_t serial;
+	};
+
+	struct Retired
+	{
+		GLenum kind; // GL_BUFFER, GL_PROGRAM or GL_TEXTURE
+		GLuint name;
+		uint64_t serial; // frame that was being built when it was destroyed
+	};
+
+	void retire(GLenum kind, GLuint name)
+	{
+		Retired r;
+		r.kind = kind;
+		r.name = name;
+		r.serial = frameSerial;
+		retired.push_back(r);
+	}
+
+	void collect()
+	{
+		// Fences signal in submission order, stop at the first busy one
+		while (!fences.empty())
+		{
+			GLenum status = glClientWaitSync(fences.front().sync, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				break;
+			completedSerial = fences.front().serial;
+			glDeleteSync(fences.front().sync);
+			fences.pop_front();
+		}
+		deleteRetired();
+	}
+
+	void deleteRetired()
+	{
+		// Retired objects are in serial order too
+		while (!retired.empty() && retired.front().serial <= completedSerial)
+		{
+			Retired &r = retired.front();
+			if (r.kind == GL_BUFFER)
+				glDeleteBuffers(1, &r.name);
+			else if (r.kind == GL_PROGRAM)
+				glDeleteProgram(r.name);
+			else
+				glDeleteTextures(1, &r.name);
+			deletedCount++;
+			retired.pop_front();
+		}
+	}
+
+	Pool<BufferTag, GpuBuffer> buffers;
+	Pool<ProgramTag, GpuProgram> programs;
+	Pool<TextureTag, GpuTexture> textures;
+	Pool<MeshTag, GpuMesh> meshes;
+	std::deque<FrameFence> fences;
+	std::deque<Retired> retired;
+	uint64_t frameSerial;     // frame being built
+	uint64_t completedSerial; // last frame the GPU finished
+	uint64_t deletedCount;
+};
+
+#endif
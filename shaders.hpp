@@ -0,0 +1,132 @@
+#ifndef SHADERS_HPP
+#define SHADERS_HPP
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <GL/glew.h>
+
+// Programs built from sources embedded in the code, for the paths that need
+// shaders the tutorial files do not have. Errors are printed like LoadShaders
+// does and give a program name of 0.
+//
+// g_shading_library goes after the #version line of every fragment and
+// compute shader, so the shading they share is written once.
+
+static const char *const g_shading_library = R"(
+// Diffuse and specular of a light in direction l, specular.a the exponent. n, l and E normalized.
+vec3 phong(vec3 diffuse, vec4 specular, vec3 n, vec3 l, vec3 E)
+{
+	float cosTheta = clamp(dot(n, l), 0, 1);
+	vec3 R = reflect(-l, n);
+	float cosAlpha = clamp(dot(E, R), 0, 1);
+	return diffuse * cosTheta + specular.rgb * pow(cosAlpha, specular.a);
+}
+// StandardShading of step8 : a tenth of the diffuse color as ambient, plus the white light of power 50 at
+// `distance` scaled by its visibility. Directions in camera space, normalized here.
+vec3 standardShading(vec3 diffuse, vec4 specular, vec3 normal, vec3 toLight, vec3 toEye, float distance, float visibility)
+{
+	vec3 lit = phong(diffuse, specular, normalize(normal), normalize(toLight), normalize(toEye));
+	return vec3(0.1, 0.1, 0.1) * diffuse + lit * 50.0 * visibility / (distance * distance);
+}
+// The meshes have no texture coordinates : the model space position projected along the largest axis of the
+// face, from the derivatives since the normals of the step8 cube are not face normals. A macro, as compute
+// shaders get this too and have no derivatives.
+#define boxProjection(position) boxProjectionAlong(position, cross(dFdx(position), dFdy(position)))
+vec2 boxProjectionAlong(vec3 p, vec3 face)
+{
+	vec3 a = abs(face);
+	return 0.5 * (a.x > a.y && a.x > a.z ? p.zy : a.y > a.z ? p.xz : p.xy) + 0.5;
+}
+#line 2
+)";
+
+// `library`, when given, is inserted after the #version line of `source`
+inline GLuint compileShader(GLenum type, const char *source, const char *label, const char *library = NULL)
+{
+	GLuint shader = glCreateShader(type);
+	const char *versionEnd = library ? strchr(source, '\n') : NULL;
+	if (versionEnd)
+	{
+		const char *parts[3] = {source, library, versionEnd + 1};
+		GLint lengths[3] = {(GLint)(versionEnd + 1 - source), -1, -1};
+		glShaderSource(shader, 3, parts, lengths);
+	}
+	else
+		glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+
+	GLint result = GL_FALSE;
+	int logLength = 0;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
+	glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+	if (result != GL_TRUE)
+	{
+		if (logLength < 1)
+			logLength = 1;
+		std::vector<char> message(logLength + 1, '\0');
+		glGetShaderInfoLog(shader, logLength, NULL, message.data());
+		fprintf(stderr, "Compiling shader %s failed\n%s\n", label, message.data());
+		glDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+
+// Links the shaders, which are deleted in any case
+inline GLuint linkProgram(const GLuint *shaders, int count, const char *label)
+{
+	GLuint program = glCreateProgram();
+	bool complete = true;
+	for (int i = 0; i < count; i++)
+	{
+		if (shaders[i])
+			glAttachShader(program, shaders[i]);
+		else
+			complete = false;
+	}
+	GLint result = GL_FALSE;
+	if (complete)
+	{
+		glLinkProgram(program);
+		glGetProgramiv(program, GL_LINK_STATUS, &result);
+		if (result != GL_TRUE)
+		{
+			int logLength = 0;
+			glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+			if (logLength < 1)
+				logLength = 1;
+			std::vector<char> message(logLength + 1, '\0');
+			glGetProgramInfoLog(program, logLength, NULL, message.data());
+			fprintf(stderr, "Linking program %s failed\n%s\n", label, message.data());
+		}
+	}
+	for (int i = 0; i < count; i++)
+	{
+		if (!shaders[i])
+			continue;
+		glDetachShader(program, shaders[i]);
+		glDeleteShader(shaders[i]);
+	}
+	if (result != GL_TRUE)
+	{
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+inline GLuint buildProgram(const char *vertexSource, const char *fragmentSource, const char *label)
+{
+	GLuint shaders[2] = {compileShader(GL_VERTEX_SHADER, vertexSource, label),
+						 compileShader(GL_FRAGMENT_SHADER, fragmentSource, label, g_shading_library)};
+	return linkProgram(shaders, 2, label);
+}
+
+inline GLuint buildComputeProgram(const char *source, const char *label)
+{
+	GLuint shader = compileShader(GL_COMPUTE_SHADER, source, label, g_shading_library);
+	return linkProgram(&shader, 1, label);
+}
+
+#endif
@@ -0,0 +1,549 @@
+#ifndef SHADOWS_HPP
+#define SHADOWS_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include "indirect.hpp"
+#include "renderthread.hpp"
+#include "resources.hpp"
+#include "shaders.hpp"
+#include "shadowviews.hpp"
+#include "stream.hpp"
+
+// Shadow maps of the views built by shadowviews.hpp.
+//   cascades : one depth atlas, 2 x 2 cascades of SHADOW_CASCADE_SIZE
+//   faces    : one depth cube map of SHADOW_CUBE_SIZE around the point light
+// Each has a copy holding the static casters only. A view whose static key
+// changed redraws its static casters into the copy, then every frame the
+// copies are blitted to the maps the scene samples and the dynamic casters
+// are drawn over them. Without the cache every view clears and draws all its
+// casters every frame.
+//
+// Casters are drawn depth only through glMultiDrawElementsIndirect over the
+// MeshBank, one instanced command per run of the same mesh. The scene reads
+// the maps through g_shadowed_fragment_shader : the matrices and the lights
+// come from the storage buffer at SHADOW_BINDING_PARAMS, the maps from
+// texture units SHADOW_UNIT_CASCADES and SHADOW_UNIT_CUBE, no uniforms.
+//
+// Needs GL 4.3 and ARB_shader_draw_parameters, see supported().
+
+#define SHADOW_BINDING_PARAMS 7
+#define SHADOW_UNIT_CASCADES 6
+#define SHADOW_UNIT_CUBE 7
+#define SHADOW_QUERIES 8   // timestamp pairs in flight
+#define SHADOW_SUN_POWER 0.6f
+
+// std430 layout of the shadow parameters
+struct ShadowParams
+{
+	glm::mat4 cascades[SHADOW_CASCADES]; // world to atlas coordinates and depth
+	glm::vec4 splits;
+	glm::vec4 texels;
+	glm::vec4 sun;	 // direction to the sun, w : power
+	glm::vec4 light; // point light position
+	glm::vec4 cube;	 // near and far of the faces, texel size at distance 1
+};
+
+// Depth only, the matrix of the caster from gl_BaseInstanceARB + gl_InstanceID
+static const char *const g_shadow_vertex_shader = R"(#version 430 core
+#extension GL_ARB_shader_draw_parameters : require
+layout(location = 0) in vec3 vertexPosition_modelspace;
+layout(std430, binding = 0) readonly buffer Casters
+{
+	mat4 casters[];
+};
+void main()
+{
+	gl_Position = casters[gl_BaseInstanceARB + gl_InstanceID] * vec4(vertexPosition_modelspace, 1);
+}
+)";
+
+static const char *const g_shadow_fragment_shader = R"(#version 330 core
+void main()
+{
+}
+)";
+
+// StandardShading of step8 with the point light shadowed by the cube map,
+// plus the sun shadowed by the cascades. Positions are offset along the
+// normal by about a texel before the lookup, against self shadowing.
+static const char *const g_shadowed_fragment_shader = R"(#version 430 core
+in vec3 Position_worldspace;
+in vec3 Normal_cameraspace;
+in vec3 EyeDirection_cameraspace;
+in vec3 LightDirection_cameraspace;
+in vec3 fragmentColor;
+out vec3 color;
+uniform vec3 LightPosition_worldspace;
+uniform mat4 V;
+layout(std430, binding = 7) readonly buffer Shadows
+{
+	mat4 cascades[4];
+	vec4 splits;
+	vec4 texels;
+	vec4 sun;
+	vec4 light;
+	vec4 cube;
+};
+layout(binding = 6) uniform sampler2DShadow cascadeAtlas;
+layout(binding = 7) uniform samplerCubeShadow lightCube;
+float sunVisibility(vec3 normal, float viewDistance)
+{
+	int c = 0;
+	while (c < 3 && viewDistance > splits[c])
+		c++;
+	if (viewDistance > splits[3])
+		return 1.0;
+	vec4 s = cascades[c] * vec4(Position_worldspace + normal * texels[c] * 1.5, 1.0);
+	// PCF of the hardware, kept inside the cascade's quarter of the atlas
+	vec2 low = vec2(c & 1, c >> 1) * 0.5, margin = vec2(0.5 / textureSize(cascadeAtlas, 0));
+	return texture(cascadeAtlas, vec3(clamp(s.xy, low + margin, low + 0.5 - margin), s.z - 0.0002));
+}
+float lightVisibility(vec3 normal)
+{
+	vec3 toFragment = Position_worldspace - light.xyz;
+	vec3 a = abs(toFragment);
+	toFragment += normal * max(a.x, max(a.y, a.z)) * cube.z * 1.5;
+	a = abs(toFragment);
+	float d = max(a.x, max(a.y, a.z));
+	float n = cube.x, f = cube.y;
+	float depth = ((f + n) / (f - n) - 2.0 * f * n / ((f - n) * d)) * 0.5 + 0.5;
+	return texture(lightCube, vec4(toFragment, depth - 0.00002));
+}
+void main()
+{
+	vec3 MaterialDiffuseColor = fragmentColor;
+	vec4 MaterialSpecular = vec4(0.3, 0.3, 0.3, 5.0);
+	float distance = length(LightPosition_worldspace - Position_worldspace);
+	vec3 normal = normalize(transpose(mat3(V)) * Normal_cameraspace);
+	color = standardShading(MaterialDiffuseColor, MaterialSpecular, Normal_cameraspace, LightDirection_cameraspace,
+							EyeDirection_cameraspace, distance, lightVisibility(normal));
+
+	vec3 s = normalize(mat3(V) * sun.xyz);
+	color += phong(MaterialDiffuseColor, MaterialSpecular, normalize(Normal_cameraspace), s, normalize(EyeDirection_cameraspace)) *
+			 sun.w * sunVisibility(normal, EyeDirection_cameraspace.z);
+}
+)";
+
+struct ShadowStats
+{
+	uint32_t frames;
+	uint32_t redrawnViews;	   // static casters drawn again
+	double staticCasters;	   // drawn, summed over the frames
+	double dynamicCasters;
+	uint32_t dropped;	   // casters beyond the capacity
+	TimingStats cpu;	   // recording and issuing the shadow passes
+	TimingStats gpu;	   // from the timestamps around them
+};
+
+class ShadowRenderer
+{
+public:
+	ShadowRenderer()
+		: program(0), atlas(0), cube(0), staticAtlas(0), staticCube(0), drawFramebuffer(0), readFramebuffer(0), caching(true),
+		  capacity(0), queryHead(0), queryTail(0)
+	{
+		memset(queries, 0, sizeof(queries));
+		memset(cachedKeys, 0, sizeof(cachedKeys));
+		memset(cached, 0, sizeof(cached));
+		resetStats();
+	}
+
+	static bool supported() { return GLEW_VERSION_4_3 && GLEW_ARB_shader_draw_parameters; }
+
+	// maxCasters : most casters in a frame. Without `cache` every view draws all its casters every frame.
+	bool create(uint32_t maxCasters, bool cache)
+	{
+		caching = cache;
+		capacity = maxCasters * SHADOW_VIEWS;
+		program = buildProgram(g_shadow_vertex_shader, g_shadow_fragment_shader, "shadow");
+		if (!program || !casterRing.create(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(glm::mat4) + sizeof(ShadowParams) + 2 * 256) ||
+			!commandRing.create(GL_DRAW_INDIRECT_BUFFER, capacity * sizeof(DrawElementsIndirectCommand)))
+		{
+			destroy();
+			return false;
+		}
+		atlas = createTexture(GL_TEXTURE_2D, 2 * SHADOW_CASCADE_SIZE);
+		cube = createTexture(GL_TEXTURE_CUBE_MAP, SHADOW_CUBE_SIZE);
+		if (caching)
+		{
+			staticAtlas = createTexture(GL_TEXTURE_2D, 2 * SHADOW_CASCADE_SIZE);
+			staticCube = createTexture(GL_TEXTURE_CUBE_MAP, SHADOW_CUBE_SIZE);
+		}
+		glGenFramebuffers(1, &drawFramebuffer);
+		glGenFramebuffers(1, &readFramebuffer);
+		// Depth only
+		static const GLenum none = GL_NONE;
+		glBindFramebuffer(GL_FRAMEBUFFER, drawFramebuffer);
+		glDrawBuffers(1, &none);
+		glReadBuffer(GL_NONE);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, atlas, 0);
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		glBindFramebuffer(GL_FRAMEBUFFER, readFramebuffer);
+		glDrawBuffers(1, &none);
+		glReadBuffer(GL_NONE);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (status != GL_FRAMEBUFFER_COMPLETE)
+		{
+			fprintf(stderr, "Shadow framebuffer incomplete (0x%x)\n", status);
+			destroy();
+			return false;
+		}
+		glGenQueries(2 * SHADOW_QUERIES, queries);
+		return true;
+	}
+
+	void destroy()
+	{
+		casterRing.destroy();
+		commandRing.destroy();
+		if (program)
+			glDeleteProgram(program);
+		GLuint textures[4] = {atlas, cube, staticAtlas, staticCube};
+		for (int t = 0; t < 4; t++)
+			if (textures[t])
+				glDeleteTextures(1, &textures[t]);
+		if (drawFramebuffer)
+			glDeleteFramebuffers(1, &drawFramebuffer);
+		if (readFramebuffer)
+			glDeleteFramebuffers(1, &readFramebuffer);
+		if (queries[0])
+			glDeleteQueries(2 * SHADOW_QUERIES, queries);
+		memset(queries, 0, sizeof(queries));
+		program = atlas = cube = staticAtlas = staticCube = drawFramebuffer = readFramebuffer = 0;
+	}
+
+	// Draws the shadow maps of the frame and binds them for the scene. The
+	// MeshBank VAO must be bound. Leaves the default framebuffer bound with
+	// a `width` x `height` viewport.
+	void render(const ShadowFrame &frame, const GpuResources &resources, int width, int height)
+	{
+		double start = glfwGetTime();
+		bool timing = queryHead - queryTail < SHADOW_QUERIES;
+		if (timing)
+			glQueryCounter(queries[2 * (queryHead % SHADOW_QUERIES)], GL_TIMESTAMP);
+
+		// Everything is recorded first, the rings are committed before the draws
+		passCount = 0;
+		commandCount = 0;
+		casterCount = 0;
+		matrices = NULL;
+		commands = NULL;
+		GLintptr paramsOffset = 0;
+		ShadowParams *params = NULL;
+		if (casterRing.beginFrame())
+		{
+			matrices = (glm::mat4 *)casterRing.allocate(capacity * sizeof(glm::mat4), &matricesOffset);
+			params = (ShadowParams *)casterRing.allocate(sizeof(ShadowParams), &paramsOffset);
+		}
+		if (commandRing.beginFrame())
+			commands = (DrawElementsIndirectCommand *)commandRing.allocate(capacity * sizeof(DrawElementsIndirectCommand), &commandsOffset);
+		bool redraw[SHADOW_VIEWS];
+		for (int v = 0; v < SHADOW_VIEWS; v++)
+		{
+			const ShadowView &view = frame.views[v];
+			redraw[v] = caching && !(cached[v] && cachedKeys[v] == view.staticKey);
+			if (!caching)
+				record(frame, v, view.first, view.staticCount + view.dynamicCount, resources, false);
+			else
+			{
+				if (redraw[v])
+					record(frame, v, view.first, view.staticCount, resources, true);
+				record(frame, v, view.first + view.staticCount, view.dynamicCount, resources, false);
+			}
+			if (redraw[v])
+			{
+				cachedKeys[v] = view.staticKey;
+				cached[v] = matrices && commands;
+			}
+			if (!caching || redraw[v])
+			{
+				stats.redrawnViews++;
+				stats.staticCasters += view.staticCount;
+			}
+			stats.dynamicCasters += view.dynamicCount;
+		}
+		if (params)
+		{
+			// Depth -1..1 to 0..1, then the cascade's quarter of the atlas
+			for (int c = 0; c < SHADOW_CASCADES; c++)
+			{
+				glm::mat4 toAtlas(1.0f);
+				toAtlas[0][0] = toAtlas[1][1] = 0.25f;
+				toAtlas[2][2] = 0.5f;
+				toAtlas[3] = glm::vec4(0.25f + 0.5f * (c & 1), 0.25f + 0.5f * (c >> 1), 0.5f, 1.0f);
+				params->cascades[c] = toAtlas * frame.views[c].viewProjection;
+			}
+			params->splits = frame.splits;
+			params->texels = frame.texels;
+			params->sun = glm::vec4(frame.sunDirection, SHADOW_SUN_POWER);
+			params->light = glm::vec4(frame.lightPos, 1.0f);
+			params->cube = glm::vec4(SHADOW_CUBE_NEAR, frame.lightFar, 2.0f / SHADOW_CUBE_SIZE, 0.0f);
+		}
+		casterRing.commit();
+		commandRing.commit();
+
+		glUseProgram(program);
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, casterRing.buffer(), matricesOffset, capacity * sizeof(glm::mat4));
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandRing.buffer());
+		glEnable(GL_SCISSOR_TEST);
+		if (!caching)
+		{
+			clear(atlas, cube);
+			draw(false);
+		}
+		else
+		{
+			// Static casters of the views that changed, then the static maps under the dynamic casters
+			for (int v = 0; v < SHADOW_VIEWS; v++)
+				if (redraw[v])
+				{
+					target(staticAtlas, staticCube, v);
+					glClear(GL_DEPTH_BUFFER_BIT);
+				}
+			draw(true);
+			copy();
+			draw(false);
+		}
+		glDisable(GL_SCISSOR_TEST);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, width, height);
+
+		// For the scene
+		if (params)
+			glBindBufferRange(GL_SHADER_STORAGE_BUFFER, SHADOW_BINDING_PARAMS, casterRing.buffer(), paramsOffset, sizeof(ShadowParams));
+		glActiveTexture(GL_TEXTURE0 + SHADOW_UNIT_CASCADES);
+		glBindTexture(GL_TEXTURE_2D, atlas);
+		glActiveTexture(GL_TEXTURE0 + SHADOW_UNIT_CUBE);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, cube);
+		glActiveTexture(GL_TEXTURE0);
+
+		if (timing)
+		{
+			glQueryCounter(queries[2 * (queryHead % SHADOW_QUERIES) + 1], GL_TIMESTAMP);
+			queryHead++;
+		}
+		stats.frames++;
+		stats.cpu.add(glfwGetTime() - start);
+	}
+
+	// After the swap
+	void endFrame()
+	{
+		casterRing.endFrame();
+		commandRing.endFrame();
+		// Pairs come back in order
+		while (queryTail < queryHead)
+		{
+			GLuint *pair = queries + 2 * (queryTail % SHADOW_QUERIES);
+			GLint available = 0;
+			glGetQueryObjectiv(pair[1], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				break;
+			GLuint64 begin = 0, end = 0;
+			glGetQueryObjectui64v(pair[0], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(pair[1], GL_QUERY_RESULT, &end);
+			stats.gpu.add((end - begin) * 1e-9);
+			queryTail++;
+		}
+	}
+
+	bool cache() const { return caching; }
+
+	ShadowStats takeStats()
+	{
+		ShadowStats s = stats;
+		resetStats();
+		return s;
+	}
+
+private:
+	ShadowRenderer(const ShadowRenderer &);
+	ShadowRenderer &operator=(const ShadowRenderer &);
+
+	// Commands of one view drawn into the static or the live maps
+	struct Pass
+	{
+		int view;
+		bool toStatic;
+		uint32_t firstCommand;
+		uint32_t commandCount;
+	};
+
+	void resetStats()
+	{
+		stats.frames = stats.redrawnViews = stats.dropped = 0;
+		stats.staticCasters = stats.dynamicCasters = 0.0;
+		stats.cpu.reset();
+		stats.gpu.reset();
+	}
+
+	GLuint createTexture(GLenum target, int size)
+	{
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(target, texture);
+		if (target == GL_TEXTURE_CUBE_MAP)
+			for (int f = 0; f < SHADOW_CUBE_FACES; f++)
+				glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + f, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+		else
+			glTexImage2D(target, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+		// Compared on lookup, 2 x 2 PCF from the linear filter
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(target, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(target, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		glBindTexture(target, 0);
+		return texture;
+	}
+
+	// Commands for `count` casters of the view from `first` in the indices, one per run of a mesh
+	void record(const ShadowFrame &frame, int v, uint32_t first, uint32_t count, const GpuResources &resources, bool toStatic)
+	{
+		if (!count)
+			return;
+		if (!matrices || !commands || passCount == SHADOW_VIEWS * 2)
+		{
+			stats.dropped += count;
+			return;
+		}
+		Pass &pass = passes[passCount++];
+		pass.view = v;
+		pass.toStatic = toStatic;
+		pass.firstCommand = commandCount;
+		const glm::mat4 &viewProjection = frame.views[v].viewProjection;
+		uint32_t currentMesh = 0;
+		const GpuMesh *mesh = NULL;
+		DrawElementsIndirectCommand *command = NULL;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const ShadowCaster &caster = frame.casters[frame.indices[first + i]];
+			if (caster.mesh != currentMesh || !command)
+			{
+				currentMesh = caster.mesh;
+				mesh = resources.mesh(MeshId::fromValue(caster.mesh));
+				command = NULL;
+				if (!mesh || !mesh->bank.indexCount)
+					continue;
+				if (commandCount == capacity)
+					break;
+				command = &commands[commandCount++];
+				command->count = mesh->bank.indexCount;
+				command->instanceCount = 0;
+				command->firstIndex = mesh->bank.firstIndex;
+				command->baseVertex = mesh->bank.baseVertex;
+				command->baseInstance = casterCount;
+			}
+			if (casterCount == capacity)
+			{
+				stats.dropped += count - i;
+				break;
+			}
+			matrices[casterCount++] = viewProjection * caster.model;
+			command->instanceCount++;
+		}
+		pass.commandCount = commandCount - pass.firstCommand;
+	}
+
+	// Binds the depth of view `v` in the atlas or the cube map for drawing
+	void target(GLuint atlasTexture, GLuint cubeTexture, int v)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, drawFramebuffer);
+		if (v < SHADOW_CASCADES)
+		{
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, atlasTexture, 0);
+			int x = (v & 1) * SHADOW_CASCADE_SIZE, y = (v >> 1) * SHADOW_CASCADE_SIZE;
+			glViewport(x, y, SHADOW_CASCADE_SIZE, SHADOW_CASCADE_SIZE);
+			glScissor(x, y, SHADOW_CASCADE_SIZE, SHADOW_CASCADE_SIZE);
+		}
+		else
+		{
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + v - SHADOW_CASCADES, cubeTexture, 0);
+			glViewport(0, 0, SHADOW_CUBE_SIZE, SHADOW_CUBE_SIZE);
+			glScissor(0, 0, SHADOW_CUBE_SIZE, SHADOW_CUBE_SIZE);
+		}
+	}
+
+	void clear(GLuint atlasTexture, GLuint cubeTexture)
+	{
+		target(atlasTexture, cubeTexture, 0);
+		glScissor(0, 0, 2 * SHADOW_CASCADE_SIZE, 2 * SHADOW_CASCADE_SIZE);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		for (int f = 0; f < SHADOW_CUBE_FACES; f++)
+		{
+			target(atlasTexture, cubeTexture, SHADOW_CASCADES + f);
+			glClear(GL_DEPTH_BUFFER_BIT);
+		}
+	}
+
+	// The passes of the static or the live maps
+	void draw(bool toStatic)
+	{
+		for (uint32_t p = 0; p < passCount; p++)
+		{
+			const Pass &pass = passes[p];
+			if (pass.toStatic != toStatic || !pass.commandCount)
+				continue;
+			if (toStatic)
+				target(staticAtlas, staticCube, pass.view);
+			else
+				target(atlas, cube, pass.view);
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)(commandsOffset + pass.firstCommand * sizeof(DrawElementsIndirectCommand)),
+										pass.commandCount, 0);
+		}
+	}
+
+	// Static maps to the live ones
+	void copy()
+	{
+		glDisable(GL_SCISSOR_TEST);
+		for (int f = -1; f < SHADOW_CUBE_FACES; f++)
+		{
+			GLenum face = f < 0 ? GL_TEXTURE_2D : GL_TEXTURE_CUBE_MAP_POSITIVE_X + f;
+			int size = f < 0 ? 2 * SHADOW_CASCADE_SIZE : SHADOW_CUBE_SIZE;
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+			glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, face, f < 0 ? staticAtlas : staticCube, 0);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFramebuffer);
+			glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, face, f < 0 ? atlas : cube, 0);
+			glBlitFramebuffer(0, 0, size, size, 0, 0, size, size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		}
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		glEnable(GL_SCISSOR_TEST);
+	}
+
+	GLuint program;
+	GLuint atlas;
+	GLuint cube;
+	GLuint staticAtlas; // static casters only
+	GLuint staticCube;
+	GLuint drawFramebuffer;
+	GLuint readFramebuffer;
+	bool caching;
+	uint64_t cachedKeys[SHADOW_VIEWS];
+	bool cached[SHADOW_VIEWS];
+	StreamRing casterRing; // matrices of the casters and the ShadowParams
+	StreamRing commandRing;
+	uint32_t capacity; // casters and commands of a frame
+	glm::mat4 *matrices;
+	DrawElementsIndirectCommand *commands;
+	GLintptr matricesOffset;
+	GLintptr commandsOffset;
+	uint32_t casterCount;
+	uint32_t commandCount;
+	Pass passes[SHADOW_VIEWS * 2];
+	uint32_t passCount;
+	GLuint queries[2 * SHADOW_QUERIES];
+	uint64_t queryHead; // next pair to write
+	uint64_t queryTail; // oldest pair not read back
+	ShadowStats stats;
+};
+
+#endif
@@ -0,0 +1,273 @@
+#ifndef SHADOWVIEWS_HPP
+#define SHADOWVIEWS_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "arena.hpp"
+#include "entities.hpp"
+#include "jobs.hpp"
+
+// Shadow views of a frame and the casters each of them draws.
+// The sun gets SHADOW_CASCADES cascades : the view frustum is cut into depth
+// slices, each covered by an orthographic view along the sun. A slice is
+// bounded by a sphere, so its cascade keeps its size when the camera turns,
+// and the cascade moves by whole texels, so shadows do not shimmer. The point
+// light gets the SHADOW_CUBE_FACES 90 degree views of a cube map.
+//
+// Casters are split by mobility, entities without Animation are static. Per
+// view, the matrix and the static casters are hashed into a key : the
+// renderer keeps the static shadows of a view while its key holds and only
+// draws the dynamic casters over them.
+//
+// Culling runs on the job system, one job per view. Everything of the frame
+// lives in its arena.
+
+#define SHADOW_CASCADES 4
+#define SHADOW_CUBE_FACES 6
+#define SHADOW_VIEWS (SHADOW_CASCADES + SHADOW_CUBE_FACES) // cascades, then the faces in GL order
+#define SHADOW_CASCADE_SIZE 1024						   // texels, side of a cascade
+#define SHADOW_CUBE_SIZE 512							   // texels, side of a face
+#define SHADOW_CUBE_NEAR 0.05f
+
+struct ShadowCaster
+{
+	glm::mat4 model;
+	uint32_t mesh; // MeshId value
+	uint32_t isStatic;
+	glm::vec3 center; // world bounds
+	float radius;
+};
+
+struct ShadowView
+{
+	glm::mat4 viewProjection;
+	uint32_t first; // casters of the view in ShadowFrame::indices, the static ones first
+	uint32_t staticCount;
+	uint32_t dynamicCount;
+	uint64_t staticKey; // the static shadows of the view stay the same while it does
+};
+
+struct ShadowFrame
+{
+	FrameArray<ShadowCaster> casters;
+	FrameArray<uint32_t> indices;
+	ShadowView views[SHADOW_VIEWS];
+	glm::vec4 splits;		// view distance where each cascade ends
+	glm::vec4 texels;		// world size of a texel of each cascade
+	glm::vec3 sunDirection; // to the sun
+	glm::vec3 lightPos;
+	float lightFar; // of the face projections
+	double seconds; // building time
+};
+
+class ShadowBuilder
+{
+public:
+	// Every caster stays within `sceneRadius` of `sceneCenter`. The cascades
+	// cover the view up to `distance`.
+	ShadowBuilder(const glm::vec3 &sunDirection, const glm::vec3 &sceneCenter, float sceneRadius, float distance)
+		: sunDirection(glm::normalize(sunDirection)), sceneCenter(sceneCenter), sceneRadius(sceneRadius), distance(distance)
+	{
+	}
+
+	// Views of the frame for the camera `view` and symmetric perspective `projection`,
+	// with the casters of `chunks` as transformSystem left them
+	ShadowFrame build(JobSystem &jobs, FrameArena &frame, const std::vector<Chunk *> &chunks, const glm::mat4 &view,
+					  const glm::mat4 &projection, const glm::vec3 &lightPos)
+	{
+		double start = now();
+		ShadowFrame out;
+		out.sunDirection = sunDirection;
+		out.lightPos = lightPos;
+		out.lightFar = glm::length(lightPos - sceneCenter) + sceneRadius;
+
+		// Casters, a fixed window per chunk
+		const uint32_t casterMask = COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_MESH) | COMPONENT_BIT(COMPONENT_BOUNDS);
+		FrameArray<uint32_t> firsts(frame, chunks.size() + 1);
+		firsts[0] = 0;
+		for (size_t c = 0; c < chunks.size(); c++)
+			firsts[c + 1] = firsts[c] + ((chunks[c]->archetype->mask & casterMask) == casterMask ? chunks[c]->count : 0);
+		uint32_t count = firsts[chunks.size()];
+		out.casters = FrameArray<ShadowCaster>(frame, count);
+		jobs.parallelFor((uint32_t)chunks.size(), 4, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t c = begin; c < end; c++)
+				if (firsts[c + 1] > firsts[c])
+					gatherChunk(*chunks[c], out.casters.data() + firsts[c]);
+		});
+
+		// Views
+		Volume volumes[SHADOW_VIEWS];
+		cascades(view, projection, out, volumes);
+		faces(out, volumes);
+
+		// Casters of each view, in its own window of the indices
+		out.indices = FrameArray<uint32_t>(frame, (size_t)count * SHADOW_VIEWS);
+		jobs.parallelFor(SHADOW_VIEWS, 1, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t v = begin; v < end; v++)
+				cull(out, volumes[v], v, v * count);
+		});
+		out.seconds = now() - start;
+		return out;
+	}
+
+private:
+	// What a view sees : the box of a cascade or the pyramid of a face
+	struct Volume
+	{
+		glm::mat4 lightView; // cascades
+		float extent;		 // half size of a cascade
+		float depth;		 // far plane
+		glm::vec3 axis;		 // faces : the look direction and the two others
+		glm::vec3 side0;
+		glm::vec3 side1;
+		bool face;
+	};
+
+	static double now() { return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+	static void gatherChunk(Chunk &chunk, ShadowCaster *casters)
+	{
+		Transform *transform = chunk.array<Transform>();
+		MeshHandle *mesh = chunk.array<MeshHandle>();
+		Bounds *bounds = chunk.array<Bounds>();
+		uint32_t isStatic = (chunk.archetype->mask & COMPONENT_BIT(COMPONENT_ANIMATION)) == 0;
+		for (uint32_t i = 0; i < chunk.count; i++)
+		{
+			casters[i].model = transform[i].model;
+			casters[i].mesh = mesh[i].id;
+			casters[i].isStatic = isStatic;
+			casters[i].center = bounds[i].worldCenter;
+			casters[i].radius = bounds[i].worldRadius;
+		}
+	}
+
+	void cascades(const glm::mat4 &view, const glm::mat4 &projection, ShadowFrame &out, Volume *volumes) const
+	{
+		float near = projection[3][2] / (projection[2][2] - 1.0f);
+		float far = std::min(projection[3][2] / (projection[2][2] + 1.0f), distance);
+		glm::mat4 toWorld = glm::inverse(view);
+		glm::vec3 up = fabsf(sunDirection.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+		float sliceNear = near;
+		for (int c = 0; c < SHADOW_CASCADES; c++)
+		{
+			// Between logarithmic and even splits
+			float t = (float)(c + 1) / SHADOW_CASCADES;
+			float sliceFar = 0.6f * near * powf(far / near, t) + 0.4f * (near + (far - near) * t);
+			out.splits[c] = sliceFar;
+
+			// Smallest sphere around the slice, centered on the view axis
+			float nearSquared = sliceNear * sliceNear * (1.0f / (projection[0][0] * projection[0][0]) + 1.0f / (projection[1][1] * projection[1][1]));
+			float farSquared = sliceFar * sliceFar * (1.0f / (projection[0][0] * projection[0][0]) + 1.0f / (projection[1][1] * projection[1][1]));
+			float center = 0.5f * (sliceNear + sliceFar) + (farSquared - nearSquared) / (2.0f * (sliceFar - sliceNear));
+			center = std::max(sliceNear, std::min(sliceFar, center));
+			float radius = sqrtf(std::max(nearSquared + (center - sliceNear) * (center - sliceNear),
+										  farSquared + (sliceFar - center) * (sliceFar - center)));
+			// Sizes in steps of 1/16, so a moving camera does not rescale the texels every frame
+			radius = ceilf(radius * 16.0f) / 16.0f;
+			glm::vec3 centerWorld = glm::vec3(toWorld * glm::vec4(0.0f, 0.0f, -center, 1.0f));
+
+			// From beyond every caster towards the slice
+			float back = glm::length(centerWorld - sceneCenter) + sceneRadius;
+			glm::mat4 lightView = glm::lookAt(centerWorld + sunDirection * back, centerWorld, up);
+			glm::mat4 lightProjection = glm::ortho(-radius, radius, -radius, radius, 0.0f, back + radius);
+			// Whole texels : the world origin lands on a texel corner
+			glm::vec4 origin = lightProjection * lightView * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+			float half = SHADOW_CASCADE_SIZE * 0.5f;
+			lightProjection[3][0] += (floorf(origin.x * half + 0.5f) - origin.x * half) / half;
+			lightProjection[3][1] += (floorf(origin.y * half + 0.5f) - origin.y * half) / half;
+
+			out.views[c].viewProjection = lightProjection * lightView;
+			out.texels[c] = 2.0f * radius / SHADOW_CASCADE_SIZE;
+			volumes[c].lightView = lightView;
+			volumes[c].extent = radius;
+			volumes[c].depth = back + radius;
+			volumes[c].face = false;
+			sliceNear = sliceFar;
+		}
+	}
+
+	static void faces(ShadowFrame &out, Volume *volumes)
+	{
+		// Look and up directions of the cube map faces, +X -X +Y -Y +Z -Z
+		static const float directions[SHADOW_CUBE_FACES][6] = {{1, 0, 0, 0, -1, 0}, {-1, 0, 0, 0, -1, 0}, {0, 1, 0, 0, 0, 1},
+															   {0, -1, 0, 0, 0, -1}, {0, 0, 1, 0, -1, 0}, {0, 0, -1, 0, -1, 0}};
+		glm::mat4 projection = glm::frustum(-SHADOW_CUBE_NEAR, SHADOW_CUBE_NEAR, -SHADOW_CUBE_NEAR, SHADOW_CUBE_NEAR, SHADOW_CUBE_NEAR, out.lightFar);
+		for (int f = 0; f < SHADOW_CUBE_FACES; f++)
+		{
+			glm::vec3 axis(directions[f][0], directions[f][1], directions[f][2]);
+			glm::vec3 up(directions[f][3], directions[f][4], directions[f][5]);
+			Volume &volume = volumes[SHADOW_CASCADES + f];
+			out.views[SHADOW_CASCADES + f].viewProjection = projection * glm::lookAt(out.lightPos, out.lightPos + axis, up);
+			volume.axis = axis;
+			volume.side0 = up;
+			volume.side1 = glm::cross(axis, up);
+			volume.depth = out.lightFar;
+			volume.face = true;
+		}
+	}
+
+	static bool visible(const Volume &volume, const ShadowFrame &frame, const ShadowCaster &caster)
+	{
+		if (volume.face)
+		{
+			// Side planes of a 90 degree pyramid are at 45 degrees from its axis
+			glm::vec3 p = caster.center - frame.lightPos;
+			float ahead = glm::dot(p, volume.axis);
+			float slack = caster.radius * 1.41421356f;
+			return ahead + caster.radius > SHADOW_CUBE_NEAR && ahead - caster.radius < volume.depth &&
+				   ahead - fabsf(glm::dot(p, volume.side0)) > -slack && ahead - fabsf(glm::dot(p, volume.side1)) > -slack;
+		}
+		glm::vec3 p = glm::vec3(volume.lightView * glm::vec4(caster.center, 1.0f));
+		return fabsf(p.x) < volume.extent + caster.radius && fabsf(p.y) < volume.extent + caster.radius && -p.z + caster.radius > 0.0f &&
+			   -p.z - caster.radius < volume.depth;
+	}
+
+	// FNV-1a
+	static uint64_t hash(uint64_t h, const void *data, size_t size)
+	{
+		const unsigned char *bytes = (const unsigned char *)data;
+		for (size_t i = 0; i < size; i++)
+			h = (h ^ bytes[i]) * 1099511628211ull;
+		return h;
+	}
+
+	static void cull(ShadowFrame &out, const Volume &volume, uint32_t v, uint32_t first)
+	{
+		ShadowView &view = out.views[v];
+		uint32_t count = (uint32_t)out.casters.size();
+		uint32_t *indices = out.indices.data() + first;
+		uint64_t key = hash(14695981039346656037ull, &view.viewProjection, sizeof(view.viewProjection));
+		uint32_t n = 0;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const ShadowCaster &caster = out.casters[i];
+			if (caster.isStatic && visible(volume, out, caster))
+			{
+				indices[n++] = i;
+				key = hash(key, &caster.model, sizeof(caster.model));
+				key = hash(key, &caster.mesh, sizeof(caster.mesh));
+			}
+		}
+		view.staticCount = n;
+		for (uint32_t i = 0; i < count; i++)
+			if (!out.casters[i].isStatic && visible(volume, out, out.casters[i]))
+				indices[n++] = i;
+		view.first = first;
+		view.dynamicCount = n - view.staticCount;
+		view.staticKey = key;
+	}
+
+	glm::vec3 sunDirection;
+	glm::vec3 sceneCenter;
+	float sceneRadius;
+	float distance;
+};
+
+#endif
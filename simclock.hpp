@@ -0,0 +1,70 @@
+#ifndef SIMCLOCK_HPP
+#define SIMCLOCK_HPP
+
+#include <stdint.h>
+
+// Fixed timestep simulation clock.
+// The simulation always advances by the same step, so what it computes no
+// longer depends on how long the frames took : real time is added to an
+// accumulator and spent in whole steps, the remainder (alpha, in [0, 1[) is
+// how far the rendered frame is between the last two simulated states.
+//
+// Offline, real time is ignored : every frame runs a fixed number of steps,
+// as fast as the machine goes, and a run gives the same states on any machine.
+
+class SimulationClock
+{
+public:
+	// `maxSteps` bounds the steps of one frame : after a long stall the
+	// simulation falls behind real time instead of taking ever longer frames
+	explicit SimulationClock(double step = 1.0 / 60.0, uint32_t maxSteps = 8)
+		: step(step), maxSteps(maxSteps), offlineSteps(0), accumulator(0.0), steps(0), dropped(0)
+	{
+	}
+
+	// Fixed steps per frame from now on, 0 to follow real time again
+	void setOffline(uint32_t stepsPerFrame) { offlineSteps = stepsPerFrame; }
+	bool offline() const { return offlineSteps != 0; }
+
+	// Steps to run for a frame that took `realSeconds`
+	uint32_t advance(double realSeconds)
+	{
+		if (offlineSteps)
+		{
+			steps += offlineSteps;
+			return offlineSteps;
+		}
+		accumulator += realSeconds;
+		uint32_t count = (uint32_t)(accumulator / step);
+		if (count > maxSteps)
+		{
+			dropped += count - maxSteps;
+			count = maxSteps;
+			accumulator = 0.0;
+		}
+		else
+			accumulator -= count * step;
+		steps += count;
+		return count;
+	}
+
+	// Between the state before the last step (0) and after it (1)
+	float alpha() const { return offlineSteps ? 1.0f : (float)(accumulator / step); }
+
+	double stepSeconds() const { return step; }
+	uint64_t stepCount() const { return steps; }
+	// Simulated seconds of the rendered frame, interpolated like the states
+	double time() const { return steps ? (steps - 1 + alpha()) * step : 0.0; }
+	// Steps skipped because a frame needed more than `maxSteps`
+	uint64_t droppedSteps() const { return dropped; }
+
+private:
+	double step;
+	uint32_t maxSteps;
+	uint32_t offlineSteps;
+	double accumulator;
+	uint64_t steps;
+	uint64_t dropped;
+};
+
+#endif
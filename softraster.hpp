@@ -0,0 +1,592 @@
+#ifndef SOFTRASTER_HPP
+#define SOFTRASTER_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <algorithm>
+#include <glm/glm.hpp>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "jobs.hpp"
+
+// Software rendering backend, for machines without a GPU.
+// Draws the same data as the GL path (triangle lists of separate xyz position,
+// color and normal streams, optionally indexed) with the same MVP / M / V
+// matrices and the StandardShading lighting of step8, into an RGBA8 image.
+//
+// A frame runs in two parallel phases on the job system :
+//   draw()     : vertex shading, near plane clipping, triangle setup, then
+//                binning of the triangles into 64x64 screen tiles
+//   endFrame() : every tile is rasterized by one job. Edge functions are
+//                evaluated 8 pixels at a time (AVX2 when compiled for it),
+//                depth is tested against a two level hierarchical depth
+//                buffer (8x8 blocks, then the tile) so hidden triangles and
+//                blocks are skipped, and only the visible pixel of each
+//                position is shaded once all the triangles are in.
+// Tiles keep the submission order of their triangles, so images are the same
+// for any thread count. Rows go bottom to top, like glReadPixels.
+
+#define SOFT_TILE_SIZE 64
+#define SOFT_BLOCK_SIZE 8
+#define SOFT_SETUP_CHUNK 4096 // triangles per setup / binning job
+
+// Vertex shader output
+struct SoftVertex
+{
+	glm::vec4 clip;
+	glm::vec3 world;
+	glm::vec3 normal; // camera space
+	glm::vec3 color;
+};
+
+// Counter-clockwise on screen, vertices in window coordinates
+struct SoftTriangle
+{
+	float x[3];
+	float y[3];
+	float z[3];
+	float minZ;
+	const SoftVertex *v[3];
+	int16_t minX, minY, maxX, maxY; // pixels, inclusive
+};
+
+struct SoftRasterStats
+{
+	uint32_t draws;
+	uint64_t triangles;      // submitted
+	uint64_t clipped;        // crossing the near plane
+	uint64_t culled;         // outside the frustum, degenerate or between pixel centers
+	uint64_t binned;         // triangle / tile pairs
+	uint64_t tilesRejected;  // pairs hidden by the depth of the tile
+	uint64_t blocksTested;   // triangle / 8x8 block pairs
+	uint64_t blocksRejected; // hidden by the depth of the block
+	uint64_t pixelsShaded;
+	double geometrySeconds;  // vertex, setup and binning, every draw
+	double rasterSeconds;    // raster and shading of the tiles
+
+	SoftRasterStats() { reset(); }
+
+	void reset()
+	{
+		draws = 0;
+		triangles = clipped = culled = binned = tilesRejected = blocksTested = blocksRejected = pixelsShaded = 0;
+		geometrySeconds = rasterSeconds = 0.0;
+	}
+};
+
+class SoftRasterizer
+{
+public:
+	SoftRasterizer(JobSystem &jobs, int width, int height)
+		: jobs(jobs), width(width), height(height), vertexBlocksUsed(0), chunksUsed(0)
+	{
+		tilesX = (width + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+		tilesY = (height + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+		bins.resize(tilesX * tilesY);
+		scratch.resize(jobs.threadCount());
+		color.resize(width * height);
+	}
+
+	~SoftRasterizer()
+	{
+		for (size_t c = 0; c < chunks.size(); c++)
+			delete chunks[c];
+	}
+
+	void beginFrame(const glm::mat4 &viewMatrix, const glm::vec3 &lightPosition, const glm::vec3 &clearColor)
+	{
+		view = viewMatrix;
+		lightPos = lightPosition;
+		lightCamera = glm::vec3(view * glm::vec4(lightPos, 1.0f));
+		clear = packColor(clearColor);
+		vertexBlocksUsed = 0;
+		chunksUsed = 0;
+		for (size_t t = 0; t < bins.size(); t++)
+			bins[t].clear();
+		frameStats.reset();
+	}
+
+	// Triangle list of `vertexCount` vertices, or of `indexCount` indices when `indices` is given
+	void draw(const float *positions, const float *colors, const float *normals, uint32_t vertexCount,
+			  const uint32_t *indices, uint32_t indexCount, const glm::mat4 &mvp, const glm::mat4 &model)
+	{
+		double start = now();
+		frameStats.draws++;
+
+		// Vertex stage
+		if (vertexBlocksUsed == vertexBlocks.size())
+			vertexBlocks.push_back(std::vector<SoftVertex>());
+		std::vector<SoftVertex> &vertices = vertexBlocks[vertexBlocksUsed++];
+		vertices.resize(vertexCount);
+		glm::mat4 modelView = view * model;
+		jobs.parallelFor(vertexCount, 1024, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++)
+			{
+				glm::vec4 p(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2], 1.0f);
+				SoftVertex &v = vertices[i];
+				v.clip = mvp * p;
+				v.world = glm::vec3(model * p);
+				v.normal = glm::vec3(modelView * glm::vec4(normals[3 * i], normals[3 * i + 1], normals[3 * i + 2], 0.0f));
+				v.color = glm::vec3(colors[3 * i], colors[3 * i + 1], colors[3 * i + 2]);
+			}
+		});
+
+		// Setup, one output chunk per job
+		uint32_t triangleCount = (indices ? indexCount : vertexCount) / 3;
+		uint32_t chunkCount = (triangleCount + SOFT_SETUP_CHUNK - 1) / SOFT_SETUP_CHUNK;
+		uint32_t firstChunk = chunksUsed;
+		while (chunks.size() < chunksUsed + chunkCount)
+			chunks.push_back(new SetupChunk());
+		chunksUsed += chunkCount;
+		jobs.parallelFor(chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t c = begin; c < end; c++)
+			{
+				SetupChunk &chunk = *chunks[firstChunk + c];
+				chunk.triangles.clear();
+				chunk.clipped.clear();
+				chunk.clippedCount = chunk.culledCount = 0;
+				uint32_t last = std::min(triangleCount, (c + 1) * SOFT_SETUP_CHUNK);
+				for (uint32_t t = c * SOFT_SETUP_CHUNK; t < last; t++)
+				{
+					uint32_t i0 = indices ? indices[3 * t] : 3 * t;
+					uint32_t i1 = indices ? indices[3 * t + 1] : 3 * t + 1;
+					uint32_t i2 = indices ? indices[3 * t + 2] : 3 * t + 2;
+					setupTriangle(chunk, &vertices[i0], &vertices[i1], &vertices[i2]);
+				}
+			}
+		});
+
+		// Binning : count the triangles of each chunk per tile, then every chunk
+		// writes its own window of each bin, which keeps the submission order
+		uint32_t tileCount = (uint32_t)bins.size();
+		binOffsets.assign(chunkCount * tileCount, 0);
+		jobs.parallelFor(chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t c = begin; c < end; c++)
+			{
+				uint32_t *counts = &binOffsets[c * tileCount];
+				const std::vector<SoftTriangle> &triangles = chunks[firstChunk + c]->triangles;
+				for (size_t t = 0; t < triangles.size(); t++)
+					for (int ty = triangles[t].minY / SOFT_TILE_SIZE; ty <= triangles[t].maxY / SOFT_TILE_SIZE; ty++)
+						for (int tx = triangles[t].minX / SOFT_TILE_SIZE; tx <= triangles[t].maxX / SOFT_TILE_SIZE; tx++)
+							counts[ty * tilesX + tx]++;
+			}
+		});
+		for (uint32_t tile = 0; tile < tileCount; tile++)
+		{
+			uint32_t offset = (uint32_t)bins[tile].size();
+			for (uint32_t c = 0; c < chunkCount; c++)
+			{
+				uint32_t count = binOffsets[c * tileCount + tile];
+				binOffsets[c * tileCount + tile] = offset;
+				offset += count;
+			}
+			frameStats.binned += offset - bins[tile].size();
+			bins[tile].resize(offset);
+		}
+		jobs.parallelFor(chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t c = begin; c < end; c++)
+			{
+				uint32_t *offsets = &binOffsets[c * tileCount];
+				const std::vector<SoftTriangle> &triangles = chunks[firstChunk + c]->triangles;
+				for (size_t t = 0; t < triangles.size(); t++)
+					for (int ty = triangles[t].minY / SOFT_TILE_SIZE; ty <= triangles[t].maxY / SOFT_TILE_SIZE; ty++)
+						for (int tx = triangles[t].minX / SOFT_TILE_SIZE; tx <= triangles[t].maxX / SOFT_TILE_SIZE; tx++)
+							bins[ty * tilesX + tx][offsets[ty * tilesX + tx]++] = &triangles[t];
+			}
+		});
+
+		frameStats.triangles += triangleCount;
+		for (uint32_t c = 0; c < chunkCount; c++)
+		{
+			frameStats.clipped += chunks[firstChunk + c]->clippedCount;
+			frameStats.culled += chunks[firstChunk + c]->culledCount;
+		}
+		frameStats.geometrySeconds += now() - start;
+	}
+
+	// Rasterizes and shades every tile
+	void endFrame()
+	{
+		double start = now();
+		for (size_t s = 0; s < scratch.size(); s++)
+			scratch[s].stats.reset();
+		jobs.parallelFor((uint32_t)bins.size(), 1, [&](uint32_t begin, uint32_t end) {
+			TileScratch &tile = scratch[jobThreadIndex()];
+			for (uint32_t t = begin; t < end; t++)
+				rasterTile(t, tile);
+		});
+		for (size_t s = 0; s < scratch.size(); s++)
+		{
+			frameStats.tilesRejected += scratch[s].stats.tilesRejected;
+			frameStats.blocksTested += scratch[s].stats.blocksTested;
+			frameStats.blocksRejected += scratch[s].stats.blocksRejected;
+			frameStats.pixelsShaded += scratch[s].stats.pixelsShaded;
+		}
+		frameStats.rasterSeconds = now() - start;
+	}
+
+	// RGBA8, R in the low byte, rows from the bottom
+	const uint32_t *pixels() const { return color.data(); }
+	int imageWidth() const { return width; }
+	int imageHeight() const { return height; }
+	const SoftRasterStats &stats() const { return frameStats; }
+
+private:
+	struct SetupChunk
+	{
+		std::vector<SoftTriangle> triangles;
+		std::deque<SoftVertex> clipped; // vertices made by clipping, their addresses stay put
+		uint32_t clippedCount;
+		uint32_t culledCount;
+	};
+
+	struct TileScratch
+	{
+		float depth[SOFT_TILE_SIZE * SOFT_TILE_SIZE];
+		float l1[SOFT_TILE_SIZE * SOFT_TILE_SIZE]; // barycentric weights of vertices 1 and 2
+		float l2[SOFT_TILE_SIZE * SOFT_TILE_SIZE];
+		const SoftTriangle *triangle[SOFT_TILE_SIZE * SOFT_TILE_SIZE];
+		float blockMax[(SOFT_TILE_SIZE / SOFT_BLOCK_SIZE) * (SOFT_TILE_SIZE / SOFT_BLOCK_SIZE)];
+		SoftRasterStats stats;
+	};
+
+	// Edge functions of a triangle in one tile : E_i = a_i * x + b_i * y + c_i,
+	// the weight of vertex i times twice the area
+	struct Edges
+	{
+		float a[3], b[3], c[3];
+		bool topLeft[3]; // pixels exactly on the edge belong to this triangle
+		float invArea;
+		float z0, dz1, dz2;
+	};
+
+	static double now()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static uint32_t packColor(const glm::vec3 &c)
+	{
+		uint32_t r = (uint32_t)(glm::clamp(c.x, 0.0f, 1.0f) * 255.0f + 0.5f);
+		uint32_t g = (uint32_t)(glm::clamp(c.y, 0.0f, 1.0f) * 255.0f + 0.5f);
+		uint32_t b = (uint32_t)(glm::clamp(c.z, 0.0f, 1.0f) * 255.0f + 0.5f);
+		return r | (g << 8) | (b << 16) | 0xff000000u;
+	}
+
+	static SoftVertex lerp(const SoftVertex &a, const SoftVertex &b, float t)
+	{
+		SoftVertex v;
+		v.clip = a.clip + (b.clip - a.clip) * t;
+		v.world = a.world + (b.world - a.world) * t;
+		v.normal = a.normal + (b.normal - a.normal) * t;
+		v.color = a.color + (b.color - a.color) * t;
+		return v;
+	}
+
+	// Outside bits of a clip space position : -x, +x, -y, +y, near, far
+	static uint32_t outcode(const glm::vec4 &p)
+	{
+		return (p.x < -p.w) | ((p.x > p.w) << 1) | ((p.y < -p.w) << 2) | ((p.y > p.w) << 3) | ((p.z < -p.w) << 4) |
+			   ((p.z > p.w) << 5);
+	}
+
+	void setupTriangle(SetupChunk &chunk, const SoftVertex *v0, const SoftVertex *v1, const SoftVertex *v2)
+	{
+		uint32_t o0 = outcode(v0->clip), o1 = outcode(v1->clip), o2 = outcode(v2->clip);
+		if (o0 & o1 & o2)
+		{
+			chunk.culledCount++;
+			return;
+		}
+		if (!((o0 | o1 | o2) & 16))
+		{
+			emitTriangle(chunk, v0, v1, v2);
+			return;
+		}
+
+		// Sutherland-Hodgman against the near plane z = -w, gives 3 or 4 corners
+		chunk.clippedCount++;
+		const SoftVertex *in[3] = {v0, v1, v2};
+		const SoftVertex *out[4];
+		int count = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			const SoftVertex *a = in[i], *b = in[(i + 1) % 3];
+			float da = a->clip.z + a->clip.w, db = b->clip.z + b->clip.w;
+			if (da >= 0.0f)
+				out[count++] = a;
+			if ((da >= 0.0f) != (db >= 0.0f))
+			{
+				chunk.clipped.push_back(lerp(*a, *b, da / (da - db)));
+				out[count++] = &chunk.clipped.back();
+			}
+		}
+		for (int i = 2; i < count; i++)
+			emitTriangle(chunk, out[0], out[i - 1], out[i]);
+	}
+
+	void emitTriangle(SetupChunk &chunk, const SoftVertex *v0, const SoftVertex *v1, const SoftVertex *v2)
+	{
+		SoftTriangle t;
+		const SoftVertex *v[3] = {v0, v1, v2};
+		for (int i = 0; i < 3; i++)
+		{
+			float invW = 1.0f / v[i]->clip.w;
+			t.x[i] = (v[i]->clip.x * invW * 0.5f + 0.5f) * width;
+			t.y[i] = (v[i]->clip.y * invW * 0.5f + 0.5f) * height;
+			t.z[i] = v[i]->clip.z * invW * 0.5f + 0.5f;
+			t.v[i] = v[i];
+		}
+		float area = (t.x[1] - t.x[0]) * (t.y[2] - t.y[0]) - (t.x[2] - t.x[0]) * (t.y[1] - t.y[0]);
+		if (!(area != 0.0f))
+		{
+			chunk.culledCount++;
+			return;
+		}
+		// No face culling in the tutorials : clockwise triangles are turned around
+		if (area < 0.0f)
+		{
+			std::swap(t.x[1], t.x[2]);
+			std::swap(t.y[1], t.y[2]);
+			std::swap(t.z[1], t.z[2]);
+			std::swap(t.v[1], t.v[2]);
+		}
+
+		// Pixels whose center is inside the bounds
+		float minX = std::min(t.x[0], std::min(t.x[1], t.x[2])), maxX = std::max(t.x[0], std::max(t.x[1], t.x[2]));
+		float minY = std::min(t.y[0], std::min(t.y[1], t.y[2])), maxY = std::max(t.y[0], std::max(t.y[1], t.y[2]));
+		float left = std::max(ceilf(minX - 0.5f), 0.0f), right = std::min(floorf(maxX - 0.5f), (float)(width - 1));
+		float bottom = std::max(ceilf(minY - 0.5f), 0.0f), top = std::min(floorf(maxY - 0.5f), (float)(height - 1));
+		if (left > right || bottom > top)
+		{
+			chunk.culledCount++;
+			return;
+		}
+		t.minX = (int16_t)left;
+		t.maxX = (int16_t)right;
+		t.minY = (int16_t)bottom;
+		t.maxY = (int16_t)top;
+		t.minZ = std::min(t.z[0], std::min(t.z[1], t.z[2]));
+		chunk.triangles.push_back(t);
+	}
+
+	// Relative to the tile origin, which keeps the products small
+	static void setupEdges(const SoftTriangle &t, int tileX, int tileY, Edges &e)
+	{
+		float x[3], y[3];
+		for (int i = 0; i < 3; i++)
+		{
+			x[i] = t.x[i] - (float)tileX;
+			y[i] = t.y[i] - (float)tileY;
+		}
+		for (int i = 0; i < 3; i++)
+		{
+			int j = (i + 1) % 3, k = (i + 2) % 3;
+			// A shared edge gets the exact opposite coefficients in the other triangle,
+			// so every pixel center is inside exactly one of them
+			e.a[i] = y[j] - y[k];
+			e.b[i] = x[k] - x[j];
+			e.c[i] = x[j] * y[k] - x[k] * y[j];
+			e.topLeft[i] = e.a[i] > 0.0f || (e.a[i] == 0.0f && e.b[i] > 0.0f);
+		}
+		e.invArea = 1.0f / ((x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]));
+		e.z0 = t.z[0];
+		e.dz1 = t.z[1] - t.z[0];
+		e.dz2 = t.z[2] - t.z[0];
+	}
+
+	// Covers 8 pixels of one row starting at tile pixel `index`, at (x, y) in the tile.
+	// Returns true when a depth was written.
+	static bool rasterRow(const Edges &e, const SoftTriangle *t, int x, int y, int index, TileScratch &tile)
+	{
+		float px = (float)x + 0.5f, py = (float)y + 0.5f;
+#if defined(__AVX2__)
+		__m256 lanes = _mm256_add_ps(_mm256_set1_ps(px), _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f));
+		__m256 zero = _mm256_setzero_ps();
+		__m256 edge[3];
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int i = 0; i < 3; i++)
+		{
+			edge[i] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(e.a[i]), lanes), _mm256_set1_ps(e.b[i] * py)),
+									_mm256_set1_ps(e.c[i]));
+			__m256 test = e.topLeft[i] ? _mm256_cmp_ps(edge[i], zero, _CMP_GE_OQ) : _mm256_cmp_ps(edge[i], zero, _CMP_GT_OQ);
+			inside = _mm256_and_ps(inside, test);
+		}
+		if (!_mm256_movemask_ps(inside))
+			return false;
+		__m256 invArea = _mm256_set1_ps(e.invArea);
+		__m256 l1 = _mm256_mul_ps(edge[1], invArea);
+		__m256 l2 = _mm256_mul_ps(edge[2], invArea);
+		__m256 z = _mm256_add_ps(_mm256_set1_ps(e.z0),
+								 _mm256_add_ps(_mm256_mul_ps(l1, _mm256_set1_ps(e.dz1)), _mm256_mul_ps(l2, _mm256_set1_ps(e.dz2))));
+		__m256 depth = _mm256_loadu_ps(tile.depth + index);
+		inside = _mm256_and_ps(inside, _mm256_cmp_ps(z, depth, _CMP_LT_OQ));
+		int mask = _mm256_movemask_ps(inside);
+		if (!mask)
+			return false;
+		_mm256_storeu_ps(tile.depth + index, _mm256_blendv_ps(depth, z, inside));
+		_mm256_storeu_ps(tile.l1 + index, _mm256_blendv_ps(_mm256_loadu_ps(tile.l1 + index), l1, inside));
+		_mm256_storeu_ps(tile.l2 + index, _mm256_blendv_ps(_mm256_loadu_ps(tile.l2 + index), l2, inside));
+		for (; mask; mask &= mask - 1)
+			tile.triangle[index + __builtin_ctz(mask)] = t;
+		return true;
+#else
+		bool wrote = false;
+		for (int lane = 0; lane < SOFT_BLOCK_SIZE; lane++)
+		{
+			float lx = px + (float)lane;
+			float edge[3];
+			bool inside = true;
+			for (int i = 0; i < 3; i++)
+			{
+				edge[i] = (e.a[i] * lx + e.b[i] * py) + e.c[i];
+				inside = inside && (e.topLeft[i] ? edge[i] >= 0.0f : edge[i] > 0.0f);
+			}
+			if (!inside)
+				continue;
+			float l1 = edge[1] * e.invArea, l2 = edge[2] * e.invArea;
+			float z = e.z0 + (l1 * e.dz1 + l2 * e.dz2);
+			if (!(z < tile.depth[index + lane]))
+				continue;
+			tile.depth[index + lane] = z;
+			tile.l1[index + lane] = l1;
+			tile.l2[index + lane] = l2;
+			tile.triangle[index + lane] = t;
+			wrote = true;
+		}
+		return wrote;
+#endif
+	}
+
+	void rasterTile(uint32_t tileIndex, TileScratch &tile)
+	{
+		const int blocksPerRow = SOFT_TILE_SIZE / SOFT_BLOCK_SIZE;
+		int tileX = (tileIndex % tilesX) * SOFT_TILE_SIZE, tileY = (tileIndex / tilesX) * SOFT_TILE_SIZE;
+		for (int i = 0; i < SOFT_TILE_SIZE * SOFT_TILE_SIZE; i++)
+		{
+			tile.depth[i] = 1.0f;
+			tile.triangle[i] = NULL;
+		}
+		for (int b = 0; b < blocksPerRow * blocksPerRow; b++)
+			tile.blockMax[b] = 1.0f;
+		float tileMax = 1.0f;
+
+		const std::vector<const SoftTriangle *> &bin = bins[tileIndex];
+		for (size_t n = 0; n < bin.size(); n++)
+		{
+			const SoftTriangle &t = *bin[n];
+			if (t.minZ >= tileMax)
+			{
+				tile.stats.tilesRejected++;
+				continue;
+			}
+			Edges e;
+			setupEdges(t, tileX, tileY, e);
+			int x0 = std::max((int)t.minX - tileX, 0), x1 = std::min((int)t.maxX - tileX, SOFT_TILE_SIZE - 1);
+			int y0 = std::max((int)t.minY - tileY, 0), y1 = std::min((int)t.maxY - tileY, SOFT_TILE_SIZE - 1);
+			bool tileChanged = false;
+			for (int by = y0 / SOFT_BLOCK_SIZE; by <= y1 / SOFT_BLOCK_SIZE; by++)
+				for (int bx = x0 / SOFT_BLOCK_SIZE; bx <= x1 / SOFT_BLOCK_SIZE; bx++)
+				{
+					tile.stats.blocksTested++;
+					float &blockMax = tile.blockMax[by * blocksPerRow + bx];
+					if (t.minZ >= blockMax)
+					{
+						tile.stats.blocksRejected++;
+						continue;
+					}
+					int rowFirst = std::max(y0, by * SOFT_BLOCK_SIZE), rowLast = std::min(y1, by * SOFT_BLOCK_SIZE + SOFT_BLOCK_SIZE - 1);
+					bool wrote = false;
+					for (int row = rowFirst; row <= rowLast; row++)
+						wrote |= rasterRow(e, &t, bx * SOFT_BLOCK_SIZE, row, row * SOFT_TILE_SIZE + bx * SOFT_BLOCK_SIZE, tile);
+					if (!wrote)
+						continue;
+					float farthest = 0.0f;
+					for (int row = 0; row < SOFT_BLOCK_SIZE; row++)
+					{
+						const float *depth = tile.depth + (by * SOFT_BLOCK_SIZE + row) * SOFT_TILE_SIZE + bx * SOFT_BLOCK_SIZE;
+						for (int i = 0; i < SOFT_BLOCK_SIZE; i++)
+							farthest = std::max(farthest, depth[i]);
+					}
+					tileChanged |= farthest < blockMax;
+					blockMax = farthest;
+				}
+			if (tileChanged)
+				tileMax = *std::max_element(tile.blockMax, tile.blockMax + blocksPerRow * blocksPerRow);
+		}
+
+		// Shading, once per visible pixel
+		int rows = std::min(SOFT_TILE_SIZE, height - tileY), columns = std::min(SOFT_TILE_SIZE, width - tileX);
+		for (int row = 0; row < rows; row++)
+		{
+			uint32_t *out = &color[(tileY + row) * width + tileX];
+			for (int column = 0; column < columns; column++)
+			{
+				int i = row * SOFT_TILE_SIZE + column;
+				const SoftTriangle *t = tile.triangle[i];
+				if (!t)
+				{
+					out[column] = clear;
+					continue;
+				}
+				tile.stats.pixelsShaded++;
+				out[column] = packColor(shade(*t, tile.l1[i], tile.l2[i]));
+			}
+		}
+	}
+
+	// StandardShading of step8 on the perspective correct attributes
+	glm::vec3 shade(const SoftTriangle &t, float l1, float l2) const
+	{
+		float w0 = (1.0f - l1 - l2) / t.v[0]->clip.w, w1 = l1 / t.v[1]->clip.w, w2 = l2 / t.v[2]->clip.w;
+		float norm = 1.0f / (w0 + w1 + w2);
+		w0 *= norm;
+		w1 *= norm;
+		w2 *= norm;
+		glm::vec3 world = t.v[0]->world * w0 + t.v[1]->world * w1 + t.v[2]->world * w2;
+		glm::vec3 normal = t.v[0]->normal * w0 + t.v[1]->normal * w1 + t.v[2]->normal * w2;
+		glm::vec3 diffuse = t.v[0]->color * w0 + t.v[1]->color * w1 + t.v[2]->color * w2;
+
+		glm::vec3 eye = -glm::vec3(view * glm::vec4(world, 1.0f));
+		glm::vec3 lightDirection = lightCamera + eye;
+		const float lightPower = 50.0f;
+		glm::vec3 toLight = lightPos - world;
+		float distance2 = glm::dot(toLight, toLight);
+		glm::vec3 n = glm::normalize(normal);
+		glm::vec3 l = glm::normalize(lightDirection);
+		float cosTheta = glm::clamp(glm::dot(n, l), 0.0f, 1.0f);
+		glm::vec3 E = glm::normalize(eye);
+		glm::vec3 R = -l - 2.0f * glm::dot(-l, n) * n;
+		float cosAlpha = glm::clamp(glm::dot(E, R), 0.0f, 1.0f);
+		float cosAlpha2 = cosAlpha * cosAlpha;
+		return diffuse * 0.1f + diffuse * (lightPower * cosTheta / distance2) +
+			   glm::vec3(0.3f) * (lightPower * cosAlpha2 * cosAlpha2 * cosAlpha / distance2);
+	}
+
+	JobSystem &jobs;
+	int width;
+	int height;
+	int tilesX;
+	int tilesY;
+	glm::mat4 view;
+	glm::vec3 lightPos;
+	glm::vec3 lightCamera;
+	uint32_t clear;
+	std::vector<std::vector<SoftVertex>> vertexBlocks; // one per draw of the frame, kept between frames
+	size_t vertexBlocksUsed;
+	std::vector<SetupChunk *> chunks;
+	size_t chunksUsed;
+	std::vector<uint32_t> binOffsets;
+	std::vector<std::vector<const SoftTriangle *>> bins; // per tile, in submission order
+	std::vector<TileScratch> scratch;                   // per job thread
+	std::vector<uint32_t> color;
+	SoftRasterStats frameStats;
+};
+
+#endif
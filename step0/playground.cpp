@@ -7,10 +7,13 @@
 GLFWwindow* window;
 
 #include <glm/glm.hpp>
+
+#include "../stephooks.hpp"
 using namespace glm;
 
-int main( void )
+int main(int argc, char **argv)
 {
+	StepHooks hooks(argc, argv);
 	// Initialise GLFW
 	if( !glfwInit() )
 	{
@@ -26,6 +29,8 @@ int main( void )
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make MacOS happy; should not be needed
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+	hooks.windowHints();
+
 	// Open a window and create its OpenGL context
 	window = glfwCreateWindow( 1024, 768, "Playground", NULL, NULL);
 	if( window == NULL ){
@@ -45,6 +50,8 @@ int main( void )
 		return -1;
 	}
 
+	hooks.begin(window);
+
 	// Ensure we can capture the escape key being pressed below
 	glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
 
@@ -55,14 +62,15 @@ int main( void )
 		// Draw nothing, see you in step 1 !
 
 		// Swap buffers
-		glfwSwapBuffers(window);
+		hooks.swapBuffers(window);
 		glfwPollEvents();
 
 	} // Check if the ESC key was pressed or the window was closed
 	while( glfwGetKey(window, GLFW_KEY_ESCAPE ) != GLFW_PRESS &&
-		   glfwWindowShouldClose(window) == 0 );
+		   glfwWindowShouldClose(window) == 0 && !hooks.done() );
 
 	// Close OpenGL window and terminate GLFW
+	hooks.end();
 	glfwTerminate();
 
 	return 0;
@@ -8,11 +8,14 @@
 #include <common/shader.hpp>
 #include <common/objloader.hpp>
 #include <common/texture.hpp>
+#include "scene.hpp"
+#include "../stephooks.hpp"
 
 using namespace glm;
 
-int main(void)
+int main(int argc, char **argv)
 {
+    StepHooks hooks(argc, argv);
     GLFWwindow *window;
 
     // Initialise GLFW
@@ -30,6 +33,8 @@ int main(void)
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make MacOS happy; should not be needed
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+    hooks.windowHints();
+
     // Open a window and create its OpenGL context
     window = glfwCreateWindow(1024, 768, "Playground", NULL, NULL);
     if (window == NULL)
@@ -51,6 +56,8 @@ int main(void)
         return -1;
     }
 
+    hooks.begin(window);
+
     // Ensure we can capture the escape key being pressed below
     glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
 
@@ -63,22 +70,17 @@ int main(void)
 
     GLuint programID = LoadShaders("playground_steps/step1/SimpleVertexShader.vertexshader", "playground_steps/step1/SimpleFragmentShader.fragmentshader");
 
-    static const GLfloat g_vertex_buffer_data[] = 
-    {
-        -1.0f,-1.0f,0.0f,
-        1.0f,-1.0f,0.0f,
-        0.0f,1.0f,0.0f,
-    };
     GLuint vertexbuffer;
+    // Upload the buffers once, the data never changes
+    glGenBuffers(1, &vertexbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
+
     do
     {
         // Clear the screen
         glClear(GL_COLOR_BUFFER_BIT);
 
-        glGenBuffers(1, &vertexbuffer);
-        glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-
         // Use our shader
         glUseProgram(programID);
         // 1rst attribute buffer : vertices
@@ -97,16 +99,17 @@ int main(void)
         glDrawArrays(GL_TRIANGLES, 0, 3); // 3 indices starting at 0 -> 1 triangle
         glDisableVertexAttribArray(0);
         // Swap buffers
-        glfwSwapBuffers(window);
+        hooks.swapBuffers(window);
         glfwPollEvents();
 
-    } while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS && glfwWindowShouldClose(window) == 0);
+    } while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS && glfwWindowShouldClose(window) == 0 && !hooks.done());
 
     // Close OpenGL window and terminate GLFW
     // Cleanup VBO
     glDeleteBuffers(1, &vertexbuffer);
     glDeleteVertexArrays(1, &VertexArrayID);
     glDeleteProgram(programID);
+    hooks.end();
     glfwTerminate();
 
     return 0;
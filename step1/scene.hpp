@@ -0,0 +1,13 @@
+#ifndef STEP1_SCENE_HPP
+#define STEP1_SCENE_HPP
+
+// Geometry of step1.
+
+static const float g_vertex_buffer_data[] =
+{
+    -1.0f,-1.0f,0.0f,
+    1.0f,-1.0f,0.0f,
+    0.0f,1.0f,0.0f,
+};
+
+#endif
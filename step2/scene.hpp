@@ -0,0 +1,38 @@
+#ifndef STEP2_SCENE_HPP
+#define STEP2_SCENE_HPP
+
+// Geometry of step2.
+
+// Vertex data for three triangles
+static const float g_vertex_buffer_data[] = {
+    -1.0f, -1.0f, 0.0f,
+    -1.0f,  1.0f, 0.0f,
+     1.0f,  1.0f, 0.0f,
+
+     1.0f,  1.0f, 0.0f,
+     1.0f, -1.0f, 0.0f,
+    -1.0f, -1.0f, 0.0f,
+
+    -1.0f,  1.0f, 0.0f,
+     0.0f,  1.5f, 0.0f,
+     1.0f,  1.0f, 0.0f
+};
+
+// One color for each vertex.
+static const float g_color_buffer_data[] = {
+	0.0f, 1.0, 0.0f,
+	0.0f, 0.0f, 1.0,
+	1.0, 0.0f, 0.0f,
+
+	1.0, 0.0f, 0.0f,
+	0.0f, 0.0f, 1.0,
+	0.0f, 1.0, 0.0f,
+
+
+	0.0f, 0.0f, 1.0,
+	0.0f, 1.0, 0.0f,
+	1.0, 0.0f, 0.0f,
+
+};
+
+#endif
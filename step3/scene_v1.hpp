@@ -0,0 +1,53 @@
+#ifndef STEP3_SCENE_V1_HPP
+#define STEP3_SCENE_V1_HPP
+
+// Geometry of playground_v1 of step3.
+
+// Vertex data for three triangles
+static const float g_vertex_buffer_data[] = {
+    -1.0f, -1.0f, 0.0f,
+    -1.0f,  1.0f, 0.0f,
+
+    -1.0f,  -1.0f, 0.0f,
+     1.0f,  -1.0f, 0.0f,
+
+     1.0f, -1.0f, 0.0f,
+     1.0f, 1.0f, 0.0f,
+
+    -1.0f,  1.0f, 0.0f,
+     0.0f,  1.5f, 0.0f,
+
+     1.0f,  1.0f, 0.0f,
+     0.0f,  1.5f, 0.0f,
+
+     1.0f,  1.0f, 0.0f,
+     1.0f,  0.0f, 0.0f,
+
+     -1.0f,  1.0f, 0.0f,
+     1.0f,  1.0f, 0.0f,
+
+};
+
+// One color for each vertex.
+static const float g_color_buffer_data[] = {
+	1.0f, 1.0f, 1.0,
+	1.0f, 1.0f, 1.0,
+	1.0f, 1.0f, 1.0,
+
+	1.0f, 1.0f, 1.0,
+	1.0f, 1.0f, 1.0,
+	1.0f, 1.0f, 1.0,
+
+	1.0f, 1.0f, 1.0,
+	1.0f, 1.0f, 1.0,
+	1.0f, 1.0f, 1.0,
+
+	1.0f, 1.0f, 1.0,
+	1.0f, 1.0f, 1.0,
+	1.0f, 1.0f, 1.0,
+
+	1.0f, 1.0f, 1.0,
+	1.0f, 1.0f, 1.0,
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef STEP3_SCENE_V2_HPP
+#define STEP3_SCENE_V2_HPP
+
+// Geometry of playground_v2 of step3.
+
+// Vertex data for three triangles
+static const float g_vertex_buffer_data[] = {
+    -1.0f, 1.0f, 0.0f,
+    -1.0f,  -1.0f, 0.0f,
+
+     1.0f,  -1.0f, 0.0f,
+     1.0f,  1.0f, 0.0f,
+
+    -1.0f, 1.0f, 0.0f,
+     0.0f, 1.5f, 0.0f,
+
+     1.0f,  1.0f, 0.0f,
+    -1.0, -1.0, 0.0
+
+
+};
+
+// One color for each vertex.
+static const float g_color_buffer_data[] = {
+	1.0f, 1.0f, 1.0,
+	1.0f, 1.0f, 1.0,
+	1.0f, 1.0f, 1.0,
+
+	1.0f, 1.0f, 1.0,
+	1.0f, 1.0f, 1.0,
+	1.0f, 1.0f, 1.0,
+
+	1.0f, 1.0f, 1.0,
+	1.0f, 1.0f, 1.0,
+	1.0f, 1.0f, 1.0,
+
+	1.0f, 1.0f, 1.0,
+	1.0f, 1.0f, 1.0,
+	1.0f, 1.0f, 1.0,
+
+	1.0f, 1.0f, 1.0,
+	1.0f, 1.0f, 1.0,
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef STEP6_SCENE_HPP
+#define STEP6_SCENE_HPP
+
+// Geometry of step6.
+
+// Vertex data for 4 triangles
+static const float g_vertex_buffer_data[] = {
+
+    -1.0f, -1.0f, 0.0f,
+    -1.0f,  1.0f, 0.0f,
+     1.0f,  1.0f, 0.0f,
+
+     1.0f,  1.0f, 0.0f,
+     1.0f, -1.0f, 0.0f,
+    -1.0f, -1.0f, 0.0f,
+
+    -1.0f,  1.0f, 0.0f,
+     0.0f,  1.5f, 0.0f,
+     1.0f,  1.0f, 0.0f,
+
+     -1.0f, -1.0f, 0.2f,
+     0.0f,  1.0f, 0.2f,
+     1.0f,  -1.0f, 0.2f
+};
+
+// One color for each vertex.
+static const float g_color_buffer_data[] = {
+
+	1.0, 0.0f, 0.0f,
+	1.0, 0.0f, 0.0f,
+	1.0, 0.0f, 0.0f,
+
+	0.0f, 1.0, 0.0f,
+	0.0f, 1.0, 0.0f,
+	0.0f, 1.0, 0.0f,
+
+	0.0f, 0.0f, 1.0,
+	0.0f, 0.0f, 1.0,
+	0.0f, 0.0f, 1.0,
+
+	1.0, 1.0f, 1.0f,
+	1.0, 1.0f, 1.0f,
+	1.0, 1.0f, 1.0f,
+
+};
+
+#endif
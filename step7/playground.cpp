@@ -8,11 +8,14 @@
 #include <common/shader.hpp>
 #include <common/objloader.hpp>
 #include <common/texture.hpp>
+#include "scene.hpp"
+#include "../stephooks.hpp"
 
 using namespace glm;
 
-int main(void)
+int main(int argc, char **argv)
 {
+	StepHooks hooks(argc, argv);
 	GLFWwindow *window;
 
 	// Initialise GLFW
@@ -30,6 +33,8 @@ int main(void)
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make MacOS happy; should not be needed
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+	hooks.windowHints();
+
 	// Open a window and create its OpenGL context
 	window = glfwCreateWindow(1024, 768, "Playground", NULL, NULL);
 	if (window == NULL)
@@ -51,6 +56,8 @@ int main(void)
 		return -1;
 	}
 
+	hooks.begin(window);
+
     // Ensure we can capture the escape key being pressed below
 	glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
 
@@ -63,61 +70,6 @@ int main(void)
 
 	GLuint programID = LoadShaders("playground_steps/step7/StandardShading.vertexshader", "playground_steps/step7/StandardShading.fragmentshader");
 
-	// Normal
-	static const GLfloat g_normal_buffer_data[] = {
-
-		0.0f, 0.0f, 1.0f,
-		0.0f, 0.0f, 1.f,
-		0.0f, 0.0f, 1.f,
-
-		0.0f, 0.0f, 1.f,
-		0.0f, 0.0f, 1.f,
-		0.0f, 0.0f, 1.f,
-
-		0.0f, 0.0f, 1.f,
-		0.0f, 0.0f, 1.f,
-		0.0f, 0.0f, 1.f
-        };
-
-	// Vertex data for 4 triangles
-	static const GLfloat g_vertex_buffer_data[] = {
-
-		-1.0f, -1.0f, 0.0f, 
-		-1.0f, 1.0f, 0.0f,	
-		1.0f, 1.0f, 0.0f,	
-
-		1.0f, 1.0f, 0.0f,	
-		1.0f, -1.0f, 0.0f,	
-		-1.0f, -1.0f, 0.0f, 
-
-		-1.0f, 1.0f, 0.0f, 
-		0.0f, 1.5f, 0.0f,  
-		1.0f, 1.0f, 0.0f,  
-
-		-1.0f, -1.0f, 0.2f, 
-		0.0f, 1.0f, 0.2f,	
-		1.0f, -1.0f, 0.2f
-        }; 
-
-	// One color for each vertex.
-	static const GLfloat g_color_buffer_data[] = {
-
-		0.0f, 1.0f, 0.0f, 
-		0.0f, 1.0f, 0.0f, 
-		0.0f, 1.0f, 0.0f, 
-        
-		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f, 0.0f,
-
-		0.0f, 0.0f, 1.0f,
-		0.0f, 0.0f, 1.0f,
-		0.0f, 0.0f, 1.0f,
-
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f};
-
 	GLuint normalbuffer;
     GLuint vertexbuffer;
     GLuint colorbuffer;
@@ -150,19 +102,21 @@ int main(void)
 	glm::mat4 Model2 = glm::mat4(1.0f);
     float lastFrame=0,angle=0;
 
+	// Upload the buffers once, the data never changes
+	glGenBuffers(1, &vertexbuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &colorbuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, colorbuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(g_color_buffer_data), g_color_buffer_data, GL_STATIC_DRAW);
+
 	do
 	{
         // Clear the screen
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glGenBuffers(1, &vertexbuffer);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-
-		glGenBuffers(1, &colorbuffer);
-		glBindBuffer(GL_ARRAY_BUFFER, colorbuffer);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(g_color_buffer_data), g_color_buffer_data, GL_STATIC_DRAW);
 
-		float currentFrame = glfwGetTime();
+		float currentFrame = (float)hooks.time();
 		float deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 		angle += 3.14159f / 2.0f * deltaTime;
@@ -244,17 +198,20 @@ int main(void)
 		glDisableVertexAttribArray(0);
 
 		// Swap buffers
-		glfwSwapBuffers(window);
+		hooks.swapBuffers(window);
 		glfwPollEvents();
 
-		// Cleanup the buffer
-		glDeleteBuffers(1, &vertexbuffer);
+	} while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS && glfwWindowShouldClose(window) == 0 && !hooks.done());
 
-	} while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS && glfwWindowShouldClose(window) == 0);
+	// Cleanup VBOs
+	glDeleteBuffers(1, &vertexbuffer);
+	glDeleteBuffers(1, &colorbuffer);
+	glDeleteBuffers(1, &normalbuffer);
 
 	// Close OpenGL window and terminate GLFW
 	glDeleteVertexArrays(1, &VertexArrayID);
 	glDeleteProgram(programID);
+	hooks.end();
 	glfwTerminate();
 
 	return 0;
@@ -0,0 +1,61 @@
+#ifndef STEP7_SCENE_HPP
+#define STEP7_SCENE_HPP
+
+// Geometry of step7.
+
+// Normal
+static const float g_normal_buffer_data[] = {
+
+	0.0f, 0.0f, 1.0f,
+	0.0f, 0.0f, 1.f,
+	0.0f, 0.0f, 1.f,
+
+	0.0f, 0.0f, 1.f,
+	0.0f, 0.0f, 1.f,
+	0.0f, 0.0f, 1.f,
+
+	0.0f, 0.0f, 1.f,
+	0.0f, 0.0f, 1.f,
+	0.0f, 0.0f, 1.f
+    };
+
+// Vertex data for 4 triangles
+static const float g_vertex_buffer_data[] = {
+
+	-1.0f, -1.0f, 0.0f,
+	-1.0f, 1.0f, 0.0f,
+	1.0f, 1.0f, 0.0f,
+
+	1.0f, 1.0f, 0.0f,
+	1.0f, -1.0f, 0.0f,
+	-1.0f, -1.0f, 0.0f,
+
+	-1.0f, 1.0f, 0.0f,
+	0.0f, 1.5f, 0.0f,
+	1.0f, 1.0f, 0.0f,
+
+	-1.0f, -1.0f, 0.2f,
+	0.0f, 1.0f, 0.2f,
+	1.0f, -1.0f, 0.2f
+    };
+
+// One color for each vertex.
+static const float g_color_buffer_data[] = {
+
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+
+	0.0f, 0.0f, 1.0f,
+	0.0f, 0.0f, 1.0f,
+	0.0f, 0.0f, 1.0f,
+
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f};
+
+#endif
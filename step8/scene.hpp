@@ -0,0 +1,159 @@
+#ifndef STEP8_SCENE_HPP
+#define STEP8_SCENE_HPP
+
+// Geometry of step8, also drawn by tools/step8scene.hpp.
+// The tool includes it inside a namespace, so no includes here.
+
+// Normal
+static const float g_normal_buffer_data[] = {
+	//1
+	0.0f, 0.0f, 1.0f,
+	0.0f, 0.0f, 1.0f,
+	0.0f, 0.0f, 1.0f,
+
+	0.0f, 0.0f, 1.0f,
+	0.0f, 0.0f, 1.0f,
+	0.0f, 0.0f, 1.0f,
+	//2
+	0.0f, 0.0f, -1.0f,
+	0.0f, 0.0f, -1.0f,
+	0.0f, 0.0f, -1.0f,
+
+	0.0f, 0.0f, -1.0f,
+	0.0f, 0.0f, -1.0f,
+	0.0f, 0.0f, -1.0f,
+	//3
+	-1.0f, 0.0f, 0.0f,
+	-1.0f, 0.0f, 0.0f,
+	-1.0f, 0.0f, 0.0f,
+
+	-1.0f, 0.0f, 0.0f,
+	-1.0f, 0.0f, 0.0f,
+	-1.0f, 0.0f, 0.0f,
+	//4
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+	//5
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	//6
+	0.0f, -1.0f, 0.0f,
+	0.0f, -1.0f, 0.0f,
+	0.0f, -1.0f, 0.0f,
+
+	0.0f, -1.0f, 0.0f,
+	0.0f, -1.0f, 0.0f,
+	0.0f, -1.0f, 0.0f};
+
+// Vertex data for a cube
+static const float g_vertex_buffer_data[] = {
+	//Face 1
+	-1.0f, 1.0f, 0.2f,
+	1.0f, 1.0f, 0.2f,
+	-1.0f, -1.0f, 0.2f,
+
+	1.0f, 1.0f, 0.2f,
+	1.0f, -1.0f, 0.2f,
+	-1.0f, -1.0f, 0.2f,
+	//Face 2
+	-1.0f, 1.0f, -1.8f,
+	1.0f, 1.0f, -1.8f,
+	-1.0f, -1.0f, -1.8f,
+
+	1.0f, 1.0f, -1.8f,
+	1.0f, -1.0f, -1.8f,
+	-1.0f, -1.0f, -1.8f,
+	//Face 3
+	-1.0f, 1.0f, -1.8f,
+	-1.0f, -1.0f, 0.2f,
+	-1.0f, -1.0f, -1.8f,
+
+	-1.0f, 1.0f, -1.8f,
+	-1.0f, 1.0f, 0.2f,
+	-1.0f, -1.0f, 0.2f,
+	//Face 4
+	1.0f, 1.0f, 0.2f,
+	1.0f, 1.0f, -1.8f,
+	1.0f, -1.0f, 0.2f,
+
+	1.0f, 1.0f, -1.8f,
+	1.0f, -1.0f, -1.8f,
+	1.0f, -1.0f, 0.2f,
+	//Face 5
+	-1.0f, 1.0f, 0.2f,
+	-1.0f, 1.0f, -1.8f,
+	1.0f, 1.0f, -1.8f,
+
+	-1.0f, 1.0f, 0.2f,
+	1.0f, 1.0f, -1.8f,
+	1.0f, 1.0f, 0.2f,
+	//Face 6
+	-1.0f, -1.0f, 0.2f,
+	1.0f, -1.0f, 0.2f,
+	1.0f, -1.0f, -1.8f,
+
+	-1.0f, -1.0f, 0.2f,
+	1.0f, -1.0f, -1.8f,
+	-1.0f, -1.0f, -1.8f};
+
+// One color for each vertex.
+static const float g_color_buffer_data[] = {
+	0.0f, 0.0f, 0.0f,
+	0.0f, 0.0f, 0.0f,
+	0.0f, 0.0f, 0.0f,
+
+	0.0f, 0.0f, 0.0f,
+	0.0f, 0.0f, 0.0f,
+	0.0f, 0.0f, 0.0f,
+
+	0.0f, 0.0f, 1.0f,
+	0.0f, 0.0f, 1.0f,
+	0.0f, 0.0f, 1.0f,
+
+	0.0f, 0.0f, 1.0f,
+	0.0f, 0.0f, 1.0f,
+	0.0f, 0.0f, 1.0f,
+
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f};
+
+#endif
@@ -8,11 +8,14 @@
 #include <common/shader.hpp>
 #include <common/objloader.hpp>
 #include <common/texture.hpp>
+#include "scene.hpp"
+#include "../stephooks.hpp"
 
 using namespace glm;
 
-int main(void)
+int main(int argc, char **argv)
 {
+	StepHooks hooks(argc, argv);
 	GLFWwindow *window;
 
 	// Initialise GLFW
@@ -30,6 +33,8 @@ int main(void)
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make MacOS happy; should not be needed
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+	hooks.windowHints();
+
 	// Open a window and create its OpenGL context
 	window = glfwCreateWindow(1024, 768, "Playground", NULL, NULL);
 	if (window == NULL)
@@ -51,6 +56,8 @@ int main(void)
 		return -1;
 	}
 
+	hooks.begin(window);
+
 	// Ensure we can capture the escape key being pressed below
 	glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
 
@@ -64,157 +71,6 @@ int main(void)
 	//Pas de step9 donc on utilise le step8
 	GLuint programID = LoadShaders("playground_steps/step8/StandardShading.vertexshader", "playground_steps/step8/StandardShading.fragmentshader");
 
-	// Vertex data for a cube
-	static const GLfloat g_vertex_buffer_data[] = {
-
-		-1.0f, 1.0f, 0.2f,
-		1.0f, 1.0f, 0.2f,
-		-1.0f, -1.0f, 0.2f,
-
-		1.0f, 1.0f, 0.2f,
-		1.0f, -1.0f, 0.2f,
-		-1.0f, -1.0f, 0.2f,
-
-		-1.0f, 1.0f, -1.8f,
-		1.0f, 1.0f, -1.8f,
-		-1.0f, -1.0f, -1.8f,
-
-		1.0f, 1.0f, -1.8f,
-		1.0f, -1.0f, -1.8f,
-		-1.0f, -1.0f, -1.8f,
-
-		-1.0f, 1.0f, -1.8f,
-		-1.0f, -1.0f, 0.2f,
-		-1.0f, -1.0f, -1.8f,
-
-		-1.0f, 1.0f, -1.8f,
-		-1.0f, 1.0f, 0.2f,
-		-1.0f, -1.0f, 0.2f,
-
-		1.0f, 1.0f, 0.2f,
-		1.0f, 1.0f, -1.8f,
-		1.0f, -1.0f, 0.2f,
-
-		1.0f, 1.0f, -1.8f,
-		1.0f, -1.0f, -1.8f,
-		1.0f, -1.0f, 0.2f,
-
-		-1.0f, 1.0f, 0.2f,
-		-1.0f, 1.0f, -1.8f,
-		1.0f, 1.0f, -1.8f,
-
-		-1.0f, 1.0f, 0.2f,
-		1.0f, 1.0f, -1.8f,
-		1.0f, 1.0f, 0.2f,
-
-		-1.0f, -1.0f, 0.2f,
-		1.0f, -1.0f, 0.2f,
-		1.0f, -1.0f, -1.8f,
-
-		-1.0f, -1.0f, 0.2f,
-		1.0f, -1.0f, -1.8f,
-		-1.0f, -1.0f, -1.8f};
-
-	// One color for each vertex.
-	static const GLfloat g_color_buffer_data[] = {
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-
-		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f, 0.0f};
-
-	// Normals
-	static const GLfloat g_normal_buffer_data[] = {
-		-1.0f, 1.0f, 0.2f,
-		1.0f, 1.0f, 0.2f,
-		-1.0f, -1.0f, 0.2f,
-
-		1.0f, 1.0f, 0.2f,
-		1.0f, -1.0f, 0.2f,
-		-1.0f, -1.0f, 0.2f,
-
-		-1.0f, 1.0f, -1.8f,
-		1.0f, 1.0f, -1.8f,
-		-1.0f, -1.0f, -1.8f,
-
-		1.0f, 1.0f, -1.8f,
-		1.0f, -1.0f, -1.8f,
-		-1.0f, -1.0f, -1.8f,
-
-		-1.0f, 1.0f, -1.8f,
-		-1.0f, -1.0f, 0.2f,
-		-1.0f, -1.0f, -1.8f,
-
-		-1.0f, 1.0f, -1.8f,
-		-1.0f, 1.0f, 0.2f,
-		-1.0f, -1.0f, 0.2f,
-
-		1.0f, 1.0f, 0.2f,
-		1.0f, 1.0f, -1.8f,
-		1.0f, -1.0f, 0.2f,
-
-		1.0f, 1.0f, -1.8f,
-		1.0f, -1.0f, -1.8f,
-		1.0f, -1.0f, 0.2f,
-
-		-1.0f, 1.0f, 0.2f,
-		-1.0f, 1.0f, -1.8f,
-		1.0f, 1.0f, -1.8f,
-
-		-1.0f, 1.0f, 0.2f,
-		1.0f, 1.0f, -1.8f,
-		1.0f, 1.0f, 0.2f,
-
-		-1.0f, -1.0f, 0.2f,
-		1.0f, -1.0f, 0.2f,
-		1.0f, -1.0f, -1.8f,
-
-		-1.0f, -1.0f, 0.2f,
-		1.0f, -1.0f, -1.8f,
-		-1.0f, -1.0f, -1.8f};
-
 	GLuint normalbuffer;
 	GLuint vertexbuffer;
 	GLuint colorbuffer;
@@ -268,7 +124,7 @@ int main(void)
 		// Clear the screen
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		float currentFrame = glfwGetTime();
+		float currentFrame = (float)hooks.time();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 		angle += 3.14159f / 2.0f * deltaTime;
@@ -341,17 +197,20 @@ int main(void)
 		glDisableVertexAttribArray(0);
 
 		// Swap buffers
-		glfwSwapBuffers(window);
+		hooks.swapBuffers(window);
 		glfwPollEvents();
 
-		// Cleanup the buffer
-		glDeleteBuffers(1, &vertexbuffer);
+	} while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS && glfwWindowShouldClose(window) == 0 && !hooks.done());
 
-	} while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS && glfwWindowShouldClose(window) == 0);
+	// Cleanup VBOs
+	glDeleteBuffers(1, &vertexbuffer);
+	glDeleteBuffers(1, &colorbuffer);
+	glDeleteBuffers(1, &normalbuffer);
 
 	// Close OpenGL window and terminate GLFW
 	glDeleteVertexArrays(1, &VertexArrayID);
 	glDeleteProgram(programID);
+	hooks.end();
 	glfwTerminate();
 
 	return 0;
@@ -0,0 +1,158 @@
+#ifndef STEP9_SCENE_HPP
+#define STEP9_SCENE_HPP
+
+// Geometry of step9, also drawn by tools/step9scene.hpp.
+// The tool includes it inside a namespace, so no includes here.
+
+// Vertex data for a cube
+static const float g_vertex_buffer_data[] = {
+
+	-1.0f, 1.0f, 0.2f,
+	1.0f, 1.0f, 0.2f,
+	-1.0f, -1.0f, 0.2f,
+
+	1.0f, 1.0f, 0.2f,
+	1.0f, -1.0f, 0.2f,
+	-1.0f, -1.0f, 0.2f,
+
+	-1.0f, 1.0f, -1.8f,
+	1.0f, 1.0f, -1.8f,
+	-1.0f, -1.0f, -1.8f,
+
+	1.0f, 1.0f, -1.8f,
+	1.0f, -1.0f, -1.8f,
+	-1.0f, -1.0f, -1.8f,
+
+	-1.0f, 1.0f, -1.8f,
+	-1.0f, -1.0f, 0.2f,
+	-1.0f, -1.0f, -1.8f,
+
+	-1.0f, 1.0f, -1.8f,
+	-1.0f, 1.0f, 0.2f,
+	-1.0f, -1.0f, 0.2f,
+
+	1.0f, 1.0f, 0.2f,
+	1.0f, 1.0f, -1.8f,
+	1.0f, -1.0f, 0.2f,
+
+	1.0f, 1.0f, -1.8f,
+	1.0f, -1.0f, -1.8f,
+	1.0f, -1.0f, 0.2f,
+
+	-1.0f, 1.0f, 0.2f,
+	-1.0f, 1.0f, -1.8f,
+	1.0f, 1.0f, -1.8f,
+
+	-1.0f, 1.0f, 0.2f,
+	1.0f, 1.0f, -1.8f,
+	1.0f, 1.0f, 0.2f,
+
+	-1.0f, -1.0f, 0.2f,
+	1.0f, -1.0f, 0.2f,
+	1.0f, -1.0f, -1.8f,
+
+	-1.0f, -1.0f, 0.2f,
+	1.0f, -1.0f, -1.8f,
+	-1.0f, -1.0f, -1.8f};
+
+// One color for each vertex.
+static const float g_color_buffer_data[] = {
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f};
+
+// Normals
+static const float g_normal_buffer_data[] = {
+	-1.0f, 1.0f, 0.2f,
+	1.0f, 1.0f, 0.2f,
+	-1.0f, -1.0f, 0.2f,
+
+	1.0f, 1.0f, 0.2f,
+	1.0f, -1.0f, 0.2f,
+	-1.0f, -1.0f, 0.2f,
+
+	-1.0f, 1.0f, -1.8f,
+	1.0f, 1.0f, -1.8f,
+	-1.0f, -1.0f, -1.8f,
+
+	1.0f, 1.0f, -1.8f,
+	1.0f, -1.0f, -1.8f,
+	-1.0f, -1.0f, -1.8f,
+
+	-1.0f, 1.0f, -1.8f,
+	-1.0f, -1.0f, 0.2f,
+	-1.0f, -1.0f, -1.8f,
+
+	-1.0f, 1.0f, -1.8f,
+	-1.0f, 1.0f, 0.2f,
+	-1.0f, -1.0f, 0.2f,
+
+	1.0f, 1.0f, 0.2f,
+	1.0f, 1.0f, -1.8f,
+	1.0f, -1.0f, 0.2f,
+
+	1.0f, 1.0f, -1.8f,
+	1.0f, -1.0f, -1.8f,
+	1.0f, -1.0f, 0.2f,
+
+	-1.0f, 1.0f, 0.2f,
+	-1.0f, 1.0f, -1.8f,
+	1.0f, 1.0f, -1.8f,
+
+	-1.0f, 1.0f, 0.2f,
+	1.0f, 1.0f, -1.8f,
+	1.0f, 1.0f, 0.2f,
+
+	-1.0f, -1.0f, 0.2f,
+	1.0f, -1.0f, 0.2f,
+	1.0f, -1.0f, -1.8f,
+
+	-1.0f, -1.0f, 0.2f,
+	1.0f, -1.0f, -1.8f,
+	-1.0f, -1.0f, -1.8f};
+
+#endif
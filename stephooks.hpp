@@ -0,0 +1,106 @@
+#ifndef STEPHOOKS_HPP
+#define STEPHOOKS_HPP
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "capture.hpp"
+
+// The options of the playground the step programs share, so that
+// tools/regress_gl can run them as they are and compare their frames :
+//   --frames N             frames drawn before quitting, 0 to run until Escape
+//   --window hidden        the window is never shown, its frames are still drawn and captured
+//   --offline N            time() advances N steps of 1/60 s per frame instead of following
+//                          the clock, so a given frame is the same on every run
+//   --capture prefix       every frame read back and written by capture.hpp
+//   --capture-format name  png, ppm, raw, y4m or pipe
+// A step gives the hints before creating its window, begin() once its
+// context is current, reads its clock through time(), swaps through
+// swapBuffers() and quits once done(), then end() before glfwTerminate().
+
+class StepHooks
+{
+public:
+	StepHooks(int argc, char **argv)
+		: frameLimit(0), hiddenWindow(false), offlineSteps(0), capturePrefix(NULL), captureFormat(CAPTURE_PNG), frame(0)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+				frameLimit = atoi(argv[++i]);
+			else if (!strcmp(argv[i], "--window") && i + 1 < argc)
+				hiddenWindow = !strcmp(argv[++i], "hidden");
+			else if (!strcmp(argv[i], "--offline") && i + 1 < argc)
+				offlineSteps = atoi(argv[++i]);
+			else if (!strcmp(argv[i], "--capture") && i + 1 < argc)
+				capturePrefix = argv[++i];
+			else if (!strcmp(argv[i], "--capture-format") && i + 1 < argc)
+			{
+				const char *name = argv[++i];
+				for (int f = CAPTURE_PNG; f <= CAPTURE_PIPE; f++)
+					if (!strcmp(name, g_capture_format_names[f]))
+						captureFormat = (CaptureFormat)f;
+			}
+		}
+	}
+
+	// Before glfwCreateWindow
+	void windowHints() const
+	{
+		if (hiddenWindow)
+			glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	}
+
+	// Once the context is current and GLEW initialized
+	void begin(GLFWwindow *window)
+	{
+		// Offline runs go as fast as they can
+		if (offlineSteps > 0)
+			glfwSwapInterval(0);
+		if (capturePrefix)
+		{
+			int width, height;
+			glfwGetFramebufferSize(window, &width, &height);
+			if (!capture.create(width, height, capturePrefix, captureFormat))
+				capturePrefix = NULL;
+		}
+	}
+
+	// Seconds of the frame being drawn
+	double time() const { return offlineSteps > 0 ? frame * offlineSteps / 60.0 : glfwGetTime(); }
+
+	// The readback is queued before the swap, while the back buffer still holds the frame
+	void swapBuffers(GLFWwindow *window)
+	{
+		if (capturePrefix)
+			capture.readback(frame);
+		glfwSwapBuffers(window);
+		if (capturePrefix)
+			capture.endFrame();
+		frame++;
+	}
+
+	bool done() const { return frameLimit > 0 && frame >= (uint64_t)frameLimit; }
+
+	// Writes the frames still in flight, needs the GL context
+	void end()
+	{
+		if (capturePrefix)
+			capture.destroy();
+		capturePrefix = NULL;
+	}
+
+private:
+	int frameLimit;
+	bool hiddenWindow;
+	int offlineSteps;
+	const char *capturePrefix;
+	CaptureFormat captureFormat;
+	uint64_t frame;
+	FrameCapture capture;
+};
+
+#endif
@@ -0,0 +1,233 @@
+#ifndef STREAM_HPP
+#define STREAM_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <GL/glew.h>
+
+// Streaming ring buffer for data rewritten every frame (per-draw constants,
+// dynamic vertices...).
+// The buffer is cut into STREAM_FRAMES regions, one per frame in flight. A
+// frame writes its region while the GPU still reads the previous ones, and a
+// fence per region makes the CPU wait (and count the stall) only when it
+// comes back to a region the GPU has not finished with.
+//
+//   STREAM_PERSISTENT : glBufferStorage + one persistent, coherent mapping
+//                       (GL 4.4 or ARB_buffer_storage), no map call per frame
+//   STREAM_MAP_RANGE  : GL 3.3 fallback, the region is mapped every frame,
+//                       unsynchronized since the fence already protects it
+//   STREAM_ORPHAN     : GL 3.3 fallback without fences, the whole buffer is
+//                       orphaned every frame and the driver does the renaming
+//
+// Per frame : beginFrame(), allocate() and write, commit() before the draws
+// that read the data, endFrame() after them.
+
+#define STREAM_FRAMES 3
+
+enum StreamMode
+{
+	STREAM_AUTO, // persistent when available, map range otherwise
+	STREAM_PERSISTENT,
+	STREAM_MAP_RANGE,
+	STREAM_ORPHAN
+};
+
+static const char *const g_stream_mode_names[] = {"auto", "persistent", "map range", "orphan"};
+
+struct StreamStats
+{
+	size_t bytes;        // allocated this frame
+	double stallSeconds; // this frame, waiting for the GPU to release the region
+	uint32_t failed;     // allocations that did not fit this frame
+};
+
+class StreamRing
+{
+public:
+	StreamRing() : name(0), target(GL_ARRAY_BUFFER), mode(STREAM_AUTO), regionBytes(0), region(0), head(0), mapped(NULL), minAlign(1)
+	{
+		for (int i = 0; i < STREAM_FRAMES; i++)
+			fences[i] = 0;
+		resetStats();
+	}
+
+	// frameBytes is what one frame may allocate. False if the buffer could not be created.
+	bool create(GLenum bufferTarget, size_t frameBytes, StreamMode requested = STREAM_AUTO)
+	{
+		target = bufferTarget;
+		mode = requested;
+		if (mode == STREAM_AUTO || mode == STREAM_PERSISTENT)
+			mode = (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) ? STREAM_PERSISTENT : STREAM_MAP_RANGE;
+		if (mode != requested && requested == STREAM_PERSISTENT)
+			fprintf(stderr, "Persistent mapping needs GL 4.4 or ARB_buffer_storage, streaming through glMapBufferRange\n");
+
+		// Allocations may be bound with glBindBufferRange, which has its own alignment
+		minAlign = 16;
+		GLint align = 0;
+		if (target == GL_UNIFORM_BUFFER)
+			glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+		else if (target == GL_SHADER_STORAGE_BUFFER)
+			glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &align);
+		if (align > (GLint)minAlign)
+			minAlign = align;
+		regionBytes = (frameBytes + minAlign - 1) / minAlign * minAlign;
+		int regions = mode == STREAM_ORPHAN ? 1 : STREAM_FRAMES;
+
+		glGenBuffers(1, &name);
+		glBindBuffer(target, name);
+		if (mode == STREAM_PERSISTENT)
+		{
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(target, regionBytes * regions, NULL, flags);
+			mapped = (unsigned char *)glMapBufferRange(target, 0, regionBytes * regions, flags);
+			if (!mapped)
+			{
+				fprintf(stderr, "Failed to map the streaming buffer persistently (%.1f MB)\n", regionBytes * regions / 1048576.0);
+				destroy();
+				return false;
+			}
+		}
+		else
+			glBufferData(target, regionBytes * regions, NULL, GL_STREAM_DRAW);
+		glBindBuffer(target, 0);
+		region = STREAM_FRAMES - 1;
+		head = regionBytes;
+		return true;
+	}
+
+	void destroy()
+	{
+		for (int i = 0; i < STREAM_FRAMES; i++)
+		{
+			if (fences[i])
+				glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+		if (name && mapped)
+		{
+			glBindBuffer(target, name);
+			glUnmapBuffer(target);
+			glBindBuffer(target, 0);
+		}
+		mapped = NULL;
+		if (name)
+			glDeleteBuffers(1, &name);
+		name = 0;
+	}
+
+	// Moves to the next region, waiting for the GPU if it still reads it
+	bool beginFrame()
+	{
+		resetStats();
+		region = mode == STREAM_ORPHAN ? 0 : (region + 1) % STREAM_FRAMES;
+		head = 0;
+		waitRegion(region);
+
+		if (mode == STREAM_PERSISTENT)
+			return true;
+		glBindBuffer(target, name);
+		if (mode == STREAM_ORPHAN)
+		{
+			glBufferData(target, regionBytes, NULL, GL_STREAM_DRAW);
+			mapped = (unsigned char *)glMapBufferRange(target, 0, regionBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		}
+		else
+			mapped = (unsigned char *)glMapBufferRange(target, region * regionBytes, regionBytes,
+													   GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		glBindBuffer(target, 0);
+		return mapped != NULL;
+	}
+
+	// Write pointer for `bytes` of this frame, and their offset in buffer().
+	// NULL when the frame budget is used up.
+	void *allocate(size_t bytes, GLintptr *offset, size_t align = 0)
+	{
+		if (align < minAlign)
+			align = minAlign;
+		size_t start = (head + align - 1) / align * align;
+		if (!mapped || start + bytes > regionBytes)
+		{
+			stats.failed++;
+			return NULL;
+		}
+		head = start + bytes;
+		stats.bytes += bytes;
+		*offset = regionOffset() + start;
+		return (mode == STREAM_PERSISTENT ? mapped + regionOffset() : mapped) + start;
+	}
+
+	// The writes of the frame are done, the buffer may be used by draws
+	void commit()
+	{
+		if (mode == STREAM_PERSISTENT || !mapped)
+			return;
+		glBindBuffer(target, name);
+		glUnmapBuffer(target);
+		glBindBuffer(target, 0);
+		mapped = NULL;
+	}
+
+	// After the last draw reading this frame's data
+	void endFrame()
+	{
+		commit();
+		if (mode == STREAM_ORPHAN)
+			return;
+		if (fences[region])
+			glDeleteSync(fences[region]);
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	GLuint buffer() const { return name; }
+	StreamMode streamMode() const { return mode; }
+	size_t frameBytes() const { return regionBytes; }
+	size_t alignment() const { return minAlign; }
+	const StreamStats &frameStats() const { return stats; }
+
+private:
+	GLintptr regionOffset() const { return mode == STREAM_ORPHAN ? 0 : (GLintptr)(region * regionBytes); }
+
+	void waitRegion(int r)
+	{
+		if (!fences[r])
+			return;
+		GLenum status = glClientWaitSync(fences[r], 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+			do
+			{
+				status = glClientWaitSync(fences[r], flags, 1000000); // 1 ms
+				flags = 0;
+			} while (status == GL_TIMEOUT_EXPIRED);
+			stats.stallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+		glDeleteSync(fences[r]);
+		fences[r] = 0;
+	}
+
+	void resetStats()
+	{
+		stats.bytes = 0;
+		stats.stallSeconds = 0.0;
+		stats.failed = 0;
+	}
+
+	GLuint name;
+	GLenum target;
+	StreamMode mode;
+	size_t regionBytes;
+	int region;
+	size_t head;
+	unsigned char *mapped; // whole buffer when persistent, current region otherwise
+	size_t minAlign;
+	GLsync fences[STREAM_FRAMES];
+	StreamStats stats;
+
+	StreamRing(const StreamRing &);
+	StreamRing &operator=(const StreamRing &);
+};
+
+#endif
@@ -0,0 +1,77 @@
+// Clustered light binning for 1, 64, 512 and 4096 lights, from 1 to N threads.
+// The lights circle through the cubes of the playground scene seen from its
+// camera. For every light count it prints the binning time per frame and how
+// many lights the clusters hold, which is what each fragment loops over.
+//
+// Build : g++ -O2 -std=c++11 -pthread -I.. -I<glm> bench_clusters.cpp -o bench_clusters
+// Usage : bench_clusters [cubes] [max threads]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <glm/gtc/matrix_transform.hpp>
+#include "../clusters.hpp"
+
+#define FRAMES 200
+
+static double now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char **argv)
+{
+	int cubeCount = argc > 1 ? atoi(argv[1]) : 200;
+	int maxThreads = argc > 2 ? atoi(argv[2]) : (int)std::thread::hardware_concurrency();
+	if (maxThreads < 1)
+		maxThreads = 1;
+	int gridSide = 1;
+	while (gridSide * gridSide * gridSide < cubeCount)
+		gridSide++;
+
+	// Same view as playground.cpp
+	glm::mat4 projection = glm::perspective(45.0f, 4.0f / 3.0f, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(4, 3, 3), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+
+	std::vector<int> threadCounts;
+	for (int threads = 1; threads < maxThreads; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+
+	printf("%d cubes, %d frames, %dx%dx%d clusters, %u hardware threads\n", cubeCount, FRAMES, CLUSTER_X, CLUSTER_Y, CLUSTER_Z,
+		   std::thread::hardware_concurrency());
+	printf(" lights  threads  binning ms  speedup  in view  per cluster  max  occupied\n");
+	static const uint32_t lightCounts[] = {1, 64, 512, 4096};
+	for (size_t l = 0; l < sizeof(lightCounts) / sizeof(lightCounts[0]); l++)
+	{
+		std::vector<LightOrbit> orbits;
+		makeLightOrbits(lightCounts[l], glm::vec3(4, 4, 1), 1.5f * gridSide + 2.0f, orbits);
+		double base = 0.0;
+		for (size_t t = 0; t < threadCounts.size(); t++)
+		{
+			JobSystem jobs(threadCounts[t]);
+			ClusterBuilder builder;
+			FrameArena frame;
+			LightClusters clusters;
+			double seconds = 0.0;
+			for (int f = 0; f < FRAMES; f++)
+			{
+				frame.reset();
+				double start = now();
+				clusters = builder.build(jobs, frame, orbits.data(), lightCounts[l], f / 60.0f, view, projection);
+				seconds += now() - start;
+			}
+			double ms = seconds / FRAMES * 1000.0;
+			if (t == 0)
+				base = ms;
+			uint32_t occupied = 0;
+			for (uint32_t c = 0; c < CLUSTER_COUNT; c++)
+				occupied += clusters.clusters[c].y != 0;
+			printf("%7u %8d %11.3f %7.2fx %8u %12.2f %4u %8.1f%%\n", lightCounts[l], threadCounts[t], ms, base / ms, clusters.visibleLights,
+				   (double)clusters.indices.size() / CLUSTER_COUNT, clusters.maxPerCluster, 100.0 * occupied / CLUSTER_COUNT);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,148 @@
+// Update throughput of the entity store against array-of-objects layouts.
+// Runs the animation + transform update on 1M entities with each layout :
+//   aos      : std::vector<RenderObject>, all fields of an object side by side
+//   aos-heap : std::vector<RenderObject *>, objects allocated one by one
+//   chunks   : EntityStore archetype chunks, one array per component
+//
+// Build : g++ -O2 -std=c++11 -I.. -I<glm> bench_entities.cpp -o bench_entities
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include "../entities.hpp"
+
+#define ENTITY_COUNT 1000000
+#define FRAMES 20
+
+// Classic game object, every component of an entity in one struct
+struct RenderObject
+{
+	Transform transform;
+	MeshHandle mesh;
+	MaterialHandle material;
+	Bounds bounds;
+	Animation animation;
+
+	void update(float deltaTime)
+	{
+		animation.angle += animation.speed * deltaTime;
+		glm::mat4 model = glm::translate(glm::mat4(1.0f), transform.position);
+		model = glm::rotate(model, animation.angle, animation.axis);
+		transform.model = glm::scale(model, glm::vec3(transform.scale));
+		bounds.worldCenter = glm::vec3(transform.model * glm::vec4(bounds.center, 1.0f));
+		bounds.worldRadius = bounds.radius * transform.scale;
+	}
+};
+
+static float randf()
+{
+	return rand() / (float)RAND_MAX;
+}
+
+static void initObject(Transform &t, Bounds &b, Animation &a)
+{
+	t.position = glm::vec3(randf() * 100.0f, randf() * 100.0f, randf() * 100.0f);
+	t.scale = 0.5f + randf();
+	b.center = glm::vec3(0.0f, 0.0f, -0.8f);
+	b.radius = 1.7321f;
+	a.axis = glm::vec3(0.0f, 1.0f, 0.0f);
+	a.angle = randf() * 6.28f;
+	a.speed = randf();
+}
+
+static double now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void report(const char *name, double seconds, float checksum)
+{
+	double perFrame = seconds / FRAMES;
+	printf("%-9s %8.2f ms/frame %8.2f ns/entity %8.1f M entities/s   (checksum %g)\n",
+		   name, perFrame * 1000.0, perFrame * 1e9 / ENTITY_COUNT, ENTITY_COUNT / perFrame / 1e6, checksum);
+}
+
+int main(void)
+{
+	const float deltaTime = 1.0f / 60.0f;
+	printf("%d entities, %d frames\n", ENTITY_COUNT, FRAMES);
+
+	// Array of objects
+	{
+		srand(1);
+		std::vector<RenderObject> objects(ENTITY_COUNT);
+		for (size_t i = 0; i < objects.size(); i++)
+			initObject(objects[i].transform, objects[i].bounds, objects[i].animation);
+		double start = now();
+		for (int f = 0; f < FRAMES; f++)
+			for (size_t i = 0; i < objects.size(); i++)
+				objects[i].update(deltaTime);
+		double elapsed = now() - start;
+		float checksum = 0.0f;
+		for (size_t i = 0; i < objects.size(); i += 1000)
+			checksum += objects[i].bounds.worldCenter.x;
+		report("aos", elapsed, checksum);
+	}
+
+	// Array of pointers to individually allocated objects, in allocation-shuffled order
+	{
+		srand(1);
+		std::vector<RenderObject *> objects(ENTITY_COUNT);
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			objects[i] = new RenderObject();
+			initObject(objects[i]->transform, objects[i]->bounds, objects[i]->animation);
+		}
+		std::mt19937 rng(1);
+		std::shuffle(objects.begin(), objects.end(), rng);
+		double start = now();
+		for (int f = 0; f < FRAMES; f++)
+			for (size_t i = 0; i < objects.size(); i++)
+				objects[i]->update(deltaTime);
+		double elapsed = now() - start;
+		float checksum = 0.0f;
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			if (i % 1000 == 0)
+				checksum += objects[i]->bounds.worldCenter.x;
+			delete objects[i];
+		}
+		report("aos-heap", elapsed, checksum);
+	}
+
+	// Entity store
+	{
+		srand(1);
+		EntityStore store;
+		uint32_t mask = COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_MESH) | COMPONENT_BIT(COMPONENT_MATERIAL) | COMPONENT_BIT(COMPONENT_BOUNDS) | COMPONENT_BIT(COMPONENT_ANIMATION);
+		std::vector<Entity> entities(ENTITY_COUNT);
+		for (size_t i = 0; i < entities.size(); i++)
+		{
+			entities[i] = store.create(mask);
+			initObject(*store.get<Transform>(entities[i]), *store.get<Bounds>(entities[i]), *store.get<Animation>(entities[i]));
+		}
+		double start = now();
+		for (int f = 0; f < FRAMES; f++)
+		{
+			animationSystem(store, deltaTime);
+			transformSystem(store);
+		}
+		double elapsed = now() - start;
+		float checksum = 0.0f;
+		for (size_t i = 0; i < entities.size(); i += 1000)
+			checksum += store.get<Bounds>(entities[i])->worldCenter.x;
+		report("chunks", elapsed, checksum);
+
+		// Animation alone only streams the Animation arrays
+		start = now();
+		for (int f = 0; f < FRAMES; f++)
+			animationSystem(store, deltaTime);
+		elapsed = now() - start;
+		report("anim-only", elapsed, store.get<Animation>(entities[0])->angle);
+	}
+
+	return 0;
+}
@@ -0,0 +1,124 @@
+// Scaling of the per-frame CPU stages on the job system, from 1 to N threads.
+// For every thread count it times, on the same scene :
+//   update : animation + transform of every entity
+//   draws  : frustum culling, draw list building and sorting
+//   sort   : parallelSort alone, on as many random keys as entities, checked
+//            against std::sort
+//
+// Build : g++ -O2 -std=c++11 -pthread -I.. -I<glm> bench_jobs.cpp -o bench_jobs
+// Usage : bench_jobs [entities] [max threads]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include "../drawlist.hpp"
+
+#define FRAMES 30
+
+static double now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static float randf()
+{
+	return rand() / (float)RAND_MAX;
+}
+
+int main(int argc, char **argv)
+{
+	int entityCount = argc > 1 ? atoi(argv[1]) : 200000;
+	int maxThreads = argc > 2 ? atoi(argv[2]) : (int)std::thread::hardware_concurrency();
+	if (maxThreads < 1)
+		maxThreads = 1;
+
+	// Cubes scattered in a box around the camera target, about half of them in view
+	srand(1);
+	EntityStore scene;
+	const uint32_t renderable = COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_MESH) | COMPONENT_BIT(COMPONENT_MATERIAL);
+	for (int i = 0; i < entityCount; i++)
+	{
+		Entity e = scene.create(renderable | COMPONENT_BIT(COMPONENT_BOUNDS) | COMPONENT_BIT(COMPONENT_ANIMATION));
+		scene.get<Transform>(e)->position = glm::vec3(randf() * 200.0f - 100.0f, randf() * 200.0f - 100.0f, randf() * 200.0f - 100.0f);
+		scene.get<MeshHandle>(e)->vertexCount = 36;
+		scene.get<MaterialHandle>(e)->id = 1 + rand() % 4;
+		scene.get<Bounds>(e)->center = glm::vec3(0.0f, 0.0f, -0.8f);
+		scene.get<Bounds>(e)->radius = 1.7321f;
+		scene.get<Animation>(e)->speed = randf();
+	}
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 4.0f / 3.0f, 0.1f, 300.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0, 0, 0), glm::vec3(1, 0, 0), glm::vec3(0, 1, 0));
+	Frustum frustum(projection * view);
+
+	printf("%d entities, %d frames, %u hardware threads\n", entityCount, FRAMES, std::thread::hardware_concurrency());
+	std::vector<uint64_t> keys(entityCount), sortedKeys;
+	for (int i = 0; i < entityCount; i++)
+		keys[i] = ((uint64_t)rand() << 32) ^ ((uint64_t)rand() << 16) ^ (uint64_t)rand();
+	sortedKeys = keys;
+	std::sort(sortedKeys.begin(), sortedKeys.end());
+
+	printf("threads   update ms  speedup   draws ms  speedup    sort ms  speedup   visible\n");
+
+	// 1, 2, 4 ... and the maximum
+	std::vector<int> threadCounts;
+	for (int threads = 1; threads < maxThreads; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+
+	double updateBase = 0.0, drawsBase = 0.0, sortBase = 0.0;
+	for (size_t t = 0; t < threadCounts.size(); t++)
+	{
+		int threads = threadCounts[t];
+		JobSystem jobs(threads);
+		DrawListBuilder drawList;
+		std::vector<Chunk *> chunks;
+		FrameArena frame;
+		scene.gatherChunks(renderable, chunks);
+
+		double update = 0.0, build = 0.0, sort = 0.0;
+		std::vector<uint64_t> sorting, scratch(keys.size());
+		for (int f = 0; f < FRAMES; f++)
+		{
+			double start = now();
+			jobs.parallelFor((uint32_t)chunks.size(), 4, [&](uint32_t begin, uint32_t end) {
+				for (uint32_t c = begin; c < end; c++)
+				{
+					animateChunk(*chunks[c], 1.0f / 60.0f);
+					transformChunk(*chunks[c]);
+				}
+			});
+			double middle = now();
+			frame.reset();
+			drawList.build(jobs, frame, chunks, view, frustum);
+			double end = now();
+			update += middle - start;
+			build += end - middle;
+
+			sorting = keys;
+			start = now();
+			parallelSort(jobs, sorting.data(), sorting.size(), scratch.data(), std::less<uint64_t>());
+			sort += now() - start;
+		}
+		if (sorting != sortedKeys)
+		{
+			fprintf(stderr, "parallelSort on %d threads differs from std::sort\n", threads);
+			return 1;
+		}
+		update = update / FRAMES * 1000.0;
+		build = build / FRAMES * 1000.0;
+		sort = sort / FRAMES * 1000.0;
+		if (threads == 1)
+		{
+			updateBase = update;
+			drawsBase = build;
+			sortBase = sort;
+		}
+		printf("%7d %11.2f %8.2fx %10.2f %8.2fx %10.2f %8.2fx %9u\n", threads, update, updateBase / update, build, drawsBase / build, sort,
+			   sortBase / sort, drawList.visibleCount);
+	}
+	return 0;
+}
@@ -0,0 +1,99 @@
+// Create / destroy churn on a handle pool against new / delete.
+// Keeps a working set of live objects and, every round, destroys a random
+// part of it and creates as many again, looking up every live handle once.
+// Handles of destroyed objects are kept too : each of their lookups must fail.
+//
+// Build : g++ -O2 -std=c++11 -I.. bench_pools.cpp -o bench_pools
+// Usage : bench_pools [live objects] [rounds]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <chrono>
+#include <random>
+#include "../pools.hpp"
+
+struct Object
+{
+	uint32_t name;
+	uint32_t payload[7];
+};
+
+struct ObjectTag;
+typedef Pool<ObjectTag, Object> ObjectPool;
+
+static double now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char **argv)
+{
+	int liveCount = argc > 1 ? atoi(argv[1]) : 100000;
+	int rounds = argc > 2 ? atoi(argv[2]) : 100;
+	int churn = liveCount / 4;
+	std::mt19937 rng(1);
+
+	// Pool
+	ObjectPool pool;
+	std::vector<ObjectPool::HandleType> handles, stale;
+	Object o = Object();
+	for (int i = 0; i < liveCount; i++)
+	{
+		o.name = i;
+		handles.push_back(pool.create(o));
+	}
+	uint64_t checksum = 0, staleHits = 0, staleChecked = 0;
+	double start = now();
+	for (int r = 0; r < rounds; r++)
+	{
+		stale.clear();
+		for (int i = 0; i < churn; i++)
+		{
+			size_t k = rng() % handles.size();
+			pool.release(handles[k], NULL);
+			stale.push_back(handles[k]);
+			o.name = r * churn + i;
+			handles[k] = pool.create(o);
+		}
+		for (size_t i = 0; i < handles.size(); i++)
+			checksum += pool.get(handles[i])->name;
+		for (size_t i = 0; i < stale.size(); i++, staleChecked++)
+			if (pool.get(stale[i]))
+				staleHits++;
+	}
+	double poolTime = now() - start;
+
+	// new / delete
+	std::vector<Object *> pointers;
+	for (int i = 0; i < liveCount; i++)
+	{
+		pointers.push_back(new Object());
+		pointers.back()->name = i;
+	}
+	rng.seed(1);
+	uint64_t checksumHeap = 0;
+	start = now();
+	for (int r = 0; r < rounds; r++)
+	{
+		for (int i = 0; i < churn; i++)
+		{
+			size_t k = rng() % pointers.size();
+			delete pointers[k];
+			pointers[k] = new Object();
+			pointers[k]->name = r * churn + i;
+		}
+		for (size_t i = 0; i < pointers.size(); i++)
+			checksumHeap += pointers[i]->name;
+	}
+	double heapTime = now() - start;
+	for (size_t i = 0; i < pointers.size(); i++)
+		delete pointers[i];
+
+	printf("%d live objects, %d destroyed and created per round, %d rounds\n", liveCount, churn, rounds);
+	printf("pool        : %.2f ms per round, %u slots (checksum %llu)\n", poolTime / rounds * 1000.0, pool.capacity(),
+		   (unsigned long long)checksum);
+	printf("new / delete: %.2f ms per round (checksum %llu)\n", heapTime / rounds * 1000.0, (unsigned long long)checksumHeap);
+	printf("stale handles : %llu looked up, %llu resolved\n", (unsigned long long)staleChecked, (unsigned long long)staleHits);
+	return staleHits == 0 ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+// Frame rate of the software rasterizer, from 1 to N threads, on two scenes :
+//   cube : the turning cube of step8, with its camera and light
+//   mesh : a torus of about a million triangles, indexed, at the same place
+// The image of every thread count is checked against the single thread one,
+// and the first scene images can be written as PPM files.
+//
+// Build : g++ -O3 -march=native -std=c++11 -pthread -I.. -I<glm> bench_softraster.cpp -o bench_softraster
+// Usage : bench_softraster [max threads] [frames] [image prefix]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include "../softraster.hpp"
+#include "step8scene.hpp"
+#include "ppm.hpp"
+
+#define WIDTH 1024
+#define HEIGHT 768
+
+struct Mesh
+{
+	std::vector<float> positions;
+	std::vector<float> colors;
+	std::vector<float> normals;
+	std::vector<uint32_t> indices; // empty for a plain triangle list
+};
+
+static double now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// rings * sides * 2 triangles, about the size of the cube
+static Mesh makeTorus(int rings, int sides)
+{
+	Mesh mesh;
+	const float major = 1.2f, minor = 0.5f;
+	for (int r = 0; r < rings; r++)
+		for (int s = 0; s < sides; s++)
+		{
+			float u = 6.2831853f * r / rings, v = 6.2831853f * s / sides;
+			glm::vec3 normal(cosf(v) * cosf(u), sinf(v), cosf(v) * sinf(u));
+			glm::vec3 position = glm::vec3(major * cosf(u), 0.0f, major * sinf(u)) + minor * normal;
+			glm::vec3 color(0.5f + 0.5f * cosf(u), 0.5f + 0.5f * sinf(u), 0.6f);
+			for (int k = 0; k < 3; k++)
+			{
+				mesh.positions.push_back(position[k]);
+				mesh.normals.push_back(normal[k]);
+				mesh.colors.push_back(color[k]);
+			}
+		}
+	for (int r = 0; r < rings; r++)
+		for (int s = 0; s < sides; s++)
+		{
+			uint32_t a = r * sides + s, b = ((r + 1) % rings) * sides + s;
+			uint32_t c = ((r + 1) % rings) * sides + (s + 1) % sides, d = r * sides + (s + 1) % sides;
+			uint32_t quad[6] = {a, b, c, a, c, d};
+			mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+		}
+	return mesh;
+}
+
+int main(int argc, char **argv)
+{
+	int maxThreads = argc > 1 ? atoi(argv[1]) : (int)std::thread::hardware_concurrency();
+	int frames = argc > 2 ? atoi(argv[2]) : 30;
+	const char *prefix = argc > 3 ? argv[3] : NULL;
+	if (maxThreads < 1)
+		maxThreads = 1;
+	if (frames < 1)
+		frames = 1;
+
+	Mesh cube;
+	cube.positions.assign(g_step8_positions, g_step8_positions + 3 * g_step8_vertex_count);
+	cube.colors.assign(g_step8_colors, g_step8_colors + 3 * g_step8_vertex_count);
+	cube.normals.assign(g_step8_normals, g_step8_normals + 3 * g_step8_vertex_count);
+	Mesh torus = makeTorus(1000, 500);
+	const char *names[2] = {"cube", "mesh"};
+	const Mesh *meshes[2] = {&cube, &torus};
+
+	glm::mat4 projection = step8Projection((float)WIDTH / HEIGHT);
+	glm::mat4 view = step8View();
+
+	std::vector<int> threadCounts;
+	for (int threads = 1; threads < maxThreads; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+
+#if defined(__AVX2__)
+	const char *simd = "AVX2";
+#else
+	const char *simd = "scalar";
+#endif
+	printf("%dx%d, %d frames, %s edge functions, %u hardware threads\n", WIDTH, HEIGHT, frames, simd, std::thread::hardware_concurrency());
+	for (int s = 0; s < 2; s++)
+	{
+		const Mesh &mesh = *meshes[s];
+		uint32_t vertexCount = (uint32_t)mesh.positions.size() / 3;
+		uint32_t indexCount = (uint32_t)mesh.indices.size();
+		printf("\n%s : %u triangles\n", names[s], (indexCount ? indexCount : vertexCount) / 3);
+		printf("threads    fps  speedup  geometry ms  raster ms   binned  tile / block hidden   shaded\n");
+
+		std::vector<uint32_t> reference;
+		double baseFps = 0.0;
+		bool deterministic = true;
+		for (size_t t = 0; t < threadCounts.size(); t++)
+		{
+			JobSystem jobs(threadCounts[t]);
+			SoftRasterizer raster(jobs, WIDTH, HEIGHT);
+			SoftRasterStats total;
+			double start = now();
+			for (int f = 0; f < frames; f++)
+			{
+				// Same animation for every thread count, 60 Hz
+				glm::mat4 model = step8Model(f / 60.0f);
+				raster.beginFrame(view, g_step8_light, glm::vec3(0.0f, 0.0f, 0.4f));
+				raster.draw(mesh.positions.data(), mesh.colors.data(), mesh.normals.data(), vertexCount,
+							indexCount ? mesh.indices.data() : NULL, indexCount, projection * view * model, model);
+				raster.endFrame();
+				const SoftRasterStats &stats = raster.stats();
+				total.geometrySeconds += stats.geometrySeconds;
+				total.rasterSeconds += stats.rasterSeconds;
+				total.binned += stats.binned;
+				total.tilesRejected += stats.tilesRejected;
+				total.blocksTested += stats.blocksTested;
+				total.blocksRejected += stats.blocksRejected;
+				total.pixelsShaded += stats.pixelsShaded;
+			}
+			double fps = frames / (now() - start);
+			if (t == 0)
+				baseFps = fps;
+
+			std::vector<uint32_t> image(raster.pixels(), raster.pixels() + WIDTH * HEIGHT);
+			if (t == 0)
+				reference = image;
+			else if (image != reference)
+				deterministic = false;
+			if (prefix && t == 0)
+				writePPM((std::string(prefix) + names[s] + ".ppm").c_str(), image.data(), WIDTH, HEIGHT);
+
+			printf("%7d %6.1f %7.2fx %12.2f %10.2f %8.0f %8.1f%% / %5.1f%% %8.0f\n", threadCounts[t], fps, fps / baseFps,
+				   total.geometrySeconds / frames * 1000.0, total.rasterSeconds / frames * 1000.0, (double)total.binned / frames,
+				   total.binned ? 100.0 * total.tilesRejected / total.binned : 0.0,
+				   total.blocksTested ? 100.0 * total.blocksRejected / total.blocksTested : 0.0, (double)total.pixelsShaded / frames);
+		}
+		printf("%s image for every thread count\n", deterministic ? "same" : "DIFFERENT");
+	}
+	return 0;
+}
@@ -0,0 +1,173 @@
+// Upload bandwidth and CPU stalls of the streaming paths, 1 to 256 MB per frame.
+// Every frame writes `size` bytes for the GPU and has the GPU read all of
+// them (a copy into a device buffer), then the next frame starts right away,
+// so the ring runs as far ahead as its fences let it :
+//   buffer data : glBufferData(GL_STATIC_DRAW) of a CPU copy every frame, as
+//                 the step programs used to do
+//   persistent, map range, orphan : the StreamRing modes
+//
+// Build : g++ -O2 -std=c++11 -I.. bench_stream.cpp -o bench_stream -lglfw -lGLEW -lGL
+// Usage : bench_stream [max MB per frame] [frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "../stream.hpp"
+
+static double now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Result
+{
+	double seconds;    // all frames, GPU finished
+	double cpuMax;     // longest frame on the CPU
+	double stall;      // waiting for fences, all frames
+	bool ok;
+};
+
+// The GPU reads what the frame wrote
+static void consume(GLuint source, GLintptr offset, size_t size, GLuint sink)
+{
+	glBindBuffer(GL_COPY_READ_BUFFER, source);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, sink);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, 0, size);
+}
+
+static Result runBufferData(size_t size, int frames, const unsigned char *source, GLuint sink)
+{
+	Result r = Result();
+	std::vector<unsigned char> staging(size);
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	glFinish();
+	double start = now();
+	for (int f = 0; f < frames; f++)
+	{
+		double frameStart = now();
+		memcpy(&staging[0], source, size);
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferData(GL_ARRAY_BUFFER, size, &staging[0], GL_STATIC_DRAW);
+		consume(buffer, 0, size, sink);
+		double cpu = now() - frameStart;
+		if (cpu > r.cpuMax)
+			r.cpuMax = cpu;
+	}
+	glFinish();
+	r.seconds = now() - start;
+	r.ok = true;
+	glDeleteBuffers(1, &buffer);
+	return r;
+}
+
+static Result runRing(StreamMode mode, size_t size, int frames, const unsigned char *source, GLuint sink)
+{
+	Result r = Result();
+	StreamRing ring;
+	if (!ring.create(GL_ARRAY_BUFFER, size, mode) || ring.streamMode() != mode)
+	{
+		ring.destroy();
+		return r;
+	}
+	glFinish();
+	double start = now();
+	for (int f = 0; f < frames; f++)
+	{
+		double frameStart = now();
+		GLintptr offset;
+		void *p = ring.beginFrame() ? ring.allocate(size, &offset) : NULL;
+		if (!p)
+		{
+			ring.destroy();
+			return r;
+		}
+		memcpy(p, source, size);
+		ring.commit();
+		consume(ring.buffer(), offset, size, sink);
+		ring.endFrame();
+		r.stall += ring.frameStats().stallSeconds;
+		double cpu = now() - frameStart;
+		if (cpu > r.cpuMax)
+			r.cpuMax = cpu;
+	}
+	glFinish();
+	r.seconds = now() - start;
+	r.ok = true;
+	ring.destroy();
+	return r;
+}
+
+int main(int argc, char **argv)
+{
+	int maxMB = argc > 1 ? atoi(argv[1]) : 256;
+	int frames = argc > 2 ? atoi(argv[2]) : 20;
+
+	if (!glfwInit())
+	{
+		fprintf(stderr, "Failed to initialize GLFW\n");
+		return -1;
+	}
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	GLFWwindow *window = glfwCreateWindow(64, 64, "bench_stream", NULL, NULL);
+	if (window == NULL)
+	{
+		fprintf(stderr, "Failed to open GLFW window\n");
+		glfwTerminate();
+		return -1;
+	}
+	glfwMakeContextCurrent(window);
+	glewExperimental = true;
+	if (glewInit() != GLEW_OK)
+	{
+		fprintf(stderr, "Failed to initialize GLEW\n");
+		glfwTerminate();
+		return -1;
+	}
+	printf("%s, %d frames per size\n", (const char *)glGetString(GL_RENDERER), frames);
+
+	size_t maxSize = (size_t)maxMB << 20;
+	std::vector<unsigned char> source(maxSize);
+	for (size_t i = 0; i < maxSize; i++)
+		source[i] = (unsigned char)i;
+	GLuint sink;
+	glGenBuffers(1, &sink);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, sink);
+	glBufferData(GL_COPY_WRITE_BUFFER, maxSize, NULL, GL_STATIC_COPY);
+
+	printf("MB/frame  path          GB/s   ms/frame  cpu max ms  stall ms/frame\n");
+	for (int mb = 1; mb <= maxMB;)
+	{
+		size_t size = (size_t)mb << 20;
+		for (int path = 0; path < 4; path++)
+		{
+			static const char *names[] = {"buffer data", "persistent", "map range", "orphan"};
+			static const StreamMode modes[] = {STREAM_AUTO, STREAM_PERSISTENT, STREAM_MAP_RANGE, STREAM_ORPHAN};
+			Result r = path == 0 ? runBufferData(size, frames, &source[0], sink) : runRing(modes[path], size, frames, &source[0], sink);
+			if (!r.ok)
+			{
+				printf("%8d  %-12s  unavailable\n", mb, names[path]);
+				continue;
+			}
+			printf("%8d  %-12s %5.2f %10.2f %11.2f %15.3f\n", mb, names[path], (double)size * frames / r.seconds / 1e9,
+				   r.seconds / frames * 1000.0, r.cpuMax * 1000.0, r.stall / frames * 1000.0);
+		}
+		// Four times larger each pass, always finishing with the maximum
+		int next = mb * 4;
+		if (mb < maxMB && next > maxMB)
+			next = maxMB;
+		mb = next;
+	}
+
+	glDeleteBuffers(1, &sink);
+	glfwTerminate();
+	return 0;
+}
@@ -0,0 +1,986 @@
+// Replays a GL trace recorded by a -DGLTRACE build of the playground (see
+// gltrace.hpp) in a hidden window, as fast as the driver goes, and times every
+// call of the traced frame range. The command stream is the same on every run,
+// so two drivers, two builds of one, or two settings can be compared on
+// identical work.
+//
+// Call times are CPU times, what the driver takes to accept the call. With
+// --finish every frame ends with glFinish, so the frame times include the GPU.
+//
+// Build : g++ -O2 -std=c++11 -I.. -I<glew, glfw> gltrace_replay.cpp -lglfw -lGLEW -lGL -o gltrace_replay
+// Usage : gltrace_replay file.trace [--finish] [--vsync]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <algorithm>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "../gltrace.hpp"
+
+struct CallStats
+{
+	uint64_t count;
+	double seconds;
+	double max;
+};
+
+struct Mapping
+{
+	unsigned char *pointer;
+	uint64_t offset; // of the mapped range in the buffer
+};
+
+// Everything named by the recording driver, and what it is called here
+struct ReplayNames
+{
+	std::map<GLuint, GLuint> buffers;
+	std::map<GLuint, GLuint> vertexArrays;
+	std::map<GLuint, GLuint> queries;
+	std::map<GLuint, GLuint> textures;
+	std::map<GLuint, GLuint> framebuffers;
+	std::map<GLuint, GLuint> renderbuffers;
+	std::map<GLuint, GLuint> objects; // shaders and programs share names
+	std::map<uint32_t, GLsync> syncs;
+	std::map<std::pair<GLuint, GLint>, GLint> locations; // by recorded program and location
+
+	static GLuint find(const std::map<GLuint, GLuint> &names, GLuint name)
+	{
+		std::map<GLuint, GLuint>::const_iterator it = names.find(name);
+		return it == names.end() ? name : it->second;
+	}
+
+	GLuint buffer(GLuint name) const { return find(buffers, name); }
+	GLuint vertexArray(GLuint name) const { return find(vertexArrays, name); }
+	GLuint query(GLuint name) const { return find(queries, name); }
+	GLuint texture(GLuint name) const { return find(textures, name); }
+	GLuint framebuffer(GLuint name) const { return find(framebuffers, name); }
+	GLuint renderbuffer(GLuint name) const { return find(renderbuffers, name); }
+
+	// Names made by a glGen* call or freed by a glDelete* one
+	std::map<GLuint, GLuint> &generated(GlTraceOp op)
+	{
+		switch (op)
+		{
+		case GLT_GenBuffers:
+		case GLT_DeleteBuffers:
+			return buffers;
+		case GLT_GenVertexArrays:
+		case GLT_DeleteVertexArrays:
+			return vertexArrays;
+		case GLT_GenQueries:
+		case GLT_DeleteQueries:
+			return queries;
+		case GLT_GenTextures:
+		case GLT_DeleteTextures:
+			return textures;
+		case GLT_GenFramebuffers:
+		case GLT_DeleteFramebuffers:
+			return framebuffers;
+		default:
+			return renderbuffers;
+		}
+	}
+	GLuint object(GLuint name) const { return find(objects, name); }
+
+	GLsync sync(uint32_t id) const
+	{
+		std::map<uint32_t, GLsync>::const_iterator it = syncs.find(id);
+		return it == syncs.end() ? 0 : it->second;
+	}
+
+	GLint location(GLuint program, GLint location) const
+	{
+		std::map<std::pair<GLuint, GLint>, GLint>::const_iterator it = locations.find(std::make_pair(program, location));
+		return it == locations.end() ? location : it->second;
+	}
+};
+
+static void genNames(GlTraceOp op, GLsizei n, GLuint *names)
+{
+	switch (op)
+	{
+	case GLT_GenBuffers:
+		glGenBuffers(n, names);
+		break;
+	case GLT_GenVertexArrays:
+		glGenVertexArrays(n, names);
+		break;
+	case GLT_GenQueries:
+		glGenQueries(n, names);
+		break;
+	case GLT_GenTextures:
+		glGenTextures(n, names);
+		break;
+	case GLT_GenFramebuffers:
+		glGenFramebuffers(n, names);
+		break;
+	default:
+		glGenRenderbuffers(n, names);
+		break;
+	}
+}
+
+static void deleteNames(GlTraceOp op, GLsizei n, const GLuint *names)
+{
+	switch (op)
+	{
+	case GLT_DeleteBuffers:
+		glDeleteBuffers(n, names);
+		break;
+	case GLT_DeleteVertexArrays:
+		glDeleteVertexArrays(n, names);
+		break;
+	case GLT_DeleteQueries:
+		glDeleteQueries(n, names);
+		break;
+	case GLT_DeleteTextures:
+		glDeleteTextures(n, names);
+		break;
+	case GLT_DeleteFramebuffers:
+		glDeleteFramebuffers(n, names);
+		break;
+	default:
+		glDeleteRenderbuffers(n, names);
+		break;
+	}
+}
+
+static double now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = NULL;
+	bool finish = false;
+	bool vsync = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--finish"))
+			finish = true;
+		else if (!strcmp(argv[i], "--vsync"))
+			vsync = true;
+		else if (!path)
+			path = argv[i];
+	}
+	if (!path)
+	{
+		fprintf(stderr, "Usage : %s file.trace [--finish] [--vsync]\n", argv[0]);
+		return 2;
+	}
+
+	GlTraceReader trace;
+	if (!trace.open(path))
+		return 1;
+
+	if (!glfwInit())
+	{
+		fprintf(stderr, "Failed to initialize GLFW\n");
+		return 1;
+	}
+	// Same context as the playground, never shown
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	glfwWindowHint(GLFW_SAMPLES, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	GLFWwindow *window = glfwCreateWindow(trace.header.width, trace.header.height, "Replay", NULL, NULL);
+	if (!window)
+	{
+		fprintf(stderr, "Failed to create a GL 3.3 context\n");
+		glfwTerminate();
+		return 1;
+	}
+	glfwMakeContextCurrent(window);
+	glewExperimental = true;
+	if (glewInit() != GLEW_OK)
+	{
+		fprintf(stderr, "Failed to initialize GLEW\n");
+		glfwTerminate();
+		return 1;
+	}
+	glfwSwapInterval(vsync ? 1 : 0);
+
+	printf("%s : %ux%u, frames %u to %u timed\n", path, trace.header.width, trace.header.height, trace.header.firstFrame,
+		   trace.header.firstFrame + trace.header.frameCount - 1);
+	printf("recorded on %s, %s\n", trace.header.renderer, trace.header.glVersion);
+	printf("replayed on %s, %s\n", (const char *)glGetString(GL_RENDERER), (const char *)glGetString(GL_VERSION));
+
+	ReplayNames names;
+	std::map<GLuint, Mapping> mappings; // by recorded buffer
+	GLuint program = 0;                 // recorded name of the program in use
+	std::vector<unsigned char> blob;
+	std::vector<unsigned char> scratch;
+	std::vector<CallStats> calls(GLT_COUNT);
+	std::vector<double> frameTimes;
+	uint64_t frame = 0; // the frame the calls belong to, ended by the next Frame record
+	uint64_t replayed = 0;
+	uint32_t unmappedWrites = 0;
+	const uint64_t firstFrame = trace.header.firstFrame, endFrame = firstFrame + trace.header.frameCount;
+	double frameStart = now();
+
+	GlTraceOp op = GLT_Frame;
+	while (trace.next(op))
+	{
+		typedef GlTraceReader R;
+		R &r = trace;
+		double start = 0.0;
+#define TIMED(call) \
+	start = now();  \
+	call;
+
+		switch (op)
+		{
+		case GLT_Frame:
+		{
+			uint64_t number = r.get<uint64_t>();
+			if (finish)
+				glFinish();
+			TIMED(glfwSwapBuffers(window));
+			frame = number + 1;
+			break;
+		}
+		case GLT_MappedWrite:
+		{
+			GLuint buffer = r.get<GLuint>();
+			uint64_t offset = r.get<uint64_t>();
+			r.bytes(blob);
+			std::map<GLuint, Mapping>::iterator it = mappings.find(buffer);
+			if (it == mappings.end() || !it->second.pointer)
+			{
+				unmappedWrites++;
+				continue;
+			}
+			TIMED(memcpy(it->second.pointer + (offset - it->second.offset), blob.data(), blob.size()));
+			break;
+		}
+		case GLT_AttachShader:
+		{
+			GLuint p = r.get<GLuint>(), s = r.get<GLuint>();
+			TIMED(glAttachShader(names.object(p), names.object(s)));
+			break;
+		}
+		case GLT_BindBuffer:
+		{
+			GLenum target = r.get<GLenum>();
+			GLuint buffer = r.get<GLuint>();
+			TIMED(glBindBuffer(target, names.buffer(buffer)));
+			break;
+		}
+		case GLT_BindBufferBase:
+		{
+			GLenum target = r.get<GLenum>();
+			GLuint index = r.get<GLuint>(), buffer = r.get<GLuint>();
+			TIMED(glBindBufferBase(target, index, names.buffer(buffer)));
+			break;
+		}
+		case GLT_BindBufferRange:
+		{
+			GLenum target = r.get<GLenum>();
+			GLuint index = r.get<GLuint>(), buffer = r.get<GLuint>();
+			uint64_t offset = r.get<uint64_t>(), size = r.get<uint64_t>();
+			TIMED(glBindBufferRange(target, index, names.buffer(buffer), offset, size));
+			break;
+		}
+		case GLT_BindVertexArray:
+		{
+			GLuint array = r.get<GLuint>();
+			TIMED(glBindVertexArray(names.vertexArray(array)));
+			break;
+		}
+		case GLT_BufferData:
+		case GLT_BufferStorage:
+		{
+			GLenum target = r.get<GLenum>();
+			uint64_t size = r.get<uint64_t>();
+			const void *data = r.bytes(blob) ? blob.data() : NULL;
+			GLenum usage = r.get<GLenum>();
+			if (op == GLT_BufferData)
+			{
+				TIMED(glBufferData(target, size, data, usage));
+			}
+			else
+			{
+				TIMED(glBufferStorage(target, size, data, usage));
+			}
+			break;
+		}
+		case GLT_Clear:
+		{
+			GLbitfield mask = r.get<GLbitfield>();
+			TIMED(glClear(mask));
+			break;
+		}
+		case GLT_ClearBufferData:
+		{
+			GLenum target = r.get<GLenum>(), internalformat = r.get<GLenum>(), format = r.get<GLenum>(), type = r.get<GLenum>();
+			const void *data = r.bytes(blob) ? blob.data() : NULL;
+			TIMED(glClearBufferData(target, internalformat, format, type, data));
+			break;
+		}
+		case GLT_ClearBufferSubData:
+		{
+			GLenum target = r.get<GLenum>(), internalformat = r.get<GLenum>();
+			uint64_t offset = r.get<uint64_t>(), size = r.get<uint64_t>();
+			GLenum format = r.get<GLenum>(), type = r.get<GLenum>();
+			const void *data = r.bytes(blob) ? blob.data() : NULL;
+			TIMED(glClearBufferSubData(target, internalformat, offset, size, format, type, data));
+			break;
+		}
+		case GLT_ClearColor:
+		{
+			GLfloat red = r.get<GLfloat>(), green = r.get<GLfloat>(), blue = r.get<GLfloat>(), alpha = r.get<GLfloat>();
+			TIMED(glClearColor(red, green, blue, alpha));
+			break;
+		}
+		case GLT_ClientWaitSync:
+		{
+			uint32_t id = r.get<uint32_t>();
+			GLbitfield flags = r.get<GLbitfield>();
+			GLuint64 timeout = r.get<GLuint64>();
+			GLsync sync = names.sync(id);
+			if (!sync)
+				continue;
+			TIMED(glClientWaitSync(sync, flags, timeout));
+			break;
+		}
+		case GLT_CompileShader:
+		{
+			GLuint shader = r.get<GLuint>();
+			TIMED(glCompileShader(names.object(shader)));
+			break;
+		}
+		case GLT_CopyBufferSubData:
+		{
+			GLenum readTarget = r.get<GLenum>(), writeTarget = r.get<GLenum>();
+			uint64_t readOffset = r.get<uint64_t>(), writeOffset = r.get<uint64_t>(), size = r.get<uint64_t>();
+			TIMED(glCopyBufferSubData(readTarget, writeTarget, readOffset, writeOffset, size));
+			break;
+		}
+		case GLT_CreateProgram:
+		{
+			GLuint recorded = r.get<GLuint>();
+			TIMED(names.objects[recorded] = glCreateProgram());
+			break;
+		}
+		case GLT_CreateShader:
+		{
+			GLenum type = r.get<GLenum>();
+			GLuint recorded = r.get<GLuint>();
+			TIMED(names.objects[recorded] = glCreateShader(type));
+			break;
+		}
+		case GLT_DeleteBuffers:
+		case GLT_DeleteFramebuffers:
+		case GLT_DeleteQueries:
+		case GLT_DeleteRenderbuffers:
+		case GLT_DeleteTextures:
+		case GLT_DeleteVertexArrays:
+		case GLT_GenBuffers:
+		case GLT_GenFramebuffers:
+		case GLT_GenQueries:
+		case GLT_GenRenderbuffers:
+		case GLT_GenTextures:
+		case GLT_GenVertexArrays:
+		{
+			r.bytes(blob);
+			std::vector<GLuint> recorded(blob.size() / sizeof(GLuint));
+			if (!recorded.empty())
+				memcpy(recorded.data(), blob.data(), blob.size());
+			std::vector<GLuint> local(recorded.size());
+			GLsizei n = (GLsizei)recorded.size();
+			std::map<GLuint, GLuint> &table = names.generated(op);
+			bool generate = op == GLT_GenBuffers || op == GLT_GenFramebuffers || op == GLT_GenQueries || op == GLT_GenRenderbuffers ||
+							op == GLT_GenTextures || op == GLT_GenVertexArrays;
+			if (generate)
+			{
+				TIMED(genNames(op, n, local.data()));
+				for (GLsizei i = 0; i < n; i++)
+					table[recorded[i]] = local[i];
+				break;
+			}
+			for (GLsizei i = 0; i < n; i++)
+			{
+				local[i] = ReplayNames::find(table, recorded[i]);
+				table.erase(recorded[i]);
+				if (op == GLT_DeleteBuffers)
+					mappings.erase(recorded[i]);
+			}
+			TIMED(deleteNames(op, n, local.data()));
+			break;
+		}
+		case GLT_DeleteProgram:
+		case GLT_DeleteShader:
+		{
+			GLuint recorded = r.get<GLuint>();
+			GLuint local = names.object(recorded);
+			names.objects.erase(recorded);
+			if (op == GLT_DeleteProgram)
+			{
+				TIMED(glDeleteProgram(local));
+			}
+			else
+			{
+				TIMED(glDeleteShader(local));
+			}
+			break;
+		}
+		case GLT_DeleteSync:
+		{
+			uint32_t id = r.get<uint32_t>();
+			GLsync sync = names.sync(id);
+			names.syncs.erase(id);
+			if (!sync)
+				continue;
+			TIMED(glDeleteSync(sync));
+			break;
+		}
+		case GLT_DepthFunc:
+		{
+			GLenum func = r.get<GLenum>();
+			TIMED(glDepthFunc(func));
+			break;
+		}
+		case GLT_DetachShader:
+		{
+			GLuint p = r.get<GLuint>(), s = r.get<GLuint>();
+			TIMED(glDetachShader(names.object(p), names.object(s)));
+			break;
+		}
+		case GLT_DisableVertexAttribArray:
+		{
+			GLuint index = r.get<GLuint>();
+			TIMED(glDisableVertexAttribArray(index));
+			break;
+		}
+		case GLT_DispatchCompute:
+		{
+			GLuint x = r.get<GLuint>(), y = r.get<GLuint>(), z = r.get<GLuint>();
+			TIMED(glDispatchCompute(x, y, z));
+			break;
+		}
+		case GLT_DrawArrays:
+		{
+			GLenum mode = r.get<GLenum>();
+			GLint first = r.get<GLint>();
+			GLsizei count = r.get<GLsizei>();
+			TIMED(glDrawArrays(mode, first, count));
+			break;
+		}
+		case GLT_Enable:
+		{
+			GLenum cap = r.get<GLenum>();
+			TIMED(glEnable(cap));
+			break;
+		}
+		case GLT_EnableVertexAttribArray:
+		{
+			GLuint index = r.get<GLuint>();
+			TIMED(glEnableVertexAttribArray(index));
+			break;
+		}
+		case GLT_FenceSync:
+		{
+			GLenum condition = r.get<GLenum>();
+			GLbitfield flags = r.get<GLbitfield>();
+			uint32_t id = r.get<uint32_t>();
+			TIMED(names.syncs[id] = glFenceSync(condition, flags));
+			break;
+		}
+		case GLT_Finish:
+		{
+			TIMED(glFinish());
+			break;
+		}
+		case GLT_GetBufferSubData:
+		{
+			GLenum target = r.get<GLenum>();
+			uint64_t offset = r.get<uint64_t>(), size = r.get<uint64_t>();
+			scratch.resize(size);
+			TIMED(glGetBufferSubData(target, offset, size, scratch.data()));
+			break;
+		}
+		case GLT_GetIntegerv:
+		{
+			GLenum pname = r.get<GLenum>();
+			GLint values[16];
+			TIMED(glGetIntegerv(pname, values));
+			break;
+		}
+		case GLT_GetProgramInfoLog:
+		case GLT_GetShaderInfoLog:
+		{
+			GLuint object = names.object(r.get<GLuint>());
+			GLsizei size = r.get<GLsizei>();
+			scratch.resize(size > 0 ? size : 1);
+			if (op == GLT_GetProgramInfoLog)
+			{
+				TIMED(glGetProgramInfoLog(object, size, NULL, (GLchar *)scratch.data()));
+			}
+			else
+			{
+				TIMED(glGetShaderInfoLog(object, size, NULL, (GLchar *)scratch.data()));
+			}
+			break;
+		}
+		case GLT_GetProgramiv:
+		case GLT_GetShaderiv:
+		{
+			GLuint object = names.object(r.get<GLuint>());
+			GLenum pname = r.get<GLenum>();
+			GLint values[4];
+			if (op == GLT_GetProgramiv)
+			{
+				TIMED(glGetProgramiv(object, pname, values));
+			}
+			else
+			{
+				TIMED(glGetShaderiv(object, pname, values));
+			}
+			break;
+		}
+		case GLT_GetUniformLocation:
+		{
+			GLuint recorded = r.get<GLuint>();
+			std::string name = r.string();
+			GLint location = r.get<GLint>();
+			TIMED(names.locations[std::make_pair(recorded, location)] = glGetUniformLocation(names.object(recorded), name.c_str()));
+			break;
+		}
+		case GLT_LinkProgram:
+		{
+			GLuint p = r.get<GLuint>();
+			TIMED(glLinkProgram(names.object(p)));
+			break;
+		}
+		case GLT_MapBufferRange:
+		{
+			GLenum target = r.get<GLenum>();
+			GLuint buffer = r.get<GLuint>();
+			uint64_t offset = r.get<uint64_t>(), length = r.get<uint64_t>();
+			GLbitfield access = r.get<GLbitfield>();
+			Mapping mapping;
+			mapping.offset = offset;
+			TIMED(mapping.pointer = (unsigned char *)glMapBufferRange(target, offset, length, access));
+			mappings[buffer] = mapping;
+			break;
+		}
+		case GLT_MemoryBarrier:
+		{
+			GLbitfield barriers = r.get<GLbitfield>();
+			TIMED(glMemoryBarrier(barriers));
+			break;
+		}
+		case GLT_MultiDrawElementsIndirect:
+		{
+			GLenum mode = r.get<GLenum>(), type = r.get<GLenum>();
+			uint64_t indirect = r.get<uint64_t>();
+			GLsizei drawcount = r.get<GLsizei>(), stride = r.get<GLsizei>();
+			TIMED(glMultiDrawElementsIndirect(mode, type, (const void *)(uintptr_t)indirect, drawcount, stride));
+			break;
+		}
+		case GLT_MultiDrawElementsIndirectCountARB:
+		{
+			GLenum mode = r.get<GLenum>(), type = r.get<GLenum>();
+			uint64_t indirect = r.get<uint64_t>(), drawcount = r.get<uint64_t>();
+			GLsizei maxdrawcount = r.get<GLsizei>(), stride = r.get<GLsizei>();
+			TIMED(glMultiDrawElementsIndirectCountARB(mode, type, (const void *)(uintptr_t)indirect, drawcount, maxdrawcount, stride));
+			break;
+		}
+		case GLT_PixelStorei:
+		{
+			GLenum pname = r.get<GLenum>();
+			GLint param = r.get<GLint>();
+			TIMED(glPixelStorei(pname, param));
+			break;
+		}
+		case GLT_ReadBuffer:
+		{
+			GLenum src = r.get<GLenum>();
+			TIMED(glReadBuffer(src));
+			break;
+		}
+		case GLT_ReadPixels:
+		{
+			GLint x = r.get<GLint>(), y = r.get<GLint>();
+			GLsizei width = r.get<GLsizei>(), height = r.get<GLsizei>();
+			GLenum format = r.get<GLenum>(), type = r.get<GLenum>();
+			GLuint packBuffer = r.get<GLuint>();
+			uint64_t pixels = r.get<uint64_t>();
+			void *target = (void *)(uintptr_t)pixels;
+			if (!packBuffer)
+			{
+				scratch.resize((size_t)width * height * 16); // any format and type
+				target = scratch.data();
+			}
+			TIMED(glReadPixels(x, y, width, height, format, type, target));
+			break;
+		}
+		case GLT_ShaderSource:
+		{
+			GLuint shader = r.get<GLuint>();
+			GLsizei count = r.get<GLsizei>();
+			std::vector<std::string> sources(count);
+			std::vector<const GLchar *> strings(count);
+			for (GLsizei i = 0; i < count; i++)
+			{
+				sources[i] = r.string();
+				strings[i] = sources[i].c_str();
+			}
+			TIMED(glShaderSource(names.object(shader), count, strings.data(), NULL));
+			break;
+		}
+		case GLT_Uniform1f:
+		{
+			GLint location = names.location(program, r.get<GLint>());
+			GLfloat v0 = r.get<GLfloat>();
+			TIMED(glUniform1f(location, v0));
+			break;
+		}
+		case GLT_Uniform1ui:
+		{
+			GLint location = names.location(program, r.get<GLint>());
+			GLuint v0 = r.get<GLuint>();
+			TIMED(glUniform1ui(location, v0));
+			break;
+		}
+		case GLT_Uniform3f:
+		{
+			GLint location = names.location(program, r.get<GLint>());
+			GLfloat v0 = r.get<GLfloat>(), v1 = r.get<GLfloat>(), v2 = r.get<GLfloat>();
+			TIMED(glUniform3f(location, v0, v1, v2));
+			break;
+		}
+		case GLT_Uniform4fv:
+		{
+			GLint location = names.location(program, r.get<GLint>());
+			GLsizei count = r.get<GLsizei>();
+			r.bytes(blob);
+			TIMED(glUniform4fv(location, count, (const GLfloat *)blob.data()));
+			break;
+		}
+		case GLT_UniformMatrix4fv:
+		{
+			GLint location = names.location(program, r.get<GLint>());
+			GLsizei count = r.get<GLsizei>();
+			GLboolean transpose = r.get<GLboolean>();
+			r.bytes(blob);
+			TIMED(glUniformMatrix4fv(location, count, transpose, (const GLfloat *)blob.data()));
+			break;
+		}
+		case GLT_UnmapBuffer:
+		{
+			GLenum target = r.get<GLenum>();
+			GLuint buffer = r.get<GLuint>();
+			mappings.erase(buffer);
+			TIMED(glUnmapBuffer(target));
+			break;
+		}
+		case GLT_UseProgram:
+		{
+			program = r.get<GLuint>();
+			TIMED(glUseProgram(names.object(program)));
+			break;
+		}
+		case GLT_VertexAttribPointer:
+		{
+			GLuint index = r.get<GLuint>();
+			GLint size = r.get<GLint>();
+			GLenum type = r.get<GLenum>();
+			GLboolean normalized = r.get<GLboolean>();
+			GLsizei stride = r.get<GLsizei>();
+			uint64_t pointer = r.get<uint64_t>();
+			TIMED(glVertexAttribPointer(index, size, type, normalized, stride, (const void *)(uintptr_t)pointer));
+			break;
+		}
+		case GLT_BeginQuery:
+		{
+			GLenum target = r.get<GLenum>();
+			GLuint id = r.get<GLuint>();
+			TIMED(glBeginQuery(target, names.query(id)));
+			break;
+		}
+		case GLT_EndQuery:
+		{
+			GLenum target = r.get<GLenum>();
+			TIMED(glEndQuery(target));
+			break;
+		}
+		case GLT_GetQueryObjectiv:
+		case GLT_GetQueryObjectui64v:
+		{
+			GLuint id = names.query(r.get<GLuint>());
+			GLenum pname = r.get<GLenum>();
+			if (op == GLT_GetQueryObjectiv)
+			{
+				GLint value;
+				TIMED(glGetQueryObjectiv(id, pname, &value));
+			}
+			else
+			{
+				GLuint64 value;
+				TIMED(glGetQueryObjectui64v(id, pname, &value));
+			}
+			break;
+		}
+		case GLT_ActiveTexture:
+		{
+			GLenum texture = r.get<GLenum>();
+			TIMED(glActiveTexture(texture));
+			break;
+		}
+		case GLT_BindFramebuffer:
+		{
+			GLenum target = r.get<GLenum>();
+			GLuint framebuffer = r.get<GLuint>();
+			TIMED(glBindFramebuffer(target, names.framebuffer(framebuffer)));
+			break;
+		}
+		case GLT_BindRenderbuffer:
+		{
+			GLenum target = r.get<GLenum>();
+			GLuint renderbuffer = r.get<GLuint>();
+			TIMED(glBindRenderbuffer(target, names.renderbuffer(renderbuffer)));
+			break;
+		}
+		case GLT_BindTexture:
+		{
+			GLenum target = r.get<GLenum>();
+			GLuint texture = r.get<GLuint>();
+			TIMED(glBindTexture(target, names.texture(texture)));
+			break;
+		}
+		case GLT_BlitFramebuffer:
+		{
+			GLint v[8];
+			for (int i = 0; i < 8; i++)
+				v[i] = r.get<GLint>();
+			GLbitfield mask = r.get<GLbitfield>();
+			GLenum filter = r.get<GLenum>();
+			TIMED(glBlitFramebuffer(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], mask, filter));
+			break;
+		}
+		case GLT_CheckFramebufferStatus:
+		{
+			GLenum target = r.get<GLenum>();
+			TIMED(glCheckFramebufferStatus(target));
+			break;
+		}
+		case GLT_Disable:
+		{
+			GLenum cap = r.get<GLenum>();
+			TIMED(glDisable(cap));
+			break;
+		}
+		case GLT_FramebufferRenderbuffer:
+		{
+			GLenum target = r.get<GLenum>(), attachment = r.get<GLenum>(), renderbuffertarget = r.get<GLenum>();
+			GLuint renderbuffer = r.get<GLuint>();
+			TIMED(glFramebufferRenderbuffer(target, attachment, renderbuffertarget, names.renderbuffer(renderbuffer)));
+			break;
+		}
+		case GLT_FramebufferTexture2D:
+		{
+			GLenum target = r.get<GLenum>(), attachment = r.get<GLenum>(), textarget = r.get<GLenum>();
+			GLuint texture = r.get<GLuint>();
+			GLint level = r.get<GLint>();
+			TIMED(glFramebufferTexture2D(target, attachment, textarget, names.texture(texture), level));
+			break;
+		}
+		case GLT_RenderbufferStorageMultisample:
+		{
+			GLenum target = r.get<GLenum>();
+			GLsizei samples = r.get<GLsizei>();
+			GLenum internalformat = r.get<GLenum>();
+			GLsizei width = r.get<GLsizei>(), height = r.get<GLsizei>();
+			TIMED(glRenderbufferStorageMultisample(target, samples, internalformat, width, height));
+			break;
+		}
+		case GLT_Scissor:
+		case GLT_Viewport:
+		{
+			GLint x = r.get<GLint>(), y = r.get<GLint>();
+			GLsizei width = r.get<GLsizei>(), height = r.get<GLsizei>();
+			if (op == GLT_Scissor)
+			{
+				TIMED(glScissor(x, y, width, height));
+			}
+			else
+			{
+				TIMED(glViewport(x, y, width, height));
+			}
+			break;
+		}
+		case GLT_TexImage2D:
+		{
+			GLenum target = r.get<GLenum>();
+			GLint level = r.get<GLint>(), internalformat = r.get<GLint>();
+			GLsizei width = r.get<GLsizei>(), height = r.get<GLsizei>();
+			GLint border = r.get<GLint>();
+			GLenum format = r.get<GLenum>(), type = r.get<GLenum>();
+			const void *pixels = r.bytes(blob) ? blob.data() : NULL;
+			TIMED(glTexImage2D(target, level, internalformat, width, height, border, format, type, pixels));
+			break;
+		}
+		case GLT_TexParameteri:
+		{
+			GLenum target = r.get<GLenum>(), pname = r.get<GLenum>();
+			GLint param = r.get<GLint>();
+			TIMED(glTexParameteri(target, pname, param));
+			break;
+		}
+		case GLT_Uniform1i:
+		{
+			GLint location = names.location(program, r.get<GLint>());
+			GLint v0 = r.get<GLint>();
+			TIMED(glUniform1i(location, v0));
+			break;
+		}
+		case GLT_Uniform2f:
+		{
+			GLint location = names.location(program, r.get<GLint>());
+			GLfloat v0 = r.get<GLfloat>(), v1 = r.get<GLfloat>();
+			TIMED(glUniform2f(location, v0, v1));
+			break;
+		}
+		case GLT_BindImageTexture:
+		{
+			GLuint unit = r.get<GLuint>(), texture = r.get<GLuint>();
+			GLint level = r.get<GLint>();
+			GLboolean layered = r.get<GLboolean>();
+			GLint layer = r.get<GLint>();
+			GLenum access = r.get<GLenum>(), format = r.get<GLenum>();
+			TIMED(glBindImageTexture(unit, names.texture(texture), level, layered, layer, access, format));
+			break;
+		}
+		case GLT_DrawBuffers:
+		{
+			GLsizei n = (GLsizei)(r.bytes(blob) / sizeof(GLenum));
+			TIMED(glDrawBuffers(n, (const GLenum *)blob.data()));
+			break;
+		}
+		case GLT_QueryCounter:
+		{
+			GLuint id = r.get<GLuint>();
+			GLenum target = r.get<GLenum>();
+			TIMED(glQueryCounter(names.query(id), target));
+			break;
+		}
+		case GLT_BlendFunc:
+		{
+			GLenum sfactor = r.get<GLenum>(), dfactor = r.get<GLenum>();
+			TIMED(glBlendFunc(sfactor, dfactor));
+			break;
+		}
+		case GLT_ColorMask:
+		{
+			GLboolean red = r.get<GLboolean>(), green = r.get<GLboolean>(), blue = r.get<GLboolean>(), alpha = r.get<GLboolean>();
+			TIMED(glColorMask(red, green, blue, alpha));
+			break;
+		}
+		case GLT_DepthMask:
+		{
+			GLboolean flag = r.get<GLboolean>();
+			TIMED(glDepthMask(flag));
+			break;
+		}
+		case GLT_TexImage3D:
+		{
+			GLenum target = r.get<GLenum>();
+			GLint level = r.get<GLint>(), internalformat = r.get<GLint>();
+			GLsizei width = r.get<GLsizei>(), height = r.get<GLsizei>(), depth = r.get<GLsizei>();
+			GLint border = r.get<GLint>();
+			GLenum format = r.get<GLenum>(), type = r.get<GLenum>();
+			const void *pixels = r.bytes(blob) ? blob.data() : NULL;
+			TIMED(glTexImage3D(target, level, internalformat, width, height, depth, border, format, type, pixels));
+			break;
+		}
+		case GLT_ClearBufferfv:
+		{
+			GLenum buffer = r.get<GLenum>();
+			GLint drawbuffer = r.get<GLint>();
+			r.bytes(blob);
+			TIMED(glClearBufferfv(buffer, drawbuffer, (const GLfloat *)blob.data()));
+			break;
+		}
+		case GLT_TexSubImage2D:
+		{
+			GLenum target = r.get<GLenum>();
+			GLint level = r.get<GLint>(), xoffset = r.get<GLint>(), yoffset = r.get<GLint>();
+			GLsizei width = r.get<GLsizei>(), height = r.get<GLsizei>();
+			GLenum format = r.get<GLenum>(), type = r.get<GLenum>();
+			r.bytes(blob);
+			TIMED(glTexSubImage2D(target, level, xoffset, yoffset, width, height, format, type, blob.data()));
+			break;
+		}
+		case GLT_COUNT:
+			break;
+		}
+#undef TIMED
+		double seconds = now() - start;
+		replayed++;
+
+		// The Frame record ends the frame before `frame`
+		uint64_t callFrame = op == GLT_Frame ? frame - 1 : frame;
+		if (callFrame >= firstFrame && callFrame < endFrame)
+		{
+			CallStats &stats = calls[op];
+			stats.count++;
+			stats.seconds += seconds;
+			stats.max = std::max(stats.max, seconds);
+		}
+		if (op == GLT_Frame)
+		{
+			double end = now();
+			if (callFrame >= firstFrame && callFrame < endFrame)
+				frameTimes.push_back(end - frameStart);
+			frameStart = end;
+		}
+	}
+	if (trace.truncated())
+		fprintf(stderr, "The trace is truncated\n");
+	if (unmappedWrites)
+		fprintf(stderr, "%u writes to buffers that are not mapped here were skipped\n", unmappedWrites);
+
+	printf("%llu calls replayed\n", (unsigned long long)replayed);
+	if (!frameTimes.empty())
+	{
+		std::vector<double> sorted(frameTimes);
+		std::sort(sorted.begin(), sorted.end());
+		double sum = 0.0;
+		for (size_t i = 0; i < sorted.size(); i++)
+			sum += sorted[i];
+		printf("%zu frames%s : %.1f fps, %.3f ms avg, %.3f ms median, %.3f ms max\n", sorted.size(), finish ? " (finished)" : "",
+			   sorted.size() / sum, sum / sorted.size() * 1000.0, sorted[sorted.size() / 2] * 1000.0, sorted.back() * 1000.0);
+
+		std::vector<int> order;
+		double total = 0.0;
+		for (int i = 0; i < GLT_COUNT; i++)
+			if (calls[i].count)
+			{
+				order.push_back(i);
+				total += calls[i].seconds;
+			}
+		std::sort(order.begin(), order.end(), [&](int a, int b) { return calls[a].seconds > calls[b].seconds; });
+		printf("\ncall (per frame)                       count   total ms      %%   avg us   max us\n");
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			const CallStats &stats = calls[order[i]];
+			printf("%-36s %8.1f %10.3f %6.1f %8.2f %8.1f\n", order[i] == GLT_Frame ? "SwapBuffers" : g_gltrace_op_names[order[i]],
+				   (double)stats.count / frameTimes.size(), stats.seconds / frameTimes.size() * 1000.0, 100.0 * stats.seconds / total,
+				   stats.seconds / stats.count * 1e6, stats.max * 1e6);
+		}
+	}
+	else
+		printf("The trace ends before frame %llu, nothing timed\n", (unsigned long long)firstFrame);
+
+	glfwTerminate();
+	return 0;
+}
@@ -0,0 +1,122 @@
+#ifndef GOLDEN_HPP
+#define GOLDEN_HPP
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "ppm.hpp"
+
+// Golden images of the regression tools (regress_softraster, regress_gl).
+// Images are compared by their mean SSIM over 8x8 windows of the luma, which
+// forgives the last-bit differences between builds (SIMD or not, compilers)
+// but not a missing face or a wrong light. A failed case writes its image
+// and an amplified difference next to the working directory.
+
+struct GoldenOptions
+{
+	bool update;           // records the images as the golden ones
+	std::string directory; // of the golden images
+	double minSsim;        // lowest mean SSIM accepted
+	FILE *log;             // one line per case, or NULL
+	char date[32];         // of the run, in the log
+
+	GoldenOptions(const char *defaultDirectory) : update(false), directory(defaultDirectory), minSsim(0.99), log(NULL)
+	{
+		time_t seconds = time(NULL);
+		strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&seconds));
+	}
+};
+
+inline float goldenLuma(uint32_t p)
+{
+	return 0.299f * (p & 0xff) + 0.587f * ((p >> 8) & 0xff) + 0.114f * ((p >> 16) & 0xff);
+}
+
+// Mean SSIM of 8x8 windows every 4 pixels, 1 for identical images
+inline double goldenSsim(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b, int width, int height)
+{
+	const double c1 = (0.01 * 255) * (0.01 * 255), c2 = (0.03 * 255) * (0.03 * 255);
+	double sum = 0.0;
+	int windows = 0;
+	for (int y = 0; y + 8 <= height; y += 4)
+		for (int x = 0; x + 8 <= width; x += 4)
+		{
+			double meanA = 0, meanB = 0, varA = 0, varB = 0, cov = 0;
+			for (int j = 0; j < 8; j++)
+				for (int i = 0; i < 8; i++)
+				{
+					double la = goldenLuma(a[(y + j) * width + x + i]), lb = goldenLuma(b[(y + j) * width + x + i]);
+					meanA += la;
+					meanB += lb;
+					varA += la * la;
+					varB += lb * lb;
+					cov += la * lb;
+				}
+			meanA /= 64;
+			meanB /= 64;
+			varA = varA / 64 - meanA * meanA;
+			varB = varB / 64 - meanB * meanB;
+			cov = cov / 64 - meanA * meanB;
+			sum += (2 * meanA * meanB + c1) * (2 * cov + c2) / ((meanA * meanA + meanB * meanB + c1) * (varA + varB + c2));
+			windows++;
+		}
+	return windows ? sum / windows : 1.0;
+}
+
+inline void printGoldenHeader()
+{
+	printf("case               ms      SSIM  max diff  changed  result\n");
+}
+
+// Records `image` as the golden image of `name`, or compares it with it and
+// prints the result. False when it was not recorded or does not match.
+inline bool checkGolden(const char *name, double ms, const std::vector<uint32_t> &image, int width, int height, const GoldenOptions &options)
+{
+	std::string goldenPath = options.directory + "/" + name + ".ppm";
+	if (options.update)
+	{
+		bool written = writePPM(goldenPath.c_str(), image.data(), width, height);
+		printf("%-16s %6.2f         -         -        -  %s\n", name, ms, written ? "recorded" : "FAILED");
+		return written;
+	}
+
+	std::vector<uint32_t> reference;
+	int goldenWidth = 0, goldenHeight = 0;
+	if (!readPPM(goldenPath.c_str(), reference, goldenWidth, goldenHeight) || goldenWidth != width || goldenHeight != height)
+	{
+		printf("%-16s %6.2f         -         -        -  MISSING %s\n", name, ms, goldenPath.c_str());
+		return false;
+	}
+
+	// Largest channel difference and pixels off by more than 8 in some channel
+	int maxDifference = 0, changed = 0;
+	std::vector<uint32_t> difference(width * height);
+	for (int i = 0; i < width * height; i++)
+	{
+		int worst = 0;
+		for (int shift = 0; shift < 24; shift += 8)
+			worst = std::max(worst, abs((int)((image[i] >> shift) & 0xff) - (int)((reference[i] >> shift) & 0xff)));
+		maxDifference = std::max(maxDifference, worst);
+		changed += worst > 8;
+		uint32_t shown = std::min(255, worst * 8);
+		difference[i] = shown | (shown << 8) | (shown << 16) | 0xff000000u;
+	}
+	double score = goldenSsim(image, reference, width, height);
+	bool passed = score >= options.minSsim;
+	const char *result = maxDifference == 0 ? "exact" : passed ? "ok" : "FAIL";
+	printf("%-16s %6.2f %9.5f %9d %8d  %s\n", name, ms, score, maxDifference, changed, result);
+	if (options.log)
+		fprintf(options.log, "%s %s %.3f %.5f %s\n", options.date, name, ms, score, result);
+	if (!passed)
+	{
+		writePPM((std::string(name) + ".new.ppm").c_str(), image.data(), width, height);
+		writePPM((std::string(name) + ".diff.ppm").c_str(), difference.data(), width, height);
+	}
+	return passed;
+}
+
+#endif
@@ -0,0 +1,61 @@
+// Writes a page file for the virtual texture of the playground (--virtual-texture).
+// Without an input image the texture is generated : a hue per region, lines
+// every 1024, 128 and 16 texels, so the level drawn and the page edges are
+// easy to tell apart. A PPM input must be square, a power of two of 128
+// texels or more. The whole level 0 is held in memory.
+//
+// Build : g++ -O2 -std=c++11 -I.. pagefile_build.cpp -o pagefile_build
+// Usage : pagefile_build <out.vt> [size, 8192] [input.ppm]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include "../pagefile.hpp"
+#include "ppm.hpp"
+
+static uint32_t generatedTexel(int x, int y, int size)
+{
+	float hue = 6.0f * ((x / 1024 + 3 * (y / 1024)) % 7) / 7.0f;
+	float rgb[3] = {fabsf(hue - 3.0f) - 1.0f, 2.0f - fabsf(hue - 2.0f), 2.0f - fabsf(hue - 4.0f)};
+	// Darker towards the top right, so far regions differ at the coarse levels too
+	float shade = 1.0f - 0.5f * (x + y) / (2.0f * size);
+	if (x % 1024 < 8 || y % 1024 < 8)
+		shade = 0.0f;
+	else if (x % 128 < 2 || y % 128 < 2)
+		shade *= 0.3f;
+	else if (x % 16 == 0 || y % 16 == 0)
+		shade *= 0.7f;
+	uint32_t texel = 0xff000000;
+	for (int c = 0; c < 3; c++)
+		texel |= (uint32_t)(255.0f * shade * std::min(std::max(rgb[c], 0.0f), 1.0f)) << (8 * c);
+	return texel;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage : pagefile_build <out.vt> [size] [input.ppm]\n");
+		return 1;
+	}
+	int size = argc > 2 ? atoi(argv[2]) : 8192;
+	TextureImage image;
+	if (argc > 3)
+	{
+		if (!readPPM(argv[3], image.texels, image.width, image.height))
+			return 1;
+	}
+	else
+	{
+		image = TextureImage(size, size);
+		for (int y = 0; y < size; y++)
+			for (int x = 0; x < size; x++)
+				image.at(x, y) = generatedTexel(x, y, size);
+	}
+	if (!writePageFile(argv[1], image))
+		return 1;
+	printf("%s : %dx%d, %u levels, %u pages of %dx%d texels, %.1f MB\n", argv[1], image.width, image.height, pageLevels(image.width),
+		   pageCount(image.width), PAGE_SIZE, PAGE_SIZE, (sizeof(PageFileHeader) + (double)pageCount(image.width) * PAGE_BYTES) / 1e6);
+	return 0;
+}
@@ -0,0 +1,66 @@
+#ifndef PPM_HPP
+#define PPM_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+// Binary PPM (P6) images for the tools, from and to the RGBA8 pixels of the
+// software rasterizer (red in the low byte, rows bottom-up like GL).
+
+inline bool writePPM(const char *path, const uint32_t *pixels, int width, int height)
+{
+	FILE *file = fopen(path, "wb");
+	if (!file)
+	{
+		fprintf(stderr, "Could not write %s\n", path);
+		return false;
+	}
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+	std::vector<unsigned char> row(width * 3);
+	for (int y = height - 1; y >= 0; y--)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			uint32_t p = pixels[y * width + x];
+			row[3 * x] = p & 0xff;
+			row[3 * x + 1] = (p >> 8) & 0xff;
+			row[3 * x + 2] = (p >> 16) & 0xff;
+		}
+		fwrite(row.data(), 1, row.size(), file);
+	}
+	fclose(file);
+	return true;
+}
+
+// Only what writePPM writes : P6, 8 bits, no comments
+inline bool readPPM(const char *path, std::vector<uint32_t> &pixels, int &width, int &height)
+{
+	FILE *file = fopen(path, "rb");
+	if (!file)
+		return false;
+	int maxValue = 0;
+	if (fscanf(file, "P6 %d %d %d", &width, &height, &maxValue) != 3 || maxValue != 255 || width <= 0 || height <= 0 || fgetc(file) == EOF)
+	{
+		fprintf(stderr, "%s is not a binary 8 bit PPM\n", path);
+		fclose(file);
+		return false;
+	}
+	pixels.resize(width * height);
+	std::vector<unsigned char> row(width * 3);
+	for (int y = height - 1; y >= 0; y--)
+	{
+		if (fread(row.data(), 1, row.size(), file) != row.size())
+		{
+			fprintf(stderr, "%s is truncated\n", path);
+			fclose(file);
+			return false;
+		}
+		for (int x = 0; x < width; x++)
+			pixels[y * width + x] = row[3 * x] | (row[3 * x + 1] << 8) | (row[3 * x + 2] << 16) | 0xff000000u;
+	}
+	fclose(file);
+	return true;
+}
+
+#endif
@@ -0,0 +1,294 @@
+// Image regression of what goes through GL : the step programs and the
+// rendering paths of the playground, each run as it is built, compared with
+// their golden images (golden.hpp), so that a change to their draw code or an
+// optimization of the GL paths can't silently change what they draw.
+//
+// Every case runs its program from --bin with the options of stephooks.hpp
+// (the playground has the same ones) : a number of offline frames at 1/60 s
+// in a hidden window, recorded raw by its capture (capture.hpp). The last
+// frame is compared, scaled down SCALE times. Dynamic resolution follows the
+// GPU timings and the virtual texture needs a page file, so neither has a case.
+//
+// What the programs draw also depends on the driver and on their shaders, so
+// both are pinned : the programs run on Mesa's llvmpipe (LIBGL_ALWAYS_SOFTWARE,
+// GALLIUM_DRIVER), in golden/gl where they find the shaders of the tutorial
+// in playground_steps/, which drew the golden images next to them. --root
+// runs them with other shaders, a case whose shaders are missing is skipped.
+//
+// Build : g++ -O2 -std=c++11 -I.. -I<glew, glfw> regress_gl.cpp -lglfw -lGLEW -lGL -o regress_gl
+// Usage : regress_gl [--update] [--golden dir] [--ssim min] [--log file] [--bin dir] [--root dir] [--window shown] [--native]
+//   --update       records the current images as the golden ones
+//   --golden       directory of the golden images, "golden/gl" by default
+//   --ssim         lowest mean SSIM accepted, 0.999 by default : on the pinned
+//                  renderer only a change of what is drawn moves it
+//   --log          appends one line per case (name, ms, SSIM, result) to a file
+//   --bin          directory of the programs, "." by default : step0 to step9,
+//                  step3_v1 and step3_v2 for the two of step3, and playground
+//   --root         where the programs run, the one of their playground_steps/,
+//                  "golden/gl" by default
+//   --window       shown : the programs in a visible window, for drivers that
+//                  do not draw into hidden ones
+//   --native       the GL driver of the machine instead of llvmpipe, with
+//                  golden images recorded on it (--golden)
+// Exit status is 1 when an image is missing or too far from its golden one.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#ifdef _WIN32
+#include <direct.h>
+#define getcwd _getcwd
+#else
+#include <unistd.h>
+#endif
+#include "golden.hpp"
+
+#define SCALE 4 // 1024x768 compared at 256x192
+
+struct RegressCase
+{
+	const char *name;
+	const char *program; // in --bin
+	const char *flags;
+	int frames;          // the last one is compared, at (frames - 1) / 60 s
+	const char *shaders; // a file the program loads from --root, the case is skipped without it, or NULL
+};
+
+static const RegressCase g_cases[] = {
+	{"step0", "step0", "", 1, NULL},
+	{"step1", "step1", "", 1, "playground_steps/step1/SimpleVertexShader.vertexshader"},
+	{"step2", "step2", "", 1, "playground_steps/step2/SimpleVertexShader.vertexshader"},
+	{"step3_v1", "step3_v1", "", 1, "playground_steps/step2/SimpleVertexShader.vertexshader"},
+	{"step3_v2", "step3_v2", "", 1, "playground_steps/step2/SimpleVertexShader.vertexshader"},
+	{"step4", "step4", "", 1, "playground_steps/step4/SimpleVertexShader.vertexshader"},
+	// step5 moves its model a little every frame, the others turn with the time
+	{"step5_f0", "step5", "", 1, "playground_steps/step4/SimpleVertexShader.vertexshader"},
+	{"step5_f60", "step5", "", 61, "playground_steps/step4/SimpleVertexShader.vertexshader"},
+	{"step6_t0.50", "step6", "", 31, "playground_steps/step6/SimpleVertexShader.vertexshader"},
+	{"step6_t1.30", "step6", "", 79, "playground_steps/step6/SimpleVertexShader.vertexshader"},
+	{"step7_t0.50", "step7", "", 31, "playground_steps/step7/StandardShading.vertexshader"},
+	{"step7_t1.30", "step7", "", 79, "playground_steps/step7/StandardShading.vertexshader"},
+	{"step8_t0.50", "step8", "", 31, "playground_steps/step8/StandardShading.vertexshader"},
+	{"step8_t1.30", "step8", "", 79, "playground_steps/step8/StandardShading.vertexshader"},
+	{"step9_t0.50", "step9", "", 31, "playground_steps/step8/StandardShading.vertexshader"},
+	{"step9_t1.30", "step9", "", 79, "playground_steps/step8/StandardShading.vertexshader"},
+	// The paths of the playground, on a scene where the cubes hide each other
+	{"pg_loop", "playground", "--cubes 8 --submit loop", 30, "playground_steps/step8/StandardShading.vertexshader"},
+	{"pg_indirect", "playground", "--cubes 8", 30, NULL},
+	{"pg_no_meshlets", "playground", "--cubes 8 --meshlets off", 30, NULL},
+	{"pg_gpu", "playground", "--cubes 8 --cull gpu", 30, NULL},
+	{"pg_gpu_prepass", "playground", "--cubes 8 --cull gpu --prepass on", 30, NULL},
+	{"pg_prepass", "playground", "--cubes 8 --prepass on", 30, NULL},
+	{"pg_back_to_front", "playground", "--cubes 8 --order back", 30, NULL},
+	{"pg_lights", "playground", "--cubes 8 --lights 64", 30, NULL},
+	{"pg_deferred", "playground", "--cubes 8 --lights 64 --shading deferred", 30, NULL},
+	{"pg_shadows", "playground", "--cubes 8 --shadows on --static 9", 30, NULL},
+	{"pg_separate", "playground", "--cubes 8 --textures 4", 30, NULL},
+	{"pg_atlas", "playground", "--cubes 8 --textures 4 --texture-packing atlas", 30, NULL},
+	{"pg_array", "playground", "--cubes 8 --textures 4 --texture-packing array", 30, NULL},
+	{"pg_materials", "playground", "--cubes 8 --materials 8 --textures 4", 30, NULL},
+	{"pg_gpu_materials", "playground", "--cubes 8 --cull gpu --materials 8", 30, NULL},
+};
+
+static double now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool fileExists(const char *path)
+{
+	FILE *file = fopen(path, "rb");
+	if (file)
+		fclose(file);
+	return file != NULL;
+}
+
+// `path` from the working directory, for the programs that run in another one
+static std::string absolutePath(const std::string &path)
+{
+	if (!path.empty() && (path[0] == '/' || path[0] == '\\' || (path.size() > 1 && path[1] == ':')))
+		return path;
+	char directory[4096];
+	if (!getcwd(directory, sizeof(directory)))
+		return path;
+	return std::string(directory) + "/" + path;
+}
+
+static void setEnvironment(const char *name, const char *value)
+{
+#ifdef _WIN32
+	_putenv_s(name, value);
+#else
+	setenv(name, value, 1);
+#endif
+}
+
+// Renderer of the GL 3.3 context the programs get, empty without one
+static std::string queryRenderer()
+{
+	std::string renderer;
+	if (!glfwInit())
+		return renderer;
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	GLFWwindow *window = glfwCreateWindow(64, 48, "regress_gl", NULL, NULL);
+	if (window)
+	{
+		glfwMakeContextCurrent(window);
+		renderer = std::string((const char *)glGetString(GL_RENDERER)) + ", " + (const char *)glGetString(GL_VERSION);
+		glfwDestroyWindow(window);
+	}
+	glfwTerminate();
+	return renderer;
+}
+
+// The last frame of a raw recording of `frames` 4:3 frames, top-down RGB24,
+// as bottom-up pixels scaled down `scale` times
+static bool readLastFrame(const char *path, int frames, int scale, std::vector<uint32_t> &pixels, int &width, int &height)
+{
+	FILE *file = fopen(path, "rb");
+	if (!file)
+		return false;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	long frameBytes = frames > 0 ? size / frames : 0;
+	int fullHeight = (int)(sqrt(frameBytes / 4.0) + 0.5), fullWidth = fullHeight * 4 / 3;
+	if (!frameBytes || (long)fullWidth * fullHeight * 3 != frameBytes || fullWidth % scale || fullHeight % scale)
+	{
+		fprintf(stderr, "%s : %ld bytes are not %d frames of 4:3 RGB\n", path, size, frames);
+		fclose(file);
+		return false;
+	}
+	std::vector<unsigned char> frame(frameBytes);
+	fseek(file, size - frameBytes, SEEK_SET);
+	bool read = fread(frame.data(), 1, frameBytes, file) == (size_t)frameBytes;
+	fclose(file);
+	if (!read)
+		return false;
+
+	width = fullWidth / scale;
+	height = fullHeight / scale;
+	pixels.resize(width * height);
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+		{
+			unsigned sum[3] = {0, 0, 0};
+			for (int j = 0; j < scale; j++)
+				for (int i = 0; i < scale; i++)
+				{
+					const unsigned char *p = &frame[3 * ((size_t)(y * scale + j) * fullWidth + x * scale + i)];
+					for (int c = 0; c < 3; c++)
+						sum[c] += p[c];
+				}
+			uint32_t pixel = 0xff000000u;
+			for (int c = 0; c < 3; c++)
+				pixel |= (sum[c] / (scale * scale)) << (8 * c);
+			pixels[(height - 1 - y) * width + x] = pixel;
+		}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	GoldenOptions options("golden/gl");
+	options.minSsim = 0.999;
+	const char *logPath = NULL;
+	std::string bin = ".";
+	std::string root = "golden/gl";
+	bool shownWindow = false;
+	bool native = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--update"))
+			options.update = true;
+		else if (!strcmp(argv[i], "--golden") && i + 1 < argc)
+			options.directory = argv[++i];
+		else if (!strcmp(argv[i], "--ssim") && i + 1 < argc)
+			options.minSsim = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--log") && i + 1 < argc)
+			logPath = argv[++i];
+		else if (!strcmp(argv[i], "--bin") && i + 1 < argc)
+			bin = argv[++i];
+		else if (!strcmp(argv[i], "--root") && i + 1 < argc)
+			root = argv[++i];
+		else if (!strcmp(argv[i], "--window") && i + 1 < argc)
+			shownWindow = !strcmp(argv[++i], "shown");
+		else if (!strcmp(argv[i], "--native"))
+			native = true;
+		else
+		{
+			fprintf(stderr, "Usage : %s [--update] [--golden dir] [--ssim min] [--log file] [--bin dir] [--root dir] [--window shown] [--native]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	// Inherited by the programs
+	if (!native)
+	{
+		setEnvironment("LIBGL_ALWAYS_SOFTWARE", "1");
+		setEnvironment("GALLIUM_DRIVER", "llvmpipe");
+	}
+	std::string renderer = queryRenderer();
+	if (renderer.empty())
+	{
+		fprintf(stderr, "Failed to open a GL 3.3 context\n");
+		return 2;
+	}
+	if (!native && renderer.find("llvmpipe") == std::string::npos)
+		fprintf(stderr, "Warning : %s is not llvmpipe, the golden images may not match\n", renderer.c_str());
+
+	if (logPath && !(options.log = fopen(logPath, "a")))
+		fprintf(stderr, "Could not open %s, no log\n", logPath);
+
+	bin = absolutePath(bin);
+
+	printf("%s, %s\n", renderer.c_str(), options.update ? "recording golden images" : "comparing to golden images");
+	printGoldenHeader();
+	int cases = 0, failures = 0, skipped = 0;
+	for (size_t c = 0; c < sizeof(g_cases) / sizeof(g_cases[0]); c++)
+	{
+		const RegressCase &test = g_cases[c];
+		if (test.shaders && !fileExists((root + "/" + test.shaders).c_str()))
+		{
+			printf("%-16s      -         -         -        -  skipped, no %s\n", test.name, test.shaders);
+			skipped++;
+			continue;
+		}
+		// A run per case, with --offline its last frame is the same on every run
+		std::string prefix = absolutePath(std::string("regress_gl_") + test.name);
+		char command[2048];
+		snprintf(command, sizeof(command), "cd \"%s\" && \"%s/%s\" --offline 1 --frames %d --window %s --capture \"%s\" --capture-format raw %s > \"%s.log\" 2>&1",
+				 root.c_str(), bin.c_str(), test.program, test.frames, shownWindow ? "shown" : "hidden", prefix.c_str(), test.flags, prefix.c_str());
+		cases++;
+		double start = now();
+		int status = system(command);
+		double ms = (now() - start) * 1000.0;
+		std::vector<uint32_t> image;
+		int width = 0, height = 0;
+		if (status != 0 || !readLastFrame((prefix + ".rgb").c_str(), test.frames, SCALE, image, width, height))
+		{
+			printf("%-16s %6.2f         -         -        -  NO FRAME, see %s.log\n", test.name, ms, prefix.c_str());
+			failures++;
+			continue;
+		}
+		remove((prefix + ".rgb").c_str());
+		if (checkGolden(test.name, ms, image, width, height, options))
+			remove((prefix + ".log").c_str());
+		else
+			failures++;
+	}
+	if (options.log)
+		fclose(options.log);
+
+	printf("%d of %d cases %s, %d skipped\n", cases - failures, cases, options.update ? "recorded" : "passed", skipped);
+	return failures ? 1 : 0;
+}
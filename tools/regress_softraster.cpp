@@ -0,0 +1,130 @@
+// Image regression of the software rasterizer : the cubes of step8 and step9,
+// read from the steps, are rendered without a GL context at fixed animation
+// times, compared with their golden images (golden.hpp) and timed, so an
+// optimization of softraster.hpp can't silently change what it draws.
+// The rasterizer only implements the lit shading of those two steps : the
+// other steps and the GL paths of the playground are covered by regress_gl.
+//
+// Build : g++ -O2 -std=c++11 -pthread -I.. -I<glm> regress_softraster.cpp -o regress_softraster
+// Usage : regress_softraster [--update] [--golden dir] [--ssim min] [--repeat n] [--log file]
+//   --update     records the current images as the golden ones
+//   --golden     directory of the golden images, "golden" by default
+//   --ssim       lowest mean SSIM accepted, 0.99 by default
+//   --repeat     renders per case for the timing (median), 10 by default
+//   --log        appends one line per case (name, ms, SSIM, result) to a file
+// Exit status is 1 when an image is missing or too far from its golden one.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include "../softraster.hpp"
+#include "step8scene.hpp"
+#include "step9scene.hpp"
+#include "golden.hpp"
+
+#define WIDTH 320
+#define HEIGHT 240
+
+struct Scene
+{
+	const char *name;
+	const float *positions;
+	const float *colors;
+	const float *normals;
+	unsigned vertexCount;
+};
+
+struct Case
+{
+	const Scene *scene;
+	float seconds; // animation time
+};
+
+static double now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char **argv)
+{
+	GoldenOptions options("golden");
+	int repeat = 10;
+	const char *logPath = NULL;
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--update"))
+			options.update = true;
+		else if (!strcmp(argv[i], "--golden") && i + 1 < argc)
+			options.directory = argv[++i];
+		else if (!strcmp(argv[i], "--ssim") && i + 1 < argc)
+			options.minSsim = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+			repeat = std::max(1, atoi(argv[++i]));
+		else if (!strcmp(argv[i], "--log") && i + 1 < argc)
+			logPath = argv[++i];
+		else
+		{
+			fprintf(stderr, "Usage : %s [--update] [--golden dir] [--ssim min] [--repeat n] [--log file]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	const Scene scenes[] = {
+		{"step8", g_step8_positions, g_step8_colors, g_step8_normals, g_step8_vertex_count},
+		{"step9", g_step9_positions, g_step9_colors, g_step9_normals, g_step9_vertex_count},
+	};
+	// Front, a quarter turn on, and an angle showing three faces
+	const Case cases[] = {
+		{&scenes[0], 0.0f},
+		{&scenes[0], 0.5f},
+		{&scenes[0], 1.3f},
+		{&scenes[1], 0.0f},
+		{&scenes[1], 0.5f},
+		{&scenes[1], 1.3f},
+	};
+	const int caseCount = sizeof(cases) / sizeof(cases[0]);
+
+	if (logPath && !(options.log = fopen(logPath, "a")))
+		fprintf(stderr, "Could not open %s, no log\n", logPath);
+
+	JobSystem jobs;
+	SoftRasterizer raster(jobs, WIDTH, HEIGHT);
+	glm::mat4 projection = step8Projection((float)WIDTH / HEIGHT);
+	glm::mat4 view = step8View();
+
+	printf("%dx%d, %u threads, %s\n", WIDTH, HEIGHT, jobs.threadCount(), options.update ? "recording golden images" : "comparing to golden images");
+	printGoldenHeader();
+	int failures = 0;
+	for (int c = 0; c < caseCount; c++)
+	{
+		const Case &test = cases[c];
+		char name[64];
+		snprintf(name, sizeof(name), "%s_t%.2f", test.scene->name, test.seconds);
+		glm::mat4 model = step8Model(test.seconds);
+
+		std::vector<double> times;
+		for (int r = 0; r < repeat; r++)
+		{
+			double start = now();
+			raster.beginFrame(view, g_step8_light, glm::vec3(0.0f, 0.0f, 0.4f));
+			raster.draw(test.scene->positions, test.scene->colors, test.scene->normals, test.scene->vertexCount, NULL, 0,
+						projection * view * model, model);
+			raster.endFrame();
+			times.push_back(now() - start);
+		}
+		std::sort(times.begin(), times.end());
+		double ms = times[times.size() / 2] * 1000.0;
+		std::vector<uint32_t> image(raster.pixels(), raster.pixels() + WIDTH * HEIGHT);
+		failures += !checkGolden(name, ms, image, WIDTH, HEIGHT, options);
+	}
+	if (options.log)
+		fclose(options.log);
+
+	printf("%d of %d cases %s\n", caseCount - failures, caseCount, options.update ? "recorded" : "passed");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,46 @@
+#ifndef STEP8SCENE_HPP
+#define STEP8SCENE_HPP
+
+#include <math.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// The scene of step8 for the tools that render without a GL context : its
+// cube, read from the step itself, and the camera, light and animation of
+// its loop.
+
+namespace step8
+{
+#include "../step8/scene.hpp"
+}
+
+static const float *const g_step8_positions = step8::g_vertex_buffer_data;
+static const float *const g_step8_colors = step8::g_color_buffer_data;
+static const float *const g_step8_normals = step8::g_normal_buffer_data;
+static const unsigned g_step8_vertex_count = sizeof(step8::g_vertex_buffer_data) / sizeof(float) / 3;
+
+inline glm::mat4 step8Projection(float aspect)
+{
+	return glm::perspective(45.0f, aspect, 0.1f, 100.0f);
+}
+
+inline glm::mat4 step8View()
+{
+	return glm::lookAt(glm::vec3(4, 3, 3), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+}
+
+static const glm::vec3 g_step8_light(4, 4, 1);
+
+// The cube turns a quarter turn per second around y
+inline glm::mat4 step8Model(float seconds)
+{
+	float angle = 3.14159f / 2.0f * seconds;
+	float c = (float)cos(angle);
+	float s = (float)sin(angle);
+	glm::mat4 model(1.0f);
+	model[0] = glm::vec4(c, 0.0f, s, 0.0f);
+	model[2] = glm::vec4(-s, 0.0f, c, 0.0f);
+	return model;
+}
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef STEP9SCENE_HPP
+#define STEP9SCENE_HPP
+
+#include "step8scene.hpp"
+
+// The cube of step9 for the tools that render without a GL context, read
+// from the step itself. Camera, light and animation are the ones of step8.
+
+namespace step9
+{
+#include "../step9/scene.hpp"
+}
+
+static const float *const g_step9_positions = step9::g_vertex_buffer_data;
+static const float *const g_step9_colors = step9::g_color_buffer_data;
+static const float *const g_step9_normals = step9::g_normal_buffer_data;
+// Its real count : the step asks glDrawArrays for three times as many, past the end of its buffers
+static const unsigned g_step9_vertex_count = sizeof(step9::g_vertex_buffer_data) / sizeof(float) / 3;
+
+#endif
@@ -0,0 +1,577 @@
+#ifndef VTEXTURE_HPP
+#define VTEXTURE_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <GL/glew.h>
+
+#include "indirect.hpp"
+#include "pagefile.hpp"
+
+// Virtual texturing.
+// A texture too large to keep resident (a page file of pagefile.hpp, up to
+// 32768 texels a side) is drawn from a cache of a few of its pages :
+//   physical texture : a square of cache slots, PAGE_SLOT texels each, that
+//                      hold pages of any level with their borders
+//   page table       : one RGBA8UI texel per page of the virtual texture,
+//                      a mip level per page level, holding the slot of the
+//                      page or of its closest resident ancestor and that
+//                      ancestor's level. The fragment shader reads it, then
+//                      the slot, so a missing page is drawn blurrier
+//                      instead of not at all.
+//   feedback pass    : the scene drawn again at 1/VT_FEEDBACK_DIVISOR of
+//                      its size, writing the page each pixel wants (x, y,
+//                      level) instead of a color, read back through a ring
+//                      of PBOs without stalling, like capture.hpp
+// The render thread turns the pages of a readback into requests, missing
+// ancestors first, and a loader thread reads them from the page file. The
+// pages it has read are copied into the free slot or the least recently
+// wanted one, then the page table is rebuilt. The coarsest page, the whole
+// texture, is loaded up front and never evicted.
+//
+// The draws use the DrawData and the box projected coordinates of
+// indirect.hpp, the `texture` of their material being the region of the
+// virtual texture they map to. Pages are sampled bilinearly at the level of
+// the pixel, the border of the slots keeping the lookups inside their page.
+//
+// Per frame : update() before the draws, beginFeedback(), the scene drawn
+// with feedbackProgram(), endFeedback().
+
+#define VT_UNIT_PAGE_TABLE 4      // TEXTURE_UNIT_ALBEDO holds the physical texture
+#define VT_FEEDBACK_DIVISOR 8     // feedback size, log2 of it in g_virtual_feedback_fragment_shader
+#define VT_FEEDBACK_SLOTS 3       // readbacks in flight
+#define VT_UPLOADS_PER_FRAME 16   // pages copied into the cache per frame, about 1 MB
+#define VT_MAX_REQUESTS 64        // pages asked to the loader and not uploaded yet
+#define VT_MAX_PAGES_PER_SIDE 256 // 8 bits of a page coordinate in the feedback and the page ids
+
+// StandardShading of step8 with the diffuse color from the virtual texture.
+// The level comes from the gradients of the unwrapped coordinates, as in g_textured_fragment_shader.
+static const char *const g_virtual_fragment_shader = R"(#version 430 core
+in vec3 Position_worldspace;
+in vec3 Normal_cameraspace;
+in vec3 EyeDirection_cameraspace;
+in vec3 LightDirection_cameraspace;
+in vec3 fragmentColor;
+in vec3 Position_modelspace;
+flat in vec4 drawTexture;
+out vec3 color;
+uniform vec3 LightPosition_worldspace;
+layout(binding = 3) uniform sampler2D physicalPages;
+layout(binding = 4) uniform usampler2D pageTable;
+void main()
+{
+	vec2 textureUV = boxProjection(Position_modelspace);
+	// Virtual texels per pixel, 128 texels per page table texel
+	vec2 texels = vec2(textureSize(pageTable, 0) * 128);
+	vec2 dx = dFdx(textureUV) * drawTexture.zw * texels, dy = dFdy(textureUV) * drawTexture.zw * texels;
+	float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8));
+	int level = clamp(int(floor(lod)), 0, textureQueryLevels(pageTable) - 1);
+	vec2 uv = drawTexture.xy + fract(textureUV) * drawTexture.zw;
+	// Pages of a level from those of level 0 : textureSize() of a level that varies per pixel is not reliable everywhere
+	ivec2 pages = max(textureSize(pageTable, 0) >> level, 1);
+	uvec4 entry = texelFetch(pageTable, min(ivec2(uv * vec2(pages)), pages - 1), level);
+	// Inside the page, or the resident ancestor, at its own level, past the 1 texel border of its slot
+	vec2 inPage = fract(uv * vec2(max(textureSize(pageTable, 0) >> int(entry.z), 1)));
+	vec2 physical = (vec2(entry.xy) * 130.0 + 1.0 + inPage * 128.0) / vec2(textureSize(physicalPages, 0));
+	vec3 MaterialDiffuseColor = textureLod(physicalPages, physical, 0.0).rgb;
+	float distance = length(LightPosition_worldspace - Position_worldspace);
+	color = standardShading(MaterialDiffuseColor, vec4(0.3, 0.3, 0.3, 5.0), Normal_cameraspace, LightDirection_cameraspace,
+							EyeDirection_cameraspace, distance, 1.0);
+}
+)";
+
+// The page the shader above would want : x, y and level over 255, alpha 1 where something was drawn.
+// Drawn at 1/8 of the size, the gradients are 8 times larger, 3 levels coarser.
+static const char *const g_virtual_feedback_fragment_shader = R"(#version 430 core
+in vec3 Position_modelspace;
+flat in vec4 drawTexture;
+out vec4 color;
+layout(binding = 4) uniform usampler2D pageTable;
+void main()
+{
+	vec2 textureUV = boxProjection(Position_modelspace);
+	vec2 texels = vec2(textureSize(pageTable, 0) * 128);
+	vec2 dx = dFdx(textureUV) * drawTexture.zw * texels, dy = dFdy(textureUV) * drawTexture.zw * texels;
+	float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) - 3.0;
+	int level = clamp(int(floor(lod)), 0, textureQueryLevels(pageTable) - 1);
+	vec2 uv = drawTexture.xy + fract(textureUV) * drawTexture.zw;
+	ivec2 pages = max(textureSize(pageTable, 0) >> level, 1);
+	ivec2 page = min(ivec2(uv * vec2(pages)), pages - 1);
+	color = vec4(vec2(page), float(level), 255.0) / 255.0;
+}
+)";
+
+struct VirtualTextureStats
+{
+	uint32_t readbacks; // feedback readbacks analyzed
+	uint32_t requested; // distinct pages wanted in them
+	uint32_t hits;      // of those, resident
+	uint32_t uploads;   // pages copied into the cache
+	uint32_t evictions; // resident pages replaced by them
+	uint32_t dropped;   // pages read but not uploaded, every slot wanted by the last readback
+	uint64_t bytesRead; // from the page file
+	uint32_t resident;  // pages in the cache now
+	uint32_t capacity;  // slots of the cache
+};
+
+class VirtualTexture
+{
+public:
+	VirtualTexture()
+		: physicalTexture(0), pageTableTexture(0), feedbackFramebuffer(0), feedbackColor(0), feedbackDepth(0), feedbackShader(0),
+		  cacheSide(0), feedbackWidth(0), feedbackHeight(0), frame(0), feedbackFrame(0), head(0), pending(0), tableDirty(false),
+		  bytesRead(0), stopped(false)
+	{
+		for (int i = 0; i < VT_FEEDBACK_SLOTS; i++)
+		{
+			pbos[i] = 0;
+			fences[i] = 0;
+		}
+		memset(&stats, 0, sizeof(stats));
+	}
+
+	~VirtualTexture() { stopLoader(); }
+
+	// Same requirements as IndirectRenderer, whose draws it shares
+	static bool supported() { return GLEW_VERSION_4_3 != 0; }
+
+	// path : page file. slotsPerSide : the cache holds slotsPerSide^2 pages.
+	// sceneWidth, sceneHeight : size of the scene, the feedback is a fraction of it.
+	bool create(const char *path, int slotsPerSide, int sceneWidth, int sceneHeight)
+	{
+		if (!file.open(path))
+			return false;
+		if (pagesPerSide(file.size(), 0) > VT_MAX_PAGES_PER_SIDE)
+		{
+			fprintf(stderr, "%s : %u texels, virtual textures go up to %d\n", path, file.size(), VT_MAX_PAGES_PER_SIDE * PAGE_SIZE);
+			file.close();
+			return false;
+		}
+		GLint maxSize = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+		cacheSide = std::min(std::max(slotsPerSide, 2), maxSize / PAGE_SLOT);
+
+		glGenTextures(1, &physicalTexture);
+		glBindTexture(GL_TEXTURE_2D, physicalTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, cacheSide * PAGE_SLOT, cacheSide * PAGE_SLOT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		// Integer texture : nearest filtering, or it is incomplete
+		glGenTextures(1, &pageTableTexture);
+		glBindTexture(GL_TEXTURE_2D, pageTableTexture);
+		table.resize(file.levels());
+		for (uint32_t l = 0; l < file.levels(); l++)
+		{
+			uint32_t pages = pagesPerSide(file.size(), l);
+			table[l].assign(pages * pages, 0);
+			glTexImage2D(GL_TEXTURE_2D, l, GL_RGBA8UI, pages, pages, 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, NULL);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, file.levels() - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		feedbackWidth = std::max(sceneWidth / VT_FEEDBACK_DIVISOR, 1);
+		feedbackHeight = std::max(sceneHeight / VT_FEEDBACK_DIVISOR, 1);
+		glGenRenderbuffers(1, &feedbackColor);
+		glBindRenderbuffer(GL_RENDERBUFFER, feedbackColor);
+		glRenderbufferStorageMultisample(GL_RENDERBUFFER, 0, GL_RGBA8, feedbackWidth, feedbackHeight);
+		glGenRenderbuffers(1, &feedbackDepth);
+		glBindRenderbuffer(GL_RENDERBUFFER, feedbackDepth);
+		glRenderbufferStorageMultisample(GL_RENDERBUFFER, 0, GL_DEPTH_COMPONENT24, feedbackWidth, feedbackHeight);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		glGenFramebuffers(1, &feedbackFramebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, feedbackColor);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, feedbackDepth);
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (status != GL_FRAMEBUFFER_COMPLETE)
+		{
+			fprintf(stderr, "Feedback target incomplete (0x%x)\n", status);
+			destroy();
+			return false;
+		}
+		glGenBuffers(VT_FEEDBACK_SLOTS, pbos);
+		for (int i = 0; i < VT_FEEDBACK_SLOTS; i++)
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[i]);
+			glBufferData(GL_PIXEL_PACK_BUFFER, feedbackWidth * feedbackHeight * 4, NULL, GL_STREAM_READ);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		feedbackShader = buildProgram(g_indirect_vertex_shader, g_virtual_feedback_fragment_shader, "virtual texture feedback");
+		if (!feedbackShader)
+		{
+			destroy();
+			return false;
+		}
+
+		slots.assign(cacheSide * cacheSide, Slot());
+		// Slot 0 : the coarsest page, what every missing page falls back to
+		LoadedPage root;
+		root.page = pageId(file.levels() - 1, 0, 0);
+		root.texels.resize(PAGE_SLOT * PAGE_SLOT);
+		if (!file.read(file.levels() - 1, 0, 0, root.texels.data()))
+		{
+			fprintf(stderr, "%s : could not read its coarsest page\n", path);
+			destroy();
+			return false;
+		}
+		bytesRead += PAGE_BYTES;
+		upload(root, 0);
+		slots[0].pinned = true;
+		rebuildTable();
+
+		stopped = false;
+		loader = std::thread(&VirtualTexture::loaderLoop, this);
+		return true;
+	}
+
+	// Waits for the loader, needs the GL context
+	void destroy()
+	{
+		stopLoader();
+		for (int i = 0; i < VT_FEEDBACK_SLOTS; i++)
+		{
+			if (fences[i])
+				glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+		if (pbos[0])
+			glDeleteBuffers(VT_FEEDBACK_SLOTS, pbos);
+		for (int i = 0; i < VT_FEEDBACK_SLOTS; i++)
+			pbos[i] = 0;
+		if (feedbackShader)
+			glDeleteProgram(feedbackShader);
+		if (feedbackFramebuffer)
+			glDeleteFramebuffers(1, &feedbackFramebuffer);
+		if (feedbackColor)
+			glDeleteRenderbuffers(1, &feedbackColor);
+		if (feedbackDepth)
+			glDeleteRenderbuffers(1, &feedbackDepth);
+		if (physicalTexture)
+			glDeleteTextures(1, &physicalTexture);
+		if (pageTableTexture)
+			glDeleteTextures(1, &pageTableTexture);
+		feedbackShader = feedbackFramebuffer = feedbackColor = feedbackDepth = physicalTexture = pageTableTexture = 0;
+		pending = 0;
+		file.close();
+	}
+
+	// Analyzes a finished readback, uploads what the loader has read and binds the textures
+	void update()
+	{
+		frame++;
+		if (pending)
+		{
+			int oldest = (head + VT_FEEDBACK_SLOTS - pending) % VT_FEEDBACK_SLOTS;
+			GLenum status = glClientWaitSync(fences[oldest], 0, 0);
+			if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+			{
+				glDeleteSync(fences[oldest]);
+				fences[oldest] = 0;
+				pending--;
+				glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[oldest]);
+				const uint32_t *pixels = (const uint32_t *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, feedbackWidth * feedbackHeight * 4,
+																			GL_MAP_READ_BIT);
+				if (pixels)
+					analyze(pixels);
+				glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+				glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			}
+		}
+
+		std::vector<LoadedPage> pages;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			size_t count = std::min(loaded.size(), (size_t)VT_UPLOADS_PER_FRAME);
+			for (size_t i = 0; i < count; i++)
+			{
+				pages.push_back(std::move(loaded.front()));
+				loaded.pop_front();
+			}
+		}
+		for (size_t i = 0; i < pages.size(); i++)
+		{
+			requested.erase(pages[i].page);
+			if (pages[i].texels.empty() || resident.count(pages[i].page))
+				continue;
+			int slot = victim();
+			if (slot < 0)
+			{
+				stats.dropped++;
+				continue;
+			}
+			if (slots[slot].page != NO_PAGE)
+			{
+				resident.erase(slots[slot].page);
+				stats.evictions++;
+			}
+			upload(pages[i], slot);
+			stats.uploads++;
+		}
+		if (tableDirty)
+			rebuildTable();
+
+		glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_ALBEDO);
+		glBindTexture(GL_TEXTURE_2D, physicalTexture);
+		glActiveTexture(GL_TEXTURE0 + VT_UNIT_PAGE_TABLE);
+		glBindTexture(GL_TEXTURE_2D, pageTableTexture);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	// The feedback draws go to the small target from here
+	void beginFeedback()
+	{
+		static const GLfloat nothing[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+		static const GLfloat farthest = 1.0f;
+		glBindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer);
+		glViewport(0, 0, feedbackWidth, feedbackHeight);
+		glClearBufferfv(GL_COLOR, 0, nothing);
+		glClearBufferfv(GL_DEPTH, 0, &farthest);
+	}
+
+	// Queues the readback, back to the window of `width` x `height`. Skipped while every PBO is in flight.
+	void endFeedback(int width, int height)
+	{
+		if (pending < VT_FEEDBACK_SLOTS)
+		{
+			glReadBuffer(GL_COLOR_ATTACHMENT0);
+			glPixelStorei(GL_PACK_ALIGNMENT, 4);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[head]);
+			glReadPixels(0, 0, feedbackWidth, feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, (void *)0);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			fences[head] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			head = (head + 1) % VT_FEEDBACK_SLOTS;
+			pending++;
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, width, height);
+	}
+
+	// For IndirectRenderer::submitProgram() between beginFeedback() and endFeedback()
+	GLuint feedbackProgram() const { return feedbackShader; }
+
+	// Counters since the last call, the residency as of now
+	VirtualTextureStats takeStats()
+	{
+		VirtualTextureStats result = stats;
+		result.bytesRead = bytesRead.exchange(0);
+		result.resident = (uint32_t)resident.size();
+		result.capacity = (uint32_t)slots.size();
+		memset(&stats, 0, sizeof(stats));
+		return result;
+	}
+
+	// Bytes of every page of the file, what the cache stands in for
+	uint64_t fullBytes() const { return (uint64_t)pageCount(file.size()) * PAGE_BYTES; }
+	uint32_t size() const { return file.size(); }
+
+private:
+	VirtualTexture(const VirtualTexture &);
+	VirtualTexture &operator=(const VirtualTexture &);
+
+	static const uint32_t NO_PAGE = 0xffffffff;
+
+	struct Slot
+	{
+		Slot() : page(NO_PAGE), lastWanted(0), pinned(false) {}
+		uint32_t page;
+		uint64_t lastWanted; // frame of the last readback that wanted it
+		bool pinned;
+	};
+
+	struct LoadedPage
+	{
+		uint32_t page;
+		std::vector<uint32_t> texels; // empty when the read failed
+	};
+
+	static uint32_t pageId(uint32_t level, uint32_t x, uint32_t y) { return level << 16 | y << 8 | x; }
+	static uint32_t pageLevel(uint32_t page) { return page >> 16; }
+	static uint32_t pageX(uint32_t page) { return page & 0xff; }
+	static uint32_t pageY(uint32_t page) { return (page >> 8) & 0xff; }
+
+	// Requests the missing pages of a readback and their missing ancestors, coarse first
+	void analyze(const uint32_t *pixels)
+	{
+		wanted.clear();
+		for (int i = 0; i < feedbackWidth * feedbackHeight; i++)
+			if (pixels[i] >> 24)
+				wanted.push_back(pixels[i] & 0xffffff);
+		std::sort(wanted.begin(), wanted.end());
+		wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+		stats.readbacks++;
+		stats.requested += (uint32_t)wanted.size();
+		feedbackFrame = frame;
+
+		missing.clear();
+		for (size_t i = 0; i < wanted.size(); i++)
+		{
+			uint32_t level = pageLevel(wanted[i]), x = pageX(wanted[i]), y = pageY(wanted[i]);
+			if (level >= file.levels() || x >= pagesPerSide(file.size(), level) || y >= pagesPerSide(file.size(), level))
+				continue;
+			if (resident.count(wanted[i]))
+				stats.hits++;
+			for (; level < file.levels(); level++, x /= 2, y /= 2)
+			{
+				uint32_t page = pageId(level, x, y);
+				std::unordered_map<uint32_t, int>::iterator found = resident.find(page);
+				if (found != resident.end())
+					slots[found->second].lastWanted = frame;
+				else if (!requested.count(page))
+					missing.push_back(page);
+			}
+		}
+		std::sort(missing.begin(), missing.end());
+		missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+		// Level in the high bits : coarsest last
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t i = missing.size(); i-- > 0 && requested.size() < VT_MAX_REQUESTS;)
+		{
+			requested.insert(missing[i]);
+			queue.push_back(missing[i]);
+		}
+		wake.notify_one();
+	}
+
+	// A free slot, or the one wanted the longest ago if the last readback did not want it, -1 otherwise
+	int victim() const
+	{
+		int best = -1;
+		for (size_t s = 0; s < slots.size(); s++)
+		{
+			if (slots[s].pinned)
+				continue;
+			if (slots[s].page == NO_PAGE)
+				return (int)s;
+			if (best < 0 || slots[s].lastWanted < slots[best].lastWanted)
+				best = (int)s;
+		}
+		return best >= 0 && (slots[best].lastWanted < feedbackFrame || !feedbackFrame) ? best : -1;
+	}
+
+	void upload(const LoadedPage &page, int slot)
+	{
+		glBindTexture(GL_TEXTURE_2D, physicalTexture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % cacheSide) * PAGE_SLOT, (slot / cacheSide) * PAGE_SLOT, PAGE_SLOT, PAGE_SLOT, GL_RGBA,
+						GL_UNSIGNED_BYTE, page.texels.data());
+		glBindTexture(GL_TEXTURE_2D, 0);
+		slots[slot].page = page.page;
+		slots[slot].lastWanted = frame;
+		resident[page.page] = slot;
+		tableDirty = true;
+	}
+
+	// Coarsest level first, a missing page takes the entry of its parent
+	void rebuildTable()
+	{
+		glBindTexture(GL_TEXTURE_2D, pageTableTexture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		for (uint32_t l = file.levels(); l-- > 0;)
+		{
+			uint32_t pages = pagesPerSide(file.size(), l);
+			uint32_t parentPages = pagesPerSide(file.size(), std::min(l + 1, file.levels() - 1));
+			for (uint32_t y = 0; y < pages; y++)
+				for (uint32_t x = 0; x < pages; x++)
+				{
+					std::unordered_map<uint32_t, int>::const_iterator found = resident.find(pageId(l, x, y));
+					uint32_t &entry = table[l][y * pages + x];
+					if (found != resident.end())
+						entry = (found->second % cacheSide) | (found->second / cacheSide) << 8 | l << 16 | 0xffu << 24;
+					else
+						entry = table[l + 1][(y / 2) * parentPages + x / 2];
+				}
+			glTexSubImage2D(GL_TEXTURE_2D, l, 0, 0, pages, pages, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, table[l].data());
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+		tableDirty = false;
+	}
+
+	void loaderLoop()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;)
+		{
+			wake.wait(lock, [this] { return stopped || !queue.empty(); });
+			if (stopped)
+				return;
+			LoadedPage page;
+			page.page = queue.front();
+			queue.pop_front();
+			lock.unlock();
+			page.texels.resize(PAGE_SLOT * PAGE_SLOT);
+			if (file.read(pageLevel(page.page), pageX(page.page), pageY(page.page), page.texels.data()))
+				bytesRead += PAGE_BYTES;
+			else
+				page.texels.clear();
+			lock.lock();
+			loaded.push_back(std::move(page));
+		}
+	}
+
+	void stopLoader()
+	{
+		if (!loader.joinable())
+			return;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopped = true;
+			queue.clear();
+		}
+		wake.notify_one();
+		loader.join();
+		loaded.clear();
+		requested.clear();
+	}
+
+	PageFile file; // read by the loader thread only, once it runs
+	GLuint physicalTexture;
+	GLuint pageTableTexture;
+	GLuint feedbackFramebuffer;
+	GLuint feedbackColor;
+	GLuint feedbackDepth;
+	GLuint feedbackShader;
+	GLuint pbos[VT_FEEDBACK_SLOTS];
+	GLsync fences[VT_FEEDBACK_SLOTS];
+	int cacheSide;
+	int feedbackWidth;
+	int feedbackHeight;
+	uint64_t frame;
+	uint64_t feedbackFrame; // frame of the last readback analyzed
+	int head;
+	int pending;
+	bool tableDirty;
+	std::vector<Slot> slots;
+	std::unordered_map<uint32_t, int> resident; // page to slot
+	std::unordered_set<uint32_t> requested;     // asked to the loader, not uploaded yet
+	std::vector<std::vector<uint32_t> > table;  // page table levels
+	std::vector<uint32_t> wanted;
+	std::vector<uint32_t> missing;
+	VirtualTextureStats stats;
+
+	std::thread loader;
+	std::mutex mutex; // guards queue, loaded and stopped
+	std::condition_variable wake;
+	std::deque<uint32_t> queue;
+	std::deque<LoadedPage> loaded;
+	std::atomic<uint64_t> bytesRead;
+	bool stopped;
+};
+
+#endif